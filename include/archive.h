@@ -0,0 +1,96 @@
+#ifndef _H_ARCHIVE
+#define _H_ARCHIVE
+
+#include <time.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "screener.h"
+#include "universe.h"
+#include "option_table.h"
+
+#define ARCHIVE_ENV "SCREENER_ARCHIVE"       // directory of daily segments, empty to keep none
+#define ARCHIVE_DIRECTORY "archive"
+#define ARCHIVE_AS_OF_ENV "SCREENER_AS_OF"   // YYYYMMDD, screens that day's archived chains instead of today's
+#define ARCHIVE_SUFFIX ".chain"
+#define ARCHIVE_MAGIC "OSCRARCH"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_ALIGNMENT 64
+
+/* How one column of one ticker's block is packed */
+enum ArchiveCodec {
+   ARCHIVE_RAW,               // the bytes as they are
+   ARCHIVE_DELTA,             // integers, zigzag varints of the change from the row before
+   ARCHIVE_CENTS,             // floats that are whole cents, packed as ARCHIVE_DELTA of the cents
+   ARCHIVE_XOR                // any other float, varints of its bits xored with the row before's
+};
+
+/*
+ * The archived columns, with how each is packed. Contract type is not stored, each ticker's calls
+ * come before its puts and its entry counts both.
+ */
+#define ARCHIVE_COLUMNS(X)                      \
+   X(char, in_the_money, BYTES)                 \
+   X(long, expiration_date, INTEGER)            \
+   X(int, days_til_expiration, INTEGER)         \
+   X(float, strike, DECIMAL)                    \
+   X(long, volume, INTEGER)                     \
+   X(long, open_interest, INTEGER)              \
+   X(float, bid, DECIMAL)                       \
+   X(float, ask, DECIMAL)                       \
+   X(float, last_price, DECIMAL)                \
+   X(float, percent_change, DECIMAL)            \
+   X(float, implied_volatility, DECIMAL)
+
+/*
+ * One segment per trading day, named YYYYMMDD.chain and never rewritten once it exists. This header
+ * is followed by one struct ArchiveTicker per ticker, sorted by name, and then each ticker's block:
+ * every archived column in turn, as a codec byte, a 32 bit length and the packed values. A ticker's
+ * block is contiguous, so reading one ticker of one day only touches its index entry and its block.
+ */
+struct ArchiveHeader {
+   char magic[8];
+   uint32_t version;
+   int32_t date;              // YYYYMMDD
+   int64_t ticker_count;
+   int64_t row_count;
+   uint64_t tickers_offset;
+   uint64_t file_size;
+};
+
+struct ArchiveTicker {
+   char ticker[TICK_SIZE];
+   char reserved[2];
+   uint32_t call_count;
+   uint32_t put_count;
+   float curr_price;
+   float iv20;
+   float iv50;
+   float iv100;
+   uint32_t size;             // bytes in the block
+   uint64_t offset;           // of the block, from the start of the file
+};
+
+/* One mapped segment */
+struct ArchiveDay {
+   void *mapping;
+   size_t size;
+   struct ArchiveHeader *header;
+   struct ArchiveTicker *tickers;
+};
+
+const char *archive_directory(void);
+time_t archive_time(int date, int days);
+int archive_day(time_t t);
+int archive_date(struct Universe *universe);
+void archive_append(struct Universe *universe);
+
+int archive_open(struct ArchiveDay *day, const char *directory, int date);
+struct ArchiveTicker *archive_find(struct ArchiveDay *day, const char *ticker);
+int archive_read(struct ArchiveDay *day, struct ArchiveTicker *entry, struct OptionTable *options, int parent);
+void archive_close(struct ArchiveDay *day);
+long archive_range(const char *directory, int from, int to, int **dates);
+
+int archive_load(struct Universe *universe, const char *directory, int date, struct Universe *history);
+
+#endif
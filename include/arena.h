@@ -0,0 +1,38 @@
+#ifndef _H_ARENA
+#define _H_ARENA
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define ARENA_CHUNK_SIZE (1 << 20)
+#define ARENA_ALIGNMENT 16
+
+struct ArenaChunk {
+   struct ArenaChunk *next;
+   size_t size;               // usable bytes in data
+   size_t used;
+   unsigned char data[];
+};
+
+/*
+ * Region allocator for everything belonging to one screening run. Allocations are bumped out of
+ * large chunks and are never freed individually; arena_reset hands every chunk back for the next
+ * run so a process that reloads repeatedly holds flat memory, and arena_free releases it all.
+ */
+struct Arena {
+   struct ArenaChunk *head;
+   struct ArenaChunk *current;
+   void *last;                // most recent allocation, the only one arena_grow can extend in place
+   size_t reserved;           // bytes held in chunks
+   pthread_mutex_t lock;      // the loaders allocate from the same arena in parallel
+};
+
+void arena_init(struct Arena *arena);
+void *arena_alloc(struct Arena *arena, size_t size);
+void *arena_calloc(struct Arena *arena, size_t num, size_t size);
+void *arena_grow(struct Arena *arena, void *prev, size_t old_size, size_t new_size);
+void arena_reset(struct Arena *arena);
+void arena_free(struct Arena *arena);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _H_BACKTEST
+#define _H_BACKTEST
+
+#include "screener.h"
+#include "batch.h"
+
+#define BACKTEST_DEFAULT_TOP 10      // picks per day for a spec without top
+
+/* One pick of one spec on one archived day, and what became of it. Prices are per share */
+struct BacktestTrade {
+   int date;                  // YYYYMMDD it was picked
+   int exit_date;             // YYYYMMDD it was closed, 0 while the history does not reach that far
+   char ticker[TICK_SIZE];
+   char type;                 // call = TRUE, put = FALSE
+   float strike;
+   long expiration_date;      // in epoch time
+   float weight;              // total weight when picked
+   float entry;               // midpoint paid, or the last trade when the quote is one sided
+   float exit;                // midpoint on exit_date, or intrinsic value at expiration
+};
+
+/*
+ * Replays the screen on every archived day in [from, to], YYYYMMDD, and follows the picks of every
+ * spec: the top contracts by total weight that match it, bought at the day's midpoint and held for
+ * the spec's hold days, or to expiration without one. A pick whose holding period ends before it
+ * expires is sold at the midpoint on the last archived day of that period, and one held to
+ * expiration is settled at its intrinsic value from that day's close. Each day is rebuilt from its
+ * archived chains and the bars up to it, with days screened in parallel on the thread pool and every
+ * worker reusing one universe's memory from day to day. Trades go to each spec's out as CSV and a
+ * summary per spec to stdout. Picks are always single contracts, a spec's strategy is not replayed.
+ * Returns FALSE if no day was archived or a trade list could not be written.
+ */
+int backtest_run(const char *directory, int from, int to, struct QuerySpec *specs, long spec_count);
+
+#endif
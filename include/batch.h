@@ -0,0 +1,53 @@
+#ifndef _H_BATCH
+#define _H_BATCH
+
+#include "screener.h"
+#include "universe.h"
+#include "query_index.h"
+
+#define QUERY_SPEC_LENGTH 1024
+#define QUERY_OUTPUT_LENGTH 256
+#define QUERY_STDOUT "-"
+
+#define QUERY_ALL 0
+#define QUERY_CALLS 1
+#define QUERY_PUTS 2
+
+/*
+ * One screen to run against a loaded universe, written as whitespace separated key=value pairs:
+ *
+ *    max_price=2.5 min_weight=50 type=put min_dte=7 max_dte=45 top=20 out=puts.csv format=csv
+ *
+ * Every key is optional. Without out the report goes to stdout, and without format the output's
+ * extension picks one, as it does for the interactive loop. strikes keeps only contracts within that
+ * many strikes of the money in their expiration, top only that many of the matches with the highest
+ * total weight, and hold is how many days a backtest keeps each pick, see backtest.h.
+ *
+ * strategy=vertical, calendar, straddle, strangle or condor searches multi-leg strategies instead,
+ * see strategy.h. max_cost caps a strategy's net debit, max_width the distance from its lowest strike
+ * to its highest, and min_reward its max gain over max loss when the gain is bounded; top is then the
+ * number of strategies returned, 50 without it. max_price and min_weight only apply to single contracts.
+ */
+struct QuerySpec {
+   float max_option_price;
+   float min_weight;
+   int type;                  // QUERY_ALL, QUERY_CALLS or QUERY_PUTS
+   int min_dte;
+   int max_dte;
+   int top;                   // 0 keeps every match
+   int strikes;               // -1 keeps every strike, otherwise only those this many rungs from the money
+   int hold;                  // days, 0 holds to expiration
+   int strategy;              // enum StrategyKind, STRATEGY_NONE for single contracts
+   float max_cost;
+   float max_width;
+   float min_reward;
+   int format;                // enum ReportFormat, or -1 to go by the output's extension
+   char output[QUERY_OUTPUT_LENGTH];
+};
+
+int query_spec_parse(const char *text, struct QuerySpec *spec);
+long query_spec_rows(struct QueryIndex *index, struct Universe *universe, struct QuerySpec *spec, long **rows);
+long query_specs_collect(char **args, int arg_count, struct QuerySpec **specs);
+int batch_run(struct Universe *universe, struct QueryIndex *index, struct QuerySpec *specs, long spec_count);
+
+#endif
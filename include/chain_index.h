@@ -0,0 +1,39 @@
+#ifndef _H_CHAIN_INDEX
+#define _H_CHAIN_INDEX
+
+#include "screener.h"
+#include "option_table.h"
+#include "arena.h"
+
+#define CHAIN_NO_ROW -1
+
+/*
+ * Every stock's chain as expirations, each with a ladder of strikes holding the call and the put at
+ * that strike side by side. A stock's expirations are [expiries_begin, expiries_end) in struct
+ * ParentStock, ascending, and expiration e's rungs are [rungs_begin[e], rungs_end[e]), by ascending
+ * strike. Every contract is in it, open or not. A stock's expirations and rungs are stored from its
+ * calls_begin on, as there are never more of them than it has contracts, so stocks are indexed in
+ * parallel without sharing anything. Built once per screening run, in the run's arena.
+ */
+struct ChainIndex {
+   long size;                 // contracts it was built over, the length of every array
+   long *expiration_date;     // expiration -> in epoch time
+   long *rungs_begin;         // expiration -> its first rung
+   long *rungs_end;
+   float *strike;             // rung -> strike
+   long *call;                // rung -> call's row, CHAIN_NO_ROW if the strike has no call
+   long *put;                 // rung -> put's row, CHAIN_NO_ROW if the strike has no put
+};
+
+void chain_index_build(struct ChainIndex *chains, struct ParentStock **parent_array, long parent_array_size, struct OptionTable *options, struct Arena *arena);
+void chain_index_reserve(struct ChainIndex *chains, struct OptionTable *options, struct Arena *arena);
+void chain_index_stock(struct ChainIndex *chains, struct ParentStock *stock, struct OptionTable *options);
+
+// lookups, each a binary search
+long chain_expiry(struct ChainIndex *chains, struct ParentStock *stock, long expiration_date);
+long chain_nearest_strike(struct ChainIndex *chains, long expiry, float price);
+long chain_rung(struct ChainIndex *chains, long expiry, float strike);
+long chain_window(struct ChainIndex *chains, long expiry, float low, float high, long *end);
+long chain_nearest_delta(struct ChainIndex *chains, struct OptionTable *options, long expiry, char type, float delta);
+
+#endif
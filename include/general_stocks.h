@@ -2,27 +2,33 @@
 #define _H_GENERAL_STOCKS
 
 #include "screener.h"
+#include "price_table.h"
+#include "option_table.h"
+#include "symbols.h"
+#include "universe.h"
+#include "options.h"
 
-long historical_array_size;
-long all_options_size;
-struct HistoricalPrice **historical_price_array;
-struct option **all_options;
+#define PRICES_DB "historicalPrices"
+#define OPTIONS_DB "optionsData"
+
+/* Arguments for running gather_data on its own thread */
+struct PriceLoad {
+   struct SymbolTable *symbols;
+   struct PriceTable *prices;
+};
 
 // collecting historical prices
-int historical_price_callback(void *NotUsed, int argc, char **argv, char **azColName);
-struct ParentStock **gather_tickers(long *pa_size);
-void gather_data(void);
+void gather_tickers(struct Universe *universe);
+void gather_data(struct SymbolTable *symbols, struct PriceTable *prices);
+int *link_tickers(struct Universe *universe, struct TickerVolatility *volatility, long volatility_size);
 
 // historical price functionality
-void average_perc_change(struct ParentStock *stock);
-void perc_from_high_low(struct ParentStock *stock);
-void large_price_drop(struct ParentStock *stock);
-void price_trend(struct ParentStock *stock);
+void price_analytics(struct ParentStock *stock, struct PriceTable *prices);
+long *screening_costs(struct ParentStock **parent_array, long parent_array_size);
 
 // write function to find all stocks that have had a 7.5% drop or gain in one or two days the past 10 days
 //
 
-void find_curr_stock_price(struct ParentStock *stock);
-void avg_stock_close(struct ParentStock *stock);
+void find_curr_stock_price(struct ParentStock *stock, struct PriceTable *prices);
 
 #endif
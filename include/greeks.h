@@ -0,0 +1,32 @@
+#ifndef _H_GREEKS
+#define _H_GREEKS
+
+#include "screener.h"
+#include "option_table.h"
+
+#define GREEKS_RATE_ENV "SCREENER_RATE"
+#define GREEKS_DEFAULT_RATE 0.05    // risk free rate, continuously compounded
+#define GREEKS_IV_ENV "SCREENER_IV"  // solved (the default) or quoted, to keep the collector's implied volatility
+
+/*
+ * Black-Scholes greeks for every contract of [begin, end), open or not, from the stock's current
+ * price, the strike, days to expiration and implied volatility, with no dividends. Delta and gamma
+ * are per dollar of the stock, theta per calendar day, vega per point of volatility and rho per
+ * point of the rate. exp, log and the normal CDF are float approximations good to about 1e-6, the
+ * same ones in every lane width, so SCREENER_KERNEL only changes how many contracts go at once.
+ */
+void greeks_contracts(struct OptionTable *options, long begin, long end, struct ParentStock *stock);
+
+/*
+ * Inverts Black-Scholes for every contract of [begin, end) whose midpoint, or last trade when the
+ * quote is one sided, lies inside the no arbitrage bounds, and overwrites its implied volatility with
+ * the result. Each contract starts from the solution 8 rows back when that one is on the same side of
+ * the same expiration, and from Corrado and Miller's closed form otherwise, then takes safeguarded
+ * Newton steps. Rows are in database order, so that contract can be any strike of the expiration; it
+ * only has to be a sane volatility for the chain. Contracts with no solution keep their quoted volatility.
+ */
+void solve_volatility(struct OptionTable *options, long begin, long end, struct ParentStock *stock);
+float greeks_price(char type, float spot, float strike, int days, float sigma);
+float greeks_rate(void);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _H_JSON
+#define _H_JSON
+
+#include <sys/types.h>
+
+#define JSON_MAX_DEPTH 64
+#define JSON_NUMBER_LENGTH 64
+
+enum JsonType {
+   JSON_END,                  // the input is used up
+   JSON_ERROR,                // malformed or too deeply nested, every later call returns this too
+   JSON_OBJECT,
+   JSON_OBJECT_END,
+   JSON_ARRAY,
+   JSON_ARRAY_END,
+   JSON_KEY,                  // a string followed by its ':'
+   JSON_STRING,
+   JSON_NUMBER,
+   JSON_TRUE,
+   JSON_FALSE,
+   JSON_NULL
+};
+
+/* What json_next will accept next, which is what tells a comma between elements from a stray one */
+enum JsonExpect {
+   JSON_EXPECT_VALUE,         // at the start, after a key or after a comma
+   JSON_EXPECT_VALUE_OR_END,  // just inside a '{' or '['
+   JSON_EXPECT_COMMA_OR_END   // after a value
+};
+
+/* One token. Strings and keys point into the input, still escaped and without their quotes */
+struct JsonToken {
+   enum JsonType type;
+   const char *text;
+   size_t length;
+   double number;
+};
+
+/*
+ * Pull parser over one buffer. Each call to json_next returns the next token in a single forward
+ * pass, so a caller walks the document and keeps only what it wants, in whatever order the keys
+ * come. Nothing is allocated and the input is never copied.
+ */
+struct JsonParser {
+   const char *data;
+   size_t size;
+   size_t position;
+   int depth;
+   int failed;
+   enum JsonExpect expect;
+};
+
+void json_init(struct JsonParser *parser, const char *data, size_t size);
+enum JsonType json_next(struct JsonParser *parser, struct JsonToken *token);
+int json_skip(struct JsonParser *parser, struct JsonToken *token);
+int json_is(struct JsonToken *token, const char *text);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _H_OPTION_TABLE
+#define _H_OPTION_TABLE
+
+#include "screener.h"
+#include "arena.h"
+
+#define OPTION_TABLE_MIN_CAPACITY 1024
+
+/*
+ * Every column of the option table, in order. Each entry expands to one contiguous
+ * array inside struct OptionTable, so adding a field to every contract is a one line change.
+ */
+#define OPTION_TABLE_COLUMNS(X)                                                     \
+   X(int, parent)                 /* stock index, symbol id while loading */        \
+   X(char, type)                  /* call/put (call = TRUE, put = FALSE) */         \
+   X(char, in_the_money)          /* TRUE/FALSE */                                  \
+   X(char, open)                  /* FALSE once screened out */                     \
+   X(long, expiration_date)       /* in epoch time */                               \
+   X(int, days_til_expiration)                                                      \
+   X(float, strike)                                                                 \
+   X(long, volume)                                                                  \
+   X(long, open_interest)                                                           \
+   X(float, bid)                                                                    \
+   X(float, ask)                                                                    \
+   X(float, last_price)                                                             \
+   X(float, percent_change)                                                         \
+   X(float, implied_volatility)                                                     \
+   X(float, delta)                /* Black-Scholes greeks, filled by greeks.c */    \
+   X(float, theta)                                                                  \
+   X(float, beta)                                                                   \
+   X(float, gamma)                                                                  \
+   X(float, vega)                                                                   \
+   X(float, rho)                                                                    \
+   X(float, weight)               /* weight for the specific option */              \
+   X(float, perc_from_strike)                                                       \
+   X(float, perc_from_iv20)                                                         \
+   X(float, perc_from_iv50)                                                         \
+   X(float, perc_from_iv100)                                                        \
+   X(float, one_std_deviation)
+
+/*
+ * Struct-of-arrays store for every contract in the universe. Rows belonging to one
+ * stock are contiguous, calls first and then puts, and are addressed through the
+ * [begin, end) ranges kept in struct ParentStock.
+ */
+struct OptionTable {
+   long size;
+   long capacity;
+   struct Arena *arena;       // every column lives in the universe's arena
+#define OPTION_TABLE_FIELD(type, name) type *name;
+   OPTION_TABLE_COLUMNS(OPTION_TABLE_FIELD)
+#undef OPTION_TABLE_FIELD
+};
+
+void option_table_init(struct OptionTable *table, struct Arena *arena);
+void option_table_reserve(struct OptionTable *table, long capacity);
+long option_table_append(struct OptionTable *table);
+void option_table_group(struct OptionTable *table, struct ParentStock **parent_array, long parent_array_size);
+
+#endif
@@ -2,23 +2,42 @@
 #define _H_OPTIONS
 
 #include "screener.h"
+#include "option_table.h"
+#include "price_table.h"
+#include "symbols.h"
 
 #define MAX_BID_ASK_ERROR 0.15
 
+/* Per ticker volatility read alongside the contracts, indexed by symbol id while loading */
+struct TickerVolatility {
+   float iv20;
+   float iv50;
+   float iv100;
+};
+
+/* Shared arguments for screening or scoring one stock per thread pool task */
+struct ScreenJob {
+   struct ParentStock **parent_array;
+   struct PriceTable *prices;
+   struct OptionTable *options;
+};
+
 // collecting options
-void screen_volume_oi_baspread(struct ParentStock **parent_array, int parent_array_size); // done
-void gather_options(struct ParentStock **parent_array, long parent_array_size);           // done
-int options_callback(void *NotUsed, int argc, char **argv, char **azColName);              // done
-void copy_option(struct option *new_option, struct option *old);                           // done
-void gather_options_data(void);                                                            // done
+void screen_stock(struct ParentStock *stock, struct PriceTable *prices, struct OptionTable *options);                                             // done
+void screen_volume_oi_baspread(struct ParentStock **parent_array, int parent_array_size, struct PriceTable *prices, struct OptionTable *options); // done
+void gather_options(struct ParentStock **parent_array, long parent_array_size, int *parent_of, struct OptionTable *options,
+                    struct TickerVolatility *volatility, long volatility_size);                                                                // done
+void gather_options_data(struct SymbolTable *symbols, struct OptionTable *options, struct TickerVolatility **volatility, long *volatility_size); // done
 
 // sepcific option functionality
-void calc_basic_data(struct ParentStock **parent_array, int parent_array_size, float max_option_price, float min_weight); // done
-void one_std_deviation(struct option *opt);                                                                                // weight - in progress
-void perc_from_strike(struct option *opt);                                                                                 // done
-int bid_ask_spread(struct option *opt);                                                                                    // done
-void perc_from_ivs(struct option *opt);                                                                                    // done
-void dte_weight(struct option *opt);                                                                                       // done
-void iv_below(struct option *opt);                                                                                         // done
+void calc_stock_data(struct ParentStock *stock, struct PriceTable *prices, struct OptionTable *options);                                          // done
+void calc_basic_data(struct ParentStock **parent_array, int parent_array_size, struct PriceTable *prices, struct OptionTable *options, float max_option_price, float min_weight); // done
+void one_std_deviation(struct OptionTable *options, long i, struct ParentStock *stock);                                                               // weight - in progress
+void perc_from_strike(struct OptionTable *options, long i, struct ParentStock *stock);                                                                // done
+int bid_ask_spread(struct OptionTable *options, long i);                                                                                              // done
+void perc_from_ivs(struct OptionTable *options, long i, struct ParentStock *stock);                                                                   // done
+void dte_weight(struct OptionTable *options, long i);                                                                                                 // done
+void iv_below(struct OptionTable *options, long i, struct ParentStock *stock);                                                                        // done
+float total_weight(struct ParentStock *stock, struct OptionTable *options, long i);                                                                  // done
 
 #endif
@@ -0,0 +1,38 @@
+#ifndef _H_PRICE_TABLE
+#define _H_PRICE_TABLE
+
+#include "screener.h"
+#include "arena.h"
+
+#define PRICE_TABLE_MIN_CAPACITY 4096
+
+/* Every column of the price table, in order. Each entry expands to one contiguous array */
+#define PRICE_TABLE_COLUMNS(X)                                                \
+   X(int, parent)                 /* stock index, symbol id while loading */  \
+   X(long, date)                  /* in epoch time */                         \
+   X(float, open)                                                             \
+   X(float, low)                                                              \
+   X(float, high)                                                             \
+   X(float, close)                                                            \
+   X(long, volume)
+
+/*
+ * Struct-of-arrays store for the daily bars of every stock. Bars belonging to one stock
+ * are contiguous and in date order, addressed through [prices_begin, prices_end) in
+ * struct ParentStock.
+ */
+struct PriceTable {
+   long size;
+   long capacity;
+   struct Arena *arena;       // every column lives in the universe's arena
+#define PRICE_TABLE_FIELD(type, name) type *name;
+   PRICE_TABLE_COLUMNS(PRICE_TABLE_FIELD)
+#undef PRICE_TABLE_FIELD
+};
+
+void price_table_init(struct PriceTable *table, struct Arena *arena);
+void price_table_reserve(struct PriceTable *table, long capacity);
+long price_table_append(struct PriceTable *table);
+void price_table_group(struct PriceTable *table, struct ParentStock **parent_array, long parent_array_size);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _H_QUERY_INDEX
+#define _H_QUERY_INDEX
+
+#include "screener.h"
+#include "option_table.h"
+#include "arena.h"
+
+/*
+ * Every open contract with its total weight (contract + stock + calls/puts weight), sorted by
+ * total weight, highest first. A min-weight threshold is then a prefix found by binary search,
+ * and a segment tree of the smallest bid under each node finds the contracts in that prefix
+ * below a max price without looking at the ones above it. Built once per screening run, in the
+ * run's arena.
+ */
+struct QueryIndex {
+   long size;
+   long leaves;               // power of two at least size, the first leaf of min_bid
+   float *weight;             // total weight, descending
+   float *bid;
+   long *row;                 // row in the option table
+   float *min_bid;            // segment tree over bid, node 1 is the root and node n has children 2n, 2n + 1
+   int averages_count;        // find_averages, worked out while building
+   float averages_sum;
+   float averages_low;
+   float averages_high;
+};
+
+void query_index_build(struct QueryIndex *index, struct ParentStock **parent_array, long parent_array_size, struct OptionTable *options, struct Arena *arena);
+long query_index_find(struct QueryIndex *index, float max_option_price, float min_weight, long **rows);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _H_REALIZED
+#define _H_REALIZED
+
+#include "screener.h"
+#include "price_table.h"
+
+#define REALIZED_ENV "SCREENER_HV"    // close (the default), parkinson, yang_zhang or quoted
+#define TRADING_DAYS 252
+
+/* Which estimate becomes iv20, iv50 and iv100 */
+enum RealizedEstimator {
+   REALIZED_CLOSE,
+   REALIZED_PARKINSON,
+   REALIZED_YANG_ZHANG,
+   REALIZED_QUOTED            // keep the collector's values, estimating only the ones it did not have
+};
+
+enum RealizedEstimator realized_estimator(void);
+
+/*
+ * Close to close, Parkinson and Yang-Zhang volatility over the last 20, 50 and 100 days of a stock's
+ * bars, annualized over TRADING_DAYS and in points like the collector's, then iv20, iv50 and iv100
+ * from the chosen estimator. The windows are nested, so a single backward sweep over at most the
+ * last 101 bars fills all three. Bars with a missing or non-positive price are stepped over, and a
+ * stock with fewer bars than a window uses all it has.
+ */
+void realized_volatility(struct ParentStock *stock, struct PriceTable *prices);
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef _H_REPORT
+#define _H_REPORT
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "screener.h"
+#include "option_table.h"
+
+#define REPORT_BUFFER_SIZE (1 << 16)
+#define REPORT_MAGIC "OSCRRPT"
+#define REPORT_VERSION 2
+#define REPORT_MEMORY -1             // fd of a sink that buffers the whole report instead of writing it
+#define REPORT_STRATEGY_LEGS 4       // legs in every strategy record, STRATEGY_MAX_LEGS
+
+struct Strategy;
+
+enum ReportFormat {
+   REPORT_TABLE,              // the aligned, tab separated view print_data has always shown
+   REPORT_CSV,
+   REPORT_JSONL,
+   REPORT_BINARY
+};
+
+/* Starts a binary report, followed by one struct ReportRecord per contract */
+struct ReportHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t record_size;
+};
+
+/* One contract in a binary report, 88 bytes in native byte order */
+struct ReportRecord {
+   char ticker[TICK_SIZE];
+   char type;                 // call = TRUE, put = FALSE
+   char in_the_money;
+   int32_t days_til_expiration;
+   int64_t expiration_date;
+   int64_t volume;
+   int64_t open_interest;
+   float stock_price;
+   float strike;
+   float bid;
+   float ask;
+   float implied_volatility;
+   float weight;
+   float delta;
+   float gamma;
+   float theta;
+   float vega;
+   float rho;
+};
+
+/* One leg of a strategy record, zeroed past its leg_count */
+struct ReportStrategyLeg {
+   int64_t expiration_date;
+   float strike;
+   char type;                 // call = TRUE, put = FALSE
+   int8_t quantity;           // 1 bought, -1 sold
+   char pad[2];
+};
+
+/*
+ * One strategy in a binary report, 112 bytes in native byte order. A strategy report's header has
+ * this record_size, which is how a reader tells it from a report of contracts.
+ */
+struct ReportStrategyRecord {
+   char ticker[TICK_SIZE];
+   char pad[2];
+   int32_t kind;              // enum StrategyKind
+   int32_t leg_count;
+   float stock_price;
+   float cost;
+   float width;
+   float max_loss;
+   float max_gain;
+   float edge;
+   float score;
+   struct ReportStrategyLeg legs[REPORT_STRATEGY_LEGS];
+};
+
+/*
+ * One destination for a report. Rows are formatted into buffer and written with one write() per
+ * REPORT_BUFFER_SIZE bytes, so a report of any length costs a handful of syscalls. The sink does
+ * not own fd. A REPORT_MEMORY sink writes nothing and grows buffer to hold the whole report.
+ */
+struct ReportSink {
+   int fd;
+   enum ReportFormat format;
+   int last_stock;            // the table view names each stock once, above its first contract
+   size_t used;
+   size_t capacity;
+   char *buffer;
+};
+
+enum ReportFormat report_format(const char *filename);
+void report_open(struct ReportSink *sink, int fd, enum ReportFormat format);
+void report_open_memory(struct ReportSink *sink, enum ReportFormat format);
+void report_clear(struct ReportSink *sink, enum ReportFormat format);
+void report_begin(struct ReportSink *sink);
+void report_row(struct ReportSink *sink, struct ParentStock **parent_array, struct OptionTable *options, long row);
+void report_begin_strategies(struct ReportSink *sink);
+void report_strategy(struct ReportSink *sink, struct ParentStock **parent_array, struct OptionTable *options, struct Strategy *strategy);
+void report_flush(struct ReportSink *sink);
+void report_close(struct ReportSink *sink);
+
+#endif
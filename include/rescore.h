@@ -0,0 +1,9 @@
+#ifndef _H_RESCORE
+#define _H_RESCORE
+
+#include "screener.h"
+#include "universe.h"
+
+long rescore_universe(struct Universe *universe, struct Universe *previous);
+
+#endif
@@ -26,10 +26,10 @@
 /*
  * STRUCTURE:
  * 
- * EACH OPTION WILL HAVE A STRUCT WITH ALL OF THE CONTENTS OF THE DATA IN DATAOPTIONS DB
- * THEY WILL HAVE A POINTER TO THE PARENT TICKER WITH LISTS FULL OF HISTORICAL OPEN, CLOSE, HIGH, LOW, VOLUME, DATE ETC.
- * THERE WILL BE ONE LIST IN THE PARENT, WHICH WILL CONTAIN A STRUCT CONTAINING THE DATA, OPEN, CLOSE, HIGH, LOW, VOLUME, ETC. FOR THE DAY
- * EACH PARENT WILL HAVE A LIST OF CALLS AND PUTS, FULL OF THE STRUCTS USED FOR OPTIONS
+ * EACH OPTION IS ONE ROW OF THE COLUMNAR OPTION TABLE (option_table.h) WITH ALL OF THE CONTENTS OF THE DATA IN DATAOPTIONS DB
+ * EACH ROW KNOWS THE INDEX OF ITS PARENT TICKER WITH LISTS FULL OF HISTORICAL OPEN, CLOSE, HIGH, LOW, VOLUME, DATE ETC.
+ * THERE WILL BE ONE RANGE IN THE PARENT INSIDE THE COLUMNAR PRICE TABLE (price_table.h) CONTAINING THE DATE, OPEN, CLOSE, HIGH, LOW, VOLUME, ETC. FOR EACH DAY
+ * EACH PARENT WILL HAVE A RANGE OF CALLS AND A RANGE OF PUTS INSIDE THE OPTION TABLE
  */
 
 /*
@@ -96,52 +96,39 @@
 #define REGULAR 1
 #define NEW_STOCKS 2
 #define APPEND_STOCKS 3
+#define BATCH 4
+#define DAEMON 5
+#define BACKTEST 6
 #define TICK_SIZE 10
 #define MIN_VOL_LENGTH 10
+#define HV_WINDOWS 3     // realized volatility over 20, 50 and 100 days
 
 #define FALSE 0
 #define TRUE 1
 
-struct option {
-   struct ParentStock *parent; // pointer to parent stock
-   char ticker[10];             // ticker symbol
-   int type;                    // call/put (call = TRUE, put = FALSE)
-   long expiration_date;        // in epoch time
-   int days_til_expiration;
-   float strike;
-   long volume;
-   long open_interest;
-   float bid;
-   float ask;
-   float last_price;
-   float percent_change;
-   int in_the_money; // TRUE/FALSE
-   float implied_volatility;
-   float iv20;
-   float iv50;
-   float iv100;
-   float theta;
-   float beta;
-   float gamma;
-   float vega;
-   float weight; // weight for the specigic option
-   float perc_from_strike;
-   float perc_from_iv20;
-   float perc_from_iv50;
-   float perc_from_iv100;
-   float one_std_deviation;
-};
+struct OptionTable;
+struct QueryIndex;
+struct ReportSink;
 
 struct ParentStock {
-   struct option **calls;                  // list of all calls associated with stock
-   struct option **puts;                   // list of all puts associated with stock
-   struct HistoricalPrice **prices_array; // list of all prices
-   long prices_array_size;
-   int calls_size;
+   long calls_begin;                       // calls occupy [calls_begin, calls_end) of the option table
+   long calls_end;
+   long puts_begin;                        // puts occupy [puts_begin, puts_end) of the option table
+   long puts_end;
+   long prices_begin;                      // daily bars occupy [prices_begin, prices_end) of the price table
+   long prices_end;
+   long expiries_begin;                    // expirations occupy [expiries_begin, expiries_end) of the chain index (chain_index.h)
+   long expiries_end;
    int num_open_calls;
-   int puts_size;
    int num_open_puts;
    char ticker[10]; // ticker symbol
+   long revision;      // collector run that last changed this stock's data, 0 if unknown
+   float iv20;
+   float iv50;
+   float iv100;
+   float hv_close[HV_WINDOWS];             // realized volatility estimates in points, see realized.h
+   float hv_parkinson[HV_WINDOWS];
+   float hv_yang_zhang[HV_WINDOWS];
    float yearly_high;
    float yearly_low;
    float curr_price;
@@ -154,23 +141,13 @@ struct ParentStock {
    float puts_weight;  // weight to be given to every put of original stock
 };
 
-struct HistoricalPrice {
-   char ticker[TICK_SIZE];
-   long date;
-   float open;
-   float low;
-   float high;
-   float close;
-   long volume;
-};
-
-void print_data(struct ParentStock **parent_array, int parent_array_size, float max_option_price, float min_weight, int fd);
-void find_min_vol(struct option **largest_volumes, int *min_vol, int *min_vol_index);
-void print_large_volumes(struct ParentStock **parent_array, int parent_array_size);
-void free_parent_array(struct ParentStock **parent_array, int parent_array_size);
-void find_averages(struct ParentStock **parent_array, int parent_array_size);
+void print_data(struct ParentStock **parent_array, struct OptionTable *options, long *rows, long count, struct ReportSink *sinks, int sink_count);
+void print_large_volumes(struct ParentStock **parent_array, int parent_array_size, struct OptionTable *options, int fd);
+void find_averages(struct QueryIndex *index);
 int callback(void *NotUsed, int argc, char **argv, char **azColName);
 char **parse_args(int argc, char *argv[], int *mode, int *ta_size);
 void free_tick_array(char **tick_array, int ta_size);
+int run_batch(char **spec_args, int spec_count);
+int run_backtest(char **args, int arg_count);
 
 #endif
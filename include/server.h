@@ -0,0 +1,55 @@
+#ifndef _H_SERVER
+#define _H_SERVER
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "screener.h"
+#include "universe.h"
+#include "snapshot.h"
+#include "query_index.h"
+
+#define SERVER_SOCKET "screener.sock"
+#define SERVER_BACKLOG 64
+#define SERVER_POLL_SECONDS 5
+
+/*
+ * The protocol is request/response over a stream socket, any number of requests per connection.
+ * A request is one line, either a query spec in the batch syntax (see batch.h, without out) or
+ * one of the commands:
+ *
+ *    PING      answers with an empty body
+ *    STATS     the generation being served, its size and its weight averages
+ *    RELOAD    loads the databases again, rescores the stocks that changed and swaps the result in,
+ *              then answers as STATS
+ *
+ * Every response is "OK <length>\n" or "ERR <length>\n" followed by exactly length bytes of body,
+ * the report for a query or a message for an error. Reports default to the table view.
+ */
+
+/*
+ * One loaded and scored universe. Every query holds a reference while it runs, so a reload can
+ * swap in a new generation without waiting for them; the old one goes when its last query ends.
+ */
+struct Generation {
+   struct Universe universe;
+   struct QueryIndex index;
+   struct SnapshotSource prices_db;   // the databases it was loaded from
+   struct SnapshotSource options_db;
+   int have_sources;
+   long number;                       // counts up from 1 with every reload
+   long rescored;                     // stocks that had changed and were scored again, the rest kept their scores
+   long references;                   // the server's own, plus one per running query
+};
+
+struct Server {
+   int listen_fd;
+   const char *path;
+   struct Generation *current;
+   pthread_mutex_t lock;              // guards current and every generation's references
+   pthread_mutex_t reload_lock;       // one reload at a time
+};
+
+int server_run(const char *path);
+
+#endif
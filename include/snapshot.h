@@ -0,0 +1,60 @@
+#ifndef _H_SNAPSHOT
+#define _H_SNAPSHOT
+
+#include <stdint.h>
+
+#include "screener.h"
+#include "universe.h"
+
+#define SNAPSHOT_FILE "universe.snapshot"
+#define SNAPSHOT_MAGIC "OSCRSNAP"
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_ALIGNMENT 64
+
+#define SNAPSHOT_COUNT_COLUMN(type, name) +1
+enum {
+   PRICE_TABLE_COLUMN_COUNT = 0 PRICE_TABLE_COLUMNS(SNAPSHOT_COUNT_COLUMN),
+   OPTION_TABLE_COLUMN_COUNT = 0 OPTION_TABLE_COLUMNS(SNAPSHOT_COUNT_COLUMN)
+};
+#undef SNAPSHOT_COUNT_COLUMN
+
+/* Identifies one of the source databases, a snapshot is only used while both still match */
+struct SnapshotSource {
+   int64_t inode;
+   int64_t size;
+   int64_t mtime;                   // nanoseconds, a same-second rewrite of the same size still changes it
+   int64_t wal_size;                // the database's -wal file, 0 when there is none
+   int64_t wal_mtime;
+};
+
+/*
+ * A snapshot is this header followed by the symbol names and hash index, the parents and every
+ * price and option column, each section starting on a SNAPSHOT_ALIGNMENT boundary. All offsets
+ * are from the start of the file, so the whole thing can be mapped and used in place.
+ */
+struct SnapshotHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t layout;                 // hash of the column lists and struct sizes it was written with
+   struct SnapshotSource prices_db;
+   struct SnapshotSource options_db;
+   int64_t symbol_count;
+   int64_t slots_capacity;
+   int64_t parent_count;
+   int64_t price_rows;
+   int64_t option_rows;
+   uint64_t names_offset;
+   uint64_t slots_offset;
+   uint64_t parents_offset;
+   uint64_t price_columns[PRICE_TABLE_COLUMN_COUNT];
+   uint64_t option_columns[OPTION_TABLE_COLUMN_COUNT];
+   uint64_t file_size;
+};
+
+int snapshot_sources(struct SnapshotSource *prices_db, struct SnapshotSource *options_db);
+int snapshot_same_source(struct SnapshotSource *a, struct SnapshotSource *b);
+int snapshot_open(struct Universe *universe, const char *filename, struct SnapshotSource *prices_db, struct SnapshotSource *options_db);
+void snapshot_write(struct Universe *universe, const char *filename, struct SnapshotSource *prices_db, struct SnapshotSource *options_db);
+void snapshot_close(struct Universe *universe);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _H_STRATEGY
+#define _H_STRATEGY
+
+#include "screener.h"
+#include "universe.h"
+#include "batch.h"
+#include "report.h"
+
+#define STRATEGY_MAX_LEGS 4
+#define STRATEGY_BEAM 16             // credit spreads kept on each side of an expiration for pairing into condors
+
+enum StrategyKind {
+   STRATEGY_NONE,             // single contracts, what every query returned before
+   STRATEGY_VERTICAL,         // one side, one expiration, two strikes, bought and sold
+   STRATEGY_CALENDAR,         // one side, one strike, the nearer expiration sold and the further bought
+   STRATEGY_STRADDLE,         // a call and a put bought at one strike
+   STRATEGY_STRANGLE,         // a put bought below the stock and a call above it
+   STRATEGY_CONDOR            // a put credit spread below a call credit spread, one expiration
+};
+
+/* One leg of a strategy, a contract bought or sold */
+struct StrategyLeg {
+   long row;                  // row in the option table
+   int quantity;              // 1 bought, -1 sold
+};
+
+/*
+ * One candidate. Prices are per share, legs filled at their midpoints. Its edge is what the legs are
+ * worth at the stock's realized volatility (iv20, iv50 or iv100 by the leg's DTE, as in
+ * one_std_deviation) less what they cost, and its score is that edge per dollar at risk.
+ */
+struct Strategy {
+   enum StrategyKind kind;
+   int stock;                 // index into parent_array
+   int leg_count;
+   struct StrategyLeg legs[STRATEGY_MAX_LEGS];
+   float cost;                // net debit, negative for a credit
+   float width;               // from the lowest strike to the highest
+   float max_loss;
+   float max_gain;            // INFINITY when unbounded, NAN when it depends on a later expiration
+   float edge;
+   float score;
+};
+
+const char *strategy_name(enum StrategyKind kind);
+int strategy_parse(const char *name);
+
+/*
+ * The spec's top strategies of its kind across every stock, best score first, in *strategies to
+ * free. Legs must be open contracts, so each one has passed the volume, open interest and spread
+ * screens, with a two sided quote, inside the spec's type and DTE filters. Candidates are pruned by
+ * bounds before they are scored: the chain index confines a leg's partners to strikes within
+ * max_width, a spread costing more than max_cost is turned away before it is valued, a vertical stops
+ * widening once no wider strike could bring its debit back under max_cost, one with a reward to risk
+ * below min_reward is never scored, and condors only pair the STRATEGY_BEAM best credit spreads on
+ * each side. Each contract's midpoint and model value are worked out once per stock. Stocks are
+ * searched in parallel on the thread pool, and ties go to the earlier stock and legs, so the result
+ * does not depend on the thread count.
+ */
+long strategy_search(struct Universe *universe, struct QuerySpec *spec, struct Strategy **strategies);
+void print_strategies(struct Universe *universe, struct Strategy *strategies, long count, struct ReportSink *sink);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _H_STREAM
+#define _H_STREAM
+
+#include <sys/types.h>
+
+#include "screener.h"
+#include "universe.h"
+
+#define STREAM_FD_ENV "SCREENER_STREAM_FD"
+#define STREAM_COLLECTOR "options_collector.py"
+
+#define STREAM_TICKER 'T'
+#define STREAM_END 'E'
+
+#define STREAM_HEADER_SIZE 5                    // payload length, kind
+#define STREAM_TICKER_SIZE (TICK_SIZE + 24)     // ticker, iv20, iv50, iv100, price count, call count, put count
+#define STREAM_PRICE_SIZE 32                    // date, open, low, high, close, volume
+#define STREAM_OPTION_SIZE 53                   // expiration, dte, strike, volume, open interest, bid, ask, last price, percent change, iv, itm
+#define STREAM_MAX_FRAME (256L << 20)
+
+/*
+ * The collector hands tickers over one frame at a time as it parses them. Every frame is a 5 byte
+ * header, a 32 bit payload length and a kind, followed by the payload, all packed little endian:
+ *
+ *    T   one ticker: its name padded to TICK_SIZE, iv20, iv50 and iv100 as floats, the 32 bit counts
+ *        of its prices, calls and puts, then that many price rows and call rows followed by put rows
+ *    E   every ticker has been sent, empty
+ *
+ * A stream that ends without an E frame means the collection failed.
+ */
+
+pid_t stream_collector(int *fd);
+int gather_stream(struct Universe *universe, int fd);
+
+#endif
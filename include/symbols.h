@@ -0,0 +1,32 @@
+#ifndef _H_SYMBOLS
+#define _H_SYMBOLS
+
+#include <pthread.h>
+
+#include "screener.h"
+#include "arena.h"
+
+#define SYMBOL_TABLE_MIN_CAPACITY 1024
+#define NO_SYMBOL -1
+
+/*
+ * Interns ticker strings to dense integer ids, [0, size), in order of first appearance.
+ * Both loaders share one table so prices and options join on the id instead of relying on
+ * both tables coming back in the same ticker order.
+ */
+struct SymbolTable {
+   long size;                 // number of interned tickers
+   long names_capacity;
+   long slots_capacity;       // always a power of two, kept at most half full
+   char (*names)[TICK_SIZE];  // id -> ticker
+   int *slots;                // open addressing hash index holding ids, NO_SYMBOL when empty
+   struct Arena *arena;
+   pthread_mutex_t lock;      // guards interning while the loaders run in parallel
+};
+
+void symbol_table_init(struct SymbolTable *symbols, struct Arena *arena);
+int symbol_intern(struct SymbolTable *symbols, const char *ticker);
+int symbol_lookup(struct SymbolTable *symbols, const char *ticker);
+void symbol_table_free(struct SymbolTable *symbols);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _H_THREAD_POOL
+#define _H_THREAD_POOL
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#define THREAD_POOL_ENV "SCREENER_THREADS"
+#define THREAD_POOL_MAX_THREADS 256
+
+/* Work runs task(i, arg) for one task index. Tasks of one run must not touch each other's data */
+typedef void (*ThreadTask)(long task, void *arg);
+
+/* Task indices dealt to one worker, taken from the front by the owner and from the back by thieves */
+struct WorkDeque {
+   long *tasks;
+   long head;
+   long tail;
+   pthread_mutex_t lock;
+};
+
+/*
+ * Fork-join pool for one batch of independent tasks. Tasks are dealt round-robin by descending cost
+ * (longest processing time first), so every worker starts on the heaviest work it owns, and an idle
+ * worker steals the cheapest task left in another worker's deque.
+ */
+struct ThreadPool {
+   int thread_count;
+   ThreadTask task;
+   void *arg;
+   struct WorkDeque *deques;
+};
+
+int thread_pool_threads(void);
+void thread_pool_run(long task_count, const long *cost, ThreadTask task, void *arg);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _H_TOP_K
+#define _H_TOP_K
+
+#include "screener.h"
+#include "option_table.h"
+
+/* Ranks one contract, larger is better. A NaN rank leaves the contract out */
+typedef double (*RankKey)(struct ParentStock *stock, struct OptionTable *options, long row);
+
+struct TopEntry {
+   double key;
+   long row;                  // row in the option table
+   int stock;                 // index into parent_array
+};
+
+/*
+ * The k best entries seen so far, kept as a min-heap so the worst of them is at the root and a
+ * candidate only costs a compare unless it gets in. Ties go to the lower row, so the result does
+ * not depend on the order entries arrive or partial heaps are merged.
+ */
+struct TopK {
+   int k;
+   int size;
+   struct TopEntry *heap;
+};
+
+void top_k_init(struct TopK *top, int k);
+void top_k_push(struct TopK *top, double key, long row, int stock);
+void top_k_merge(struct TopK *into, struct TopK *from);
+void top_k_sort(struct TopK *top);
+void top_k_free(struct TopK *top);
+
+void top_k_contracts(struct ParentStock **parent_array, long parent_array_size, struct OptionTable *options, RankKey key, struct TopK *top);
+
+// leaderboards
+double rank_volume(struct ParentStock *stock, struct OptionTable *options, long row);
+double rank_open_interest(struct ParentStock *stock, struct OptionTable *options, long row);
+double rank_volume_oi(struct ParentStock *stock, struct OptionTable *options, long row);
+double rank_total_weight(struct ParentStock *stock, struct OptionTable *options, long row);
+double rank_iv_discount(struct ParentStock *stock, struct OptionTable *options, long row);
+
+#endif
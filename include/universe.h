@@ -0,0 +1,32 @@
+#ifndef _H_UNIVERSE
+#define _H_UNIVERSE
+
+#include <sys/types.h>
+
+#include "screener.h"
+#include "arena.h"
+#include "symbols.h"
+#include "price_table.h"
+#include "option_table.h"
+#include "chain_index.h"
+
+/* Everything loaded for one screening run. All of it lives in arena and is released in one call */
+struct Universe {
+   struct Arena arena;
+   struct SymbolTable symbols;
+   struct PriceTable prices;
+   struct OptionTable options;
+   struct ParentStock **parent_array;
+   long parent_array_size;
+   struct ChainIndex chains;  // built once the contracts are scored
+   void *mapping;             // snapshot the tables point into, if the universe came from one
+   size_t mapping_size;
+   int loaded;
+};
+
+void universe_init(struct Universe *universe);
+void universe_load(struct Universe *universe);
+void universe_release(struct Universe *universe);
+void universe_free(struct Universe *universe);
+
+#endif
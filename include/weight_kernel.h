@@ -0,0 +1,30 @@
+#ifndef _H_WEIGHT_KERNEL
+#define _H_WEIGHT_KERNEL
+
+#include "screener.h"
+#include "option_table.h"
+
+#define WEIGHT_KERNEL_ENV "SCREENER_KERNEL"
+#define WEIGHT_KERNEL_CHECK_ENV "SCREENER_KERNEL_CHECK"
+
+/* Instruction sets the batched kernels can run on, picked once per process */
+enum WeightKernel {
+   KERNEL_SCALAR,
+   KERNEL_SSE2,
+   KERNEL_AVX2
+};
+
+enum WeightKernel weight_kernel(void);
+const char *weight_kernel_name(enum WeightKernel kernel);
+
+/*
+ * Batched forms of the per-contract functions in options.c. Each one gives bit for bit the same
+ * columns as calling the scalar functions on every open row of [begin, end) in order, short of
+ * which payload wins when two NaNs meet. SCREENER_KERNEL=scalar|sse2|avx2 forces a path to compare,
+ * and SCREENER_KERNEL_CHECK=1 runs the scalar functions again on a copy of every block the vector
+ * kernel scored and warns on stderr about each value that differs. The kernel's results are kept.
+ */
+void weight_contracts(struct OptionTable *options, long begin, long end, struct ParentStock *stock);
+long screen_spreads(struct OptionTable *options, long begin, long end);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _H_YAHOO
+#define _H_YAHOO
+
+#include <time.h>
+#include <sys/types.h>
+
+#include "screener.h"
+#include "symbols.h"
+#include "price_table.h"
+#include "option_table.h"
+#include "universe.h"
+
+#define YAHOO_RAW_ENV "SCREENER_RAW"
+#define YAHOO_CHART_SUFFIX ".chart.json"
+#define YAHOO_OPTIONS_SUFFIX ".options.json"
+#define YAHOO_VOLATILITY_FILE "volatility.csv"
+
+/*
+ * The collector can leave Yahoo's responses as they came instead of parsing them itself, one file
+ * per request in the directory named by YAHOO_RAW_ENV:
+ *
+ *    <TICKER>.chart.json                v8/finance/chart, a year of daily bars
+ *    <TICKER>.<expiration>.options.json v7/finance/options, one expiration's chain
+ *    volatility.csv                     ticker,iv20,iv50,iv100 for every ticker the volatility page quoted
+ *
+ * Keys are looked up by name, not position, and numbers may be plain or wrapped as the formatted
+ * {"raw": n, "fmt": "..."} objects.
+ */
+
+int yahoo_parse_chart(const char *data, size_t size, struct SymbolTable *symbols, struct PriceTable *prices);
+int yahoo_parse_options(const char *data, size_t size, time_t today, struct SymbolTable *symbols, struct OptionTable *options);
+void gather_raw(struct Universe *universe, const char *directory);
+
+#endif
@@ -0,0 +1,680 @@
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/archive.h"
+#include "../include/general_stocks.h"
+#include "../include/options.h"
+#include "../include/symbols.h"
+#include "../include/arena.h"
+#include "../include/safe.h"
+
+#define ARCHIVE_ALIGN(offset) (((offset) + ARCHIVE_ALIGNMENT - 1) & ~((uint64_t)ARCHIVE_ALIGNMENT - 1))
+#define ARCHIVE_MAX_CENTS 1e15        // beyond this a double no longer holds every cent
+
+/* A growing byte buffer the blocks are packed into */
+struct ArchiveBuffer {
+   unsigned char *data;
+   size_t used;
+   size_t capacity;
+};
+
+/* Bounds checked cursor over one packed column */
+struct ArchiveReader {
+   const unsigned char *at;
+   const unsigned char *end;
+};
+
+/* The directory segments are kept in, NULL if ARCHIVE_ENV is set but empty */
+const char *archive_directory(void) {
+	char *env = getenv(ARCHIVE_ENV);
+
+	if (env == NULL)
+		return ARCHIVE_DIRECTORY;
+
+	return (*env == '\0' ? NULL : env);
+}
+
+/* Local midnight starting the day days after date, YYYYMMDD. days may be negative */
+time_t archive_time(int date, int days) {
+	struct tm tm;
+
+	memset(&tm, 0, sizeof(struct tm));
+	tm.tm_year = date / 10000 - 1900;
+	tm.tm_mon = date / 100 % 100 - 1;
+	tm.tm_mday = date % 100 + days;
+	tm.tm_isdst = -1;
+
+	return mktime(&tm);
+}
+
+/* The local day t falls in, as YYYYMMDD */
+int archive_day(time_t t) {
+	struct tm tm;
+
+	localtime_r(&t, &tm);
+
+	return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+/* The trading day a universe holds, as YYYYMMDD: the day of its newest bar. 0 if it has none */
+int archive_date(struct Universe *universe) {
+	long i, newest;
+	struct ParentStock *stock;
+
+	newest = -1;
+
+	for (i = 0; i < universe->parent_array_size; i++) {
+		stock = universe->parent_array[i];
+
+		if (stock->prices_end > stock->prices_begin && universe->prices.date[stock->prices_end - 1] > newest)
+			newest = universe->prices.date[stock->prices_end - 1];
+	}
+
+	return (newest < 0 ? 0 : archive_day(newest));
+}
+
+static void reserve(struct ArchiveBuffer *buffer, size_t size) {
+	if (buffer->used + size <= buffer->capacity)
+		return;
+
+	while (buffer->used + size > buffer->capacity)
+		buffer->capacity = (buffer->capacity ? buffer->capacity * 2 : 1 << 16);
+
+	buffer->data = safe_realloc(buffer->data, buffer->capacity);
+}
+
+static void put_bytes(struct ArchiveBuffer *buffer, const void *data, size_t size) {
+	reserve(buffer, size);
+	memcpy(buffer->data + buffer->used, data, size);
+	buffer->used += size;
+}
+
+/* LEB128, seven bits at a time, low bits first */
+static void put_varint(struct ArchiveBuffer *buffer, uint64_t value) {
+	reserve(buffer, 10);
+
+	while (value >= 0x80) {
+		buffer->data[buffer->used++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+
+	buffer->data[buffer->used++] = (unsigned char)value;
+}
+
+static uint64_t zigzag(int64_t value) {
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/* Starts a column with its codec and a length filled in by end_column. Returns where the length goes */
+static size_t begin_column(struct ArchiveBuffer *buffer, enum ArchiveCodec codec) {
+	unsigned char byte = codec;
+	uint32_t length = 0;
+	size_t at;
+
+	put_bytes(buffer, &byte, 1);
+	at = buffer->used;
+	put_bytes(buffer, &length, sizeof(uint32_t));
+
+	return at;
+}
+
+static void end_column(struct ArchiveBuffer *buffer, size_t at) {
+	uint32_t length = buffer->used - at - sizeof(uint32_t);
+
+	memcpy(buffer->data + at, &length, sizeof(uint32_t));
+}
+
+static void encode_bytes(struct ArchiveBuffer *buffer, const char *values, long count) {
+	size_t at = begin_column(buffer, ARCHIVE_RAW);
+
+	put_bytes(buffer, values, count);
+	end_column(buffer, at);
+}
+
+/* ARCHIVE_DELTA, or ARCHIVE_CENTS when the integers are cents */
+static void encode_integers(struct ArchiveBuffer *buffer, enum ArchiveCodec codec, const int64_t *values, long count) {
+	long i;
+	int64_t previous = 0;
+	size_t at = begin_column(buffer, codec);
+
+	// the change is taken in unsigned arithmetic, so no pair of values can overflow it
+	for (i = 0; i < count; i++) {
+		put_varint(buffer, zigzag((int64_t)((uint64_t)values[i] - (uint64_t)previous)));
+		previous = values[i];
+	}
+
+	end_column(buffer, at);
+}
+
+/* A float's cents, if it is exactly what reading those cents back gives */
+static int whole_cents(float value, int64_t *cents) {
+	float back;
+
+	if (!isfinite(value) || fabs(value) * 100 >= ARCHIVE_MAX_CENTS)
+		return FALSE;
+
+	*cents = llround((double)value * 100);
+	back = (float)(*cents / 100.0);
+
+	return memcmp(&back, &value, sizeof(float)) == 0;
+}
+
+/* Quotes and strikes are nearly always whole cents and pack as such, anything else keeps its exact bits */
+static void encode_decimals(struct ArchiveBuffer *buffer, const float *values, long count, int64_t *cents) {
+	long i;
+	uint32_t bits, previous;
+	size_t at;
+
+	for (i = 0; i < count && whole_cents(values[i], &cents[i]); i++)
+		;
+
+	if (i == count) {
+		encode_integers(buffer, ARCHIVE_CENTS, cents, count);
+		return;
+	}
+
+	at = begin_column(buffer, ARCHIVE_XOR);
+	previous = 0;
+
+	for (i = 0; i < count; i++) {
+		memcpy(&bits, &values[i], sizeof(uint32_t));
+		put_varint(buffer, bits ^ previous);
+		previous = bits;
+	}
+
+	end_column(buffer, at);
+}
+
+/* Packs one stock's contracts, calls then puts, one column after another */
+static void encode_block(struct ArchiveBuffer *buffer, struct OptionTable *options, long begin, long count, int64_t *integers) {
+	long i;
+
+#define ARCHIVE_ENCODE_BYTES(type, name) encode_bytes(buffer, options->name + begin, count);
+#define ARCHIVE_ENCODE_INTEGER(type, name)        \
+	for (i = 0; i < count; i++)                    \
+		integers[i] = options->name[begin + i];     \
+	encode_integers(buffer, ARCHIVE_DELTA, integers, count);
+#define ARCHIVE_ENCODE_DECIMAL(type, name) encode_decimals(buffer, options->name + begin, count, integers);
+#define ARCHIVE_ENCODE(type, name, kind) ARCHIVE_ENCODE_##kind(type, name)
+	ARCHIVE_COLUMNS(ARCHIVE_ENCODE)
+#undef ARCHIVE_ENCODE
+#undef ARCHIVE_ENCODE_DECIMAL
+#undef ARCHIVE_ENCODE_INTEGER
+#undef ARCHIVE_ENCODE_BYTES
+}
+
+static int by_ticker(const void *a, const void *b) {
+	return strcmp((*(struct ParentStock * const *)a)->ticker, (*(struct ParentStock * const *)b)->ticker);
+}
+
+/*
+ * Writes the universe's chains as the segment for its trading day, unless that day is archived
+ * already. The segment is written next to its final name and renamed into place, so a reader only
+ * ever sees whole segments. Failing to write one only loses that day's history.
+ */
+void archive_append(struct Universe *universe) {
+	int date;
+	long i, count, most;
+	char path[PATH_MAX], temp[PATH_MAX + 8];
+	const char *directory;
+	uint64_t data_offset;
+	int64_t *integers;
+	FILE *file;
+	struct ParentStock **order, *stock;
+	struct ArchiveHeader header;
+	struct ArchiveTicker *tickers;
+	struct ArchiveBuffer blocks;
+	static const char zeros[ARCHIVE_ALIGNMENT];
+
+	if ((directory = archive_directory()) == NULL || (date = archive_date(universe)) == 0)
+		return;
+
+	snprintf(path, sizeof(path), "%s/%08d%s", directory, date, ARCHIVE_SUFFIX);
+
+	// append only, a day once written stays as it was
+	if (access(path, F_OK) == 0)
+		return;
+
+	if (mkdir(directory, 0755) < 0 && errno != EEXIST) {
+		perror(directory);
+		return;
+	}
+
+	// sorted by name, so a reader finds any ticker with a binary search over the index
+	count = universe->parent_array_size;
+	order = safe_malloc(count * sizeof(struct ParentStock *));
+	memcpy(order, universe->parent_array, count * sizeof(struct ParentStock *));
+	qsort(order, count, sizeof(struct ParentStock *), by_ticker);
+
+	for (i = 0, most = 1; i < count; i++) {
+		if (order[i]->puts_end - order[i]->calls_begin > most)
+			most = order[i]->puts_end - order[i]->calls_begin;
+	}
+
+	integers = safe_malloc(most * sizeof(int64_t));
+	tickers = safe_calloc(count, sizeof(struct ArchiveTicker));
+	memset(&blocks, 0, sizeof(struct ArchiveBuffer));
+
+	memset(&header, 0, sizeof(struct ArchiveHeader));
+	memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = ARCHIVE_VERSION;
+	header.date = date;
+	header.ticker_count = count;
+	header.tickers_offset = ARCHIVE_ALIGN(sizeof(struct ArchiveHeader));
+	data_offset = ARCHIVE_ALIGN(header.tickers_offset + count * sizeof(struct ArchiveTicker));
+
+	for (i = 0; i < count; i++) {
+		stock = order[i];
+
+		memcpy(tickers[i].ticker, stock->ticker, TICK_SIZE);
+		tickers[i].call_count = stock->calls_end - stock->calls_begin;
+		tickers[i].put_count = stock->puts_end - stock->puts_begin;
+		tickers[i].curr_price = stock->curr_price;
+		tickers[i].iv20 = stock->iv20;
+		tickers[i].iv50 = stock->iv50;
+		tickers[i].iv100 = stock->iv100;
+		tickers[i].offset = data_offset + blocks.used;
+
+		encode_block(&blocks, &universe->options, stock->calls_begin, stock->puts_end - stock->calls_begin, integers);
+
+		tickers[i].size = data_offset + blocks.used - tickers[i].offset;
+		header.row_count += stock->puts_end - stock->calls_begin;
+	}
+
+	header.file_size = data_offset + blocks.used;
+
+	snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+	if ((file = fopen(temp, "wb")) == NULL) {
+		perror(temp);
+	}
+	else {
+		fwrite(&header, sizeof(struct ArchiveHeader), 1, file);
+		fwrite(zeros, 1, header.tickers_offset - sizeof(struct ArchiveHeader), file);
+		fwrite(tickers, sizeof(struct ArchiveTicker), count, file);
+		fwrite(zeros, 1, data_offset - header.tickers_offset - count * sizeof(struct ArchiveTicker), file);
+		fwrite(blocks.data, 1, blocks.used, file);
+
+		if ((ferror(file) | fclose(file)) || rename(temp, path) < 0) {
+			fprintf(stderr, "Warning: Unable to archive %s\n", path);
+			unlink(temp);
+		}
+	}
+
+	free(blocks.data);
+	free(tickers);
+	free(integers);
+	free(order);
+}
+
+/* LEB128 as put_varint writes it. FALSE if it runs off the end of the column or past 64 bits */
+static int get_varint(struct ArchiveReader *reader, uint64_t *value) {
+	int shift;
+
+	*value = 0;
+
+	for (shift = 0; shift < 64 && reader->at < reader->end; shift += 7) {
+		*value |= (uint64_t)(*reader->at & 0x7f) << shift;
+
+		if (!(*reader->at++ & 0x80))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Steps over the next column of a block, leaving its codec and payload. FALSE if the block is damaged */
+static int next_column(struct ArchiveReader *block, struct ArchiveReader *column, enum ArchiveCodec *codec) {
+	uint32_t length;
+
+	if (block->end - block->at < 1 + (long)sizeof(uint32_t))
+		return FALSE;
+
+	*codec = block->at[0];
+	memcpy(&length, block->at + 1, sizeof(uint32_t));
+	block->at += 1 + sizeof(uint32_t);
+
+	if (length > (uint64_t)(block->end - block->at))
+		return FALSE;
+
+	column->at = block->at;
+	column->end = block->at + length;
+	block->at += length;
+
+	return TRUE;
+}
+
+static int decode_bytes(struct ArchiveReader *block, char *values, long count) {
+	enum ArchiveCodec codec;
+	struct ArchiveReader column;
+
+	if (!next_column(block, &column, &codec) || codec != ARCHIVE_RAW || column.end - column.at != count)
+		return FALSE;
+
+	memcpy(values, column.at, count);
+
+	return TRUE;
+}
+
+/* The payload of an ARCHIVE_DELTA or ARCHIVE_CENTS column, which must hold exactly count values */
+static int decode_deltas(struct ArchiveReader *column, int64_t *values, long count) {
+	long i;
+	uint64_t delta;
+	int64_t previous = 0;
+
+	for (i = 0; i < count; i++) {
+		if (!get_varint(column, &delta))
+			return FALSE;
+
+		previous = (int64_t)((uint64_t)previous + (uint64_t)unzigzag(delta));
+		values[i] = previous;
+	}
+
+	return column->at == column->end;
+}
+
+static int decode_integers(struct ArchiveReader *block, int64_t *values, long count) {
+	enum ArchiveCodec codec;
+	struct ArchiveReader column;
+
+	return next_column(block, &column, &codec) && codec == ARCHIVE_DELTA && decode_deltas(&column, values, count);
+}
+
+static int decode_decimals(struct ArchiveReader *block, float *values, long count, int64_t *cents) {
+	long i;
+	uint64_t delta;
+	uint32_t bits, previous;
+	enum ArchiveCodec codec;
+	struct ArchiveReader column;
+
+	if (!next_column(block, &column, &codec))
+		return FALSE;
+
+	if (codec == ARCHIVE_CENTS) {
+		if (!decode_deltas(&column, cents, count))
+			return FALSE;
+
+		for (i = 0; i < count; i++)
+			values[i] = (float)(cents[i] / 100.0);
+
+		return TRUE;
+	}
+
+	if (codec != ARCHIVE_XOR)
+		return FALSE;
+
+	previous = 0;
+
+	for (i = 0; i < count; i++) {
+		if (!get_varint(&column, &delta) || delta > UINT32_MAX)
+			return FALSE;
+
+		bits = previous ^ (uint32_t)delta;
+		memcpy(&values[i], &bits, sizeof(float));
+		previous = bits;
+	}
+
+	return column.at == column.end;
+}
+
+/* Maps the segment for date, YYYYMMDD, from directory. FALSE if that day is not archived or its segment is unusable */
+int archive_open(struct ArchiveDay *day, const char *directory, int date) {
+	int fd;
+	char path[PATH_MAX];
+	struct stat st;
+	void *base;
+	struct ArchiveHeader *header;
+
+	memset(day, 0, sizeof(struct ArchiveDay));
+	snprintf(path, sizeof(path), "%s/%08d%s", directory, date, ARCHIVE_SUFFIX);
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return FALSE;
+
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(struct ArchiveHeader)) {
+		close(fd);
+		return FALSE;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (base == MAP_FAILED)
+		return FALSE;
+
+	header = base;
+
+	if (memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0 || header->version != ARCHIVE_VERSION ||
+	    header->date != date || header->file_size != (uint64_t)st.st_size || header->ticker_count < 0 ||
+	    header->tickers_offset > header->file_size ||
+	    (uint64_t)header->ticker_count > (header->file_size - header->tickers_offset) / sizeof(struct ArchiveTicker)) {
+		fprintf(stderr, "Warning: Ignoring damaged archive %s\n", path);
+		munmap(base, st.st_size);
+		return FALSE;
+	}
+
+	day->mapping = base;
+	day->size = st.st_size;
+	day->header = header;
+	day->tickers = (struct ArchiveTicker *)((char *)base + header->tickers_offset);
+
+	return TRUE;
+}
+
+static int find_ticker(const void *key, const void *entry) {
+	return strncmp(key, ((const struct ArchiveTicker *)entry)->ticker, TICK_SIZE);
+}
+
+/* The day's index entry for ticker, NULL if it was not archived that day */
+struct ArchiveTicker *archive_find(struct ArchiveDay *day, const char *ticker) {
+	return bsearch(ticker, day->tickers, day->header->ticker_count, sizeof(struct ArchiveTicker), find_ticker);
+}
+
+/*
+ * Appends one ticker's archived contracts to options, calls first, tagged with parent. Only the
+ * ticker's own block is read. Returns FALSE, leaving options as it was, if the block is damaged.
+ */
+int archive_read(struct ArchiveDay *day, struct ArchiveTicker *entry, struct OptionTable *options, int parent) {
+	int ok;
+	long i, row, first, count;
+	int64_t *integers;
+	struct ArchiveReader block;
+
+	count = (long)entry->call_count + entry->put_count;
+
+	// every contract takes at least a byte of the block, so a larger count is damage, not a reason to allocate
+	if (entry->offset > day->size || entry->size > day->size - entry->offset || count > (long)entry->size)
+		return FALSE;
+
+	block.at = (const unsigned char *)day->mapping + entry->offset;
+	block.end = block.at + entry->size;
+
+	first = options->size;
+
+	for (i = 0; i < count; i++) {
+		row = option_table_append(options);
+
+		options->parent[row] = parent;
+		options->type[row] = (i < (long)entry->call_count);
+	}
+
+	integers = safe_malloc((count ? count : 1) * sizeof(int64_t));
+	ok = TRUE;
+
+#define ARCHIVE_DECODE_BYTES(type, name) ok = ok && decode_bytes(&block, options->name + first, count);
+#define ARCHIVE_DECODE_INTEGER(type, name)                          \
+	if ((ok = ok && decode_integers(&block, integers, count)))       \
+		for (i = 0; i < count; i++)                                  \
+			options->name[first + i] = integers[i];
+#define ARCHIVE_DECODE_DECIMAL(type, name) ok = ok && decode_decimals(&block, options->name + first, count, integers);
+#define ARCHIVE_DECODE(type, name, kind) ARCHIVE_DECODE_##kind(type, name)
+	ARCHIVE_COLUMNS(ARCHIVE_DECODE)
+#undef ARCHIVE_DECODE
+#undef ARCHIVE_DECODE_DECIMAL
+#undef ARCHIVE_DECODE_INTEGER
+#undef ARCHIVE_DECODE_BYTES
+
+	if (!ok)
+		options->size = first;
+
+	free(integers);
+
+	return ok;
+}
+
+void archive_close(struct ArchiveDay *day) {
+	if (day->mapping != NULL)
+		munmap(day->mapping, day->size);
+
+	memset(day, 0, sizeof(struct ArchiveDay));
+}
+
+/* Every archived day from from to to, YYYYMMDD and inclusive, in date order. Returns how many, with the days in dates to free */
+long archive_range(const char *directory, int from, int to, int **dates) {
+	int i, count, date, length;
+	long size;
+	struct dirent **entries;
+
+	*dates = safe_malloc(sizeof(int));
+	size = 0;
+
+	if ((count = scandir(directory, &entries, NULL, alphasort)) < 0)
+		return 0;
+
+	// names are YYYYMMDD.chain, so name order is date order
+	for (i = 0; i < count; i++) {
+		if (sscanf(entries[i]->d_name, "%8d%n", &date, &length) == 1 && length == 8 &&
+		    strcmp(entries[i]->d_name + length, ARCHIVE_SUFFIX) == 0 && date >= from && date <= to) {
+			*dates = safe_realloc(*dates, (size + 1) * sizeof(int));
+			(*dates)[size++] = date;
+		}
+
+		free(entries[i]);
+	}
+
+	free(entries);
+
+	return size;
+}
+
+/* Copies the bars of history, a linked universe of every bar, that are dated before end */
+static void copy_history(struct Universe *universe, struct Universe *history, time_t end) {
+	int id;
+	long i, row, copy;
+	struct ParentStock *stock;
+	struct PriceTable *prices = &universe->prices;
+
+	price_table_reserve(prices, history->prices.size);
+
+	for (i = 0; i < history->parent_array_size; i++) {
+		stock = history->parent_array[i];
+
+		id = NO_SYMBOL;
+
+		for (row = stock->prices_begin; row < stock->prices_end; row++) {
+			if (history->prices.date[row] >= end)
+				continue;
+
+			// only a stock with bars by then gets a symbol, as if the database had stopped there
+			if (id == NO_SYMBOL)
+				id = symbol_intern(&universe->symbols, stock->ticker);
+
+			copy = price_table_append(prices);
+
+#define ARCHIVE_COPY_PRICE(type, name) prices->name[copy] = history->prices.name[row];
+			PRICE_TABLE_COLUMNS(ARCHIVE_COPY_PRICE)
+#undef ARCHIVE_COPY_PRICE
+			prices->parent[copy] = id;
+		}
+	}
+}
+
+/*
+ * Loads the universe as it stood on date: that day's archived chains, and every bar up to and
+ * including it. The bars come from history when it is given, a universe already linked from every
+ * bar so many days can share one read, and from the price database otherwise. Returns FALSE if the
+ * day is not archived.
+ */
+int archive_load(struct Universe *universe, const char *directory, int date, struct Universe *history) {
+	int id, *parent_of;
+	long i, row, kept;
+	char ticker[TICK_SIZE];
+	time_t end;
+	struct ArchiveDay day;
+	struct ArchiveTicker *entry;
+	struct TickerVolatility *volatility;
+	struct PriceTable *prices = &universe->prices;
+
+	if (!archive_open(&day, directory, date))
+		return FALSE;
+
+	// bars after the day had not happened yet
+	end = archive_time(date, 1);
+
+	if (history != NULL) {
+		copy_history(universe, history, end);
+	}
+	else {
+		gather_data(&universe->symbols, prices);
+
+		for (row = kept = 0; row < prices->size; row++) {
+			if (prices->date[row] >= end)
+				continue;
+
+#define ARCHIVE_KEEP_PRICE(type, name) prices->name[kept] = prices->name[row];
+			PRICE_TABLE_COLUMNS(ARCHIVE_KEEP_PRICE)
+#undef ARCHIVE_KEEP_PRICE
+			kept++;
+		}
+
+		prices->size = kept;
+	}
+
+	for (i = 0; i < day.header->ticker_count; i++) {
+		entry = &day.tickers[i];
+		memcpy(ticker, entry->ticker, TICK_SIZE);
+		ticker[TICK_SIZE - 1] = '\0';
+
+		id = symbol_intern(&universe->symbols, ticker);
+
+		if (!archive_read(&day, entry, &universe->options, id))
+			fprintf(stderr, "Warning: Damaged archive entry for %s on %08d\n", ticker, date);
+	}
+
+	volatility = safe_calloc((universe->symbols.size ? universe->symbols.size : 1), sizeof(struct TickerVolatility));
+
+	for (i = 0; i < day.header->ticker_count; i++) {
+		memcpy(ticker, day.tickers[i].ticker, TICK_SIZE);
+		ticker[TICK_SIZE - 1] = '\0';
+		id = symbol_lookup(&universe->symbols, ticker);
+
+		volatility[id].iv20 = day.tickers[i].iv20;
+		volatility[id].iv50 = day.tickers[i].iv50;
+		volatility[id].iv100 = day.tickers[i].iv100;
+	}
+
+	parent_of = link_tickers(universe, volatility, universe->symbols.size);
+
+	free(volatility);
+	free(parent_of);
+	archive_close(&day);
+
+	return TRUE;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "../include/arena.h"
+#include "../include/safe.h"
+
+#define ALIGN_UP(size) (((size) + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1))
+
+void arena_init(struct Arena *arena) {
+	arena->head = NULL;
+	arena->current = NULL;
+	arena->last = NULL;
+	arena->reserved = 0;
+
+	pthread_mutex_init(&arena->lock, NULL);
+}
+
+/* Finds room for size bytes, reusing chunks left over from a reset before creating a new one. Called with the lock held */
+static void *bump(struct Arena *arena, size_t size) {
+	size_t chunk_size;
+	struct ArenaChunk *chunk, *tail;
+
+	size = ALIGN_UP(size ? size : 1);
+
+	for (chunk = arena->current; chunk != NULL; chunk = chunk->next) {
+		if (chunk->size - chunk->used >= size)
+			break;
+	}
+
+	if (chunk == NULL) {
+		chunk_size = (size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE);
+		chunk = safe_malloc(sizeof(struct ArenaChunk) + chunk_size);
+		chunk->next = NULL;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		arena->reserved += chunk_size;
+
+		// new chunks go to the end so a reset replays the same sequence of chunks
+		if (arena->head == NULL) {
+			arena->head = chunk;
+		}
+		else {
+			for (tail = arena->current ? arena->current : arena->head; tail->next != NULL; tail = tail->next)
+				;
+			tail->next = chunk;
+		}
+	}
+
+	arena->current = chunk;
+	arena->last = chunk->data + chunk->used;
+	chunk->used += size;
+
+	return arena->last;
+}
+
+/* Returns size bytes aligned to ARENA_ALIGNMENT that live until the arena is reset or freed */
+void *arena_alloc(struct Arena *arena, size_t size) {
+	void *new;
+
+	pthread_mutex_lock(&arena->lock);
+	new = bump(arena, size);
+	pthread_mutex_unlock(&arena->lock);
+
+	return new;
+}
+
+void *arena_calloc(struct Arena *arena, size_t num, size_t size) {
+	void *new;
+
+	new = arena_alloc(arena, num * size);
+	memset(new, 0, num * size);
+
+	return new;
+}
+
+/*
+ * Resizes prev, an earlier arena allocation of old_size bytes, to new_size bytes. The most recent
+ * allocation is extended in place when its chunk has room, anything else is copied.
+ */
+void *arena_grow(struct Arena *arena, void *prev, size_t old_size, size_t new_size) {
+	void *new;
+	size_t extra;
+	struct ArenaChunk *chunk;
+
+	pthread_mutex_lock(&arena->lock);
+
+	chunk = arena->current;
+
+	if (prev != NULL && prev == arena->last) {
+		extra = ALIGN_UP(new_size) - ALIGN_UP(old_size ? old_size : 1);
+
+		if (new_size <= old_size || chunk->size - chunk->used >= extra) {
+			if (new_size > old_size)
+				chunk->used += extra;
+
+			pthread_mutex_unlock(&arena->lock);
+			return prev;
+		}
+	}
+
+	new = bump(arena, new_size);
+	if (prev != NULL)
+		memcpy(new, prev, (old_size < new_size ? old_size : new_size));
+
+	pthread_mutex_unlock(&arena->lock);
+
+	return new;
+}
+
+/* Forgets every allocation but keeps the chunks for the next run */
+void arena_reset(struct Arena *arena) {
+	struct ArenaChunk *chunk;
+
+	pthread_mutex_lock(&arena->lock);
+
+	for (chunk = arena->head; chunk != NULL; chunk = chunk->next)
+		chunk->used = 0;
+
+	arena->current = arena->head;
+	arena->last = NULL;
+
+	pthread_mutex_unlock(&arena->lock);
+}
+
+/* Releases every chunk in one go */
+void arena_free(struct Arena *arena) {
+	struct ArenaChunk *chunk, *next;
+
+	for (chunk = arena->head; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+
+	pthread_mutex_destroy(&arena->lock);
+
+	arena->head = NULL;
+	arena->current = NULL;
+	arena->last = NULL;
+	arena->reserved = 0;
+}
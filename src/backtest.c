@@ -0,0 +1,424 @@
+#include <time.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/backtest.h"
+#include "../include/archive.h"
+#include "../include/general_stocks.h"
+#include "../include/options.h"
+#include "../include/query_index.h"
+#include "../include/thread_pool.h"
+#include "../include/arena.h"
+#include "../include/safe.h"
+
+/* One worker's universe and scratch space, reused for every day it replays */
+struct BacktestSlot {
+   struct Universe universe;
+   struct Arena scratch;      // another day's chain for one ticker, while pricing an exit
+   struct OptionTable exits;
+   int busy;
+};
+
+/* Shared arguments for replaying one archived day per thread pool task */
+struct BacktestJob {
+   const char *directory;
+   struct Universe *history;  // every bar, linked once for all days
+   int *history_parent;       // history symbol id -> history parent
+   int *archived;             // every archived day, ascending, for exits
+   long archived_count;
+   int *dates;                // the days picked on, a run of archived
+   struct QuerySpec *specs;
+   long spec_count;
+   struct BacktestSlot *slots;
+   int slot_count;
+   pthread_mutex_t lock;      // guards the slots' busy flags
+   struct BacktestTrade **trades; // [day * spec_count + spec]
+   long *trade_counts;
+};
+
+/* A free slot. There are as many slots as workers, so one is always free */
+static struct BacktestSlot *take_slot(struct BacktestJob *job) {
+	int i;
+	struct BacktestSlot *slot = NULL;
+
+	pthread_mutex_lock(&job->lock);
+
+	for (i = 0; i < job->slot_count && slot == NULL; i++) {
+		if (!job->slots[i].busy)
+			slot = &job->slots[i];
+	}
+
+	slot->busy = TRUE;
+	pthread_mutex_unlock(&job->lock);
+
+	return slot;
+}
+
+static void give_slot(struct BacktestJob *job, struct BacktestSlot *slot) {
+	pthread_mutex_lock(&job->lock);
+	slot->busy = FALSE;
+	pthread_mutex_unlock(&job->lock);
+}
+
+/* What a contract trades for: its midpoint, or its last trade when the quote is one sided */
+static float trade_price(struct OptionTable *options, long row) {
+	if (options->ask[row] > 0 && options->bid[row] >= 0 && options->ask[row] >= options->bid[row])
+		return (options->bid[row] + options->ask[row]) / 2;
+
+	return options->last_price[row];
+}
+
+/* The day a contract expires, YYYYMMDD. Expirations are midnight UTC, so the day is taken in UTC */
+static int expiration_day(long expiration_date) {
+	time_t t = expiration_date;
+	struct tm tm;
+
+	gmtime_r(&t, &tm);
+
+	return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+/* The first of a stock's bars dated date or later, prices_end if there is none. A stock's bars are in date order */
+static long first_bar(struct PriceTable *prices, struct ParentStock *stock, time_t date) {
+	long low, high, middle;
+
+	low = stock->prices_begin;
+	high = stock->prices_end;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+
+		if (prices->date[middle] < date)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+/* Settles a trade held to expiration at its intrinsic value, once the history has a bar from that day or later */
+static void settle_expiration(struct BacktestJob *job, struct BacktestTrade *trade) {
+	int id, expires;
+	long last;
+	time_t start, end;
+	struct ParentStock *stock;
+	struct PriceTable *prices = &job->history->prices;
+
+	if ((id = symbol_lookup(&job->history->symbols, trade->ticker)) == NO_SYMBOL || job->history_parent[id] == NO_SYMBOL)
+		return;
+
+	stock = job->history->parent_array[job->history_parent[id]];
+	expires = expiration_day(trade->expiration_date);
+	start = archive_time(expires, 0);
+	end = archive_time(expires, 1);
+
+	// the close it settles on is the last one by the end of the day, a holiday's being the day before
+	last = first_bar(prices, stock, end) - 1;
+
+	// and the history has to reach that day before the close is known
+	if (last < stock->prices_begin || first_bar(prices, stock, start) == stock->prices_end)
+		return;
+
+	trade->exit = (trade->type ? prices->close[last] - trade->strike : trade->strike - prices->close[last]);
+	trade->exit = (trade->exit > 0 ? trade->exit : 0);
+	trade->exit_date = expires;
+}
+
+/*
+ * Sells a trade at its midpoint on the last archived day of its holding period, which ends on
+ * target. Left open if no archived day comes after target yet, or the contract is not in the chain.
+ */
+static void settle_archived(struct BacktestJob *job, struct BacktestSlot *slot, struct ArchiveDay *day, struct BacktestTrade *trade, int target) {
+	int exit_date;
+	long i, row;
+	struct ArchiveTicker *entry;
+
+	if (job->archived_count == 0 || job->archived[job->archived_count - 1] < target)
+		return;
+
+	exit_date = 0;
+	for (i = 0; i < job->archived_count && job->archived[i] <= target; i++) {
+		if (job->archived[i] > trade->date)
+			exit_date = job->archived[i];
+	}
+
+	if (exit_date == 0)
+		return;
+
+	// picks of one spec mostly share their exit day, so it stays mapped until another is needed
+	if (day->mapping == NULL || day->header->date != exit_date) {
+		archive_close(day);
+
+		if (!archive_open(day, job->directory, exit_date))
+			return;
+	}
+
+	if ((entry = archive_find(day, trade->ticker)) == NULL)
+		return;
+
+	arena_reset(&slot->scratch);
+	option_table_init(&slot->exits, &slot->scratch);
+
+	if (!archive_read(day, entry, &slot->exits, 0))
+		return;
+
+	for (row = 0; row < slot->exits.size; row++) {
+		if (slot->exits.type[row] == trade->type && slot->exits.expiration_date[row] == trade->expiration_date &&
+		    slot->exits.strike[row] == trade->strike) {
+			trade->exit = trade_price(&slot->exits, row);
+			trade->exit_date = exit_date;
+			return;
+		}
+	}
+}
+
+/* Picks one spec's contracts from a screened day and follows each of them to its exit */
+static long pick_contracts(struct BacktestJob *job, struct BacktestSlot *slot, struct QueryIndex *index, struct QuerySpec *spec,
+                           int date, struct BacktestTrade **trades) {
+	int target;
+	long i, row, count, kept, *rows;
+	struct ParentStock *stock;
+	struct ArchiveDay day;
+	struct Universe *universe = &slot->universe;
+	struct OptionTable *options = &universe->options;
+
+	count = query_spec_rows(index, universe, spec, &rows);
+	*trades = safe_malloc((count ? count : 1) * sizeof(struct BacktestTrade));
+	target = archive_day(archive_time(date, spec->hold));
+
+	memset(&day, 0, sizeof(struct ArchiveDay));
+
+	for (i = 0, kept = 0; i < count; i++) {
+		row = rows[i];
+		stock = universe->parent_array[options->parent[row]];
+
+		// nothing can be bought for nothing
+		if (!(trade_price(options, row) > 0))
+			continue;
+
+		memset(&(*trades)[kept], 0, sizeof(struct BacktestTrade));
+		(*trades)[kept].date = date;
+		strcpy((*trades)[kept].ticker, stock->ticker);
+		(*trades)[kept].type = options->type[row];
+		(*trades)[kept].strike = options->strike[row];
+		(*trades)[kept].expiration_date = options->expiration_date[row];
+		(*trades)[kept].weight = total_weight(stock, options, row);
+		(*trades)[kept].entry = trade_price(options, row);
+
+		if (spec->hold == 0 || target >= expiration_day(options->expiration_date[row]))
+			settle_expiration(job, &(*trades)[kept]);
+		else
+			settle_archived(job, slot, &day, &(*trades)[kept], target);
+
+		kept++;
+	}
+
+	archive_close(&day);
+	free(rows);
+
+	return kept;
+}
+
+/* Rebuilds one archived day, screens and scores it and takes every spec's picks */
+static void backtest_task(long task, void *arg) {
+	long i;
+	struct BacktestJob *job = arg;
+	struct BacktestSlot *slot;
+	struct Universe *universe;
+	struct QueryIndex index;
+	struct QuerySpec spec;
+
+	slot = take_slot(job);
+	universe = &slot->universe;
+
+	// the arena keeps its chunks, so after the first day a worker allocates next to nothing
+	universe_release(universe);
+	symbol_table_init(&universe->symbols, &universe->arena);
+	price_table_init(&universe->prices, &universe->arena);
+	option_table_init(&universe->options, &universe->arena);
+	universe->loaded = TRUE;
+
+	if (!archive_load(universe, job->directory, job->dates[task], job->history)) {
+		fprintf(stderr, "Warning: No archived chains for %08d\n", job->dates[task]);
+		give_slot(job, slot);
+		return;
+	}
+
+	// days are what run in parallel, each one's stocks go one after another
+	for (i = 0; i < universe->parent_array_size; i++)
+		screen_stock(universe->parent_array[i], &universe->prices, &universe->options);
+
+	for (i = 0; i < universe->parent_array_size; i++)
+		calc_stock_data(universe->parent_array[i], &universe->prices, &universe->options);
+
+	chain_index_reserve(&universe->chains, &universe->options, &universe->arena);
+	for (i = 0; i < universe->parent_array_size; i++)
+		chain_index_stock(&universe->chains, universe->parent_array[i], &universe->options);
+
+	query_index_build(&index, universe->parent_array, universe->parent_array_size, &universe->options, &universe->arena);
+
+	for (i = 0; i < job->spec_count; i++) {
+		spec = job->specs[i];
+		if (spec.top == 0)
+			spec.top = BACKTEST_DEFAULT_TOP;
+
+		job->trade_counts[task * job->spec_count + i] = pick_contracts(job, slot, &index, &spec, job->dates[task], &job->trades[task * job->spec_count + i]);
+	}
+
+	give_slot(job, slot);
+}
+
+/* Writes one spec's trades, in date order, as CSV. Returns FALSE if the file could not be written */
+static int write_trades(struct BacktestJob *job, long date_count, long spec) {
+	int status;
+	long day, i;
+	FILE *file;
+	struct BacktestTrade *trade;
+
+	if ((file = fopen(job->specs[spec].output, "w")) == NULL) {
+		perror(job->specs[spec].output);
+		return FALSE;
+	}
+
+	fprintf(file, "date,ticker,type,strike,expiration,weight,entry,exit_date,exit,pnl,return\n");
+
+	for (day = 0; day < date_count; day++) {
+		for (i = 0; i < job->trade_counts[day * job->spec_count + spec]; i++) {
+			trade = &job->trades[day * job->spec_count + spec][i];
+
+			fprintf(file, "%08d,%s,%s,%.2f,%d,%.4f,%.4f,", trade->date, trade->ticker, (trade->type ? "call" : "put"), trade->strike,
+			        expiration_day(trade->expiration_date), trade->weight, trade->entry);
+
+			// open trades have no exit to report
+			if (trade->exit_date)
+				fprintf(file, "%08d,%.4f,%.4f,%.6f\n", trade->exit_date, trade->exit, trade->exit - trade->entry,
+				        (trade->exit - trade->entry) / trade->entry);
+			else
+				fprintf(file, ",,,\n");
+		}
+	}
+
+	status = !ferror(file);
+	status &= (fclose(file) == 0);
+
+	return status;
+}
+
+/* Prints how every spec's closed trades did */
+static void print_summary(struct BacktestJob *job, long date_count) {
+	long day, spec, i, picks, closed, wins;
+	double pnl, returns;
+	struct BacktestTrade *trade;
+
+	printf("\nBACKTEST %08d - %08d, %ld days\n", job->dates[0], job->dates[date_count - 1], date_count);
+	printf("\n\t%s\t%s\t%s\t%s\t%s\t%s\n", "SPEC", "PICKS", "CLOSED", "WIN RATE", "MEAN RETURN", "P&L PER SHARE");
+	printf("\t--------------------------------------------------------------------\n");
+
+	for (spec = 0; spec < job->spec_count; spec++) {
+		picks = closed = wins = 0;
+		pnl = returns = 0;
+
+		for (day = 0; day < date_count; day++) {
+			for (i = 0; i < job->trade_counts[day * job->spec_count + spec]; i++) {
+				trade = &job->trades[day * job->spec_count + spec][i];
+				picks++;
+
+				if (!trade->exit_date)
+					continue;
+
+				closed++;
+				wins += (trade->exit > trade->entry);
+				pnl += trade->exit - trade->entry;
+				returns += (trade->exit - trade->entry) / trade->entry;
+			}
+		}
+
+		printf("\t%ld\t%ld\t%ld\t%7.2f%%\t%10.2f%%\t%.2f\n", spec + 1, picks, closed, (closed ? 100.0 * wins / closed : 0),
+		       (closed ? 100.0 * returns / closed : 0), pnl);
+	}
+}
+
+int backtest_run(const char *directory, int from, int to, struct QuerySpec *specs, long spec_count) {
+	int i, status;
+	long first, date_count, count;
+	struct Universe history;
+	struct BacktestJob job;
+
+	memset(&job, 0, sizeof(struct BacktestJob));
+	job.directory = directory;
+	job.specs = specs;
+	job.spec_count = spec_count;
+
+	// exits can fall after to, so every archived day is listed and the picking days are a run of them
+	job.archived_count = archive_range(directory, 0, INT_MAX, &job.archived);
+
+	for (first = 0; first < job.archived_count && job.archived[first] < from; first++)
+		;
+	for (date_count = 0; first + date_count < job.archived_count && job.archived[first + date_count] <= to; date_count++)
+		;
+
+	if (date_count == 0) {
+		fprintf(stderr, "Warning: No archived days from %08d to %08d in %s\n", from, to, directory);
+		free(job.archived);
+		return FALSE;
+	}
+
+	job.dates = job.archived + first;
+
+	// every day's bars are cut from one read of the price database
+	universe_init(&history);
+	symbol_table_init(&history.symbols, &history.arena);
+	price_table_init(&history.prices, &history.arena);
+	option_table_init(&history.options, &history.arena);
+	gather_data(&history.symbols, &history.prices);
+	job.history_parent = link_tickers(&history, NULL, 0);
+	history.loaded = TRUE;
+	job.history = &history;
+
+	job.slot_count = thread_pool_threads();
+	job.slots = safe_calloc(job.slot_count, sizeof(struct BacktestSlot));
+	for (i = 0; i < job.slot_count; i++) {
+		universe_init(&job.slots[i].universe);
+		arena_init(&job.slots[i].scratch);
+	}
+	pthread_mutex_init(&job.lock, NULL);
+
+	count = date_count * spec_count;
+	job.trades = safe_calloc((count ? count : 1), sizeof(struct BacktestTrade *));
+	job.trade_counts = safe_calloc((count ? count : 1), sizeof(long));
+
+	thread_pool_run(date_count, NULL, backtest_task, &job);
+
+	status = TRUE;
+	for (i = 0; i < spec_count; i++) {
+		if (strcmp(specs[i].output, QUERY_STDOUT) != 0)
+			status &= write_trades(&job, date_count, i);
+	}
+
+	print_summary(&job, date_count);
+
+	for (count--; count >= 0; count--)
+		free(job.trades[count]);
+
+	for (i = 0; i < job.slot_count; i++) {
+		universe_free(&job.slots[i].universe);
+		arena_free(&job.slots[i].scratch);
+	}
+
+	pthread_mutex_destroy(&job.lock);
+	universe_free(&history);
+	free(job.trade_counts);
+	free(job.trades);
+	free(job.slots);
+	free(job.history_parent);
+	free(job.archived);
+
+	return status;
+}
@@ -0,0 +1,360 @@
+#include <math.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/batch.h"
+#include "../include/report.h"
+#include "../include/option_table.h"
+#include "../include/thread_pool.h"
+#include "../include/top_k.h"
+#include "../include/chain_index.h"
+#include "../include/strategy.h"
+#include "../include/safe.h"
+
+/* Shared arguments for running the file-bound queries one per thread pool task */
+struct BatchJob {
+   struct Universe *universe;
+   struct QueryIndex *index;
+   struct QuerySpec *specs;
+   long *queued;              // indices into specs of the queries to run
+   int *written;              // TRUE once a query's report is out
+};
+
+/* Reads a whole string as a number, FALSE if there is anything else in it */
+static int parse_float(const char *value, float *result) {
+	char *end;
+
+	*result = strtod(value, &end);
+
+	return end != value && *end == '\0';
+}
+
+static int parse_int(const char *value, int *result) {
+	long number;
+	char *end;
+
+	number = strtol(value, &end, 10);
+	*result = number;
+
+	return end != value && *end == '\0' && number >= INT_MIN && number <= INT_MAX;
+}
+
+/*
+ * Parses one query spec into spec. Returns TRUE if text held at least one key, FALSE if it was
+ * blank or only a comment, and -1 if it could not be read.
+ */
+int query_spec_parse(const char *text, struct QuerySpec *spec) {
+	int found, valid;
+	char buffer[QUERY_SPEC_LENGTH], *save, *token, *value;
+
+	spec->max_option_price = INFINITY;
+	spec->min_weight = -INFINITY;
+	spec->type = QUERY_ALL;
+	spec->min_dte = 0;
+	spec->max_dte = INT_MAX;
+	spec->top = 0;
+	spec->strikes = -1;
+	spec->hold = 0;
+	spec->strategy = STRATEGY_NONE;
+	spec->max_cost = INFINITY;
+	spec->max_width = INFINITY;
+	spec->min_reward = -INFINITY;
+	spec->format = -1;
+	strcpy(spec->output, QUERY_STDOUT);
+
+	strncpy(buffer, text, QUERY_SPEC_LENGTH - 1);
+	buffer[QUERY_SPEC_LENGTH - 1] = '\0';
+	found = FALSE;
+
+	for (token = strtok_r(buffer, " \t\r\n", &save); token != NULL; token = strtok_r(NULL, " \t\r\n", &save)) {
+		// everything after a # is a comment
+		if (token[0] == '#')
+			break;
+
+		if ((value = strchr(token, '=')) == NULL) {
+			fprintf(stderr, "Query key without a value: %s\n", token);
+			return -1;
+		}
+
+		*value++ = '\0';
+		found = TRUE;
+
+		if (strcmp(token, "max_price") == 0)
+			valid = parse_float(value, &spec->max_option_price);
+		else if (strcmp(token, "min_weight") == 0)
+			valid = parse_float(value, &spec->min_weight);
+		else if (strcmp(token, "min_dte") == 0)
+			valid = parse_int(value, &spec->min_dte);
+		else if (strcmp(token, "max_dte") == 0)
+			valid = parse_int(value, &spec->max_dte);
+		else if (strcmp(token, "strikes") == 0)
+			valid = parse_int(value, &spec->strikes) && spec->strikes >= 0;
+		else if (strcmp(token, "top") == 0)
+			valid = parse_int(value, &spec->top) && spec->top >= 0;
+		else if (strcmp(token, "hold") == 0)
+			valid = parse_int(value, &spec->hold) && spec->hold >= 0;
+		else if (strcmp(token, "max_cost") == 0)
+			valid = parse_float(value, &spec->max_cost);
+		else if (strcmp(token, "max_width") == 0)
+			valid = parse_float(value, &spec->max_width) && spec->max_width > 0;
+		else if (strcmp(token, "min_reward") == 0)
+			valid = parse_float(value, &spec->min_reward);
+		else if (strcmp(token, "strategy") == 0)
+			valid = ((spec->strategy = strategy_parse(value)) >= 0);
+		else if (strcmp(token, "type") == 0) {
+			valid = TRUE;
+
+			if (strcmp(value, "call") == 0 || strcmp(value, "calls") == 0)
+				spec->type = QUERY_CALLS;
+			else if (strcmp(value, "put") == 0 || strcmp(value, "puts") == 0)
+				spec->type = QUERY_PUTS;
+			else if (strcmp(value, "all") == 0)
+				spec->type = QUERY_ALL;
+			else
+				valid = FALSE;
+		}
+		else if (strcmp(token, "format") == 0) {
+			valid = TRUE;
+
+			if (strcmp(value, "table") == 0)
+				spec->format = REPORT_TABLE;
+			else if (strcmp(value, "csv") == 0)
+				spec->format = REPORT_CSV;
+			else if (strcmp(value, "jsonl") == 0)
+				spec->format = REPORT_JSONL;
+			else if (strcmp(value, "binary") == 0)
+				spec->format = REPORT_BINARY;
+			else
+				valid = FALSE;
+		}
+		else if (strcmp(token, "out") == 0) {
+			valid = (strlen(value) > 0 && strlen(value) < QUERY_OUTPUT_LENGTH);
+			if (valid)
+				strcpy(spec->output, value);
+		}
+		else {
+			fprintf(stderr, "Unknown query key: %s\n", token);
+			return -1;
+		}
+
+		if (!valid) {
+			fprintf(stderr, "Bad value for %s: %s\n", token, value);
+			return -1;
+		}
+	}
+
+	return found;
+}
+
+/* Adds one spec to the list, growing it as needed */
+static void add_spec(struct QuerySpec **specs, long *count, struct QuerySpec *spec) {
+	*specs = safe_realloc(*specs, (*count + 1) * sizeof(struct QuerySpec));
+	(*specs)[(*count)++] = *spec;
+}
+
+/*
+ * Collects the specs named on the command line. An argument holding an = is a spec itself, any
+ * other is a file with one spec per line, "-" being stdin. Returns how many there are, or -1
+ * after reporting the first one that could not be read.
+ */
+long query_specs_collect(char **args, int arg_count, struct QuerySpec **specs) {
+	int i, line, parsed;
+	long count;
+	char text[QUERY_SPEC_LENGTH];
+	FILE *file;
+	struct QuerySpec spec;
+
+	*specs = NULL;
+	count = 0;
+
+	for (i = 0; i < arg_count; i++) {
+		if (strchr(args[i], '=') != NULL) {
+			if ((parsed = query_spec_parse(args[i], &spec)) < 0)
+				return -1;
+			if (parsed)
+				add_spec(specs, &count, &spec);
+
+			continue;
+		}
+
+		if ((file = (strcmp(args[i], "-") == 0 ? stdin : fopen(args[i], "r"))) == NULL) {
+			perror(args[i]);
+			return -1;
+		}
+
+		for (line = 1; fgets(text, QUERY_SPEC_LENGTH, file) != NULL; line++) {
+			if ((parsed = query_spec_parse(text, &spec)) < 0) {
+				fprintf(stderr, "%s:%d: unable to read query\n", args[i], line);
+				return -1;
+			}
+
+			if (parsed)
+				add_spec(specs, &count, &spec);
+		}
+
+		if (file != stdin)
+			fclose(file);
+	}
+
+	return count;
+}
+
+static int by_row(const void *a, const void *b) {
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* TRUE if row's strike is within strikes rungs of the money on its expiration's ladder */
+static int near_the_money(struct Universe *universe, long row, int strikes) {
+	long expiry, money, rung;
+	struct ParentStock *stock;
+	struct OptionTable *options = &universe->options;
+
+	stock = universe->parent_array[options->parent[row]];
+	expiry = chain_expiry(&universe->chains, stock, options->expiration_date[row]);
+	money = chain_nearest_strike(&universe->chains, expiry, stock->curr_price);
+	rung = chain_rung(&universe->chains, expiry, options->strike[row]);
+
+	return expiry >= 0 && labs(rung - money) <= strikes;
+}
+
+/*
+ * Finds the contracts matching spec. *rows is set to a malloc'd list of their option rows in table
+ * order and the number of matches is returned, as query_index_find does.
+ */
+long query_spec_rows(struct QueryIndex *index, struct Universe *universe, struct QuerySpec *spec, long **rows) {
+	long i, count, kept;
+	struct TopK top;
+	struct ParentStock **parent_array = universe->parent_array;
+	struct OptionTable *options = &universe->options;
+
+	count = query_index_find(index, spec->max_option_price, spec->min_weight, rows);
+
+	// the index answers price and weight, type, DTE and strikes are filtered from its matches
+	for (i = 0, kept = 0; i < count; i++) {
+		if (spec->type == QUERY_CALLS && !options->type[(*rows)[i]])
+			continue;
+		if (spec->type == QUERY_PUTS && options->type[(*rows)[i]])
+			continue;
+		if (options->days_til_expiration[(*rows)[i]] < spec->min_dte || options->days_til_expiration[(*rows)[i]] > spec->max_dte)
+			continue;
+		if (spec->strikes >= 0 && !near_the_money(universe, (*rows)[i], spec->strikes))
+			continue;
+
+		(*rows)[kept++] = (*rows)[i];
+	}
+
+	if (spec->top == 0 || kept <= spec->top)
+		return kept;
+
+	// the best by total weight, put back in table order like every other answer
+	top_k_init(&top, spec->top);
+	for (i = 0; i < kept; i++)
+		top_k_push(&top, rank_total_weight(parent_array[options->parent[(*rows)[i]]], options, (*rows)[i]), (*rows)[i], options->parent[(*rows)[i]]);
+
+	for (i = 0; i < top.size; i++)
+		(*rows)[i] = top.heap[i].row;
+
+	kept = top.size;
+	top_k_free(&top);
+
+	qsort(*rows, kept, sizeof(long), by_row);
+
+	return kept;
+}
+
+/* Runs one query and writes its report. Returns FALSE if the output could not be opened */
+static int write_query(struct Universe *universe, struct QueryIndex *index, struct QuerySpec *spec) {
+	int fd, to_stdout;
+	long count, *rows;
+	struct Strategy *strategies;
+	struct ReportSink sink;
+
+	to_stdout = (strcmp(spec->output, QUERY_STDOUT) == 0);
+
+	if (to_stdout)
+		fd = STDOUT_FILENO;
+	else if ((fd = open(spec->output, O_CREAT | O_TRUNC | O_WRONLY, 0666)) < 0) {
+		perror(spec->output);
+		return FALSE;
+	}
+
+	report_open(&sink, fd, (spec->format >= 0 ? spec->format : (to_stdout ? REPORT_TABLE : report_format(spec->output))));
+
+	if (spec->strategy != STRATEGY_NONE) {
+		count = strategy_search(universe, spec, &strategies);
+		print_strategies(universe, strategies, count, &sink);
+		free(strategies);
+	}
+	else {
+		count = query_spec_rows(index, universe, spec, &rows);
+		print_data(universe->parent_array, &universe->options, rows, count, &sink, 1);
+		free(rows);
+	}
+
+	report_close(&sink);
+
+	if (!to_stdout)
+		close(fd);
+
+	return TRUE;
+}
+
+static void batch_task(long task, void *arg) {
+	struct BatchJob *job = arg;
+
+	job->written[task] = write_query(job->universe, job->index, &job->specs[job->queued[task]]);
+}
+
+/*
+ * Runs every spec against one loaded universe. Queries writing to files run in parallel on the
+ * thread pool, since the universe and index are only read from here on; the ones writing to stdout
+ * follow in spec order so their reports never interleave. Strategy searches spread their stocks
+ * over the pool themselves, so they run after it, one at a time, rather than nesting a pool in each
+ * of its workers. Returns TRUE if every report was written.
+ */
+int batch_run(struct Universe *universe, struct QueryIndex *index, struct QuerySpec *specs, long spec_count) {
+	int all_written;
+	long i, queued;
+	struct BatchJob job;
+
+	job.universe = universe;
+	job.index = index;
+	job.specs = specs;
+	job.queued = safe_malloc((spec_count ? spec_count : 1) * sizeof(long));
+	job.written = safe_malloc((spec_count ? spec_count : 1) * sizeof(int));
+
+	for (i = 0, queued = 0; i < spec_count; i++) {
+		if (strcmp(specs[i].output, QUERY_STDOUT) != 0 && specs[i].strategy == STRATEGY_NONE)
+			job.queued[queued++] = i;
+	}
+
+	thread_pool_run(queued, NULL, batch_task, &job);
+
+	all_written = TRUE;
+	for (i = 0; i < queued; i++)
+		all_written &= job.written[i];
+
+	for (i = 0; i < spec_count; i++) {
+		if (strcmp(specs[i].output, QUERY_STDOUT) != 0 && specs[i].strategy != STRATEGY_NONE)
+			all_written &= write_query(universe, index, &specs[i]);
+	}
+
+	for (i = 0; i < spec_count; i++) {
+		if (strcmp(specs[i].output, QUERY_STDOUT) == 0)
+			all_written &= write_query(universe, index, &specs[i]);
+	}
+
+	free(job.written);
+	free(job.queued);
+
+	return all_written;
+}
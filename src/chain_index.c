@@ -0,0 +1,266 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/chain_index.h"
+#include "../include/option_table.h"
+#include "../include/thread_pool.h"
+#include "../include/arena.h"
+#include "../include/safe.h"
+
+/* One contract while its stock's chain is sorted */
+struct ChainKey {
+   long expiration_date;
+   float strike;
+   long row;
+};
+
+/* Shared arguments for indexing one stock per thread pool task */
+struct ChainJob {
+   struct ChainIndex *chains;
+   struct ParentStock **parent_array;
+   struct OptionTable *options;
+};
+
+/* By expiration, then strike, ties by row so a repeated contract always keeps its first row */
+static int by_contract(const void *a, const void *b) {
+	const struct ChainKey *x = a, *y = b;
+
+	if (x->expiration_date != y->expiration_date)
+		return (x->expiration_date > y->expiration_date) - (x->expiration_date < y->expiration_date);
+	if (x->strike != y->strike)
+		return (x->strike > y->strike) - (x->strike < y->strike);
+
+	return (x->row > y->row) - (x->row < y->row);
+}
+
+/* Sorts one stock's contracts and lays them out as its expirations and strike ladders */
+void chain_index_stock(struct ChainIndex *chains, struct ParentStock *stock, struct OptionTable *options) {
+	long i, count, expiry, rung, *side;
+	struct ChainKey *keys;
+
+	count = stock->puts_end - stock->calls_begin;
+	stock->expiries_begin = stock->expiries_end = stock->calls_begin;
+
+	if (count == 0)
+		return;
+
+	keys = safe_malloc(count * sizeof(struct ChainKey));
+
+	for (i = 0; i < count; i++) {
+		keys[i].expiration_date = options->expiration_date[stock->calls_begin + i];
+		keys[i].strike = options->strike[stock->calls_begin + i];
+		keys[i].row = stock->calls_begin + i;
+	}
+
+	qsort(keys, count, sizeof(struct ChainKey), by_contract);
+
+	expiry = rung = stock->calls_begin - 1;
+
+	for (i = 0; i < count; i++) {
+		if (i == 0 || keys[i].expiration_date != keys[i - 1].expiration_date) {
+			expiry++;
+			chains->expiration_date[expiry] = keys[i].expiration_date;
+			chains->rungs_begin[expiry] = rung + 1;
+		}
+		else if (keys[i].strike == keys[i - 1].strike) {
+			// the other side of the rung before
+			side = (options->type[keys[i].row] ? chains->call : chains->put);
+			if (side[rung] == CHAIN_NO_ROW)
+				side[rung] = keys[i].row;
+
+			continue;
+		}
+
+		rung++;
+		chains->strike[rung] = keys[i].strike;
+		chains->call[rung] = (options->type[keys[i].row] ? keys[i].row : CHAIN_NO_ROW);
+		chains->put[rung] = (options->type[keys[i].row] ? CHAIN_NO_ROW : keys[i].row);
+		chains->rungs_end[expiry] = rung + 1;
+	}
+
+	stock->expiries_end = expiry + 1;
+
+	free(keys);
+}
+
+static void chain_task(long task, void *arg) {
+	struct ChainJob *job = arg;
+
+	chain_index_stock(job->chains, job->parent_array[task], job->options);
+}
+
+/* Makes room for indexing every contract of options, for chain_index_stock to fill one stock at a time */
+void chain_index_reserve(struct ChainIndex *chains, struct OptionTable *options, struct Arena *arena) {
+	long size;
+
+	chains->size = options->size;
+	size = (options->size ? options->size : 1);
+
+	chains->expiration_date = arena_alloc(arena, size * sizeof(long));
+	chains->rungs_begin = arena_alloc(arena, size * sizeof(long));
+	chains->rungs_end = arena_alloc(arena, size * sizeof(long));
+	chains->strike = arena_alloc(arena, size * sizeof(float));
+	chains->call = arena_alloc(arena, size * sizeof(long));
+	chains->put = arena_alloc(arena, size * sizeof(long));
+}
+
+/* Indexes every stock's chain, one stock per task across the thread pool */
+void chain_index_build(struct ChainIndex *chains, struct ParentStock **parent_array, long parent_array_size, struct OptionTable *options, struct Arena *arena) {
+	long i, *cost;
+	struct ChainJob job;
+
+	chain_index_reserve(chains, options, arena);
+
+	job.chains = chains;
+	job.parent_array = parent_array;
+	job.options = options;
+
+	cost = safe_malloc((parent_array_size ? parent_array_size : 1) * sizeof(long));
+	for (i = 0; i < parent_array_size; i++)
+		cost[i] = parent_array[i]->puts_end - parent_array[i]->calls_begin;
+
+	thread_pool_run(parent_array_size, cost, chain_task, &job);
+	free(cost);
+}
+
+/* The stock's expiration on expiration_date, -1 if it has none then */
+long chain_expiry(struct ChainIndex *chains, struct ParentStock *stock, long expiration_date) {
+	long low, high, mid;
+
+	low = stock->expiries_begin;
+	high = stock->expiries_end;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+
+		if (chains->expiration_date[mid] < expiration_date)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return (low < stock->expiries_end && chains->expiration_date[low] == expiration_date ? low : -1);
+}
+
+/* The first rung of expiry whose strike is above strike, or at it too when inclusive */
+static long first_rung(struct ChainIndex *chains, long expiry, float strike, int inclusive) {
+	long low, high, mid;
+
+	low = chains->rungs_begin[expiry];
+	high = chains->rungs_end[expiry];
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+
+		if (chains->strike[mid] < strike || (!inclusive && chains->strike[mid] == strike))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/* The rung of expiry with the strike closest to price, the lower one on a tie. The stock's current price finds the money */
+long chain_nearest_strike(struct ChainIndex *chains, long expiry, float price) {
+	long rung;
+
+	if (expiry < 0)
+		return -1;
+
+	rung = first_rung(chains, expiry, price, TRUE);
+
+	if (rung == chains->rungs_end[expiry])
+		return rung - 1;
+	if (rung > chains->rungs_begin[expiry] && price - chains->strike[rung - 1] <= chains->strike[rung] - price)
+		return rung - 1;
+
+	return rung;
+}
+
+/* The rung of expiry at exactly strike, -1 if there is none */
+long chain_rung(struct ChainIndex *chains, long expiry, float strike) {
+	long rung;
+
+	if (expiry < 0)
+		return -1;
+
+	rung = first_rung(chains, expiry, strike, TRUE);
+
+	return (rung < chains->rungs_end[expiry] && chains->strike[rung] == strike ? rung : -1);
+}
+
+/* The rungs of expiry with strikes in [low, high], as the first one returned and *end */
+long chain_window(struct ChainIndex *chains, long expiry, float low, float high, long *end) {
+	long begin;
+
+	if (expiry < 0) {
+		*end = -1;
+		return -1;
+	}
+
+	begin = first_rung(chains, expiry, low, TRUE);
+	*end = first_rung(chains, expiry, high, FALSE);
+
+	if (*end < begin)
+		*end = begin;
+
+	return begin;
+}
+
+/* A rung's delta as a call's. A put's delta is its call's less one, so a rung with either side has one */
+static float call_delta(struct ChainIndex *chains, struct OptionTable *options, long rung) {
+	if (chains->call[rung] != CHAIN_NO_ROW)
+		return options->delta[chains->call[rung]];
+
+	return options->delta[chains->put[rung]] + 1;
+}
+
+/*
+ * The row of the call, or put, of expiry whose delta is closest to delta, CHAIN_NO_ROW if that side
+ * has no contracts. Call deltas fall as the strike rises, so a binary search finds where delta falls
+ * on the ladder, and the nearest contracts of that side just before and just after it are the only
+ * ones that can be closest. The lower strike wins a tie. Needs the greeks filled in.
+ */
+long chain_nearest_delta(struct ChainIndex *chains, struct OptionTable *options, long expiry, char type, float delta) {
+	long low, high, mid, begin, end, higher, lower, *side;
+	float target;
+
+	if (expiry < 0)
+		return CHAIN_NO_ROW;
+
+	begin = chains->rungs_begin[expiry];
+	end = chains->rungs_end[expiry];
+	target = (type ? delta : delta + 1);
+	side = (type ? chains->call : chains->put);
+
+	low = begin;
+	high = end;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+
+		if (call_delta(chains, options, mid) > target)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	// low is the first rung at or below target, so the contracts either side of it are the nearest from above and below
+	for (higher = low - 1; higher >= begin && side[higher] == CHAIN_NO_ROW; higher--)
+		;
+	for (lower = low; lower < end && side[lower] == CHAIN_NO_ROW; lower++)
+		;
+
+	if (higher < begin)
+		return (lower < end ? side[lower] : CHAIN_NO_ROW);
+	if (lower == end)
+		return side[higher];
+
+	return (fabsf(options->delta[side[higher]] - delta) <= fabsf(options->delta[side[lower]] - delta) ? side[higher] : side[lower]);
+}
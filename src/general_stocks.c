@@ -5,94 +5,165 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sqlite3.h>
 #include <sys/types.h>
 
 #include "../include/screener.h"
 #include "../include/general_stocks.h"
 #include "../include/options.h"
+#include "../include/option_table.h"
+#include "../include/price_table.h"
+#include "../include/symbols.h"
+#include "../include/universe.h"
+#include "../include/arena.h"
+#include "../include/thread_pool.h"
+#include "../include/realized.h"
+#include "../include/weight_kernel.h"
 #include "../include/safe.h"
 
-void gather_options(struct ParentStock **parent_array, long parent_array_size) {
-	int i, parent_array_index;
-	char previous[TICK_SIZE];
+/* Returns the number of rows in table, so a loader can size its columns once up front */
+static long count_rows(sqlite3 *db, const char *table) {
+	long count;
+	char sql[64];
+	sqlite3_stmt *stmt;
 
-	parent_array_index = 0;
-	memset(previous, 0, TICK_SIZE);
+	count = 0;
+	snprintf(sql, sizeof(sql), "SELECT count(*) FROM %s", table);
 
-	gather_options_data();
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+		count = sqlite3_column_int64(stmt, 0);
 
-	// iterate through all_options array
-	for (i = 0; i < all_options_size; i++) {
-		// if the current and previous ticker are different, means change in ticker
-		if (0 != strcmp(all_options[i]->ticker, previous)) {
-			// to avoid skipping the first index
-			if (i != 0)
-				parent_array_index++;
+	sqlite3_finalize(stmt);
 
-			memset(previous, 0, TICK_SIZE);
-			strcpy(previous, all_options[i]->ticker);
+	return count;
+}
 
-			parent_array[parent_array_index]->calls = safe_malloc(sizeof(struct option *));
-			parent_array[parent_array_index]->puts = safe_malloc(sizeof(struct option *));
-			parent_array[parent_array_index]->calls_size = 0;
-			parent_array[parent_array_index]->puts_size = 0;
-			parent_array[parent_array_index]->weight = 0;
-		}
+/* Opens filename and prepares sql against it. Returns FALSE, with everything closed, on failure */
+static int prepare_query(const char *filename, const char *sql, sqlite3 **db, sqlite3_stmt **stmt) {
+	if (sqlite3_open_v2(filename, db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ||
+		 sqlite3_prepare_v2(*db, sql, -1, stmt, NULL) != SQLITE_OK) {
+		fprintf(stderr, "Failed to fetch data: %s\n", sqlite3_errmsg(*db));
+		sqlite3_close(*db);
+		return FALSE;
+	}
 
-		// if it's a call option
-		if (all_options[i]->type == 1) {
-			parent_array[parent_array_index]->calls = safe_realloc(parent_array[parent_array_index]->calls,
-																					 ++(parent_array[parent_array_index]->calls_size) * sizeof(struct option *));
+	return TRUE;
+}
 
-			parent_array[parent_array_index]->calls[parent_array[parent_array_index]->calls_size - 1] = safe_malloc(sizeof(struct option));
-			parent_array[parent_array_index]->calls[parent_array[parent_array_index]->calls_size - 1]->parent = parent_array[parent_array_index];
-			copy_option(parent_array[parent_array_index]->calls[parent_array[parent_array_index]->calls_size - 1], all_options[i]);
-		}
-		else if (all_options[i]->type == 0) {
-			parent_array[parent_array_index]->puts = safe_realloc(parent_array[parent_array_index]->puts,
-																					++(parent_array[parent_array_index]->puts_size) * sizeof(struct option *));
+/* Attaches the loaded contracts and per-ticker volatility to their parents by symbol id, then groups the contracts by parent */
+void gather_options(struct ParentStock **parent_array, long parent_array_size, int *parent_of, struct OptionTable *options,
+						  struct TickerVolatility *volatility, long volatility_size) {
+	long i;
+	struct ParentStock *parent;
 
-			parent_array[parent_array_index]->puts[parent_array[parent_array_index]->puts_size - 1] = safe_malloc(sizeof(struct option));
-			parent_array[parent_array_index]->puts[parent_array[parent_array_index]->puts_size - 1]->parent = parent_array[parent_array_index];
-			copy_option(parent_array[parent_array_index]->puts[parent_array[parent_array_index]->puts_size - 1], all_options[i]);
-		}
+	for (i = 0; i < volatility_size; i++) {
+		if (parent_of[i] == NO_SYMBOL)
+			continue;
 
-		free(all_options[i]);
+		parent = parent_array[parent_of[i]];
+		parent->iv20 = volatility[i].iv20;
+		parent->iv50 = volatility[i].iv50;
+		parent->iv100 = volatility[i].iv100;
 	}
 
+	// contracts for tickers without price history have no parent and are dropped
+	for (i = 0; i < options->size; i++)
+		options->parent[i] = parent_of[options->parent[i]];
+
+	option_table_group(options, parent_array, parent_array_size);
+
 	return;
 }
 
-/* Gathers all options data from database */
-void gather_options_data(void) {
-	int rc;
-	char *error_msg;
+/*
+ * Streams every contract from the database straight into the option table, tagged with its symbol id.
+ * The per-ticker volatility columns are collected once per ticker into volatility, indexed by symbol id.
+ */
+void gather_options_data(struct SymbolTable *symbols, struct OptionTable *options, struct TickerVolatility **volatility, long *volatility_size) {
+	int rc, id;
+	long row, capacity;
+	char previous[TICK_SIZE];
+	const char *ticker, *type, *itm;
 	sqlite3 *db;
-	char *sql = "SELECT * FROM optionsData";
+	sqlite3_stmt *stmt;
+	char *sql = "SELECT ticker, type, expirationDate, dte, strike, volume, openInterest, bid, ask, lastPrice, percentChange, "
+					"itm, impliedVolatility, iv20, iv50, iv100, theta, beta, gamma, vega FROM optionsData";
+
+	id = NO_SYMBOL;
+	capacity = SYMBOL_TABLE_MIN_CAPACITY;
+	*volatility = safe_calloc(capacity, sizeof(struct TickerVolatility));
+	*volatility_size = 0;
+	memset(previous, 0, TICK_SIZE);
 
-	rc = sqlite3_open("optionsData", &db);
+	if (!prepare_query(OPTIONS_DB, sql, &db, &stmt))
+		return;
 
-	all_options_size = 0;
-	all_options = malloc(sizeof(struct option *));
+	option_table_reserve(options, count_rows(db, "optionsData"));
 
-	if (rc != SQLITE_OK) {
-		fprintf(stderr, "Failed to fetch data: %s\n", sqlite3_errmsg(db));
-		sqlite3_close(db);
-		return;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		ticker = (const char *)sqlite3_column_text(stmt, 0);
+		type = (const char *)sqlite3_column_text(stmt, 1);
+		itm = (const char *)sqlite3_column_text(stmt, 11);
+
+		if (ticker == NULL || type == NULL)
+			continue;
+
+		// rows arrive grouped by ticker, so the symbol table is only consulted when the ticker changes
+		if (0 != strncmp(ticker, previous, TICK_SIZE - 1)) {
+			memset(previous, 0, TICK_SIZE);
+			strncpy(previous, ticker, TICK_SIZE - 1);
+
+			id = symbol_intern(symbols, previous);
+
+			if (id >= capacity) {
+				*volatility = safe_realloc(*volatility, capacity * 2 * sizeof(struct TickerVolatility));
+				memset(*volatility + capacity, 0, capacity * sizeof(struct TickerVolatility));
+				capacity *= 2;
+			}
+
+			if (id >= *volatility_size)
+				*volatility_size = id + 1;
+
+			(*volatility)[id].iv20 = sqlite3_column_double(stmt, 13);
+			(*volatility)[id].iv50 = sqlite3_column_double(stmt, 14);
+			(*volatility)[id].iv100 = sqlite3_column_double(stmt, 15);
+		}
+
+		row = option_table_append(options);
+
+		options->parent[row] = id;
+		options->type[row] = ((0 == strcmp(type, "Call")) ? TRUE : FALSE); // call if TRUE, put is FALSE
+		options->expiration_date[row] = sqlite3_column_int64(stmt, 2);
+		options->days_til_expiration[row] = sqlite3_column_double(stmt, 3);
+		options->strike[row] = sqlite3_column_double(stmt, 4);
+		options->volume[row] = sqlite3_column_int64(stmt, 5);
+		options->open_interest[row] = sqlite3_column_int64(stmt, 6);
+		options->bid[row] = sqlite3_column_double(stmt, 7);
+		options->ask[row] = sqlite3_column_double(stmt, 8);
+		options->last_price[row] = sqlite3_column_double(stmt, 9);
+		options->percent_change[row] = sqlite3_column_double(stmt, 10);
+		options->in_the_money[row] = ((itm && 0 == strcmp(itm, "True")) ? TRUE : FALSE);
+		options->implied_volatility[row] = sqlite3_column_double(stmt, 12);
+
+		// NULL values read back as 0
+		options->theta[row] = sqlite3_column_double(stmt, 16);
+		options->beta[row] = sqlite3_column_double(stmt, 17);
+		options->gamma[row] = sqlite3_column_double(stmt, 18);
+		options->vega[row] = sqlite3_column_double(stmt, 19);
 	}
 
-	rc = sqlite3_exec(db, sql, options_callback, 0, &error_msg);
+	if (rc != SQLITE_DONE && rc != SQLITE_ROW)
+		fprintf(stderr, "Failed to fetch data: %s\n", sqlite3_errmsg(db));
+
+	sqlite3_finalize(stmt);
 	sqlite3_close(db);
 
 	return;
 }
 
-/* 
- * Effectively removes options from the list if the volume/open interest isn't up to standards
- * Also screens for bid x ask spread
- */
-void screen_volume_oi_baspread(struct ParentStock **parent_array, int parent_array_size) {
+/* Scores one stock's price history and closes every contract that fails the volume, open interest or spread screens */
+void screen_stock(struct ParentStock *stock, struct PriceTable *prices, struct OptionTable *options) {
 	/*
     * ALGORITHM/REQUIREMENTS:
     * 
@@ -105,327 +176,388 @@ void screen_volume_oi_baspread(struct ParentStock **parent_array, int parent_arr
 
 	char removed;
 	unsigned short dte;
-	unsigned int outter_i, inner_i, volume, open_interest;
+	unsigned int volume, open_interest;
+	long inner_i;
 	float bid, ask, min_vol;
 
-	for (outter_i = 0; outter_i < parent_array_size; outter_i++) {
-		parent_array[outter_i]->num_open_calls = parent_array[outter_i]->calls_size;
-		parent_array[outter_i]->num_open_puts = parent_array[outter_i]->puts_size;
-		large_price_drop(parent_array[outter_i]);
-		avg_stock_close(parent_array[outter_i]);
-		perc_from_high_low(parent_array[outter_i]);
-
-		for (inner_i = 0; inner_i < parent_array[outter_i]->calls_size; inner_i++) {
-			removed = FALSE;
-			bid = parent_array[outter_i]->calls[inner_i]->bid;
-			ask = parent_array[outter_i]->calls[inner_i]->ask;
-			volume = parent_array[outter_i]->calls[inner_i]->volume;
-			open_interest = parent_array[outter_i]->calls[inner_i]->open_interest;
-			dte = parent_array[outter_i]->calls[inner_i]->days_til_expiration;
-
-			if (volume < 10 || open_interest < 100 || bid < 3 || ask < 2)
+	stock->num_open_calls = stock->calls_end - stock->calls_begin;
+	stock->num_open_puts = stock->puts_end - stock->puts_begin;
+	price_analytics(stock, prices);
+	realized_volatility(stock, prices);
+
+	for (inner_i = stock->calls_begin; inner_i < stock->calls_end; inner_i++) {
+		removed = FALSE;
+		bid = options->bid[inner_i];
+		ask = options->ask[inner_i];
+		volume = options->volume[inner_i];
+		open_interest = options->open_interest[inner_i];
+		dte = options->days_til_expiration[inner_i];
+
+		if (volume < 10 || open_interest < 100 || bid < 3 || ask < 2)
+			removed = TRUE;
+		if (!removed && dte < 30) {
+			// honestly, this is a random equation. It basically says the closer to the dte,
+			// the larger the volume must be, so if dte = 2, volume must be at least 2000
+			if (dte <= 1)
 				removed = TRUE;
-			if (!removed && dte < 30) {
-				// honestly, this is a random equation. It basically says the closer to the dte,
-				// the larger the volume must be, so if dte = 2, volume must be at least 2000
-				if (dte <= 1)
-					removed = TRUE;
-				else
-					min_vol = 2000 / (dte / 2);
-
-				if (volume < min_vol)
-					removed = TRUE;
-			}
-			if (!removed && bid_ask_spread(parent_array[outter_i]->calls[inner_i])) {
-				removed = TRUE;
-			}
+			else
+				min_vol = 2000 / (dte / 2);
 
-			if (removed) {
-				parent_array[outter_i]->calls[inner_i] = NULL;
-				parent_array[outter_i]->num_open_calls--;
-			}
+			if (volume < min_vol)
+				removed = TRUE;
 		}
 
-		for (inner_i = 0; inner_i < parent_array[outter_i]->puts_size; inner_i++) {
-			removed = FALSE;
-			volume = parent_array[outter_i]->puts[inner_i]->volume;
-			open_interest = parent_array[outter_i]->puts[inner_i]->open_interest;
-			dte = parent_array[outter_i]->puts[inner_i]->days_til_expiration;
+		if (removed) {
+			options->open[inner_i] = FALSE;
+			stock->num_open_calls--;
+		}
+	}
 
-			if (volume < 10 || open_interest < 100)
+	for (inner_i = stock->puts_begin; inner_i < stock->puts_end; inner_i++) {
+		removed = FALSE;
+		volume = options->volume[inner_i];
+		open_interest = options->open_interest[inner_i];
+		dte = options->days_til_expiration[inner_i];
+
+		if (volume < 10 || open_interest < 100)
+			removed = TRUE;
+		if (!removed && dte < 30) {
+			// honestly, this is a random equation. It basically says the closer to the dte,
+			// the larger the volume must be, so if dte = 2, volume must be at least 2000
+			if (dte <= 1)
 				removed = TRUE;
-			if (!removed && dte < 30) {
-				// honestly, this is a random equation. It basically says the closer to the dte,
-				// the larger the volume must be, so if dte = 2, volume must be at least 2000
-				if (dte <= 1)
-					removed = TRUE;
-				else
-					min_vol = 2000 / (dte / 2);
-
-				if (volume < min_vol)
-					removed = TRUE;
-			}
-			if (!removed && bid_ask_spread(parent_array[outter_i]->puts[inner_i]))
+			else
+				min_vol = 2000 / (dte / 2);
+
+			if (volume < min_vol)
 				removed = TRUE;
+		}
 
-			if (removed) {
-				parent_array[outter_i]->puts[inner_i] = NULL;
-				parent_array[outter_i]->num_open_calls--;
-			}
+		if (removed) {
+			options->open[inner_i] = FALSE;
+			stock->num_open_puts--;
 		}
 	}
 
+	// whatever survived the volume screens is checked for its bid x ask spread a block at a time
+	stock->num_open_calls -= screen_spreads(options, stock->calls_begin, stock->calls_end);
+	stock->num_open_puts -= screen_spreads(options, stock->puts_begin, stock->puts_end);
+
 	return;
 }
 
-/* Gathers all historical pricing data from database */
-void gather_data(void) {
-	int rc;
-	char *error_msg;
-	sqlite3 *db;
-	char *sql = "SELECT * FROM historicalPrices";
+/* Screens one task's stock */
+static void screen_task(long task, void *arg) {
+	struct ScreenJob *job = arg;
 
-	historical_array_size = 0;
-	historical_price_array = malloc(sizeof(struct HistoricalPrice *));
+	screen_stock(job->parent_array[task], job->prices, job->options);
+}
 
-	rc = sqlite3_open("historicalPrices", &db);
+/* Screens every stock across the thread pool. Each stock only writes its own parent and option rows, so the result is the same for any thread count */
+void screen_volume_oi_baspread(struct ParentStock **parent_array, int parent_array_size, struct PriceTable *prices, struct OptionTable *options) {
+	long *cost;
+	struct ScreenJob job;
 
-	if (rc != SQLITE_OK) {
-		fprintf(stderr, "Failed to fetch data: %s\n", sqlite3_errmsg(db));
-		sqlite3_close(db);
+	job.parent_array = parent_array;
+	job.prices = prices;
+	job.options = options;
 
-		return;
-	}
+	cost = screening_costs(parent_array, parent_array_size);
+	thread_pool_run(parent_array_size, cost, screen_task, &job);
+	free(cost);
 
-	rc = sqlite3_exec(db, sql, historical_price_callback, 0, &error_msg);
+	return;
+}
 
-	sqlite3_close(db);
+/* Estimated work for each stock, its option chain plus its price history */
+long *screening_costs(struct ParentStock **parent_array, long parent_array_size) {
+	long i, *cost;
 
-	return;
+	cost = safe_malloc((parent_array_size ? parent_array_size : 1) * sizeof(long));
+
+	for (i = 0; i < parent_array_size; i++)
+		cost[i] = (parent_array[i]->puts_end - parent_array[i]->calls_begin) + (parent_array[i]->prices_end - parent_array[i]->prices_begin);
+
+	return cost;
 }
 
-struct ParentStock **gather_tickers(long *pa_size) {
-	int i;
+/* Streams every daily bar from the database straight into the price table, tagged with its symbol id */
+void gather_data(struct SymbolTable *symbols, struct PriceTable *prices) {
+	int rc, id;
+	long row;
 	char previous[TICK_SIZE];
-	long prices_array_size, parent_array_size;
-	struct ParentStock **parent_array; // list of all stock tickers containing lists of their historical prices
+	const char *ticker;
+	sqlite3 *db;
+	sqlite3_stmt *stmt;
+	char *sql = "SELECT ticker, date, open, low, high, close, volume FROM historicalPrices";
 
-	parent_array_size = 0;
-	parent_array = safe_malloc(sizeof(struct ParentStock *));
+	id = NO_SYMBOL;
 	memset(previous, 0, TICK_SIZE);
 
-	gather_data();
+	if (!prepare_query(PRICES_DB, sql, &db, &stmt))
+		return;
 
-	for (i = 0; i < historical_array_size; i++) {
-		if (0 != strcmp(historical_price_array[i]->ticker, previous)) {
-			if (i != 0)
-				find_curr_stock_price(parent_array[parent_array_size - 1]);
+	price_table_reserve(prices, count_rows(db, "historicalPrices"));
 
-			memset(previous, 0, TICK_SIZE);
-			strcpy(previous, historical_price_array[i]->ticker);
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		ticker = (const char *)sqlite3_column_text(stmt, 0);
 
-			parent_array = safe_realloc(parent_array, ++parent_array_size * (sizeof(struct ParentStock *)));
-			parent_array[parent_array_size - 1] = safe_malloc(sizeof(struct ParentStock));
+		if (ticker == NULL)
+			continue;
 
-			memset(parent_array[parent_array_size - 1]->ticker, 0, TICK_SIZE);
-			strcpy(parent_array[parent_array_size - 1]->ticker, historical_price_array[i]->ticker);
-			parent_array[parent_array_size - 1]->prices_array = safe_malloc(sizeof(struct HistoricalPrice *));
-			parent_array[parent_array_size - 1]->weight = 0;
-			parent_array[parent_array_size - 1]->calls_weight = 0;
-			parent_array[parent_array_size - 1]->puts_weight = 0;
+		if (0 != strncmp(ticker, previous, TICK_SIZE - 1)) {
+			memset(previous, 0, TICK_SIZE);
+			strncpy(previous, ticker, TICK_SIZE - 1);
 
-			prices_array_size = 0;
+			id = symbol_intern(symbols, previous);
 		}
 
-		parent_array[parent_array_size - 1]->prices_array = safe_realloc(parent_array[parent_array_size - 1]->prices_array, ++prices_array_size * (sizeof(struct HistoricalPrice *)));
-		parent_array[parent_array_size - 1]->prices_array[prices_array_size - 1] = safe_malloc(sizeof(struct HistoricalPrice));
-		parent_array[parent_array_size - 1]->prices_array_size = prices_array_size;
-
-		strcpy(parent_array[parent_array_size - 1]->prices_array[prices_array_size - 1]->ticker, historical_price_array[i]->ticker);
-		parent_array[parent_array_size - 1]->prices_array[prices_array_size - 1]->date = historical_price_array[i]->date;
-		parent_array[parent_array_size - 1]->prices_array[prices_array_size - 1]->open = historical_price_array[i]->open;
-		parent_array[parent_array_size - 1]->prices_array[prices_array_size - 1]->low = historical_price_array[i]->low;
-		parent_array[parent_array_size - 1]->prices_array[prices_array_size - 1]->high = historical_price_array[i]->high;
-		parent_array[parent_array_size - 1]->prices_array[prices_array_size - 1]->close = historical_price_array[i]->close;
-		parent_array[parent_array_size - 1]->prices_array[prices_array_size - 1]->volume = historical_price_array[i]->volume;
+		row = price_table_append(prices);
 
-		// to free up memory since this is memory intensive
-		free(historical_price_array[i]);
+		prices->parent[row] = id;
+		prices->date[row] = sqlite3_column_int64(stmt, 1);
+		prices->open[row] = sqlite3_column_double(stmt, 2);
+		prices->low[row] = sqlite3_column_double(stmt, 3);
+		prices->high[row] = sqlite3_column_double(stmt, 4);
+		prices->close[row] = sqlite3_column_double(stmt, 5);
+		prices->volume[row] = sqlite3_column_int64(stmt, 6);
 	}
 
-	free(historical_price_array);
-
-	*pa_size = parent_array_size;
-	return parent_array;
-}
-
-void find_curr_stock_price(struct ParentStock *stock) {
-	int size = stock->prices_array_size - 1;
+	if (rc != SQLITE_DONE && rc != SQLITE_ROW)
+		fprintf(stderr, "Failed to fetch data: %s\n", sqlite3_errmsg(db));
 
-	stock->curr_price = stock->prices_array[size]->close;
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
 
 	return;
 }
 
-int historical_price_callback(void *NotUsed, int argc, char **argv, char **azColName) {
-	historical_price_array = realloc(historical_price_array, ++historical_array_size * (sizeof(struct HistoricalPrice *)));
-	historical_price_array[historical_array_size - 1] = malloc(sizeof(struct HistoricalPrice));
+/* Runs gather_data on its own thread */
+static void *gather_data_thread(void *load) {
+	struct PriceLoad *args = load;
 
-	memset(historical_price_array[historical_array_size - 1]->ticker, 0, 10);
-	strcpy(historical_price_array[historical_array_size - 1]->ticker, argv[0]);
-	historical_price_array[historical_array_size - 1]->date = atof(argv[1]);
-	historical_price_array[historical_array_size - 1]->open = atof(argv[2]);
-	historical_price_array[historical_array_size - 1]->low = atof(argv[3]);
-	historical_price_array[historical_array_size - 1]->high = atof(argv[4]);
-	historical_price_array[historical_array_size - 1]->close = atof(argv[5]);
-	historical_price_array[historical_array_size - 1]->volume = atof(argv[6]);
+	gather_data(args->symbols, args->prices);
 
-	return 0;
+	return NULL;
 }
 
-void large_price_drop(struct ParentStock *stock) {
-	int i, starting_index;
-	float change, previous;
+/* Tags each stock with the collector revision that last changed its data. Databases written before revisions were kept leave every stock at 0 */
+static void gather_revisions(struct SymbolTable *symbols, struct ParentStock **parent_array, int *parent_of) {
+	int id;
+	char name[TICK_SIZE];
+	const char *ticker;
+	sqlite3 *db;
+	sqlite3_stmt *stmt;
+	char *sql = "SELECT ticker, revision FROM tickerRevisions";
 
-	starting_index = (stock->prices_array_size <= 100 ? 0 : stock->prices_array_size - 30);
+	if (sqlite3_open_v2(OPTIONS_DB, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK || sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+		sqlite3_close(db);
+		return;
+	}
 
-	previous = 0;
+	memset(name, 0, TICK_SIZE);
 
-	for (i = starting_index; i < stock->prices_array_size; i++) {
-		if (i == 0 || i == starting_index) {
-			previous = stock->prices_array[i]->close;
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		if ((ticker = (const char *)sqlite3_column_text(stmt, 0)) == NULL)
 			continue;
-		}
 
-		change = (previous - stock->prices_array[i]->close) / previous;
-		change = (change < 0 ? change *= -1 : change); // since abs() only works on ints
+		strncpy(name, ticker, TICK_SIZE - 1);
+
+		if ((id = symbol_lookup(symbols, name)) == NO_SYMBOL || parent_of[id] == NO_SYMBOL)
+			continue;
 
-		if (change * 100 >= 7.5)
-			stock->weight += 100 * (change / 7.5);
+		parent_array[parent_of[id]]->revision = sqlite3_column_int64(stmt, 1);
 	}
 
-	// finding total change over the period
-	change = (stock->prices_array[starting_index]->close - stock->prices_array[i - 1]->close) / stock->prices_array[starting_index]->close;
-	change = (change < 0 ? change *= -1 : change); // since abs() only works on ints
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
+}
 
-	if (change * 100 >= 10)
-		stock->weight += 100 * (change / 10);
+/*
+ * Loads historicalPrices and optionsData in parallel and joins them on symbol id, so neither table has
+ * to come back sorted or in the same ticker order. Fills the universe with one parent per ticker with
+ * price history, in the order the tickers first appear in historicalPrices.
+ */
+void gather_tickers(struct Universe *universe) {
+	int threaded, *parent_of;
+	long volatility_size;
+	pthread_t thread;
+	struct PriceLoad load;
+	struct TickerVolatility *volatility;
+	struct SymbolTable *symbols = &universe->symbols;
+	struct PriceTable *prices = &universe->prices;
 
-	return;
+	load.symbols = symbols;
+	load.prices = prices;
+
+	// each loader has its own database connection, they only share the symbol table and arena
+	threaded = (pthread_create(&thread, NULL, gather_data_thread, &load) == 0);
+	if (!threaded)
+		gather_data(symbols, prices);
+
+	gather_options_data(symbols, &universe->options, &volatility, &volatility_size);
+
+	if (threaded)
+		pthread_join(thread, NULL);
+
+	parent_of = link_tickers(universe, volatility, volatility_size);
+	gather_revisions(symbols, universe->parent_array, parent_of);
+
+	free(volatility);
+	free(parent_of);
 }
 
-void perc_from_high_low(struct ParentStock *stock) {
-	int i;
-	float dif, low, high, weight;
+/*
+ * Builds one parent per ticker with price history from price and option tables loaded with symbol
+ * ids, in the order the tickers first appear in the price table, and groups both tables by parent.
+ * Returns the symbol id to parent index map, for the caller to free.
+ */
+int *link_tickers(struct Universe *universe, struct TickerVolatility *volatility, long volatility_size) {
+	int id, *parent_of;
+	long row, parent_array_size;
+	struct SymbolTable *symbols = &universe->symbols;
+	struct PriceTable *prices = &universe->prices;
+	struct ParentStock **parent_array; // list of all stock tickers containing ranges of their historical prices
 
-	low = INT64_MAX;
-	high = 0;
+	parent_array_size = 0;
+	parent_array = arena_alloc(&universe->arena, symbols->size * sizeof(struct ParentStock *));
+	parent_of = safe_malloc((symbols->size ? symbols->size : 1) * sizeof(int));
+
+	for (id = 0; id < symbols->size; id++)
+		parent_of[id] = NO_SYMBOL;
+
+	for (row = 0; row < prices->size; row++) {
+		id = prices->parent[row];
 
-	for (i = 0; i < stock->prices_array_size; i++) {
-		if (stock->prices_array[i]->close < low)
-			low = stock->prices_array[i]->close;
-		else if (stock->prices_array[i]->close > high)
-			high = stock->prices_array[i]->close;
+		if (parent_of[id] == NO_SYMBOL) {
+			parent_array[parent_array_size] = arena_calloc(&universe->arena, 1, sizeof(struct ParentStock));
+			strcpy(parent_array[parent_array_size]->ticker, symbols->names[id]);
+			parent_of[id] = parent_array_size++;
+		}
+
+		prices->parent[row] = parent_of[id];
 	}
 
-	stock->yearly_low = low;
-	stock->yearly_high = high;
+	price_table_group(prices, parent_array, parent_array_size);
 
-	dif = low - stock->curr_price;
-	dif = (dif < 0 ? dif *= -1 : dif);
+	for (row = 0; row < parent_array_size; row++)
+		find_curr_stock_price(parent_array[row], prices);
 
-	stock->perc_from_year_low = (dif / stock->curr_price) * 100;
-	stock->perc_from_year_high = ((high - stock->curr_price) / stock->curr_price) * 100;
+	gather_options(parent_array, parent_array_size, parent_of, &universe->options, volatility, volatility_size);
+
+	universe->parent_array = parent_array;
+	universe->parent_array_size = parent_array_size;
 
-	// weight to be assigned given percent from low
-	weight = 100 - (stock->perc_from_year_low * 100);
-	stock->calls_weight += weight;
+	return parent_of;
+}
 
-	// weight to be assigned given percent from high
-	weight = 100 - (stock->perc_from_year_high * 100);
-	stock->puts_weight += weight;
+void find_curr_stock_price(struct ParentStock *stock, struct PriceTable *prices) {
+	stock->curr_price = prices->close[stock->prices_end - 1];
 
 	return;
 }
 
 /*
- * General algorithm:
+ * Every historical price statistic for one stock in a single sweep over its close column. This
+ * folds together what used to be large_price_drop, avg_stock_close, perc_from_high_low, price_trend
+ * and average_perc_change, and gives the same results down to the bit: each statistic keeps its
+ * own running state and arithmetic, and the weights are added in the order those functions used.
+ *
+ * Price trend, general algorithm:
  * Everything will be weighted as we go, so there will be a positive and a negative weight.
  * It will be adjusted as we go, so I'll use a consecutive_days variable to determine how
  * many days in a row the same price trend has been going. It might also be smart to create
  * a more generalized version because there will likely be dips even when it is generally a
  * strong uptrend pattern.
  */
-void price_trend(struct ParentStock *stock) {
-	int i, positive, prev_positive, consecutive_days;
-	float dif, previous, current, perc_change;
-	float neg_weight = 0, pos_weight = 0;
+void price_analytics(struct ParentStock *stock, struct PriceTable *prices) {
+	int i, size, starting_index, positive, prev_positive, consecutive_days;
+	float change, current, low, high, total, total_changes, weight, neg_weight, pos_weight, *close;
+	float drop_previous, trend_previous, change_previous;
 
-	positive = FALSE;
+	close = prices->close + stock->prices_begin;
+	size = stock->prices_end - stock->prices_begin;
 
-	for (i = 0; i < stock->prices_array_size; i++) {
-		current = stock->prices_array[i]->close;
+	// large drops only look at the last 30 days of a long history
+	starting_index = (size <= 100 ? 0 : size - 30);
 
-		if (i == 0) {
-			previous = current;
-			continue;
-		}
+	low = INT64_MAX;
+	high = 0;
+	total = 0;
+	total_changes = 0;
+	neg_weight = 0;
+	pos_weight = 0;
+	prev_positive = FALSE;
+	consecutive_days = 0;
+	weight = stock->weight;
 
-		dif = current - previous;
-		positive = (dif > 0 ? TRUE : FALSE);
+	// the drop and trend baselines are set once and never move on
+	drop_previous = close[starting_index];
+	trend_previous = close[0];
+	change_previous = close[0];
 
-		perc_change = fabsf(dif) / previous;
-		consecutive_days = (prev_positive == positive ? ++consecutive_days : 0); // if trend is broke, consecutive_days is reset
+	for (i = 0; i < size; i++) {
+		current = close[i];
 
-		if (positive)
-			pos_weight += perc_change * consecutive_days / 5;
-		else
-			neg_weight += perc_change * consecutive_days / 5;
+		total += current;
 
-		prev_positive = positive;
-	}
+		if (current < low)
+			low = current;
+		else if (current > high)
+			high = current;
 
-	stock->calls_weight += pos_weight / 7.5;
-	stock->puts_weight += neg_weight / 7.5;
-
-	return;
-}
+		if (i == 0)
+			continue;
 
-void average_perc_change(struct ParentStock *stock) {
-	int i;
-	float dif, change, current, previous, total_changes;
+		if (i > starting_index) {
+			change = (drop_previous - current) / drop_previous;
+			change = (change < 0 ? -change : change);
 
-	total_changes = 0;
+			if (change * 100 >= 7.5)
+				weight += 100 * (change / 7.5);
+		}
 
-	for (i = 0; i < stock->prices_array_size; i++) {
-		current = stock->prices_array[i]->close;
+		change = current - trend_previous;
+		positive = (change > 0 ? TRUE : FALSE);
+		consecutive_days = (prev_positive == positive ? consecutive_days + 1 : 0); // if trend is broke, consecutive_days is reset
 
-		if (i == 0) {
-			previous = current;
-			continue;
-		}
+		if (positive)
+			pos_weight += fabsf(change) / trend_previous * consecutive_days / 5;
+		else
+			neg_weight += fabsf(change) / trend_previous * consecutive_days / 5;
 
-		dif = fabsf(current - previous);
-		change = dif / previous * 100;
-		total_changes += change;
+		prev_positive = positive;
 
-		previous = current;
+		total_changes += fabsf(current - change_previous) / change_previous * 100;
+		change_previous = current;
 	}
 
-	change = total_changes / stock->prices_array_size;
-	stock->weight += (change * 100);
-}
+	// finding total change over the period
+	change = (close[starting_index] - close[size - 1]) / close[starting_index];
+	change = (change < 0 ? -change : change);
 
-void avg_stock_close(struct ParentStock *stock) {
-	int i;
-	float total;
+	if (change * 100 >= 10)
+		weight += 100 * (change / 10);
 
-	total = 0;
+	stock->avg_close = total / size;
+	stock->yearly_low = low;
+	stock->yearly_high = high;
+
+	change = low - stock->curr_price;
+	change = (change < 0 ? -change : change);
+
+	stock->perc_from_year_low = (change / stock->curr_price) * 100;
+	stock->perc_from_year_high = ((high - stock->curr_price) / stock->curr_price) * 100;
+
+	// weight to be assigned given percent from low and high
+	stock->calls_weight += 100 - (stock->perc_from_year_low * 100);
+	stock->puts_weight += 100 - (stock->perc_from_year_high * 100);
 
-	for (i = 0; i < stock->prices_array_size; i++)
-		total += stock->prices_array[i]->close;
+	stock->calls_weight += pos_weight / 7.5;
+	stock->puts_weight += neg_weight / 7.5;
 
-	stock->avg_close = total / i;
+	change = total_changes / size;
+	stock->weight = weight + (change * 100);
 
 	return;
 }
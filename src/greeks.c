@@ -0,0 +1,778 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define GREEKS_X86
+#endif
+
+#include "../include/screener.h"
+#include "../include/greeks.h"
+#include "../include/weight_kernel.h"
+
+// Cody-Waite split of ln 2 and the Cephes expf/logf coefficients
+#define LN2_HIGH 0.693359375f
+#define LN2_LOW -2.12194440e-4f
+#define LOG2E 1.44269504088896341f
+#define EXP_MIN -87.3f
+#define EXP_MAX 88.3f
+#define SQRT_HALF 0.707106781186547524f
+#define INV_SQRT_2PI 0.398942280401432678f
+
+// Abramowitz and Stegun 26.2.17, absolute error below 7.5e-8
+#define CDF_P 0.2316419f
+#define CDF_B1 0.319381530f
+#define CDF_B2 -0.356563782f
+#define CDF_B3 1.781477937f
+#define CDF_B4 -1.821255978f
+#define CDF_B5 1.330274429f
+
+#define DAYS_PER_YEAR 365.0f
+#define SQRT_2PI 2.50662827463100050f
+#define INV_PI 0.318309886183790672f
+
+// the solver keeps every volatility inside [IV_MIN, IV_MAX], as fractions rather than points
+#define IV_MIN 0.01f
+#define IV_MAX 5.0f
+#define IV_ITERATIONS 16
+#define IV_TOLERANCE 0.001f           // dollars, a tenth of a cent off the target price is solved
+#define IV_STRIDE 8                   // warm start from the contract this many rows back, the widest lane count
+
+static float rate;
+static int quoted_volatility;
+static pthread_once_t settings_once = PTHREAD_ONCE_INIT;
+
+static void read_settings(void) {
+	char *env, *end;
+	double value;
+
+	rate = GREEKS_DEFAULT_RATE;
+
+	if ((env = getenv(GREEKS_RATE_ENV)) != NULL) {
+		value = strtod(env, &end);
+		if (end == env || *end != '\0' || !isfinite(value))
+			fprintf(stderr, "Warning: Ignoring %s=%s\n", GREEKS_RATE_ENV, env);
+		else
+			rate = value;
+	}
+
+	quoted_volatility = FALSE;
+
+	if ((env = getenv(GREEKS_IV_ENV)) != NULL) {
+		if (strcmp(env, "quoted") == 0)
+			quoted_volatility = TRUE;
+		else if (strcmp(env, "solved") != 0)
+			fprintf(stderr, "Warning: Ignoring %s=%s\n", GREEKS_IV_ENV, env);
+	}
+}
+
+/* The risk free rate, GREEKS_DEFAULT_RATE unless GREEKS_RATE_ENV sets it */
+float greeks_rate(void) {
+	pthread_once(&settings_once, read_settings);
+
+	return rate;
+}
+
+/* e^x, rounding x / ln 2 to the nearest integer as the vector conversions do */
+static float approx_exp(float x) {
+	int32_t bits;
+	float n, r, p, scale;
+
+	x = (x < EXP_MIN ? EXP_MIN : (x > EXP_MAX ? EXP_MAX : x));
+	n = rintf(x * LOG2E);
+	r = x - n * LN2_HIGH - n * LN2_LOW;
+
+	p = 1.9875691500e-4f;
+	p = p * r + 1.3981999507e-3f;
+	p = p * r + 8.3334519073e-3f;
+	p = p * r + 4.1665795894e-2f;
+	p = p * r + 1.6666665459e-1f;
+	p = p * r + 5.0000001201e-1f;
+	p = p * r * r + r + 1;
+
+	bits = ((int32_t)n + 127) << 23;
+	memcpy(&scale, &bits, sizeof(float));
+
+	return p * scale;
+}
+
+/* ln x for positive, normal x */
+static float approx_log(float x) {
+	int32_t bits;
+	float e, m, z, y;
+
+	memcpy(&bits, &x, sizeof(float));
+	e = (float)(((bits >> 23) & 0xff) - 126);
+	bits = (bits & 0x007fffff) | 0x3f000000;
+	memcpy(&m, &bits, sizeof(float));
+
+	// m is in [0.5, 1), moved to [sqrt(0.5), sqrt(2)) so the polynomial sees x - 1 near 0
+	if (m < SQRT_HALF) {
+		e -= 1;
+		m = m + m - 1;
+	}
+	else
+		m = m - 1;
+
+	z = m * m;
+	y = 7.0376836292e-2f;
+	y = y * m - 1.1514610310e-1f;
+	y = y * m + 1.1676998740e-1f;
+	y = y * m - 1.2420140846e-1f;
+	y = y * m + 1.4249322787e-1f;
+	y = y * m - 1.6668057665e-1f;
+	y = y * m + 2.0000714765e-1f;
+	y = y * m - 2.4999993993e-1f;
+	y = y * m + 3.3333331174e-1f;
+	y = y * m * z;
+
+	y += LN2_LOW * e;
+	y -= 0.5f * z;
+
+	return m + y + LN2_HIGH * e;
+}
+
+/* Standard normal CDF at x, given the density there */
+static float normal_cdf(float x, float pdf) {
+	float t, tail;
+
+	t = 1 / (1 + CDF_P * fabsf(x));
+	tail = pdf * t * (CDF_B1 + t * (CDF_B2 + t * (CDF_B3 + t * (CDF_B4 + t * CDF_B5))));
+
+	return (x >= 0 ? 1 - tail : tail);
+}
+
+/* The greeks of one contract */
+static void greeks_row(struct OptionTable *options, long i, float spot, float rate) {
+	float strike, years, sigma, root, spread, d1, d2, pdf1, cdf1, cdf2, discount, decay;
+
+	strike = options->strike[i];
+	years = options->days_til_expiration[i] / DAYS_PER_YEAR;
+	sigma = options->implied_volatility[i] / 100;
+
+	// expired or unpriced, only the payoff is left and nothing else moves it
+	if (!(spot > 0 && strike > 0 && years > 0 && sigma > 0)) {
+		options->delta[i] = (options->type[i] ? (spot > strike) : -(spot < strike));
+		options->gamma[i] = options->theta[i] = options->vega[i] = options->rho[i] = 0;
+		return;
+	}
+
+	root = sqrtf(years);
+	spread = sigma * root;
+	d1 = (approx_log(spot / strike) + (rate + 0.5f * sigma * sigma) * years) / spread;
+	d2 = d1 - spread;
+
+	pdf1 = approx_exp(-0.5f * d1 * d1) * INV_SQRT_2PI;
+	cdf1 = normal_cdf(d1, pdf1);
+	cdf2 = normal_cdf(d2, approx_exp(-0.5f * d2 * d2) * INV_SQRT_2PI);
+	discount = strike * approx_exp(-rate * years);
+	decay = -spot * pdf1 * sigma / (2 * root);
+
+	options->gamma[i] = pdf1 / (spot * spread);
+	options->vega[i] = spot * pdf1 * root / 100;
+
+	if (options->type[i]) {
+		options->delta[i] = cdf1;
+		options->theta[i] = (decay - rate * discount * cdf2) / DAYS_PER_YEAR;
+		options->rho[i] = discount * years * cdf2 / 100;
+	}
+	else {
+		options->delta[i] = cdf1 - 1;
+		options->theta[i] = (decay + rate * discount * (1 - cdf2)) / DAYS_PER_YEAR;
+		options->rho[i] = -discount * years * (1 - cdf2) / 100;
+	}
+}
+
+/* A call's or put's price under volatility sigma, with its vega in vega. side is 1 for calls and -1 for puts */
+static float price_row(float spot, float discount, float moneyness, float root, float years, float r, float side, float sigma, float *vega) {
+	float spread, d1, d2, pdf1;
+
+	spread = sigma * root;
+	d1 = (moneyness + (r + 0.5f * (sigma * sigma)) * years) / spread;
+	d2 = d1 - spread;
+
+	pdf1 = approx_exp(-0.5f * d1 * d1) * INV_SQRT_2PI;
+	*vega = spot * pdf1 * root;
+
+	return side * (spot * normal_cdf(side * d1, pdf1) - discount * normal_cdf(side * d2, approx_exp(-0.5f * d2 * d2) * INV_SQRT_2PI));
+}
+
+/*
+ * What a call, or put, is worth with days left to run at volatility sigma, a fraction, and the
+ * risk free rate. Expired or unpriceable contracts are worth their intrinsic value.
+ */
+float greeks_price(char type, float spot, float strike, int days, float sigma) {
+	float years, root, r, side, discount, vega;
+
+	side = (type ? 1.0f : -1.0f);
+	years = days / DAYS_PER_YEAR;
+
+	if (!(spot > 0 && strike > 0 && years > 0 && sigma > 0))
+		return (side * (spot - strike) > 0 ? side * (spot - strike) : 0);
+
+	r = greeks_rate();
+	root = sqrtf(years);
+	discount = strike * approx_exp(-r * years);
+
+	return price_row(spot, discount, approx_log(spot / strike), root, years, r, side, sigma, &vega);
+}
+
+/* What the contract is worth to the solver: the midpoint of a sane quote, else the last trade, else 0 */
+static float target_price(float bid, float ask, float last_price) {
+	if (ask > 0 && bid >= 0 && ask >= bid)
+		return (bid + ask) * 0.5f;
+
+	return (last_price > 0 ? last_price : 0);
+}
+
+/* The contract IV_STRIDE rows back, if it is on the same side of the same expiration, as a starting volatility. 0 if there is none */
+static float warm_start(struct OptionTable *options, long begin, long i) {
+	float sigma;
+
+	if (i - IV_STRIDE < begin || options->type[i - IV_STRIDE] != options->type[i]
+	    || options->expiration_date[i - IV_STRIDE] != options->expiration_date[i])
+		return 0;
+
+	sigma = options->implied_volatility[i - IV_STRIDE] / 100;
+
+	return (sigma > IV_MIN && sigma < IV_MAX ? sigma : 0);
+}
+
+/* Corrado and Miller's closed form guess, from the call price parity gives for puts */
+static float rational_guess(float spot, float discount, float root, float call_price) {
+	float gap, above, disc, guess;
+
+	gap = spot - discount;
+	above = call_price - gap * 0.5f;
+	disc = above * above - gap * gap * INV_PI;
+	disc = (disc > 0 ? disc : 0);
+	guess = SQRT_2PI / (root * (spot + discount)) * (above + sqrtf(disc));
+	guess = (guess > IV_MIN ? guess : IV_MIN);
+
+	return (guess < IV_MAX ? guess : IV_MAX);
+}
+
+/* Solves one contract's volatility from its price, leaving it as quoted if the price has no solution */
+static void solve_row(struct OptionTable *options, long begin, long i, float spot, float r) {
+	int k, active;
+	float strike, years, root, side, target, discount, moneyness, lower, upper, sigma, guess, low, high, price, vega, diff, step;
+
+	strike = options->strike[i];
+	years = options->days_til_expiration[i] / DAYS_PER_YEAR;
+	side = (options->type[i] ? 1.0f : -1.0f);
+	target = target_price(options->bid[i], options->ask[i], options->last_price[i]);
+
+	// a price at or outside the no arbitrage bounds has no volatility behind it
+	discount = strike * approx_exp(-r * years);
+	lower = side * (spot - discount);
+	lower = (lower > 0 ? lower : 0);
+	upper = (options->type[i] ? spot : discount);
+	if (!(spot > 0 && strike > 0 && years > 0 && target > lower && target < upper))
+		return;
+
+	root = sqrtf(years);
+	moneyness = approx_log(spot / strike);
+
+	guess = warm_start(options, begin, i);
+	sigma = (guess > 0 ? guess : rational_guess(spot, discount, root, target + (options->type[i] ? 0 : spot - discount)));
+	low = IV_MIN;
+	high = IV_MAX;
+
+	// Newton's method, falling back to bisection whenever a step would leave the bracket
+	for (k = 0, active = TRUE; k < IV_ITERATIONS && active; k++) {
+		price = price_row(spot, discount, moneyness, root, years, r, side, sigma, &vega);
+		diff = price - target;
+
+		if (fabsf(diff) <= IV_TOLERANCE) {
+			active = FALSE;
+			break;
+		}
+
+		if (diff > 0)
+			high = sigma;
+		else
+			low = sigma;
+
+		step = sigma - diff / vega;
+		sigma = (step > low && step < high ? step : (low + high) * 0.5f);
+	}
+
+	// one that never came within IV_TOLERANCE keeps its quoted volatility
+	if (!active)
+		options->implied_volatility[i] = sigma * 100;
+}
+
+#ifdef GREEKS_X86
+
+/* Lanes of mask take b, the rest keep a. SSE2 has no blendv */
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+/* All ones in each of the four lanes whose byte is set */
+static inline __m128 byte_mask_sse2(const char *bytes) {
+	int32_t word;
+	__m128i zero = _mm_setzero_si128(), lanes;
+
+	memcpy(&word, bytes, sizeof(int32_t));
+	lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero), zero);
+
+	return _mm_castsi128_ps(_mm_andnot_si128(_mm_cmpeq_epi32(lanes, zero), _mm_set1_epi32(-1)));
+}
+
+static inline __m128 exp_sse2(__m128 x) {
+	__m128 n, r, p;
+	__m128i whole;
+
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_MIN)), _mm_set1_ps(EXP_MAX));
+	whole = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(LOG2E)));
+	n = _mm_cvtepi32_ps(whole);
+	r = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(LN2_HIGH))), _mm_mul_ps(n, _mm_set1_ps(LN2_LOW)));
+
+	p = _mm_set1_ps(1.9875691500e-4f);
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.3981999507e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(8.3334519073e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(4.1665795894e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.6666665459e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(5.0000001201e-1f));
+	p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), r), _mm_set1_ps(1));
+
+	return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(whole, _mm_set1_epi32(127)), 23)));
+}
+
+static inline __m128 log_sse2(__m128 x) {
+	__m128 e, m, z, y, small;
+	__m128i bits = _mm_castps_si128(x);
+
+	e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(126)));
+	m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f000000)));
+
+	small = _mm_cmplt_ps(m, _mm_set1_ps(SQRT_HALF));
+	e = _mm_sub_ps(e, _mm_and_ps(small, _mm_set1_ps(1)));
+	m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(small, m)), _mm_set1_ps(1));
+
+	z = _mm_mul_ps(m, m);
+	y = _mm_set1_ps(7.0376836292e-2f);
+	y = _mm_sub_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.1514610310e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.1676998740e-1f));
+	y = _mm_sub_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.2420140846e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.4249322787e-1f));
+	y = _mm_sub_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.6668057665e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(2.0000714765e-1f));
+	y = _mm_sub_ps(_mm_mul_ps(y, m), _mm_set1_ps(2.4999993993e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(3.3333331174e-1f));
+	y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+
+	y = _mm_add_ps(y, _mm_mul_ps(_mm_set1_ps(LN2_LOW), e));
+	y = _mm_sub_ps(y, _mm_mul_ps(_mm_set1_ps(0.5f), z));
+
+	return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(_mm_set1_ps(LN2_HIGH), e));
+}
+
+static inline __m128 cdf_sse2(__m128 x, __m128 pdf) {
+	__m128 t, tail, one = _mm_set1_ps(1);
+
+	t = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(CDF_P), _mm_andnot_ps(_mm_set1_ps(-0.0f), x))));
+	tail = _mm_add_ps(_mm_set1_ps(CDF_B4), _mm_mul_ps(t, _mm_set1_ps(CDF_B5)));
+	tail = _mm_add_ps(_mm_set1_ps(CDF_B3), _mm_mul_ps(t, tail));
+	tail = _mm_add_ps(_mm_set1_ps(CDF_B2), _mm_mul_ps(t, tail));
+	tail = _mm_add_ps(_mm_set1_ps(CDF_B1), _mm_mul_ps(t, tail));
+	tail = _mm_mul_ps(_mm_mul_ps(pdf, t), tail);
+
+	return select_ps(_mm_cmpge_ps(x, _mm_setzero_ps()), tail, _mm_sub_ps(one, tail));
+}
+
+static long greeks_sse2(struct OptionTable *options, long begin, long end, float spot, float rate) {
+	long i;
+	__m128 call, valid, strike, years, sigma, root, spread, d1, d2, pdf1, cdf1, cdf2, discount, decay, put_cdf2;
+	__m128 delta, theta, rho, payoff, zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+	__m128 s = _mm_set1_ps(spot), r = _mm_set1_ps(rate), days = _mm_set1_ps(DAYS_PER_YEAR), hundred = _mm_set1_ps(100);
+	__m128 half = _mm_set1_ps(0.5f), density = _mm_set1_ps(INV_SQRT_2PI);
+
+	for (i = begin; i + 4 <= end; i += 4) {
+		call = byte_mask_sse2(options->type + i);
+		strike = _mm_loadu_ps(options->strike + i);
+		years = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(options->days_til_expiration + i))), days);
+		sigma = _mm_div_ps(_mm_loadu_ps(options->implied_volatility + i), hundred);
+
+		valid = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(s, zero), _mm_cmpgt_ps(strike, zero)),
+		                   _mm_and_ps(_mm_cmpgt_ps(years, zero), _mm_cmpgt_ps(sigma, zero)));
+
+		root = _mm_sqrt_ps(years);
+		spread = _mm_mul_ps(sigma, root);
+		d1 = _mm_div_ps(_mm_add_ps(log_sse2(_mm_div_ps(s, strike)), _mm_mul_ps(_mm_add_ps(r, _mm_mul_ps(half, _mm_mul_ps(sigma, sigma))), years)), spread);
+		d2 = _mm_sub_ps(d1, spread);
+
+		pdf1 = _mm_mul_ps(exp_sse2(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(-0.5f), d1), d1)), density);
+		cdf1 = cdf_sse2(d1, pdf1);
+		cdf2 = cdf_sse2(d2, _mm_mul_ps(exp_sse2(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(-0.5f), d2), d2)), density));
+		put_cdf2 = _mm_sub_ps(one, cdf2);
+		discount = _mm_mul_ps(strike, exp_sse2(_mm_mul_ps(_mm_sub_ps(zero, r), years)));
+		decay = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(_mm_sub_ps(zero, s), pdf1), sigma), _mm_mul_ps(_mm_set1_ps(2), root));
+
+		delta = select_ps(call, _mm_sub_ps(cdf1, one), cdf1);
+		theta = select_ps(call, _mm_div_ps(_mm_add_ps(decay, _mm_mul_ps(_mm_mul_ps(r, discount), put_cdf2)), days),
+		                  _mm_div_ps(_mm_sub_ps(decay, _mm_mul_ps(_mm_mul_ps(r, discount), cdf2)), days));
+		rho = select_ps(call, _mm_div_ps(_mm_mul_ps(_mm_mul_ps(_mm_sub_ps(zero, discount), years), put_cdf2), hundred),
+		                _mm_div_ps(_mm_mul_ps(_mm_mul_ps(discount, years), cdf2), hundred));
+
+		// expired or unpriced lanes get the payoff's delta and nothing else
+		payoff = select_ps(call, _mm_sub_ps(zero, _mm_and_ps(_mm_cmplt_ps(s, strike), one)), _mm_and_ps(_mm_cmpgt_ps(s, strike), one));
+
+		_mm_storeu_ps(options->delta + i, select_ps(valid, payoff, delta));
+		_mm_storeu_ps(options->gamma + i, _mm_and_ps(valid, _mm_div_ps(pdf1, _mm_mul_ps(s, spread))));
+		_mm_storeu_ps(options->theta + i, _mm_and_ps(valid, theta));
+		_mm_storeu_ps(options->vega + i, _mm_and_ps(valid, _mm_div_ps(_mm_mul_ps(_mm_mul_ps(s, pdf1), root), hundred)));
+		_mm_storeu_ps(options->rho + i, _mm_and_ps(valid, rho));
+	}
+
+	return i;
+}
+
+/* price_row on four lanes */
+static inline __m128 price_sse2(__m128 spot, __m128 discount, __m128 moneyness, __m128 root, __m128 years, __m128 r, __m128 side, __m128 sigma, __m128 *vega) {
+	__m128 spread, d1, d2, pdf1, pdf2, density = _mm_set1_ps(INV_SQRT_2PI), neg_half = _mm_set1_ps(-0.5f);
+
+	spread = _mm_mul_ps(sigma, root);
+	d1 = _mm_div_ps(_mm_add_ps(moneyness, _mm_mul_ps(_mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(0.5f), _mm_mul_ps(sigma, sigma))), years)), spread);
+	d2 = _mm_sub_ps(d1, spread);
+
+	pdf1 = _mm_mul_ps(exp_sse2(_mm_mul_ps(_mm_mul_ps(neg_half, d1), d1)), density);
+	pdf2 = _mm_mul_ps(exp_sse2(_mm_mul_ps(_mm_mul_ps(neg_half, d2), d2)), density);
+	*vega = _mm_mul_ps(_mm_mul_ps(spot, pdf1), root);
+
+	return _mm_mul_ps(side, _mm_sub_ps(_mm_mul_ps(spot, cdf_sse2(_mm_mul_ps(side, d1), pdf1)),
+	                                   _mm_mul_ps(discount, cdf_sse2(_mm_mul_ps(side, d2), pdf2))));
+}
+
+/* solve_row on four contracts at a time, each lane stopping on its own once solved */
+static long solve_sse2(struct OptionTable *options, long begin, long end, float spot, float rate) {
+	int k;
+	long i, lane;
+	float warm[4];
+	__m128 call, side, s, r, strike, years, bid, ask, last, target, quoted, discount, lower, upper, valid, root, moneyness;
+	__m128 gap, above, disc, guess, sigma, low, high, price, vega, diff, step, inside, active, stepping;
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1), half = _mm_set1_ps(0.5f), iv_min = _mm_set1_ps(IV_MIN), iv_max = _mm_set1_ps(IV_MAX);
+
+	s = _mm_set1_ps(spot);
+	r = _mm_set1_ps(rate);
+
+	for (i = begin; i + 4 <= end; i += 4) {
+		call = byte_mask_sse2(options->type + i);
+		side = select_ps(call, _mm_set1_ps(-1), one);
+		strike = _mm_loadu_ps(options->strike + i);
+		years = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(options->days_til_expiration + i))), _mm_set1_ps(DAYS_PER_YEAR));
+
+		bid = _mm_loadu_ps(options->bid + i);
+		ask = _mm_loadu_ps(options->ask + i);
+		last = _mm_loadu_ps(options->last_price + i);
+		quoted = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(ask, zero), _mm_cmpge_ps(bid, zero)), _mm_cmpge_ps(ask, bid));
+		target = select_ps(quoted, _mm_and_ps(_mm_cmpgt_ps(last, zero), last), _mm_mul_ps(_mm_add_ps(bid, ask), half));
+
+		discount = _mm_mul_ps(strike, exp_sse2(_mm_mul_ps(_mm_sub_ps(zero, r), years)));
+		lower = _mm_max_ps(_mm_mul_ps(side, _mm_sub_ps(s, discount)), zero);
+		upper = select_ps(call, discount, s);
+		valid = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(s, zero), _mm_cmpgt_ps(strike, zero)), _mm_cmpgt_ps(years, zero));
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(target, lower), _mm_cmplt_ps(target, upper)));
+
+		if (_mm_movemask_ps(valid) == 0)
+			continue;
+
+		root = _mm_sqrt_ps(years);
+		moneyness = log_sse2(_mm_div_ps(s, strike));
+
+		gap = _mm_sub_ps(s, discount);
+		above = _mm_sub_ps(_mm_add_ps(target, _mm_andnot_ps(call, gap)), _mm_mul_ps(gap, half));
+		disc = _mm_sub_ps(_mm_mul_ps(above, above), _mm_mul_ps(_mm_mul_ps(gap, gap), _mm_set1_ps(INV_PI)));
+		disc = _mm_max_ps(disc, zero);
+		guess = _mm_mul_ps(_mm_div_ps(_mm_set1_ps(SQRT_2PI), _mm_mul_ps(root, _mm_add_ps(s, discount))), _mm_add_ps(above, _mm_sqrt_ps(disc)));
+		guess = _mm_min_ps(_mm_max_ps(guess, iv_min), iv_max);
+
+		for (lane = 0; lane < 4; lane++)
+			warm[lane] = warm_start(options, begin, i + lane);
+		sigma = _mm_loadu_ps(warm);
+		sigma = select_ps(_mm_cmpgt_ps(sigma, zero), guess, sigma);
+		low = iv_min;
+		high = iv_max;
+		active = valid;
+
+		for (k = 0; k < IV_ITERATIONS && _mm_movemask_ps(active); k++) {
+			price = price_sse2(s, discount, moneyness, root, years, r, side, sigma, &vega);
+			diff = _mm_sub_ps(price, target);
+			active = _mm_andnot_ps(_mm_cmple_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), diff), _mm_set1_ps(IV_TOLERANCE)), active);
+
+			stepping = _mm_and_ps(active, _mm_cmpgt_ps(diff, zero));
+			high = select_ps(stepping, high, sigma);
+			low = select_ps(_mm_andnot_ps(stepping, active), low, sigma);
+
+			step = _mm_sub_ps(sigma, _mm_div_ps(diff, vega));
+			inside = _mm_and_ps(_mm_cmpgt_ps(step, low), _mm_cmplt_ps(step, high));
+			sigma = select_ps(active, sigma, select_ps(inside, _mm_mul_ps(_mm_add_ps(low, high), half), step));
+		}
+
+		// lanes still active never came within IV_TOLERANCE and keep their quoted volatility
+		_mm_storeu_ps(options->implied_volatility + i, select_ps(_mm_andnot_ps(active, valid), _mm_loadu_ps(options->implied_volatility + i), _mm_mul_ps(sigma, _mm_set1_ps(100))));
+	}
+
+	return i;
+}
+
+/* All ones in each of the eight lanes whose byte is set */
+__attribute__((target("avx2"))) static inline __m256 byte_mask_avx2(const char *bytes) {
+	__m256i lanes = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)bytes));
+
+	return _mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpeq_epi32(lanes, _mm256_setzero_si256()), _mm256_set1_epi32(-1)));
+}
+
+__attribute__((target("avx2"))) static inline __m256 exp_avx2(__m256 x) {
+	__m256 n, r, p;
+	__m256i whole;
+
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_MIN)), _mm256_set1_ps(EXP_MAX));
+	whole = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)));
+	n = _mm256_cvtepi32_ps(whole);
+	r = _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(LN2_HIGH))), _mm256_mul_ps(n, _mm256_set1_ps(LN2_LOW)));
+
+	p = _mm256_set1_ps(1.9875691500e-4f);
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.3981999507e-3f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(8.3334519073e-3f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(4.1665795894e-2f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.6666665459e-1f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(5.0000001201e-1f));
+	p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, r), r), r), _mm256_set1_ps(1));
+
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(whole, _mm256_set1_epi32(127)), 23)));
+}
+
+__attribute__((target("avx2"))) static inline __m256 log_avx2(__m256 x) {
+	__m256 e, m, z, y, small;
+	__m256i bits = _mm256_castps_si256(x);
+
+	e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(126)));
+	m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000)));
+
+	small = _mm256_cmp_ps(m, _mm256_set1_ps(SQRT_HALF), _CMP_LT_OQ);
+	e = _mm256_sub_ps(e, _mm256_and_ps(small, _mm256_set1_ps(1)));
+	m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), _mm256_set1_ps(1));
+
+	z = _mm256_mul_ps(m, m);
+	y = _mm256_set1_ps(7.0376836292e-2f);
+	y = _mm256_sub_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.1514610310e-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.1676998740e-1f));
+	y = _mm256_sub_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.2420140846e-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.4249322787e-1f));
+	y = _mm256_sub_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.6668057665e-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(2.0000714765e-1f));
+	y = _mm256_sub_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(2.4999993993e-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(3.3333331174e-1f));
+	y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+
+	y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(LN2_LOW), e));
+	y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+
+	return _mm256_add_ps(_mm256_add_ps(m, y), _mm256_mul_ps(_mm256_set1_ps(LN2_HIGH), e));
+}
+
+__attribute__((target("avx2"))) static inline __m256 cdf_avx2(__m256 x, __m256 pdf) {
+	__m256 t, tail, one = _mm256_set1_ps(1);
+
+	t = _mm256_div_ps(one, _mm256_add_ps(one, _mm256_mul_ps(_mm256_set1_ps(CDF_P), _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x))));
+	tail = _mm256_add_ps(_mm256_set1_ps(CDF_B4), _mm256_mul_ps(t, _mm256_set1_ps(CDF_B5)));
+	tail = _mm256_add_ps(_mm256_set1_ps(CDF_B3), _mm256_mul_ps(t, tail));
+	tail = _mm256_add_ps(_mm256_set1_ps(CDF_B2), _mm256_mul_ps(t, tail));
+	tail = _mm256_add_ps(_mm256_set1_ps(CDF_B1), _mm256_mul_ps(t, tail));
+	tail = _mm256_mul_ps(_mm256_mul_ps(pdf, t), tail);
+
+	return _mm256_blendv_ps(tail, _mm256_sub_ps(one, tail), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GE_OQ));
+}
+
+/* Same steps as greeks_sse2, eight lanes at a time. Built without fma so no multiply-add is ever fused */
+__attribute__((target("avx2"))) static long greeks_avx2(struct OptionTable *options, long begin, long end, float spot, float rate) {
+	long i;
+	__m256 call, valid, strike, years, sigma, root, spread, d1, d2, pdf1, cdf1, cdf2, discount, decay, put_cdf2;
+	__m256 delta, theta, rho, payoff, zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1);
+	__m256 s = _mm256_set1_ps(spot), r = _mm256_set1_ps(rate), days = _mm256_set1_ps(DAYS_PER_YEAR), hundred = _mm256_set1_ps(100);
+	__m256 half = _mm256_set1_ps(0.5f), density = _mm256_set1_ps(INV_SQRT_2PI);
+
+	for (i = begin; i + 8 <= end; i += 8) {
+		call = byte_mask_avx2(options->type + i);
+		strike = _mm256_loadu_ps(options->strike + i);
+		years = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(options->days_til_expiration + i))), days);
+		sigma = _mm256_div_ps(_mm256_loadu_ps(options->implied_volatility + i), hundred);
+
+		valid = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(s, zero, _CMP_GT_OQ), _mm256_cmp_ps(strike, zero, _CMP_GT_OQ)),
+		                      _mm256_and_ps(_mm256_cmp_ps(years, zero, _CMP_GT_OQ), _mm256_cmp_ps(sigma, zero, _CMP_GT_OQ)));
+
+		root = _mm256_sqrt_ps(years);
+		spread = _mm256_mul_ps(sigma, root);
+		d1 = _mm256_div_ps(_mm256_add_ps(log_avx2(_mm256_div_ps(s, strike)), _mm256_mul_ps(_mm256_add_ps(r, _mm256_mul_ps(half, _mm256_mul_ps(sigma, sigma))), years)), spread);
+		d2 = _mm256_sub_ps(d1, spread);
+
+		pdf1 = _mm256_mul_ps(exp_avx2(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(-0.5f), d1), d1)), density);
+		cdf1 = cdf_avx2(d1, pdf1);
+		cdf2 = cdf_avx2(d2, _mm256_mul_ps(exp_avx2(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(-0.5f), d2), d2)), density));
+		put_cdf2 = _mm256_sub_ps(one, cdf2);
+		discount = _mm256_mul_ps(strike, exp_avx2(_mm256_mul_ps(_mm256_sub_ps(zero, r), years)));
+		decay = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(zero, s), pdf1), sigma), _mm256_mul_ps(_mm256_set1_ps(2), root));
+
+		delta = _mm256_blendv_ps(_mm256_sub_ps(cdf1, one), cdf1, call);
+		theta = _mm256_blendv_ps(_mm256_div_ps(_mm256_add_ps(decay, _mm256_mul_ps(_mm256_mul_ps(r, discount), put_cdf2)), days),
+		                         _mm256_div_ps(_mm256_sub_ps(decay, _mm256_mul_ps(_mm256_mul_ps(r, discount), cdf2)), days), call);
+		rho = _mm256_blendv_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(zero, discount), years), put_cdf2), hundred),
+		                       _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(discount, years), cdf2), hundred), call);
+
+		payoff = _mm256_blendv_ps(_mm256_sub_ps(zero, _mm256_and_ps(_mm256_cmp_ps(s, strike, _CMP_LT_OQ), one)),
+		                          _mm256_and_ps(_mm256_cmp_ps(s, strike, _CMP_GT_OQ), one), call);
+
+		_mm256_storeu_ps(options->delta + i, _mm256_blendv_ps(payoff, delta, valid));
+		_mm256_storeu_ps(options->gamma + i, _mm256_and_ps(valid, _mm256_div_ps(pdf1, _mm256_mul_ps(s, spread))));
+		_mm256_storeu_ps(options->theta + i, _mm256_and_ps(valid, theta));
+		_mm256_storeu_ps(options->vega + i, _mm256_and_ps(valid, _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(s, pdf1), root), hundred)));
+		_mm256_storeu_ps(options->rho + i, _mm256_and_ps(valid, rho));
+	}
+
+	return i;
+}
+
+/* price_row on eight lanes */
+__attribute__((target("avx2"))) static inline __m256 price_avx2(__m256 spot, __m256 discount, __m256 moneyness, __m256 root, __m256 years, __m256 r, __m256 side, __m256 sigma, __m256 *vega) {
+	__m256 spread, d1, d2, pdf1, pdf2, density = _mm256_set1_ps(INV_SQRT_2PI), neg_half = _mm256_set1_ps(-0.5f);
+
+	spread = _mm256_mul_ps(sigma, root);
+	d1 = _mm256_div_ps(_mm256_add_ps(moneyness, _mm256_mul_ps(_mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(sigma, sigma))), years)), spread);
+	d2 = _mm256_sub_ps(d1, spread);
+
+	pdf1 = _mm256_mul_ps(exp_avx2(_mm256_mul_ps(_mm256_mul_ps(neg_half, d1), d1)), density);
+	pdf2 = _mm256_mul_ps(exp_avx2(_mm256_mul_ps(_mm256_mul_ps(neg_half, d2), d2)), density);
+	*vega = _mm256_mul_ps(_mm256_mul_ps(spot, pdf1), root);
+
+	return _mm256_mul_ps(side, _mm256_sub_ps(_mm256_mul_ps(spot, cdf_avx2(_mm256_mul_ps(side, d1), pdf1)),
+	                                         _mm256_mul_ps(discount, cdf_avx2(_mm256_mul_ps(side, d2), pdf2))));
+}
+
+/* Same steps as solve_sse2, eight contracts at a time */
+__attribute__((target("avx2"))) static long solve_avx2(struct OptionTable *options, long begin, long end, float spot, float rate) {
+	int k;
+	long i, lane;
+	float warm[8];
+	__m256 call, side, s, r, strike, years, bid, ask, last, target, quoted, discount, lower, upper, valid, root, moneyness;
+	__m256 gap, above, disc, guess, sigma, low, high, price, vega, diff, step, inside, active, stepping;
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1), half = _mm256_set1_ps(0.5f), iv_min = _mm256_set1_ps(IV_MIN), iv_max = _mm256_set1_ps(IV_MAX);
+
+	s = _mm256_set1_ps(spot);
+	r = _mm256_set1_ps(rate);
+
+	for (i = begin; i + 8 <= end; i += 8) {
+		call = byte_mask_avx2(options->type + i);
+		side = _mm256_blendv_ps(_mm256_set1_ps(-1), one, call);
+		strike = _mm256_loadu_ps(options->strike + i);
+		years = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(options->days_til_expiration + i))), _mm256_set1_ps(DAYS_PER_YEAR));
+
+		bid = _mm256_loadu_ps(options->bid + i);
+		ask = _mm256_loadu_ps(options->ask + i);
+		last = _mm256_loadu_ps(options->last_price + i);
+		quoted = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(ask, zero, _CMP_GT_OQ), _mm256_cmp_ps(bid, zero, _CMP_GE_OQ)), _mm256_cmp_ps(ask, bid, _CMP_GE_OQ));
+		target = _mm256_blendv_ps(_mm256_and_ps(_mm256_cmp_ps(last, zero, _CMP_GT_OQ), last), _mm256_mul_ps(_mm256_add_ps(bid, ask), half), quoted);
+
+		discount = _mm256_mul_ps(strike, exp_avx2(_mm256_mul_ps(_mm256_sub_ps(zero, r), years)));
+		lower = _mm256_max_ps(_mm256_mul_ps(side, _mm256_sub_ps(s, discount)), zero);
+		upper = _mm256_blendv_ps(discount, s, call);
+		valid = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(s, zero, _CMP_GT_OQ), _mm256_cmp_ps(strike, zero, _CMP_GT_OQ)), _mm256_cmp_ps(years, zero, _CMP_GT_OQ));
+		valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(target, lower, _CMP_GT_OQ), _mm256_cmp_ps(target, upper, _CMP_LT_OQ)));
+
+		if (_mm256_movemask_ps(valid) == 0)
+			continue;
+
+		root = _mm256_sqrt_ps(years);
+		moneyness = log_avx2(_mm256_div_ps(s, strike));
+
+		gap = _mm256_sub_ps(s, discount);
+		above = _mm256_sub_ps(_mm256_add_ps(target, _mm256_andnot_ps(call, gap)), _mm256_mul_ps(gap, half));
+		disc = _mm256_sub_ps(_mm256_mul_ps(above, above), _mm256_mul_ps(_mm256_mul_ps(gap, gap), _mm256_set1_ps(INV_PI)));
+		disc = _mm256_max_ps(disc, zero);
+		guess = _mm256_mul_ps(_mm256_div_ps(_mm256_set1_ps(SQRT_2PI), _mm256_mul_ps(root, _mm256_add_ps(s, discount))), _mm256_add_ps(above, _mm256_sqrt_ps(disc)));
+		guess = _mm256_min_ps(_mm256_max_ps(guess, iv_min), iv_max);
+
+		for (lane = 0; lane < 8; lane++)
+			warm[lane] = warm_start(options, begin, i + lane);
+		sigma = _mm256_loadu_ps(warm);
+		sigma = _mm256_blendv_ps(guess, sigma, _mm256_cmp_ps(sigma, zero, _CMP_GT_OQ));
+		low = iv_min;
+		high = iv_max;
+		active = valid;
+
+		for (k = 0; k < IV_ITERATIONS && _mm256_movemask_ps(active); k++) {
+			price = price_avx2(s, discount, moneyness, root, years, r, side, sigma, &vega);
+			diff = _mm256_sub_ps(price, target);
+			active = _mm256_andnot_ps(_mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), diff), _mm256_set1_ps(IV_TOLERANCE), _CMP_LE_OQ), active);
+
+			stepping = _mm256_and_ps(active, _mm256_cmp_ps(diff, zero, _CMP_GT_OQ));
+			high = _mm256_blendv_ps(high, sigma, stepping);
+			low = _mm256_blendv_ps(low, sigma, _mm256_andnot_ps(stepping, active));
+
+			step = _mm256_sub_ps(sigma, _mm256_div_ps(diff, vega));
+			inside = _mm256_and_ps(_mm256_cmp_ps(step, low, _CMP_GT_OQ), _mm256_cmp_ps(step, high, _CMP_LT_OQ));
+			sigma = _mm256_blendv_ps(sigma, _mm256_blendv_ps(_mm256_mul_ps(_mm256_add_ps(low, high), half), step, inside), active);
+		}
+
+		_mm256_storeu_ps(options->implied_volatility + i, _mm256_blendv_ps(_mm256_loadu_ps(options->implied_volatility + i), _mm256_mul_ps(sigma, _mm256_set1_ps(100)), _mm256_andnot_ps(active, valid)));
+	}
+
+	return i;
+}
+
+#endif
+
+/* delta, gamma, theta, vega and rho for every contract of [begin, end) */
+void greeks_contracts(struct OptionTable *options, long begin, long end, struct ParentStock *stock) {
+	long i = begin;
+	float r = greeks_rate();
+
+	switch (weight_kernel()) {
+#ifdef GREEKS_X86
+	case KERNEL_AVX2:
+		i = greeks_avx2(options, begin, end, stock->curr_price, r);
+		break;
+	case KERNEL_SSE2:
+		i = greeks_sse2(options, begin, end, stock->curr_price, r);
+		break;
+
+#endif
+	default:
+		break;
+	}
+
+	// whatever is left over is less than one vector wide
+	for (; i < end; i++)
+		greeks_row(options, i, stock->curr_price, r);
+}
+
+/* Replaces the quoted implied volatility of every contract in [begin, end) with the one its price implies */
+void solve_volatility(struct OptionTable *options, long begin, long end, struct ParentStock *stock) {
+	long i = begin;
+	float r = greeks_rate();
+
+	if (quoted_volatility)
+		return;
+
+	switch (weight_kernel()) {
+#ifdef GREEKS_X86
+	case KERNEL_AVX2:
+		i = solve_avx2(options, begin, end, stock->curr_price, r);
+		break;
+	case KERNEL_SSE2:
+		i = solve_sse2(options, begin, end, stock->curr_price, r);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	for (; i < end; i++)
+		solve_row(options, begin, i, stock->curr_price, r);
+}
@@ -0,0 +1,215 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/json.h"
+
+void json_init(struct JsonParser *parser, const char *data, size_t size) {
+	parser->data = data;
+	parser->size = size;
+	parser->position = 0;
+	parser->depth = 0;
+	parser->failed = FALSE;
+	parser->expect = JSON_EXPECT_VALUE;
+}
+
+static enum JsonType fail(struct JsonParser *parser, struct JsonToken *token) {
+	parser->failed = TRUE;
+	token->type = JSON_ERROR;
+
+	return JSON_ERROR;
+}
+
+static void skip_blank(struct JsonParser *parser) {
+	while (parser->position < parser->size && isspace((unsigned char)parser->data[parser->position]))
+		parser->position++;
+}
+
+static enum JsonType literal(struct JsonParser *parser, struct JsonToken *token, const char *text, enum JsonType type) {
+	size_t length = strlen(text);
+
+	if (parser->size - parser->position < length || memcmp(parser->data + parser->position, text, length) != 0)
+		return fail(parser, token);
+
+	parser->position += length;
+	token->type = type;
+
+	return type;
+}
+
+static int number_char(char c) {
+	return isdigit((unsigned char)c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static enum JsonType number(struct JsonParser *parser, struct JsonToken *token) {
+	char text[JSON_NUMBER_LENGTH], *end;
+	size_t start, length;
+
+	start = parser->position;
+	while (parser->position < parser->size && number_char(parser->data[parser->position]))
+		parser->position++;
+
+	// the input is not terminated, so the number is copied out before strtod sees it
+	length = parser->position - start;
+	if (length >= JSON_NUMBER_LENGTH)
+		return fail(parser, token);
+
+	memcpy(text, parser->data + start, length);
+	text[length] = '\0';
+
+	token->number = strtod(text, &end);
+	if (end != text + length)
+		return fail(parser, token);
+
+	token->type = JSON_NUMBER;
+
+	return JSON_NUMBER;
+}
+
+static enum JsonType string(struct JsonParser *parser, struct JsonToken *token) {
+	size_t start;
+
+	start = ++parser->position;
+	while (parser->position < parser->size && parser->data[parser->position] != '"')
+		parser->position += (parser->data[parser->position] == '\\' ? 2 : 1);
+
+	if (parser->position >= parser->size)
+		return fail(parser, token);
+
+	token->text = parser->data + start;
+	token->length = parser->position - start;
+	parser->position++;
+
+	// a string followed by a colon is a key
+	while (parser->position < parser->size && isspace((unsigned char)parser->data[parser->position]))
+		parser->position++;
+
+	if (parser->position < parser->size && parser->data[parser->position] == ':') {
+		parser->position++;
+		token->type = JSON_KEY;
+	}
+	else
+		token->type = JSON_STRING;
+
+	return token->type;
+}
+
+/* Reads the next token, without deciding what may follow it */
+static enum JsonType token_at(struct JsonParser *parser, struct JsonToken *token, char c) {
+	switch (c) {
+	case '{':
+	case '[':
+		if (parser->depth >= JSON_MAX_DEPTH)
+			return fail(parser, token);
+
+		parser->depth++;
+		parser->position++;
+		token->type = (c == '{' ? JSON_OBJECT : JSON_ARRAY);
+		return token->type;
+	case '}':
+	case ']':
+		// a close straight after a comma or a key leaves an element missing
+		if (parser->depth == 0 || parser->expect == JSON_EXPECT_VALUE)
+			return fail(parser, token);
+
+		parser->depth--;
+		parser->position++;
+		token->type = (c == '}' ? JSON_OBJECT_END : JSON_ARRAY_END);
+		return token->type;
+	case '"':
+		return string(parser, token);
+	case 't':
+		return literal(parser, token, "true", JSON_TRUE);
+	case 'f':
+		return literal(parser, token, "false", JSON_FALSE);
+	case 'n':
+		return literal(parser, token, "null", JSON_NULL);
+	default:
+		if (c == '-' || isdigit((unsigned char)c))
+			return number(parser, token);
+
+		return fail(parser, token);
+	}
+}
+
+/*
+ * Reads the next token. A comma is only taken between two elements of an object or array, so a
+ * leading, doubled or trailing one is malformed. Once the input is malformed every call returns JSON_ERROR
+ */
+enum JsonType json_next(struct JsonParser *parser, struct JsonToken *token) {
+	char c;
+
+	if (parser->failed)
+		return fail(parser, token);
+
+	skip_blank(parser);
+
+	if (parser->position < parser->size && parser->data[parser->position] == ',') {
+		if (parser->expect != JSON_EXPECT_COMMA_OR_END || parser->depth == 0)
+			return fail(parser, token);
+
+		parser->position++;
+		parser->expect = JSON_EXPECT_VALUE;
+		skip_blank(parser);
+	}
+
+	if (parser->position >= parser->size) {
+		if (parser->depth != 0)
+			return fail(parser, token);
+
+		token->type = JSON_END;
+		return JSON_END;
+	}
+
+	c = parser->data[parser->position];
+
+	// after a value only a comma or the end of its object or array can come
+	if (parser->expect == JSON_EXPECT_COMMA_OR_END && c != '}' && c != ']')
+		return fail(parser, token);
+
+	switch (token_at(parser, token, c)) {
+	case JSON_ERROR:
+		return JSON_ERROR;
+	case JSON_OBJECT:
+	case JSON_ARRAY:
+		parser->expect = JSON_EXPECT_VALUE_OR_END;
+		break;
+	case JSON_KEY:
+		parser->expect = JSON_EXPECT_VALUE;
+		break;
+	default:
+		parser->expect = JSON_EXPECT_COMMA_OR_END;
+		break;
+	}
+
+	return token->type;
+}
+
+/* Skips the rest of the value token starts, so a whole object or array the caller has no use for goes in one call */
+int json_skip(struct JsonParser *parser, struct JsonToken *token) {
+	int depth;
+	struct JsonToken inner;
+
+	if (token->type == JSON_ERROR || token->type == JSON_END || token->type == JSON_OBJECT_END || token->type == JSON_ARRAY_END)
+		return FALSE;
+	if (token->type != JSON_OBJECT && token->type != JSON_ARRAY)
+		return TRUE;
+
+	depth = parser->depth - 1;
+
+	while (parser->depth > depth) {
+		if (json_next(parser, &inner) == JSON_ERROR || inner.type == JSON_END)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* TRUE if a string or key token is exactly text */
+int json_is(struct JsonToken *token, const char *text) {
+	return token->length == strlen(text) && memcmp(token->text, text, token->length) == 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/option_table.h"
+#include "../include/arena.h"
+#include "../include/safe.h"
+
+/* Sets up an empty table allocating from arena, columns are allocated on the first append */
+void option_table_init(struct OptionTable *table, struct Arena *arena) {
+	memset(table, 0, sizeof(struct OptionTable));
+	table->arena = arena;
+}
+
+/* Makes room for at least capacity rows, so a loader that knows its row count never has to grow */
+void option_table_reserve(struct OptionTable *table, long capacity) {
+	if (capacity <= table->capacity)
+		return;
+
+#define OPTION_TABLE_GROW(type, name) table->name = arena_grow(table->arena, table->name, table->capacity * sizeof(type), capacity * sizeof(type));
+	OPTION_TABLE_COLUMNS(OPTION_TABLE_GROW)
+#undef OPTION_TABLE_GROW
+
+	table->capacity = capacity;
+}
+
+/* Adds one zeroed row to the end of the table, growing every column geometrically. Returns the new row's index */
+long option_table_append(struct OptionTable *table) {
+	long row;
+
+	if (table->size == table->capacity)
+		option_table_reserve(table, (table->capacity < OPTION_TABLE_MIN_CAPACITY ? OPTION_TABLE_MIN_CAPACITY : table->capacity * 2));
+
+	row = table->size++;
+
+#define OPTION_TABLE_ZERO(type, name) table->name[row] = 0;
+	OPTION_TABLE_COLUMNS(OPTION_TABLE_ZERO)
+#undef OPTION_TABLE_ZERO
+
+	table->open[row] = TRUE;
+
+	return row;
+}
+
+/* Moves every column into the order given by new_index, where new_index[i] is the destination of row i */
+static void permute_columns(struct OptionTable *table, long *new_index) {
+	long i;
+	void *column;
+
+#define OPTION_TABLE_PERMUTE(type, name)                                \
+	column = arena_alloc(table->arena, table->capacity * sizeof(type)); \
+	for (i = 0; i < table->size; i++)                                   \
+		((type *)column)[new_index[i]] = table->name[i];                \
+	table->name = column;
+
+	OPTION_TABLE_COLUMNS(OPTION_TABLE_PERMUTE)
+#undef OPTION_TABLE_PERMUTE
+}
+
+/* Bucket 2p holds the calls of parent p, bucket 2p + 1 its puts, and the last bucket every row without a parent */
+static long group_key(struct OptionTable *table, long i, long parent_array_size) {
+	if (table->parent[i] < 0)
+		return parent_array_size * 2;
+
+	return table->parent[i] * 2 + (table->type[i] ? 0 : 1);
+}
+
+/*
+ * Groups the rows by stock with a stable counting sort, calls before puts, and records each
+ * stock's calls/puts ranges. Rows keep their database order within a group. Rows whose parent
+ * is negative belong to no stock and are dropped from the table.
+ */
+void option_table_group(struct OptionTable *table, struct ParentStock **parent_array, long parent_array_size) {
+	long i, key, sorted, *offsets, *new_index;
+
+	offsets = safe_calloc(parent_array_size * 2 + 2, sizeof(long));
+	new_index = safe_malloc((table->size ? table->size : 1) * sizeof(long));
+
+	for (i = 0; i < table->size; i++)
+		offsets[group_key(table, i, parent_array_size) + 1]++;
+
+	for (key = 0; key < parent_array_size * 2; key++)
+		offsets[key + 1] += offsets[key];
+
+	for (key = 0; key < parent_array_size; key++) {
+		parent_array[key]->calls_begin = offsets[key * 2];
+		parent_array[key]->calls_end = offsets[key * 2 + 1];
+		parent_array[key]->puts_begin = offsets[key * 2 + 1];
+		parent_array[key]->puts_end = offsets[key * 2 + 2];
+	}
+
+	sorted = TRUE;
+	for (i = 0; i < table->size; i++) {
+		new_index[i] = offsets[group_key(table, i, parent_array_size)]++;
+
+		if (new_index[i] != i)
+			sorted = FALSE;
+	}
+
+	// rows straight from the collector are usually already grouped
+	if (!sorted)
+		permute_columns(table, new_index);
+
+	table->size = (parent_array_size ? parent_array[parent_array_size - 1]->puts_end : 0);
+
+	free(new_index);
+	free(offsets);
+
+	return;
+}
@@ -15,7 +15,10 @@ import sys
 import csv
 import time
 import math
+import struct
+import asyncio
 import sqlite3
+import threading
 import operator
 import requests
 import progressbar
@@ -23,8 +26,52 @@ import requests_cache
 from datetime import date
 import concurrent.futures
 import urllib.request
+from urllib.parse import urlsplit
 from bs4 import BeautifulSoup as soup
 
+# columns of both tables, in order, and the keys their rows are upserted on
+PRICE_COLUMNS = ["ticker", "date", "open", "low", "high", "close", "volume"]
+PRICE_KEY = ["ticker", "date"]
+OPTION_COLUMNS = ["ticker", "type", "expirationDate", "dte", "strike", "volume", "openInterest", "bid", "ask", "lastPrice",
+                  "percentChange", "itm", "impliedVolatility", "iv20", "iv50", "iv100", "theta", "beta", "gamma", "vega"]
+OPTION_KEY = ["ticker", "type", "expirationDate", "strike"]
+
+# where pages are fetched from, overridable so the collector can run against a local stub server
+YAHOO_URL = os.environ.get("SCREENER_YAHOO_URL", "https://finance.yahoo.com")
+QUERY_URL = os.environ.get("SCREENER_QUERY_URL", "https://query1.finance.yahoo.com")
+QUOTE_PAGE = YAHOO_URL + "/quote/{0}/options?p={0}"
+CHART_PAGE = QUERY_URL + "/v8/finance/chart/{0}?formatted=true&crumb=h.8f9xpa6IF&lang=en-US&region=US&interval=1d&events=div%7Csplit&range=1y&corsDomain=finance.yahoo.com"
+OPTIONS_PAGE = QUERY_URL + "/v7/finance/options/{0}?formatted=true&crumb=R6vBcFmQGju&lang=en-US&region=US&date={1}&corsDomain=finance.yahoo.com"
+
+# requests in flight at once, requests started per second against any one host (0 for no limit),
+# attempts per page and the delay before the first retry, doubled for every retry after it
+FETCH_CONCURRENCY = int(os.environ.get("SCREENER_FETCH_CONCURRENCY", 16))
+FETCH_RATE = float(os.environ.get("SCREENER_FETCH_RATE", 10))
+FETCH_ATTEMPTS = int(os.environ.get("SCREENER_FETCH_ATTEMPTS", 4))
+FETCH_BACKOFF = float(os.environ.get("SCREENER_FETCH_BACKOFF", 0.5))
+
+# when set, every ticker is also written to this file descriptor as soon as it is parsed, in the frames
+# the screener reads (see include/stream.h), and the databases are only written if STREAM_DB allows
+STREAM_FD = os.environ.get("SCREENER_STREAM_FD")
+STREAM_DB = os.environ.get("SCREENER_STREAM_DB", "1") != "0"
+STREAM_HEADER = struct.Struct("<IB")           # payload length, kind
+STREAM_TICKER = struct.Struct("<10sfffIII")    # ticker, iv20, iv50, iv100, prices, calls, puts
+STREAM_PRICE = struct.Struct("<qffffq")        # date, open, low, high, close, volume
+STREAM_OPTION = struct.Struct("<qifqqfffffB")  # expiration, dte, strike, volume, open interest, bid, ask, last price, percent change, iv, itm
+
+# when set, Yahoo's responses are saved there as they came for the screener to parse (see include/yahoo.h)
+RAW_DIRECTORY = os.environ.get("SCREENER_RAW")
+
+
+def upsert_statement(table, columns, key):
+    """ Builds an insert that updates the row with the same key instead, and leaves it alone if no value changed """
+    values = [column for column in columns if column not in key]
+
+    return "INSERT INTO {0}({1}) VALUES({2}) ON CONFLICT({3}) DO UPDATE SET {4} WHERE {5}".format(
+        table, ", ".join(columns), ", ".join(["?"] * len(columns)), ", ".join(key),
+        ", ".join("{0} = excluded.{0}".format(column) for column in values),
+        " OR ".join("{0} IS NOT excluded.{0}".format(column) for column in values))
+
 
 class historical_price:
     def __init__(self, date=None, volume=None, open=None, low=None,
@@ -80,10 +127,68 @@ class ticker:
         self.historical_prices_page = None
 
 
+class fetcher:
+    """ Fetches pages on a thread pool, FETCH_CONCURRENCY at a time, paced per host and retried with backoff """
+
+    def __init__(self):
+        self.limit = asyncio.Semaphore(FETCH_CONCURRENCY)
+        self.next_start = {}
+        self.local = threading.local()
+        self.executor = concurrent.futures.ThreadPoolExecutor(max_workers=FETCH_CONCURRENCY)
+
+    def get(self, url):
+        """ One blocking request on the calling thread's own session """
+        if (not hasattr(self.local, "session")):
+            self.local.session = requests.session()
+
+        resp = self.local.session.get(url, headers={'User-Agent': 'Custom'}, timeout=30)
+
+        # throttled or failing on Yahoo's side is worth another try, anything else is final
+        if (resp.status_code == 429 or resp.status_code >= 500):
+            raise IOError("{0} from {1}".format(resp.status_code, url))
+        if (resp.status_code != 200):
+            return None
+
+        return resp.text
+
+    async def wait_turn(self, host):
+        """ Waits until host may be sent another request. The event loop runs one coroutine at a time, so no lock is needed """
+        if (FETCH_RATE <= 0):
+            return
+
+        now = time.monotonic()
+        start = max(now, self.next_start.get(host, now))
+        self.next_start[host] = start + 1 / FETCH_RATE
+
+        await asyncio.sleep(start - now)
+
+    async def fetch(self, url):
+        """ Returns the page's text, or None once every attempt has failed """
+        host = urlsplit(url).netloc
+
+        for attempt in range(FETCH_ATTEMPTS):
+            if (attempt > 0):
+                await asyncio.sleep(FETCH_BACKOFF * 2 ** (attempt - 1))
+
+            async with self.limit:
+                await self.wait_turn(host)
+
+                try:
+                    return await asyncio.get_running_loop().run_in_executor(self.executor, self.get, url)
+                except Exception:
+                    pass
+
+        return None
+
+    def close(self):
+        self.executor.shutdown()
+
+
 class util:
     def __init__(self):
         self.tickers = []
         self.ticker_dict = {}
+        self.stream = None
 
     def download_files(self):
         names = [
@@ -125,7 +230,6 @@ class util:
         # key: ticker
         # value: list (20 day, 50 day, 100 day)
         self.extract_historical_volatility(info_list)
-        self.clean_dict()
 
     def extract_historical_volatility(self, info_list):
         """ Parses historical volatility for each ticker """
@@ -183,36 +287,16 @@ class util:
 
         return info_list
 
-    def clean_dict(self):
-        """ Removes duplicate entries from dict and list """
-        del_list = []
-
-        # logic to remove anything not in either of the lists
-        for symbol in self.tickers:
-            if (symbol not in self.ticker_dict):
-                del_list.append(symbol)
-        for symbol in del_list:
-            self.tickers.remove(symbol)
-
-        del_list = []
-        for symbol in self.ticker_dict:
-            if (symbol not in self.tickers):
-                del_list.append(symbol)
-        for symbol in del_list:
-            del self.ticker_dict[symbol]
-
-    def get_options(self, tick):
-        """ Finds all pages regarding options data """
-        count = 0
+    def get_options(self, tick, text):
+        """ Finds all pages regarding options data from the ticker's quote page """
+        page = soup(text, 'html.parser')
         text = ""
 
-        url = "https://finance.yahoo.com/quote/{0}/options?p={0}".format(
-            tick.symbol)
-        page = soup(requests.get(
-            url, headers={'User-Agent': 'Custom'}).text, 'html.parser')
-
-        start_index = page.text.index("expirationDates")
-        end_index = page.text.index("hasMiniOptions")
+        try:
+            start_index = page.text.index("expirationDates")
+            end_index = page.text.index("hasMiniOptions")
+        except ValueError:
+            return
 
         dates_txt = page.text[start_index+18:end_index-3]
 
@@ -224,11 +308,6 @@ class util:
                 text += char
         tick.dates.append(text)
 
-    def gather_prices(self):
-        """ Gathers the stock's historical prices """
-        for tick in self.tickers:
-            self.parse_prices_page(tick.historical_prices_page, tick)
-
     def parse_prices_page(self, page, tick):
         """ Parses each page and appends historical_price objects to the correct list """
         # formatted as timestamp, volume, open, low, high, close
@@ -278,99 +357,98 @@ class util:
                                   historical_data[3][i], historical_data[4][i], historical_data[5][i])
             tick.prices.append(hp)
 
-    def gather_option_data(self):
-        """ Parses each options page to collect all data for every option """
+    def parse_option_pages(self, tick):
+        """ Parses one ticker's options pages, dropping the ticker if one cannot be read """
         test = []
         data_list = []
 
-        for tick in self.tickers:
-            calls = True
-            for j, date_page in enumerate(tick.date_pages):
-                cont = True
+        calls = True
+        for j, date_page in enumerate(tick.date_pages):
+            cont = True
+            kw_one = True
+            failed = False
+            page = date_page.text
+            keyword_list = [
+                "percentChange", "openInterest",
+                "change", "impliedVolatility", "volume",
+                "ask", "bid", "lastPrice"
+            ]
+
+            try:
+                page.index("calls")
+            except:
+                self.tickers.remove(tick)
+                break
+
+            try:
+                index = page.index("percentChange")
+                page = page[index+len("percentChange"):]
+            except:
+                self.tickers.remove(tick)
+                break
+
+            if (page.index("strike") < page.index("change")):
                 kw_one = True
-                failed = False
-                page = date_page.text
-                keyword_list = [
-                    "percentChange", "openInterest",
-                    "change", "impliedVolatility", "volume",
-                    "ask", "bid", "lastPrice"
-                ]
+                keyword_list.insert(2, "strike")
+            else:
+                kw_one = False
+                keyword_list.insert(3, "strike")
 
+            # parses the entire page
+            while (cont):
+                # determines if it should continue searching for options
                 try:
-                    page.index("calls")
+                    index = page.index("percentChange")
+                    temp = page.index("raw")
                 except:
-                    self.tickers.remove(tick)
+                    cont = False
                     break
 
+                page = page[temp+5:]
+                data_list = []
+
+                # determines whether we are collecting data for calls or puts
                 try:
-                    index = page.index("percentChange")
-                    page = page[index+len("percentChange"):]
+                    page.index("puts")
+                    calls = True
                 except:
-                    self.tickers.remove(tick)
-                    break
+                    calls = False
 
-                if (page.index("strike") < page.index("change")):
-                    kw_one = True
-                    keyword_list.insert(2, "strike")
-                else:
-                    kw_one = False
-                    keyword_list.insert(3, "strike")
-
-                # parses the entire page
-                while (cont):
-                    # determines if it should continue searching for options
-                    try:
-                        index = page.index("percentChange")
-                        temp = page.index("raw")
-                    except:
-                        cont = False
-                        break
+                # iterate through the list containing words, parsing the page for the data
+                for i in range(len(keyword_list)):
+                    text = ""
 
-                    page = page[temp+5:]
-                    data_list = []
+                    # will gather correct data for each keyword
+                    for char in page:
+                        if (char == ','):
+                            test.append(text)
 
-                    # determines whether we are collecting data for calls or puts
-                    try:
-                        page.index("puts")
-                        calls = True
-                    except:
-                        calls = False
-
-                    # iterate through the list containing words, parsing the page for the data
-                    for i in range(len(keyword_list)):
-                        text = ""
-
-                        # will gather correct data for each keyword
-                        for char in page:
-                            if (char == ','):
-                                test.append(text)
-
-                                try:
-                                    data_list.append(float(text))
-                                except:
-                                    failed = True
-                                    break
+                            try:
+                                data_list.append(float(text))
+                            except:
+                                failed = True
                                 break
-                            else:
-                                text += char
-
-                        # if, for some reason, it cannot convert the text to a float, abort entire option,
-                        # never added to calls/puts lists
-                        if (failed):
-                            break
-
-                        try:
-                            temp = page.index(
-                                keyword_list[i+1]) + len(keyword_list[i+1]) + 9
-                            page = page[temp:]
-                        except:
                             break
+                        else:
+                            text += char
 
+                    # if, for some reason, it cannot convert the text to a float, abort entire option,
+                    # never added to calls/puts lists
                     if (failed):
-                        failed = False
-                        continue
+                        break
 
-                    self.create_option_obj(tick, data_list, kw_one, j, calls)
+                    try:
+                        temp = page.index(
+                            keyword_list[i+1]) + len(keyword_list[i+1]) + 9
+                        page = page[temp:]
+                    except:
+                        break
+
+                if (failed):
+                    failed = False
+                    continue
+
+                self.create_option_obj(tick, data_list, kw_one, j, calls)
 
     def create_option_obj(self, tick, data_list, kw_one, j, calls):
         """ Determines which formatting the strike/change of the page is and creates appropriate object """
@@ -393,165 +471,394 @@ class util:
 
     def calculate_option_data(self):
         """ Calculates dte and itm for every option """
+        epoch = self.start_of_today()
+
+        for tick in list(self.tickers):
+            if (not self.calculate_ticker_data(tick, epoch)):
+                self.tickers.remove(tick)
+
+    def start_of_today(self):
         today = str(date.today())
         pattern = '%Y-%m-%d'
-        epoch = float(time.mktime(time.strptime(today, pattern)))
-        del_list = []
 
-        for tick in self.tickers:
-            # removes empty tickers
-            if (len(tick.calls) == 0 and len(tick.puts) == 0):
-                del_list.append(tick)
-                continue
-            try:
-                curr_price = tick.prices[len(tick.prices)-1].close
-            except:
-                del_list.append(tick)
-                continue
+        return float(time.mktime(time.strptime(today, pattern)))
+
+    def calculate_ticker_data(self, tick, epoch):
+        """ Calculates dte and itm for one ticker's options, False if the ticker has to be dropped """
+        # removes empty tickers
+        if (len(tick.calls) == 0 and len(tick.puts) == 0):
+            return False
+        try:
+            curr_price = tick.prices[len(tick.prices)-1].close
+        except:
+            return False
+
+        for call in tick.calls:
+            dte = float(call.expiration) - epoch
+            dte = math.ceil(dte / 86400)
+            call.dte = dte
+
+            if (call.strike <= curr_price):
+                call.itm = True
+            else:
+                call.itm = False
+        for put in tick.puts:
+            dte = float(put.expiration) - epoch
+            dte = math.ceil(dte / 86400)
+            put.dte = dte
+
+            if (put.strike >= curr_price):
+                put.itm = True
+            else:
+                put.itm = False
 
-            for call in tick.calls:
-                dte = float(call.expiration) - epoch
-                dte = math.ceil(dte / 86400)
-                call.dte = dte
+        return True
 
-                if (call.strike <= curr_price):
-                    call.itm = True
-                else:
-                    call.itm = False
-            for put in tick.puts:
-                dte = float(put.expiration) - epoch
-                dte = math.ceil(dte / 86400)
-                put.dte = dte
-
-                if (put.strike >= curr_price):
-                    put.itm = True
-                else:
-                    put.itm = False
+    def stream_frame(self, kind, payload):
+        self.stream.write(STREAM_HEADER.pack(len(payload), ord(kind)))
+        self.stream.write(payload)
 
-        for tick in del_list:
-            self.tickers.remove(tick)
+    def stream_ticker(self, tick):
+        """ Sends one ticker with all of its prices, calls and puts as a single frame """
+        number = lambda value: (value if value is not None else 0)
+
+        # the same rows the databases end up with, the newest of any that share a key
+        prices = list(dict((int(price.date), price) for price in tick.prices).values())
+        calls = list(dict(((contract.expiration, contract.strike), contract) for contract in tick.calls).values())
+        puts = list(dict(((contract.expiration, contract.strike), contract) for contract in tick.puts).values())
+
+        parts = [STREAM_TICKER.pack(tick.symbol.encode(), number(tick.iv20), number(tick.iv50), number(tick.iv100),
+                                    len(prices), len(calls), len(puts))]
+
+        for price in prices:
+            parts.append(STREAM_PRICE.pack(int(price.date), price.open, price.low, price.high, price.close, int(price.volume)))
+        for contract in calls + puts:
+            parts.append(STREAM_OPTION.pack(int(float(contract.expiration)), int(contract.dte), contract.strike, int(contract.volume),
+                                            int(contract.open_interest), contract.bid, contract.ask, contract.last_price,
+                                            contract.percent_change, contract.iv, contract.itm))
+
+        self.stream_frame("T", b"".join(parts))
+        self.stream.flush()
+
+    def stream_end(self):
+        """ Tells the screener every ticker has been sent """
+        self.stream_frame("E", b"")
+        self.stream.close()
+        self.stream = None
+
+    def open_db(self, name):
+        """ Opens a database for one bulk write, journaled to a WAL and only synced at checkpoints """
+        conn = sqlite3.connect(name)
+        conn.execute("PRAGMA journal_mode = WAL")
+        conn.execute("PRAGMA synchronous = NORMAL")
+
+        return conn
+
+    def close_db(self, conn):
+        """ Folds the WAL back into the database file, so readers and the screener's snapshot see one file again """
+        conn.execute("PRAGMA wal_checkpoint(TRUNCATE)")
+        conn.close()
+
+    def key_table(self, curs, table, key):
+        """ Keys table so rows can be upserted. Tables written before keying may repeat a key, only the newest copy is kept """
+        index = "CREATE UNIQUE INDEX IF NOT EXISTS {0}Key ON {0}({1})".format(table, ", ".join(key))
+
+        try:
+            curs.execute(index)
+        except sqlite3.IntegrityError:
+            curs.execute("DELETE FROM {0} WHERE rowid NOT IN (SELECT max(rowid) FROM {0} GROUP BY {1})".format(table, ", ".join(key)))
+            curs.execute(index)
+
+    def prepare_table(self, curs, table, key, symbols):
+        """
+        Gets table ready for this run's rows. Returns True if it is empty, in which case its key is
+        dropped so rows can be bulk inserted and key_table builds it once they are all in.
+        """
+        curs.execute("SELECT 1 FROM {0} LIMIT 1".format(table))
+
+        if (curs.fetchone() is None):
+            curs.execute("DROP INDEX IF EXISTS {0}Key".format(table))
+            return True
+
+        self.key_table(curs, table, key)
+        self.remove_tickers(curs, table, symbols)
+
+        return False
+
+    def remove_stale(self, curs, table, key, symbol, current):
+        """ Deletes every row of symbol whose key was not fetched this run, returns how many went """
+        curs.execute("SELECT rowid, {0} FROM {1} WHERE ticker = ?".format(", ".join(key[1:]), table), (symbol,))
+        stale = [(row[0],) for row in curs.fetchall() if tuple(row[1:]) not in current]
+
+        curs.executemany("DELETE FROM {0} WHERE rowid = ?".format(table), stale)
+
+        return len(stale)
+
+    def remove_tickers(self, curs, table, symbols):
+        """ Deletes every ticker that is no longer collected """
+        curs.execute("SELECT DISTINCT ticker FROM {0}".format(table))
+        gone = [(row[0],) for row in curs.fetchall() if row[0] not in symbols]
+
+        curs.executemany("DELETE FROM {0} WHERE ticker = ?".format(table), gone)
+
+    def write_rows(self, curs, table, columns, key, bulk, symbol, rows):
+        """ Writes one ticker's rows with a single executemany, returns how many rows were new, changed or deleted """
+        if (bulk):
+            curs.executemany("INSERT INTO {0}({1}) VALUES({2})".format(table, ", ".join(columns), ", ".join(["?"] * len(columns))), rows)
+            return len(rows)
+
+        curs.executemany(upsert_statement(table, columns, key), rows)
+        changed = max(curs.rowcount, 0)
+
+        positions = [columns.index(column) for column in key[1:]]
+        current = set(tuple(row[position] for position in positions) for row in rows)
+
+        return changed + self.remove_stale(curs, table, key, symbol, current)
+
+    def option_rows(self, tick):
+        """ One optionsData row per contract of tick, calls then puts """
+        rows = []
+
+        for kind, contracts in (("Call", tick.calls), ("Put", tick.puts)):
+            for contract in contracts:
+                rows.append((tick.symbol, kind, contract.expiration, contract.dte, contract.strike, contract.volume,
+                             contract.open_interest, contract.bid, contract.ask, contract.last_price, contract.percent_change,
+                             str(contract.itm), contract.iv, tick.iv20, tick.iv50, tick.iv100, contract.theta, contract.beta,
+                             contract.gamma, contract.vega))
+
+        return rows
 
     def insert_db(self):
+        """
+        Writes this run's data incrementally. Bars are keyed on (ticker, date) and contracts on
+        (ticker, type, expiration, strike); only new or changed rows are written and rows that were
+        not fetched again are deleted. Every ticker with any change gets this run's revision in
+        tickerRevisions, so the screener can rescore just those.
+
+        Each database is written in one transaction with one executemany per ticker. An empty table,
+        such as on the first run, takes plain inserts and is keyed once everything is in.
+        """
+        symbols = set(tick.symbol for tick in self.tickers)
+        changed = dict((tick.symbol, 0) for tick in self.tickers)
+
         # for historical prices, the format is:
         # ticker, open, low, high, close, volume
-        hist_prices_conn = sqlite3.connect("historicalPrices")
+        hist_prices_conn = self.open_db("historicalPrices")
         hist_prices_curs = hist_prices_conn.cursor()
-        hist_prices_curs.execute(
-            "DROP TABLE IF EXISTS historicalPrices")
         hist_prices_curs.execute(
             "CREATE TABLE IF NOT EXISTS historicalPrices(ticker TEXT, date INTEGER, open REAL, low REAL, high REAL, close REAL, volume INTEGER)")
+        bulk = self.prepare_table(hist_prices_curs, "historicalPrices", PRICE_KEY, symbols)
+
+        for tick in self.tickers:
+            rows = [(tick.symbol, price.date, price.open, price.low, price.high, price.close, price.volume) for price in tick.prices]
+            changed[tick.symbol] += self.write_rows(hist_prices_curs, "historicalPrices", PRICE_COLUMNS, PRICE_KEY, bulk, tick.symbol, rows)
+
+        if (bulk):
+            self.key_table(hist_prices_curs, "historicalPrices", PRICE_KEY)
+
+        hist_prices_conn.commit()
+        self.close_db(hist_prices_conn)
 
         # for options, the format is:
         # ticker, type, expiration date, dte, strike, volume, oi, bid, ask, last price, percent change, itm,
         # iv, iv20, iv50, iv100, theta, beta, gamma, vegas
-        options_conn = sqlite3.connect("optionsData")
+        options_conn = self.open_db("optionsData")
         options_curs = options_conn.cursor()
-        options_curs.execute(
-            "DROP TABLE IF EXISTS optionsData")
         options_curs.execute(
             "CREATE TABLE IF NOT EXISTS optionsData(ticker TEXT, type TEXT, expirationDate TEXT, dte REAL, strike REAL, " +
             "volume INTEGER, openInterest INTEGER, bid REAL, ask REAL, lastPrice REAL, percentChange REAL, itm TEXT, " +
             "impliedVolatility REAL, iv20 REAL, iv50 REAL, iv100 REAL, theta REAL, beta REAL, gamma REAL, vega REAL)")
+        options_curs.execute(
+            "CREATE TABLE IF NOT EXISTS tickerRevisions(ticker TEXT PRIMARY KEY, revision INTEGER)")
+        bulk = self.prepare_table(options_curs, "optionsData", OPTION_KEY, symbols)
+        self.remove_tickers(options_curs, "tickerRevisions", symbols)
+
+        options_curs.execute("SELECT coalesce(max(revision), 0) + 1 FROM tickerRevisions")
+        revision = options_curs.fetchone()[0]
+
+        # a ticker without a revision yet gets one even if nothing changed, so it can be skipped next time
+        options_curs.execute("SELECT ticker FROM tickerRevisions")
+        revised = set(row[0] for row in options_curs.fetchall())
 
         for tick in self.tickers:
-            for price in tick.prices:
-                hist_prices_curs.execute("INSERT INTO historicalPrices VALUES(?, ?, ?, ?, ?, ?, ?)",
-                                            (tick.symbol, price.date, price.open, price.low, price.high, price.close, price.volume))
-            hist_prices_conn.commit()
-
-            for call in tick.calls:
-                options_curs.execute("INSERT INTO optionsData VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, " +
-                                     "?, ?, ?, ?, ?, ?, ?)", (tick.symbol, "Call", call.expiration, call.dte, call.strike, call.volume,
-                                                                call.open_interest, call.bid, call.ask, call.last_price, call.percent_change, str(
-                                                                call.itm), call.iv, tick.iv20, tick.iv50, tick.iv100, call.theta, call.beta,
-                                                                call.gamma, call.vega))
-            for put in tick.puts:
-                options_curs.execute("INSERT INTO optionsData VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, " +
-                                     "?, ?, ?, ?, ?, ?, ?)", (tick.symbol, "Put", put.expiration, put.dte, put.strike, put.volume,
-                                                                put.open_interest, put.bid, put.ask, put.last_price, put.percent_change, str(
-                                                                put.itm), put.iv, tick.iv20, tick.iv50, tick.iv100, put.theta, put.beta,
-                                                                put.gamma, put.vega))
-            options_conn.commit()
+            changed[tick.symbol] += self.write_rows(options_curs, "optionsData", OPTION_COLUMNS, OPTION_KEY, bulk, tick.symbol, self.option_rows(tick))
+
+        if (bulk):
+            self.key_table(options_curs, "optionsData", OPTION_KEY)
+
+        options_curs.executemany("INSERT OR REPLACE INTO tickerRevisions VALUES(?, ?)",
+                                 [(symbol, revision) for symbol in changed if changed[symbol] or symbol not in revised])
+
+        options_conn.commit()
+        self.close_db(options_conn)
 
     def prefetch_webpages(self):
-        """ Utility function to prefetch webpages concurrently """
-        length = len(self.tickers)
+        """ Fetches every ticker's pages concurrently and parses each ticker as soon as its pages are in """
+        if (RAW_DIRECTORY):
+            os.makedirs(RAW_DIRECTORY, exist_ok=True)
 
         requests_cache.install_cache(
             'cache', backend='sqlite', expire_after=3600)
 
-        with concurrent.futures.ThreadPoolExecutor(max_workers=4) as executor:
-            future_to_tickers = {executor.submit(
-                self.get_pages, tick): tick for tick in self.tickers}
-            count = 0
+        asyncio.run(self.fetch_all())
+
+    async def fetch_all(self):
+        """ Runs the fetch and parse stages together. A ticker holds one of FETCH_CONCURRENCY slots from
+            before its first page is fetched until it has been parsed, so fetching waits for parsing
+            instead of piling up pages when parsing falls behind """
+        fetch = fetcher()
+        fetched = asyncio.Queue()
+        held = asyncio.Semaphore(FETCH_CONCURRENCY)
+        parse = concurrent.futures.ThreadPoolExecutor(max_workers=1)
+        count = 0
 
-            for future in concurrent.futures.as_completed(future_to_tickers):
-                if count >= len(self.tickers):
-                    count = count - 1
+        async def fetch_ticker(tick):
+            await held.acquire()
+
+            # a ticker whose pages failed is still handed on, so its slot comes back and parsing never waits on it
+            try:
+                await self.get_pages(fetch, tick)
+            finally:
+                await fetched.put(tick)
+
+        async def parse_tickers():
+            nonlocal count
+
+            for i in range(len(tickers)):
+                tick = await fetched.get()
+
+                # parsing is CPU bound, so it runs off the event loop to keep the fetches going
+                try:
+                    await asyncio.get_running_loop().run_in_executor(parse, self.parse_ticker, tick)
+                finally:
+                    held.release()
 
                 count += 1
-                sys.stdout.write("\rProgress: {0} / {1} webpages".format(count, len(self.tickers)))
+                sys.stdout.write("\rProgress: {0} / {1} tickers".format(count, len(tickers)))
+
+        tickers = list(self.tickers)
+        tasks = [asyncio.ensure_future(fetch_ticker(tick)) for tick in tickers]
+
+        await parse_tickers()
+        await asyncio.gather(*tasks)
+
+        fetch.close()
+        parse.shutdown()
         print()
 
-    def get_pages(self, tick):
-        """ Forces the prefetcher to load all of the pages and stores them in their appropriate objects """
-        url = (
-            "https://finance.yahoo.com/quote/{0}/options?p={0}".format(tick.symbol))
-        sess = requests.session()
-        base = soup(
-            sess.get(url, headers={'User-Agent': 'Custom'}).text, 'html.parser')
+    def parse_ticker(self, tick):
+        """ Parses one ticker's pages and lets them go, dropping the ticker if anything is missing """
+        if (len(tick.dates) == 0 or tick.historical_prices_page is None):
+            self.tickers.remove(tick)
+        elif (not RAW_DIRECTORY):
+            # a page the parsers choke on costs that ticker, not the whole collection
+            try:
+                self.parse_prices_page(tick.historical_prices_page, tick)
 
-        url = (
-            "https://query1.finance.yahoo.com/v8/finance/chart/{0}?formatted=true&crumb=h.8f9xpa6IF&lang=en-US&region=US&interval=1d&events=div%7Csplit&range=1y&corsDomain=finance.yahoo.com".format(tick.symbol))
-        sess = requests.session()
-        tick.historical_prices_page = soup(
-            sess.get(url, headers={'User-Agent': 'Custom'}).text, 'html.parser')
+                if (tick in self.tickers):
+                    self.parse_option_pages(tick)
+            except (ValueError, IndexError):
+                if (tick in self.tickers):
+                    self.tickers.remove(tick)
 
-        self.get_options(tick)
+            if (self.stream is not None and tick in self.tickers):
+                if (self.calculate_ticker_data(tick, self.start_of_today())):
+                    try:
+                        self.stream_ticker(tick)
+                    except OSError:
+                        # the screener went away, the databases still get everything
+                        self.stream = None
+                else:
+                    self.tickers.remove(tick)
 
-        for date in tick.dates:
-            cont = False
-            count = 0
-            url = (
-                "https://query1.finance.yahoo.com/v7/finance/options/{0}?formatted=true&crumb=R6vBcFmQGju&lang=en-US&region=US&date={1}&corsDomain=finance.yahoo.com".format(
-                tick.symbol, date))
+        tick.historical_prices_page = None
+        tick.date_pages = []
 
-            while (not cont):
-                try:
-                    page = soup(
-                        sess.get(url, headers={'User-Agent': 'Custom'}).text, 'html.parser')
-                    cont = True
-                except:
-                    if (count == 10):
-                        time.sleep(.5)
+    def save_raw(self, name, text):
+        """ Saves one response as it came, written aside and renamed so the screener never reads half a file """
+        path = os.path.join(RAW_DIRECTORY, name)
 
-            tick.date_pages.append(page)
+        with open(path + ".tmp", 'w') as output:
+            output.write(text)
+        os.replace(path + ".tmp", path)
 
-    def main(self):
-        remove_list = []
+    def save_raw_volatility(self):
+        """ Saves every ticker's historical volatility, which does not come from Yahoo """
+        with open(os.path.join(RAW_DIRECTORY, "volatility.csv"), 'w') as output:
+            for tick in self.tickers:
+                if (None not in (tick.iv20, tick.iv50, tick.iv100)):
+                    output.write("{0},{1},{2},{3}\n".format(tick.symbol, tick.iv20, tick.iv50, tick.iv100))
 
+    async def get_pages(self, fetch, tick):
+        """ Loads all of the ticker's pages and stores them in their appropriate objects. The quote page lists the
+            expiration dates, after which the chart and every date's options are fetched at once """
+        text = await fetch.fetch(QUOTE_PAGE.format(tick.symbol))
+
+        if (text is None):
+            return
+
+        self.get_options(tick, text)
+
+        urls = [CHART_PAGE.format(tick.symbol)] + [OPTIONS_PAGE.format(tick.symbol, date) for date in tick.dates]
+        texts = await asyncio.gather(*[fetch.fetch(url) for url in urls])
+
+        if (texts[0] is not None):
+            tick.historical_prices_page = soup(texts[0], 'html.parser')
+
+            if (RAW_DIRECTORY):
+                self.save_raw("{0}.chart.json".format(tick.symbol), texts[0])
+
+        # an expiration whose page never came is left out, so dates and pages stay in step
+        dates = []
+
+        for date, text in zip(tick.dates, texts[1:]):
+            if (text is None):
+                continue
+
+            if (RAW_DIRECTORY):
+                self.save_raw("{0}.{1}.options.json".format(tick.symbol, date), text)
+
+            dates.append(date)
+            tick.date_pages.append(soup(text, 'html.parser'))
+
+        tick.dates = dates
+
+    def main(self):
         self.download_files()
-        self.gather_historical_volatility()
 
+        # the screener estimates volatility from the prices itself, the page only adds its quoted values
+        try:
+            self.gather_historical_volatility()
+        except (requests.exceptions.RequestException, IndexError, ValueError):
+            print("Warning: Unable to gather historical volatility, continuing without it")
+
+        symbols = list(dict.fromkeys(self.tickers)) or list(self.ticker_dict)
         self.tickers = []
 
-        for symbol in self.ticker_dict:
-            self.tickers.append(ticker(
-                symbol, self.ticker_dict[symbol][0], self.ticker_dict[symbol][1], self.ticker_dict[symbol][2]))
+        for symbol in symbols:
+            self.tickers.append(ticker(symbol, *self.ticker_dict.get(symbol, [None, None, None])))
+
+        if (STREAM_FD and not RAW_DIRECTORY):
+            self.stream = os.fdopen(int(STREAM_FD), 'wb')
 
-        print("Prefetching webpages...")
+        print("Fetching and parsing prices and options data...")
         self.prefetch_webpages()
 
-        for tick in self.tickers:
-            if (len(tick.dates) == 0 or tick.historical_prices_page is None):
-                remove_list.append(tick)
+        if (self.stream is not None):
+            try:
+                self.stream_end()
+            except OSError:
+                self.stream = None
 
-        for tick in remove_list:
-            self.tickers.remove(tick)
+        if (STREAM_FD and not RAW_DIRECTORY and not STREAM_DB):
+            return
+
+        # the screener parses the saved responses itself, the databases are left as they were
+        if (RAW_DIRECTORY):
+            self.save_raw_volatility()
+            print("Saved raw responses to {0}".format(RAW_DIRECTORY))
+            return
 
-        print("Parsing prices and options data...")
-        self.gather_prices()
-        self.gather_option_data()
         self.calculate_option_data()
 
         print("Inserting data into databases...")
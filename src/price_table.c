@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/price_table.h"
+#include "../include/arena.h"
+#include "../include/safe.h"
+
+/* Sets up an empty table allocating from arena, columns are allocated on the first append */
+void price_table_init(struct PriceTable *table, struct Arena *arena) {
+	memset(table, 0, sizeof(struct PriceTable));
+	table->arena = arena;
+}
+
+/* Makes room for at least capacity rows, so a loader that knows its row count never has to grow */
+void price_table_reserve(struct PriceTable *table, long capacity) {
+	if (capacity <= table->capacity)
+		return;
+
+#define PRICE_TABLE_GROW(type, name) table->name = arena_grow(table->arena, table->name, table->capacity * sizeof(type), capacity * sizeof(type));
+	PRICE_TABLE_COLUMNS(PRICE_TABLE_GROW)
+#undef PRICE_TABLE_GROW
+
+	table->capacity = capacity;
+}
+
+/* Adds one zeroed row to the end of the table, growing every column geometrically. Returns the new row's index */
+long price_table_append(struct PriceTable *table) {
+	long row;
+
+	if (table->size == table->capacity)
+		price_table_reserve(table, (table->capacity < PRICE_TABLE_MIN_CAPACITY ? PRICE_TABLE_MIN_CAPACITY : table->capacity * 2));
+
+	row = table->size++;
+
+#define PRICE_TABLE_ZERO(type, name) table->name[row] = 0;
+	PRICE_TABLE_COLUMNS(PRICE_TABLE_ZERO)
+#undef PRICE_TABLE_ZERO
+
+	return row;
+}
+
+/* Moves every column into the order given by new_index, where new_index[i] is the destination of row i */
+static void permute_columns(struct PriceTable *table, long *new_index) {
+	long i;
+	void *column;
+
+#define PRICE_TABLE_PERMUTE(type, name)                                 \
+	column = arena_alloc(table->arena, table->capacity * sizeof(type)); \
+	for (i = 0; i < table->size; i++)                                   \
+		((type *)column)[new_index[i]] = table->name[i];                \
+	table->name = column;
+
+	PRICE_TABLE_COLUMNS(PRICE_TABLE_PERMUTE)
+#undef PRICE_TABLE_PERMUTE
+}
+
+/*
+ * Groups the bars by stock with a stable counting sort and records each stock's range, so
+ * bars keep their database (date) order. Bars whose parent is negative are dropped.
+ */
+void price_table_group(struct PriceTable *table, struct ParentStock **parent_array, long parent_array_size) {
+	long i, key, sorted, *offsets, *new_index;
+
+	offsets = safe_calloc(parent_array_size + 2, sizeof(long));
+	new_index = safe_malloc((table->size ? table->size : 1) * sizeof(long));
+
+	// the last bucket collects every bar without a parent
+	for (i = 0; i < table->size; i++)
+		offsets[(table->parent[i] < 0 ? parent_array_size : table->parent[i]) + 1]++;
+
+	for (key = 0; key < parent_array_size; key++)
+		offsets[key + 1] += offsets[key];
+
+	for (key = 0; key < parent_array_size; key++) {
+		parent_array[key]->prices_begin = offsets[key];
+		parent_array[key]->prices_end = offsets[key + 1];
+	}
+
+	sorted = TRUE;
+	for (i = 0; i < table->size; i++) {
+		new_index[i] = offsets[table->parent[i] < 0 ? parent_array_size : table->parent[i]]++;
+
+		if (new_index[i] != i)
+			sorted = FALSE;
+	}
+
+	if (!sorted)
+		permute_columns(table, new_index);
+
+	table->size = (parent_array_size ? parent_array[parent_array_size - 1]->prices_end : 0);
+
+	free(new_index);
+	free(offsets);
+
+	return;
+}
@@ -0,0 +1,162 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/query_index.h"
+#include "../include/option_table.h"
+#include "../include/options.h"
+#include "../include/arena.h"
+#include "../include/safe.h"
+
+/* One open contract while the index is sorted */
+struct IndexEntry {
+   float weight;
+   float bid;
+   long row;
+};
+
+/* Highest weight first, ties by row so the order never depends on qsort */
+static int by_weight(const void *a, const void *b) {
+	const struct IndexEntry *x = a, *y = b;
+
+	if (x->weight != y->weight)
+		return (x->weight < y->weight ? 1 : -1);
+
+	return (x->row > y->row) - (x->row < y->row);
+}
+
+static int by_row(const void *a, const void *b) {
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* The same filter and running sums find_averages has always printed from */
+static void add_to_averages(struct QueryIndex *index, float weight) {
+	index->averages_count++;
+	index->averages_sum += weight;
+
+	if (weight > index->averages_high)
+		index->averages_high = weight;
+	if (weight < index->averages_low)
+		index->averages_low = weight;
+}
+
+/*
+ * Adds up each open contract's total weight, sorts them and builds the bid tree. A contract
+ * whose total weight is NaN can never clear a threshold and is left out.
+ */
+void query_index_build(struct QueryIndex *index, struct ParentStock **parent_array, long parent_array_size, struct OptionTable *options, struct Arena *arena) {
+	int outter_i;
+	long inner_i, i, size;
+	float weight;
+	struct IndexEntry *entries;
+
+	memset(index, 0, sizeof(struct QueryIndex));
+	index->averages_low = INT32_MAX;
+
+	entries = safe_malloc((options->size ? options->size : 1) * sizeof(struct IndexEntry));
+	size = 0;
+
+	for (outter_i = 0; outter_i < parent_array_size; outter_i++) {
+		for (inner_i = parent_array[outter_i]->calls_begin; inner_i < parent_array[outter_i]->puts_end; inner_i++) {
+			if (!options->open[inner_i])
+				continue;
+
+			// calls with any weight at all have always been left out of the averages
+			if (inner_i < parent_array[outter_i]->calls_end) {
+				if (!(options->weight[inner_i] > 5000 || options->weight[inner_i] < -5000 || options->weight[inner_i]))
+					add_to_averages(index, options->weight[inner_i]);
+			}
+			else if (!(options->weight[inner_i] > 5000 || options->weight[inner_i] < -5000))
+				add_to_averages(index, options->weight[inner_i]);
+
+			weight = total_weight(parent_array[outter_i], options, inner_i);
+
+			if (isnan(weight))
+				continue;
+
+			entries[size].weight = weight;
+			entries[size].bid = options->bid[inner_i];
+			entries[size].row = inner_i;
+			size++;
+		}
+	}
+
+	qsort(entries, size, sizeof(struct IndexEntry), by_weight);
+
+	index->size = size;
+	for (index->leaves = 1; index->leaves < size; index->leaves *= 2)
+		;
+
+	index->weight = arena_alloc(arena, (size ? size : 1) * sizeof(float));
+	index->bid = arena_alloc(arena, (size ? size : 1) * sizeof(float));
+	index->row = arena_alloc(arena, (size ? size : 1) * sizeof(long));
+	index->min_bid = arena_alloc(arena, index->leaves * 2 * sizeof(float));
+
+	for (i = 0; i < size; i++) {
+		index->weight[i] = entries[i].weight;
+		index->bid[i] = entries[i].bid;
+		index->row[i] = entries[i].row;
+	}
+
+	// a NaN bid never passes bid < max_option_price, so it sorts like an infinite one
+	for (i = 0; i < index->leaves; i++)
+		index->min_bid[index->leaves + i] = (i < size && !isnan(entries[i].bid) ? entries[i].bid : INFINITY);
+
+	for (i = index->leaves - 1; i > 0; i--)
+		index->min_bid[i] = fminf(index->min_bid[i * 2], index->min_bid[i * 2 + 1]);
+
+	free(entries);
+
+	return;
+}
+
+/* Appends every position below end in node's subtree whose bid is under max_option_price */
+static void collect(struct QueryIndex *index, long node, long first, long width, long end, float max_option_price, long *rows, long *count) {
+	if (first >= end || !(index->min_bid[node] < max_option_price))
+		return;
+
+	if (node >= index->leaves) {
+		rows[(*count)++] = index->row[first];
+		return;
+	}
+
+	collect(index, node * 2, first, width / 2, end, max_option_price, rows, count);
+	collect(index, node * 2 + 1, first + width / 2, width / 2, end, max_option_price, rows, count);
+}
+
+/*
+ * Finds every contract with a total weight above min_weight and a bid below max_option_price, in
+ * O(log n) plus the matches. *rows is set to a malloc'd list of their option rows in table order,
+ * which is print_data's order, and the number of matches is returned.
+ */
+long query_index_find(struct QueryIndex *index, float max_option_price, float min_weight, long **rows) {
+	long low, high, mid, count;
+
+	// weights are descending, so the ones above min_weight are the prefix [0, low)
+	low = 0;
+	high = index->size;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+
+		if (index->weight[mid] > min_weight)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	*rows = safe_malloc((low ? low : 1) * sizeof(long));
+	count = 0;
+
+	if (low > 0)
+		collect(index, 1, 0, index->leaves, low, max_option_price, *rows, &count);
+
+	qsort(*rows, count, sizeof(long), by_row);
+
+	return count;
+}
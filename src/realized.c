@@ -0,0 +1,154 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/realized.h"
+
+static const int windows[HV_WINDOWS] = { 20, 50, 100 };
+
+static enum RealizedEstimator selected;
+static pthread_once_t selected_once = PTHREAD_ONCE_INIT;
+
+static void select_estimator(void) {
+	char *env = getenv(REALIZED_ENV);
+
+	selected = REALIZED_CLOSE;
+
+	if (env == NULL || strcmp(env, "close") == 0)
+		return;
+
+	if (strcmp(env, "parkinson") == 0)
+		selected = REALIZED_PARKINSON;
+	else if (strcmp(env, "yang_zhang") == 0)
+		selected = REALIZED_YANG_ZHANG;
+	else if (strcmp(env, "quoted") == 0)
+		selected = REALIZED_QUOTED;
+	else
+		fprintf(stderr, "Warning: Ignoring %s=%s\n", REALIZED_ENV, env);
+}
+
+/* The estimator REALIZED_ENV picked, once per process */
+enum RealizedEstimator realized_estimator(void) {
+	pthread_once(&selected_once, select_estimator);
+
+	return selected;
+}
+
+/* Sample variance from a running sum and sum of squares */
+static double variance(double sum, double squares, int count) {
+	double value = (squares - sum * sum / count) / (count - 1);
+
+	return (value > 0 ? value : 0);
+}
+
+/* An annualized daily variance, in points */
+static float annualize(double daily) {
+	return sqrt(daily * TRADING_DAYS) * 100;
+}
+
+/* Running sums over the newest count returns */
+struct RealizedSums {
+   int count;
+   double close, close_squares;           // close to close log returns
+   double range_squares;                  // squared log high/low ranges
+   double overnight, overnight_squares;   // log open over the previous close
+   double session, session_squares;       // log close over open
+   double rogers_satchell;
+};
+
+/* Writes window's three estimates from the sums, once they hold at least two returns */
+static void record_window(struct ParentStock *stock, int window, struct RealizedSums *sums) {
+	int n = sums->count;
+	double k;
+
+	if (n < 2)
+		return;
+
+	stock->hv_close[window] = annualize(variance(sums->close, sums->close_squares, n));
+	stock->hv_parkinson[window] = annualize(sums->range_squares / (4 * M_LN2 * n));
+
+	k = 0.34 / (1.34 + (double)(n + 1) / (n - 1));
+	stock->hv_yang_zhang[window] = annualize(variance(sums->overnight, sums->overnight_squares, n) +
+	                                         k * variance(sums->session, sums->session_squares, n) +
+	                                         (1 - k) * sums->rogers_satchell / n);
+}
+
+/* Overwrites one of iv20, iv50 or iv100 with the chosen estimate. A quoted value, or a window with no estimate, is kept */
+static void choose(float *iv, struct ParentStock *stock, int window, enum RealizedEstimator estimator) {
+	float estimate;
+
+	switch (estimator) {
+	case REALIZED_PARKINSON:
+		estimate = stock->hv_parkinson[window];
+		break;
+	case REALIZED_YANG_ZHANG:
+		estimate = stock->hv_yang_zhang[window];
+		break;
+	case REALIZED_QUOTED:
+		if (*iv > 0)
+			return;
+		// fall-through
+	default:
+		estimate = stock->hv_close[window];
+		break;
+	}
+
+	if (estimate > 0)
+		*iv = estimate;
+}
+
+/* Estimates one stock's realized volatility and picks its iv20, iv50 and iv100 */
+void realized_volatility(struct ParentStock *stock, struct PriceTable *prices) {
+	int window;
+	long t;
+	double open, high, low, close, previous, ret, range, overnight, session;
+	struct RealizedSums sums;
+	enum RealizedEstimator estimator = realized_estimator();
+
+	memset(&sums, 0, sizeof(struct RealizedSums));
+
+	for (window = 0; window < HV_WINDOWS; window++)
+		stock->hv_close[window] = stock->hv_parkinson[window] = stock->hv_yang_zhang[window] = 0;
+
+	// newest first, each window's sums are a prefix of the next one's
+	for (t = stock->prices_end - 1, window = 0; t > stock->prices_begin && window < HV_WINDOWS; t--) {
+		open = prices->open[t];
+		high = prices->high[t];
+		low = prices->low[t];
+		close = prices->close[t];
+		previous = prices->close[t - 1];
+
+		if (!(open > 0 && high > 0 && low > 0 && close > 0 && previous > 0))
+			continue;
+
+		ret = log(close / previous);
+		range = log(high / low);
+		overnight = log(open / previous);
+		session = log(close / open);
+
+		sums.count++;
+		sums.close += ret;
+		sums.close_squares += ret * ret;
+		sums.range_squares += range * range;
+		sums.overnight += overnight;
+		sums.overnight_squares += overnight * overnight;
+		sums.session += session;
+		sums.session_squares += session * session;
+		sums.rogers_satchell += log(high / close) * log(high / open) + log(low / close) * log(low / open);
+
+		if (sums.count == windows[window])
+			record_window(stock, window++, &sums);
+	}
+
+	// the history ran out first, the rest of the windows get everything there was
+	for (; window < HV_WINDOWS; window++)
+		record_window(stock, window, &sums);
+
+	choose(&stock->iv20, stock, 0, estimator);
+	choose(&stock->iv50, stock, 1, estimator);
+	choose(&stock->iv100, stock, 2, estimator);
+}
@@ -0,0 +1,376 @@
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/report.h"
+#include "../include/options.h"
+#include "../include/strategy.h"
+#include "../include/safe.h"
+
+/* Picks the format from a file's extension, anything unrecognised gets the table view */
+enum ReportFormat report_format(const char *filename) {
+	const char *extension = strrchr(filename, '.');
+
+	if (extension == NULL)
+		return REPORT_TABLE;
+	if (strcmp(extension, ".csv") == 0)
+		return REPORT_CSV;
+	if (strcmp(extension, ".jsonl") == 0 || strcmp(extension, ".json") == 0)
+		return REPORT_JSONL;
+	if (strcmp(extension, ".bin") == 0)
+		return REPORT_BINARY;
+
+	return REPORT_TABLE;
+}
+
+void report_open(struct ReportSink *sink, int fd, enum ReportFormat format) {
+	sink->fd = fd;
+	sink->format = format;
+	sink->last_stock = -1;
+	sink->used = 0;
+	sink->capacity = REPORT_BUFFER_SIZE;
+	sink->buffer = safe_malloc(REPORT_BUFFER_SIZE);
+}
+
+/* Opens a sink that keeps the whole report in buffer, for callers that need its length before sending it */
+void report_open_memory(struct ReportSink *sink, enum ReportFormat format) {
+	report_open(sink, REPORT_MEMORY, format);
+}
+
+/* Empties a memory sink so it can hold the next report, in format */
+void report_clear(struct ReportSink *sink, enum ReportFormat format) {
+	sink->format = format;
+	sink->used = 0;
+	sink->last_stock = -1;
+}
+
+/* Writes out everything buffered so far. Anything printed through stdio goes first, so prompts stay in order */
+void report_flush(struct ReportSink *sink) {
+	if (sink->used == 0 || sink->fd == REPORT_MEMORY)
+		return;
+
+	if (sink->fd == STDOUT_FILENO)
+		fflush(stdout);
+
+	safe_write(sink->fd, sink->buffer, sink->used);
+	sink->used = 0;
+}
+
+void report_close(struct ReportSink *sink) {
+	report_flush(sink);
+
+	free(sink->buffer);
+	sink->buffer = NULL;
+}
+
+/* Makes room for size more bytes, by writing the buffer out or, in a memory sink, by growing it */
+static void make_room(struct ReportSink *sink, size_t size) {
+	if (sink->fd != REPORT_MEMORY) {
+		report_flush(sink);
+		return;
+	}
+
+	while (sink->used + size > sink->capacity)
+		sink->capacity *= 2;
+
+	sink->buffer = safe_realloc(sink->buffer, sink->capacity);
+}
+
+/* Copies size bytes into the buffer, flushing first if they do not fit */
+static void append(struct ReportSink *sink, const void *data, size_t size) {
+	if (sink->used + size > sink->capacity)
+		make_room(sink, size);
+
+	if (sink->used + size > sink->capacity) {
+		safe_write(sink->fd, (void *)data, size);
+		return;
+	}
+
+	memcpy(sink->buffer + sink->used, data, size);
+	sink->used += size;
+}
+
+/* printf into the buffer. Formats straight into the free space and only flushes and retries if it did not fit */
+static void append_format(struct ReportSink *sink, const char *format, ...) {
+	int length;
+	char *line;
+	va_list args;
+
+	va_start(args, format);
+	length = vsnprintf(sink->buffer + sink->used, sink->capacity - sink->used, format, args);
+	va_end(args);
+
+	if (length < 0 || sink->used + length < sink->capacity) {
+		sink->used += (length < 0 ? 0 : length);
+		return;
+	}
+
+	make_room(sink, length + 1);
+
+	va_start(args, format);
+	length = vsnprintf(sink->buffer + sink->used, sink->capacity - sink->used, format, args);
+	va_end(args);
+
+	if (sink->used + length < sink->capacity) {
+		sink->used += length;
+		return;
+	}
+
+	// one line larger than the whole buffer, format it on its own
+	line = safe_malloc(length + 1);
+	va_start(args, format);
+	vsnprintf(line, length + 1, format, args);
+	va_end(args);
+
+	safe_write(sink->fd, line, length);
+	free(line);
+}
+
+/* Writes a string as a JSON string literal */
+static void append_json_string(struct ReportSink *sink, const char *string) {
+	append(sink, "\"", 1);
+
+	for (; *string != '\0'; string++) {
+		if (*string == '"' || *string == '\\')
+			append_format(sink, "\\%c", *string);
+		else if ((unsigned char)*string < 0x20)
+			append_format(sink, "\\u%04x", (unsigned char)*string);
+		else
+			append(sink, string, 1);
+	}
+
+	append(sink, "\"", 1);
+}
+
+/* JSON has no NaN or infinity, they become null */
+static void append_json_float(struct ReportSink *sink, const char *name, float value) {
+	if (isfinite(value))
+		append_format(sink, ",\"%s\":%.9g", name, value);
+	else
+		append_format(sink, ",\"%s\":null", name);
+}
+
+/* Writes whatever a format puts before its first row */
+void report_begin(struct ReportSink *sink) {
+	time_t t = time(NULL);
+	struct tm tm;
+	struct ReportHeader header;
+
+	// reports are written from several threads at once in batch and server mode
+	localtime_r(&t, &tm);
+
+	sink->last_stock = -1;
+
+	switch (sink->format) {
+	case REPORT_TABLE:
+		append_format(sink, "\nDate Generated: %d-%d-%d\n", tm.tm_mon + 1, tm.tm_mday, tm.tm_year + 1900);
+		append_format(sink, "\n\t%s\t%s\t%s\t\t%4s\t  %s\t     %s\t    %s\n", "TYPE", "STOCK PRICE", "STRIKE", "DTE", "   BID", "ASK", "WEIGHT");
+		append_format(sink, "\t--------------------------------------------------------------------------------------------\n");
+		break;
+	case REPORT_CSV:
+		append_format(sink, "ticker,type,stock_price,strike,dte,expiration_date,bid,ask,volume,open_interest,implied_volatility,weight,delta,gamma,theta,vega,rho\n");
+		break;
+	case REPORT_BINARY:
+		memset(&header, 0, sizeof(struct ReportHeader));
+		memcpy(header.magic, REPORT_MAGIC, sizeof(REPORT_MAGIC));
+		header.version = REPORT_VERSION;
+		header.record_size = sizeof(struct ReportRecord);
+		append(sink, &header, sizeof(struct ReportHeader));
+		break;
+	default:
+		break;
+	}
+}
+
+/* Formats one contract. Rows for the table view must come grouped by stock, as the query index returns them */
+void report_row(struct ReportSink *sink, struct ParentStock **parent_array, struct OptionTable *options, long row) {
+	int stock_index = options->parent[row];
+	float weight;
+	struct ParentStock *stock = parent_array[stock_index];
+	struct ReportRecord record;
+
+	weight = total_weight(stock, options, row);
+
+	switch (sink->format) {
+	case REPORT_TABLE:
+		if (stock_index != sink->last_stock)
+			append_format(sink, "\n%s", stock->ticker);
+
+		append_format(sink, "\t%s\t%7f\t%f\t%4d\t%4f\t%4f\t%f\n", (options->type[row] ? "Call" : "Put"), stock->curr_price,
+		              options->strike[row], options->days_til_expiration[row], options->bid[row], options->ask[row], weight);
+		break;
+	case REPORT_CSV:
+		// tickers are plain symbols, quoting is never needed
+		append_format(sink, "%s,%s,%.9g,%.9g,%d,%ld,%.9g,%.9g,%ld,%ld,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n", stock->ticker,
+		              (options->type[row] ? "call" : "put"), stock->curr_price, options->strike[row], options->days_til_expiration[row],
+		              options->expiration_date[row], options->bid[row], options->ask[row], options->volume[row], options->open_interest[row],
+		              options->implied_volatility[row], weight, options->delta[row], options->gamma[row], options->theta[row],
+		              options->vega[row], options->rho[row]);
+		break;
+	case REPORT_JSONL:
+		append(sink, "{\"ticker\":", 10);
+		append_json_string(sink, stock->ticker);
+		append_format(sink, ",\"type\":\"%s\"", (options->type[row] ? "call" : "put"));
+		append_json_float(sink, "stock_price", stock->curr_price);
+		append_json_float(sink, "strike", options->strike[row]);
+		append_format(sink, ",\"dte\":%d,\"expiration_date\":%ld", options->days_til_expiration[row], options->expiration_date[row]);
+		append_json_float(sink, "bid", options->bid[row]);
+		append_json_float(sink, "ask", options->ask[row]);
+		append_format(sink, ",\"volume\":%ld,\"open_interest\":%ld", options->volume[row], options->open_interest[row]);
+		append_json_float(sink, "implied_volatility", options->implied_volatility[row]);
+		append_json_float(sink, "weight", weight);
+		append_json_float(sink, "delta", options->delta[row]);
+		append_json_float(sink, "gamma", options->gamma[row]);
+		append_json_float(sink, "theta", options->theta[row]);
+		append_json_float(sink, "vega", options->vega[row]);
+		append_json_float(sink, "rho", options->rho[row]);
+		append(sink, "}\n", 2);
+		break;
+	case REPORT_BINARY:
+		memset(&record, 0, sizeof(struct ReportRecord));
+		memcpy(record.ticker, stock->ticker, TICK_SIZE);
+		record.type = options->type[row];
+		record.in_the_money = options->in_the_money[row];
+		record.days_til_expiration = options->days_til_expiration[row];
+		record.expiration_date = options->expiration_date[row];
+		record.volume = options->volume[row];
+		record.open_interest = options->open_interest[row];
+		record.stock_price = stock->curr_price;
+		record.strike = options->strike[row];
+		record.bid = options->bid[row];
+		record.ask = options->ask[row];
+		record.implied_volatility = options->implied_volatility[row];
+		record.weight = weight;
+		record.delta = options->delta[row];
+		record.gamma = options->gamma[row];
+		record.theta = options->theta[row];
+		record.vega = options->vega[row];
+		record.rho = options->rho[row];
+		append(sink, &record, sizeof(struct ReportRecord));
+		break;
+	}
+
+	sink->last_stock = stock_index;
+}
+
+/* Writes whatever a format puts before its first strategy */
+void report_begin_strategies(struct ReportSink *sink) {
+	time_t t = time(NULL);
+	struct tm tm;
+	struct ReportHeader header;
+
+	localtime_r(&t, &tm);
+
+	sink->last_stock = -1;
+
+	switch (sink->format) {
+	case REPORT_TABLE:
+		append_format(sink, "\nDate Generated: %d-%d-%d\n", tm.tm_mon + 1, tm.tm_mday, tm.tm_year + 1900);
+		append_format(sink, "\n\t%s\t%s\t%s\t\t%s\t%s\t%s\t\t%s\n", "STRATEGY", "STOCK PRICE", "COST", "MAX LOSS", "MAX GAIN", "EDGE", "SCORE");
+		append_format(sink, "\t--------------------------------------------------------------------------------------------\n");
+		break;
+	case REPORT_CSV:
+		append_format(sink, "ticker,strategy,stock_price,cost,width,max_loss,max_gain,edge,score,legs\n");
+		break;
+	case REPORT_BINARY:
+		memset(&header, 0, sizeof(struct ReportHeader));
+		memcpy(header.magic, REPORT_MAGIC, sizeof(REPORT_MAGIC));
+		header.version = REPORT_VERSION;
+		header.record_size = sizeof(struct ReportStrategyRecord);
+		append(sink, &header, sizeof(struct ReportHeader));
+		break;
+	default:
+		break;
+	}
+}
+
+/* Formats one strategy, and under it in the table view one line per leg */
+void report_strategy(struct ReportSink *sink, struct ParentStock **parent_array, struct OptionTable *options, struct Strategy *strategy) {
+	int i;
+	long row;
+	struct ParentStock *stock = parent_array[strategy->stock];
+	struct ReportStrategyRecord record;
+
+	switch (sink->format) {
+	case REPORT_TABLE:
+		append_format(sink, "\n%s\t%s\t%7f\t%f\t%f\t%f\t%f\t%f\n", stock->ticker, strategy_name(strategy->kind), stock->curr_price,
+		              strategy->cost, strategy->max_loss, strategy->max_gain, strategy->edge, strategy->score);
+
+		for (i = 0; i < strategy->leg_count; i++) {
+			row = strategy->legs[i].row;
+			append_format(sink, "\t%s %s\t\t%f\t%4d\t%4f\t%4f\n", (strategy->legs[i].quantity > 0 ? "Buy" : "Sell"),
+			              (options->type[row] ? "Call" : "Put"), options->strike[row], options->days_til_expiration[row], options->bid[row], options->ask[row]);
+		}
+		break;
+	case REPORT_CSV:
+		// legs as quantity, side, strike and expiration, separated by semicolons
+		append_format(sink, "%s,%s,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,", stock->ticker, strategy_name(strategy->kind), stock->curr_price,
+		              strategy->cost, strategy->width, strategy->max_loss, strategy->max_gain, strategy->edge, strategy->score);
+
+		for (i = 0; i < strategy->leg_count; i++) {
+			row = strategy->legs[i].row;
+			append_format(sink, "%s%+d:%s:%.9g:%ld", (i > 0 ? ";" : ""), strategy->legs[i].quantity, (options->type[row] ? "call" : "put"),
+			              options->strike[row], options->expiration_date[row]);
+		}
+
+		append(sink, "\n", 1);
+		break;
+	case REPORT_JSONL:
+		append(sink, "{\"ticker\":", 10);
+		append_json_string(sink, stock->ticker);
+		append_format(sink, ",\"strategy\":\"%s\"", strategy_name(strategy->kind));
+		append_json_float(sink, "stock_price", stock->curr_price);
+		append_json_float(sink, "cost", strategy->cost);
+		append_json_float(sink, "width", strategy->width);
+		append_json_float(sink, "max_loss", strategy->max_loss);
+		append_json_float(sink, "max_gain", strategy->max_gain);
+		append_json_float(sink, "edge", strategy->edge);
+		append_json_float(sink, "score", strategy->score);
+		append(sink, ",\"legs\":[", 9);
+
+		for (i = 0; i < strategy->leg_count; i++) {
+			row = strategy->legs[i].row;
+			append_format(sink, "%s{\"quantity\":%d,\"type\":\"%s\"", (i > 0 ? "," : ""), strategy->legs[i].quantity, (options->type[row] ? "call" : "put"));
+			append_json_float(sink, "strike", options->strike[row]);
+			append_format(sink, ",\"dte\":%d,\"expiration_date\":%ld", options->days_til_expiration[row], options->expiration_date[row]);
+			append_json_float(sink, "bid", options->bid[row]);
+			append_json_float(sink, "ask", options->ask[row]);
+			append(sink, "}", 1);
+		}
+
+		append(sink, "]}\n", 3);
+		break;
+	case REPORT_BINARY:
+		memset(&record, 0, sizeof(struct ReportStrategyRecord));
+		memcpy(record.ticker, stock->ticker, TICK_SIZE);
+		record.kind = strategy->kind;
+		record.leg_count = strategy->leg_count;
+		record.stock_price = stock->curr_price;
+		record.cost = strategy->cost;
+		record.width = strategy->width;
+		record.max_loss = strategy->max_loss;
+		record.max_gain = strategy->max_gain;
+		record.edge = strategy->edge;
+		record.score = strategy->score;
+
+		for (i = 0; i < strategy->leg_count && i < REPORT_STRATEGY_LEGS; i++) {
+			row = strategy->legs[i].row;
+			record.legs[i].expiration_date = options->expiration_date[row];
+			record.legs[i].strike = options->strike[row];
+			record.legs[i].type = options->type[row];
+			record.legs[i].quantity = strategy->legs[i].quantity;
+		}
+
+		append(sink, &record, sizeof(struct ReportStrategyRecord));
+		break;
+	}
+
+	sink->last_stock = strategy->stock;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/rescore.h"
+#include "../include/options.h"
+#include "../include/option_table.h"
+#include "../include/symbols.h"
+#include "../include/safe.h"
+
+/* TRUE if both ranges hold the same contracts in the same order */
+static int same_contracts(struct OptionTable *options, long begin, struct OptionTable *previous, long previous_begin, long count) {
+	return memcmp(options->type + begin, previous->type + previous_begin, count * sizeof(char)) == 0 &&
+	       memcmp(options->expiration_date + begin, previous->expiration_date + previous_begin, count * sizeof(long)) == 0 &&
+	       memcmp(options->strike + begin, previous->strike + previous_begin, count * sizeof(float)) == 0;
+}
+
+/*
+ * Copies a stock's scores from the universe it was scored in, if its data has not changed since.
+ * Returns FALSE, touching nothing, if it has to be scored again.
+ */
+static int carry_scores(struct Universe *universe, int stock_index, struct Universe *previous, struct ParentStock *old) {
+	long row, count;
+	struct ParentStock *stock = universe->parent_array[stock_index], loaded;
+
+	// revision 0 means the collector never said, so nothing is assumed
+	if (stock->revision == 0 || stock->revision != old->revision)
+		return FALSE;
+	if (stock->calls_end - stock->calls_begin != old->calls_end - old->calls_begin ||
+	    stock->puts_end - stock->puts_begin != old->puts_end - old->puts_begin ||
+	    stock->prices_end - stock->prices_begin != old->prices_end - old->prices_begin)
+		return FALSE;
+
+	count = stock->puts_end - stock->calls_begin;
+
+	if (!same_contracts(&universe->options, stock->calls_begin, &previous->options, old->calls_begin, count))
+		return FALSE;
+
+	loaded = *stock;
+	*stock = *old;
+	stock->calls_begin = loaded.calls_begin;
+	stock->calls_end = loaded.calls_end;
+	stock->puts_begin = loaded.puts_begin;
+	stock->puts_end = loaded.puts_end;
+	stock->prices_begin = loaded.prices_begin;
+	stock->prices_end = loaded.prices_end;
+
+	// calls and puts are contiguous, so each column is one copy. The loaded columns are identical anyway
+#define CARRY_COLUMN(type, name) \
+	memcpy(universe->options.name + stock->calls_begin, previous->options.name + old->calls_begin, count * sizeof(type));
+	OPTION_TABLE_COLUMNS(CARRY_COLUMN)
+#undef CARRY_COLUMN
+
+	for (row = stock->calls_begin; row < stock->puts_end; row++)
+		universe->options.parent[row] = stock_index;
+
+	return TRUE;
+}
+
+/*
+ * Screens and scores a freshly loaded universe, reusing the universe it replaces. A stock whose
+ * collector revision is unchanged, with the same contracts in the same order, takes its scores from
+ * previous; every other stock is screened and scored as a regular run would. With no previous
+ * universe everything is scored. Returns how many stocks were.
+ */
+long rescore_universe(struct Universe *universe, struct Universe *previous) {
+	int id, *previous_of;
+	long i, changed_size;
+	struct ParentStock **changed, *stock;
+
+	changed = safe_malloc((universe->parent_array_size ? universe->parent_array_size : 1) * sizeof(struct ParentStock *));
+	changed_size = 0;
+	previous_of = NULL;
+
+	// parents are found by symbol id in the previous universe's own symbol table
+	if (previous != NULL) {
+		previous_of = safe_malloc((previous->symbols.size ? previous->symbols.size : 1) * sizeof(int));
+
+		for (i = 0; i < previous->symbols.size; i++)
+			previous_of[i] = NO_SYMBOL;
+
+		for (i = 0; i < previous->parent_array_size; i++) {
+			if ((id = symbol_lookup(&previous->symbols, previous->parent_array[i]->ticker)) != NO_SYMBOL)
+				previous_of[id] = i;
+		}
+	}
+
+	for (i = 0; i < universe->parent_array_size; i++) {
+		stock = universe->parent_array[i];
+		id = (previous != NULL ? symbol_lookup(&previous->symbols, stock->ticker) : NO_SYMBOL);
+
+		if (id == NO_SYMBOL || previous_of[id] == NO_SYMBOL || !carry_scores(universe, i, previous, previous->parent_array[previous_of[id]]))
+			changed[changed_size++] = stock;
+	}
+
+	screen_volume_oi_baspread(changed, changed_size, &universe->prices, &universe->options);
+	calc_basic_data(changed, changed_size, &universe->prices, &universe->options, 0, 0);
+
+	free(previous_of);
+	free(changed);
+
+	return changed_size;
+}
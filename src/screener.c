@@ -6,28 +6,73 @@
 #include <string.h>
 #include <unistd.h>
 #include <sqlite3.h>
+#include <sys/wait.h>
 #include <sys/types.h>
 
 #include "../include/screener.h"
 #include "../include/general_stocks.h"
 #include "../include/options.h"
+#include "../include/option_table.h"
+#include "../include/universe.h"
+#include "../include/top_k.h"
+#include "../include/query_index.h"
+#include "../include/report.h"
+#include "../include/batch.h"
+#include "../include/backtest.h"
+#include "../include/archive.h"
+#include "../include/server.h"
+#include "../include/stream.h"
+#include "../include/yahoo.h"
 #include "../include/safe.h"
 
-long pl_size;
-struct HistoricalPrice **price_list;
-
 int main(int argc, char *argv[])
 {
-	int fd, mode, cont, status, ta_size, saved_stdout;
-	long parent_array_size;
-	pid_t pid;
+	int fd, mode, cont, status, ta_size, stream_fd;
+	long count, parent_array_size, *rows;
+	pid_t pid = -1;
 	char **tick_array = NULL;
-	char max_price[10], min_weight[6], skip_option[10], write_to_file[10], *newname;
+	char max_price[10], min_weight[6], skip_option[10], write_to_file[100], *newname;
 	struct ParentStock **parent_array;
+	struct Universe universe;
+	struct QueryIndex index;
+	struct ReportSink terminal, file;
 
 	mode = REGULAR;
 	cont = TRUE;
 	ta_size = 0;
+	stream_fd = -1;
+
+	tick_array = parse_args(argc, argv, &mode, &ta_size);
+
+	// batch mode answers every query from one load and never prompts
+	if (mode == BATCH)
+	{
+		status = run_batch(tick_array, ta_size);
+		free_tick_array(tick_array, ta_size);
+
+		return (status ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// daemon mode keeps the scored universe loaded and answers queries over a socket until stopped
+	if (mode == DAEMON)
+	{
+		status = server_run(ta_size ? tick_array[0] : SERVER_SOCKET);
+		free_tick_array(tick_array, ta_size);
+
+		return (status ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// backtest mode replays the screen over archived days and never prompts
+	if (mode == BACKTEST)
+	{
+		status = run_backtest(tick_array, ta_size);
+		free_tick_array(tick_array, ta_size);
+
+		return (status ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// the -o and -a ticker lists are not acted on yet, they screen everything like a regular run
+	mode = REGULAR;
 
 	printf("Fetch new data? ");
 	fgets(skip_option, 10, stdin);
@@ -36,8 +81,18 @@ int main(int argc, char *argv[])
 	{
 		mode = REGULAR;
 	}
+	else if (getenv(YAHOO_RAW_ENV) == NULL || *getenv(YAHOO_RAW_ENV) == '\0')
+	{
+		// the collector streams every ticker as it is parsed, and they are scored while it carries on
+		if ((pid = stream_collector(&stream_fd)) < 0)
+		{
+			printf("Warning: Unable to gather data\n");
+			exit(EXIT_FAILURE);
+		}
+	}
 	else
 	{
+		// raw responses are only readable once the collector has saved all of them
 		// if child, exec python program
 		if ((pid = fork()) == 0)
 		{
@@ -59,16 +114,40 @@ int main(int argc, char *argv[])
 
 	if (mode == REGULAR)
 	{
-		printf("Gathering historical stock prices from database...\n");
-		// collects all historical data and stores in structs
-		parent_array = gather_tickers(&parent_array_size);
+		universe_init(&universe);
+
+		if (stream_fd >= 0)
+		{
+			// every ticker is screened and scored as it arrives
+			status = gather_stream(&universe, stream_fd);
+			close(stream_fd);
+
+			if (!status)
+			{
+				waitpid(pid, &status, 0);
+				printf("Warning: Unable to gather data\n");
+				exit(EXIT_FAILURE);
+			}
 
-		// collects all data from database and stores in structs
-		gather_options(parent_array, parent_array_size);
-		// screens for volume/oi requirements, bid x ask spread
-		screen_volume_oi_baspread(parent_array, parent_array_size);
-		// calculates weights, etc.
-		calc_basic_data(parent_array, parent_array_size, atof(max_price), atof(min_weight));
+			parent_array = universe.parent_array;
+			parent_array_size = universe.parent_array_size;
+		}
+		else
+		{
+			printf("Gathering historical stock prices from database...\n");
+			// collects all historical and options data, joined by ticker, and stores it in the price and option tables
+			universe_load(&universe);
+			parent_array = universe.parent_array;
+			parent_array_size = universe.parent_array_size;
+
+			// screens for volume/oi requirements, bid x ask spread
+			screen_volume_oi_baspread(parent_array, parent_array_size, &universe.prices, &universe.options);
+			// calculates weights, etc.
+			calc_basic_data(parent_array, parent_array_size, &universe.prices, &universe.options, atof(max_price), atof(min_weight));
+		}
+		// total weights are fixed from here on, so every query below is answered from one sorted index
+		query_index_build(&index, parent_array, parent_array_size, &universe.options, &universe.arena);
+		chain_index_build(&universe.chains, parent_array, parent_array_size, &universe.options, &universe.arena);
 
 		// should probably break it up such that you gather all the data and then have one function called calc_weights that will
 		// be called so that you can easily adjust how things are weighted rather than having to go through the code and trying to
@@ -78,13 +157,14 @@ int main(int argc, char *argv[])
 		// just calculates data from those data points and determines the weights
 
 		// printing largest volumes of the day
-		// print_large_volumes(parent_array, parent_array_size);
+		// print_large_volumes(parent_array, parent_array_size, &universe.options, STDOUT_FILENO);
 
 		// printing all data
+		report_open(&terminal, STDOUT_FILENO, REPORT_TABLE);
+
 		while (TRUE)
 		{
-			fd = STDOUT_FILENO;
-			find_averages(parent_array, parent_array_size);
+			find_averages(&index);
 
 			printf("\nMaximum option price: ");
 			fgets(max_price, 10, stdin);
@@ -96,29 +176,52 @@ int main(int argc, char *argv[])
 			if (strstr(min_weight, "q") || strstr(min_weight, "Q"))
 				break;
 
-			print_data(parent_array, parent_array_size, atof(max_price), atof(min_weight), STDOUT_FILENO);
+			count = query_index_find(&index, atof(max_price), atof(min_weight), &rows);
+			print_data(parent_array, &universe.options, rows, count, &terminal, 1);
 
 			printf("Write to text file (Y filename)? ");
 			fgets(write_to_file, 100, stdin);
 			system("clear");
 			if (strstr(write_to_file, "q") || strstr(write_to_file, "Q"))
+			{
+				free(rows);
 				break;
+			}
 
-			// if they would like to write the data to a file
-			if (strstr(write_to_file, "y") || strstr(write_to_file, "Y"))
+			// if they would like to write the data to a file, the extension picks the format
+			if ((strstr(write_to_file, "y") || strstr(write_to_file, "Y")) && (newname = strstr(write_to_file, " ")) != NULL)
 			{
-				newname = strstr(write_to_file, " ") + 1;
-				fd = open(newname, O_CREAT | O_TRUNC | O_WRONLY, 0666);
-
-				saved_stdout = dup(STDOUT_FILENO);
-				dup2(fd, STDOUT_FILENO);
+				newname++;
+				newname[strcspn(newname, "\n")] = '\0';
 
-				print_data(parent_array, parent_array_size, atof(max_price), atof(min_weight), fd);
-				dup2(saved_stdout, STDOUT_FILENO);
+				if ((fd = open(newname, O_CREAT | O_TRUNC | O_WRONLY, 0666)) < 0)
+				{
+					perror(newname);
+				}
+				else
+				{
+					report_open(&file, fd, report_format(newname));
+					print_data(parent_array, &universe.options, rows, count, &file, 1);
+					report_close(&file);
+					close(fd);
+				}
 			}
+
+			free(rows);
 		}
 
-		free_parent_array(parent_array, parent_array_size);
+		report_close(&terminal);
+
+		// everything loaded for the run goes in one call
+		universe_free(&universe);
+	}
+
+	// the collector may still be writing the databases after its last ticker was streamed
+	if (stream_fd >= 0)
+	{
+		waitpid(pid, &status, 0);
+		if (status)
+			printf("Warning: Unable to save collected data\n");
 	}
 
 	free_tick_array(tick_array, ta_size);
@@ -128,6 +231,8 @@ int main(int argc, char *argv[])
 
 /* 
  * Parses argv, decides which mode to use, creates list containing personalized stocks, if necessary.
+ * In batch mode the list holds the query specs and spec files instead, in daemon mode the socket path,
+ * and in backtest mode the first and last day followed by the specs.
  */
 char **parse_args(int argc, char *argv[], int *mode, int *ta_size)
 {
@@ -152,12 +257,33 @@ char **parse_args(int argc, char *argv[], int *mode, int *ta_size)
 			{
 				*mode = APPEND_STOCKS;
 			}
+			// fall-through
+		// if they want to run query specs without prompting
+		case 'b':
+			if (argv[1][1] == 'b')
+			{
+				*mode = BATCH;
+			}
+			// fall-through
+		// if they want to serve queries over a socket
+		case 'd':
+			if (argv[1][1] == 'd')
+			{
+				*mode = DAEMON;
+			}
+			// fall-through
+		// if they want to replay the screen over archived days
+		case 't':
+			if (argv[1][1] == 't')
+			{
+				*mode = BACKTEST;
+			}
 
-			// collect all desired tickers
+			// collect all desired tickers, or specs
 			for (; i < argc; i++)
 			{
 				tick_array = safe_realloc(tick_array, ++(*ta_size) * sizeof(char *));
-				tick_array[*ta_size - 1] = safe_malloc(sizeof(char));
+				tick_array[*ta_size - 1] = safe_malloc(strlen(argv[i]) + 1);
 
 				strcpy(tick_array[*ta_size - 1], argv[i]);
 			}
@@ -166,237 +292,162 @@ char **parse_args(int argc, char *argv[], int *mode, int *ta_size)
 		// if there is a usage error
 		default:
 			fprintf(stderr, "usage: ./screener [ -oa ] [ tickers ]\n");
+			fprintf(stderr, "       ./screener -b [ specs | spec files | - ]\n");
+			fprintf(stderr, "       ./screener -d [ socket ]\n");
+			fprintf(stderr, "       ./screener -t from to [ specs | spec files | - ]\n");
 			exit(EXIT_FAILURE);
 		}
 	}
 
+	free(tick_array);
+
 	*mode = REGULAR;
 	return NULL;
 }
 
-void print_data(struct ParentStock **parent_array, int parent_array_size, float max_option_price, float min_weight, int fd)
+/*
+ * Loads the universe once and runs every query spec named by spec_args against it, see batch.h for
+ * the spec format. Returns TRUE if every report was written.
+ */
+int run_batch(char **spec_args, int spec_count)
 {
-	int printed, outter_i, inner_i;
-	float weight;
-	time_t t = time(NULL);
-	struct tm tm = *localtime(&t);
+	int written;
+	long count;
+	struct Universe universe;
+	struct QueryIndex index;
+	struct QuerySpec *specs;
 
-	dprintf(fd, "\nDate Generated: %d-%d-%d\n", tm.tm_mon + 1, tm.tm_mday, tm.tm_year + 1900);
-	dprintf(fd, "\n\t%s\t%s\t%s\t\t%4s\t  %s\t     %s\t    %s\n", "TYPE", "STOCK PRICE", "STRIKE", "DTE", "   BID", "ASK", "WEIGHT");
-	dprintf(fd, "\t--------------------------------------------------------------------------------------------\n");
+	// specs are all read before anything is loaded, so a typo costs nothing
+	if ((count = query_specs_collect(spec_args, spec_count, &specs)) < 0)
+		return FALSE;
 
-	for (outter_i = 0; outter_i < parent_array_size; outter_i++)
+	if (count == 0)
 	{
-		printed = FALSE;
+		fprintf(stderr, "Warning: No queries to run\n");
+		free(specs);
+		return TRUE;
+	}
 
-		for (inner_i = 0; inner_i < parent_array[outter_i]->calls_size; inner_i++)
-		{
-			if (parent_array[outter_i]->calls[inner_i] != NULL)
-			{
-				weight = parent_array[outter_i]->calls[inner_i]->weight;
-				weight += parent_array[outter_i]->calls[inner_i]->parent->weight;
-				weight += parent_array[outter_i]->calls_weight;
+	universe_init(&universe);
+	universe_load(&universe);
 
-				if (weight > min_weight && parent_array[outter_i]->calls[inner_i]->bid < max_option_price)
-				{
-					if (printed == FALSE)
-						dprintf(fd, "\n%s", parent_array[outter_i]->ticker);
+	screen_volume_oi_baspread(universe.parent_array, universe.parent_array_size, &universe.prices, &universe.options);
+	calc_basic_data(universe.parent_array, universe.parent_array_size, &universe.prices, &universe.options, 0, 0);
+	query_index_build(&index, universe.parent_array, universe.parent_array_size, &universe.options, &universe.arena);
+	chain_index_build(&universe.chains, universe.parent_array, universe.parent_array_size, &universe.options, &universe.arena);
 
-					printed = TRUE;
-					dprintf(fd, "\tCall\t%7f\t%f\t%4d\t%4f\t%4f\t%f\n", parent_array[outter_i]->curr_price,
-							parent_array[outter_i]->calls[inner_i]->strike, parent_array[outter_i]->calls[inner_i]->days_til_expiration,
-							parent_array[outter_i]->calls[inner_i]->bid, parent_array[outter_i]->calls[inner_i]->ask, weight);
-				}
-			}
-		}
+	written = batch_run(&universe, &index, specs, count);
 
-		for (inner_i = 0; inner_i < parent_array[outter_i]->puts_size; inner_i++)
-		{
-			if (parent_array[outter_i]->puts[inner_i] != NULL)
-			{
-				weight = parent_array[outter_i]->puts[inner_i]->weight;
-				weight += parent_array[outter_i]->puts[inner_i]->parent->weight;
-				weight += parent_array[outter_i]->puts_weight;
-
-				if (weight > min_weight && parent_array[outter_i]->puts[inner_i]->bid < max_option_price)
-				{
-					if (printed == FALSE)
-						dprintf(fd, "\n%s", parent_array[outter_i]->ticker);
+	universe_free(&universe);
+	free(specs);
 
-					printed = TRUE;
-					dprintf(fd, "\tPut\t%7f\t%f\t%4d\t%4f\t%4f\t%f\n", parent_array[outter_i]->curr_price,
-							parent_array[outter_i]->puts[inner_i]->strike, parent_array[outter_i]->puts[inner_i]->days_til_expiration,
-							parent_array[outter_i]->puts[inner_i]->bid, parent_array[outter_i]->puts[inner_i]->ask, weight);
-				}
-			}
-		}
-	}
-
-	return;
+	return written;
 }
 
-/* frees all mallocs made in main, or functions called by main */
-void free_tick_array(char **tick_array, int ta_size)
+/*
+ * Replays the screen on every day archived from the first argument to the second, YYYYMMDD, and
+ * follows the picks of every query spec after them, see backtest.h. Without specs every contract is
+ * a candidate. Returns TRUE if every trade list was written.
+ */
+int run_backtest(char **args, int arg_count)
 {
-	int i;
-
-	for (i = 0; i < ta_size; i++)
-		free(tick_array[i]);
+	int from, to, status;
+	long count;
+	struct QuerySpec *specs;
 
-	return;
-}
+	if (arg_count < 2 || (from = atoi(args[0])) <= 0 || (to = atoi(args[1])) < from)
+	{
+		fprintf(stderr, "usage: ./screener -t from to [ specs | spec files | - ]\n");
+		return FALSE;
+	}
 
-void free_parent_array(struct ParentStock **parent_array, int parent_array_size)
-{
-	int outter_i, inner_i;
+	if ((count = query_specs_collect(args + 2, arg_count - 2, &specs)) < 0)
+		return FALSE;
 
-	for (outter_i = 0; outter_i < parent_array_size; outter_i++)
+	if (count == 0)
 	{
-		for (inner_i = 0; inner_i < parent_array[outter_i]->calls_size; inner_i++)
-		{
-			if (parent_array[outter_i]->calls[inner_i] != NULL)
-				free(parent_array[outter_i]->calls[inner_i]);
-		}
-
-		for (inner_i = 0; inner_i < parent_array[outter_i]->puts_size; inner_i++)
-		{
-			if (parent_array[outter_i]->puts[inner_i] != NULL)
-				free(parent_array[outter_i]->puts[inner_i]);
-		}
+		specs = safe_malloc(sizeof(struct QuerySpec));
+		query_spec_parse("", &specs[0]);
+		count = 1;
+	}
 
-		free(parent_array[outter_i]);
+	if (archive_directory() == NULL)
+	{
+		fprintf(stderr, "Warning: %s is empty, there is no archive to replay\n", ARCHIVE_ENV);
+		free(specs);
+		return FALSE;
 	}
 
-	return;
+	status = backtest_run(archive_directory(), from, to, specs, count);
+	free(specs);
+
+	return status;
 }
 
-void print_large_volumes(struct ParentStock **parent_array, int parent_array_size)
+/* Writes the rows of one query to every sink in a single pass, each sink in its own format */
+void print_data(struct ParentStock **parent_array, struct OptionTable *options, long *rows, long count, struct ReportSink *sinks, int sink_count)
 {
-	int count, min_vol, outter_i, inner_i, min_vol_index;
-	struct option *largest_volumes[MIN_VOL_LENGTH];
+	int outter_i;
+	long inner_i;
 
-	count = 0;
-	min_vol = 0;
-	min_vol_index = 0;
+	for (outter_i = 0; outter_i < sink_count; outter_i++)
+		report_begin(&sinks[outter_i]);
 
-	for (outter_i = 0; outter_i < parent_array_size; outter_i++)
+	for (inner_i = 0; inner_i < count; inner_i++)
 	{
-		for (inner_i = 0; inner_i < parent_array[outter_i]->calls_size; inner_i++)
-		{
-			if (parent_array[outter_i]->calls[inner_i] != NULL)
-			{
-				count++;
-
-				if (count < MIN_VOL_LENGTH)
-				{
-					copy_option(largest_volumes[count], parent_array[outter_i]->calls[inner_i]);
-					if (parent_array[outter_i]->calls[inner_i]->volume > min_vol)
-					{
-						min_vol = parent_array[outter_i]->calls[inner_i]->volume;
-						min_vol_index = count;
-					}
-				}
-				else if (parent_array[outter_i]->calls[inner_i]->volume > min_vol)
-				{
-					copy_option(largest_volumes[min_vol_index], parent_array[outter_i]->calls[inner_i]);
-					find_min_vol(largest_volumes, &min_vol, &min_vol_index);
-				}
-			}
-		}
-
-		for (inner_i = 0; inner_i < parent_array[outter_i]->puts_size; inner_i++)
-		{
-			if (parent_array[outter_i]->puts[inner_i] != NULL)
-			{
-				count++;
-
-				if (count < MIN_VOL_LENGTH)
-				{
-					copy_option(largest_volumes[count], parent_array[outter_i]->puts[inner_i]);
-					if (parent_array[outter_i]->puts[inner_i]->volume > min_vol)
-					{
-						min_vol = parent_array[outter_i]->puts[inner_i]->volume;
-						min_vol_index = count;
-					}
-				}
-				else if (parent_array[outter_i]->puts[inner_i]->volume > min_vol)
-				{
-					copy_option(largest_volumes[min_vol_index], parent_array[outter_i]->puts[inner_i]);
-					find_min_vol(largest_volumes, &min_vol, &min_vol_index);
-				}
-			}
-		}
+		for (outter_i = 0; outter_i < sink_count; outter_i++)
+			report_row(&sinks[outter_i], parent_array, options, rows[inner_i]);
 	}
 
+	for (outter_i = 0; outter_i < sink_count; outter_i++)
+		report_flush(&sinks[outter_i]);
+
 	return;
 }
 
-void find_min_vol(struct option **largest_volumes, int *min_vol, int *min_vol_index)
+/* frees all mallocs made in main, or functions called by main */
+void free_tick_array(char **tick_array, int ta_size)
 {
 	int i;
 
-	*min_vol = INT32_MAX;
+	for (i = 0; i < ta_size; i++)
+		free(tick_array[i]);
 
-	for (i = 0; i < MIN_VOL_LENGTH; i++)
-	{
-		if (largest_volumes[i]->volume < *min_vol)
-		{
-			*min_vol = largest_volumes[i]->volume;
-			*min_vol_index = i;
-		}
-	}
+	free(tick_array);
 
 	return;
 }
 
-/* idea: have it print the average weight, lows, highs, and one std */
-void find_averages(struct ParentStock **parent_array, int parent_array_size)
+/* Prints the MIN_VOL_LENGTH open contracts with the largest volume of the day */
+void print_large_volumes(struct ParentStock **parent_array, int parent_array_size, struct OptionTable *options, int fd)
 {
-	int count, outter_i, inner_i;
-	float weights, low, high;
-
-	weights = 0;
-	count = 0;
-	high = 0;
-	low = INT32_MAX;
+	int i;
+	long row;
+	struct TopK top;
 
-	for (outter_i = 0; outter_i < parent_array_size; outter_i++)
-	{
-		for (inner_i = 0; inner_i < parent_array[outter_i]->calls_size; inner_i++)
-		{
-			if (parent_array[outter_i]->calls[inner_i] != NULL)
-			{
-				if (parent_array[outter_i]->calls[inner_i]->weight > 5000 || parent_array[outter_i]->calls[inner_i]->weight < -5000 || parent_array[outter_i]->calls[inner_i]->weight)
-					continue;
+	top_k_init(&top, MIN_VOL_LENGTH);
+	top_k_contracts(parent_array, parent_array_size, options, rank_volume, &top);
 
-				count++;
-				weights += parent_array[outter_i]->calls[inner_i]->weight;
+	dprintf(fd, "\nLARGEST VOLUMES\n");
+	dprintf(fd, "\n\t%s\t%s\t\t%4s\t%s\t\t%s\n", "TYPE", "STRIKE", "DTE", "VOLUME", "OPEN INTEREST");
+	dprintf(fd, "\t--------------------------------------------------------------------\n");
 
-				if (parent_array[outter_i]->calls[inner_i]->weight > high)
-					high = parent_array[outter_i]->calls[inner_i]->weight;
-				if (parent_array[outter_i]->calls[inner_i]->weight < low)
-					low = parent_array[outter_i]->calls[inner_i]->weight;
-			}
-		}
+	for (i = 0; i < top.size; i++)
+	{
+		row = top.heap[i].row;
 
-		for (inner_i = 0; inner_i < parent_array[outter_i]->puts_size; inner_i++)
-		{
-			if (parent_array[outter_i]->puts[inner_i] != NULL)
-			{
-				if (parent_array[outter_i]->puts[inner_i]->weight > 5000 || parent_array[outter_i]->puts[inner_i]->weight < -5000)
-					continue;
+		dprintf(fd, "%s\t%s\t%f\t%4d\t%ld\t\t%ld\n", parent_array[top.heap[i].stock]->ticker, (options->type[row] ? "Call" : "Put"),
+				options->strike[row], options->days_til_expiration[row], options->volume[row], options->open_interest[row]);
+	}
 
-				count++;
-				weights += parent_array[outter_i]->puts[inner_i]->weight;
+	top_k_free(&top);
 
-				if (parent_array[outter_i]->puts[inner_i]->weight > high)
-					high = parent_array[outter_i]->puts[inner_i]->weight;
-				if (parent_array[outter_i]->puts[inner_i]->weight < low)
-					low = parent_array[outter_i]->puts[inner_i]->weight;
-			}
-		}
-	}
+	return;
+}
 
+/* idea: have it print the average weight, lows, highs, and one std */
+void find_averages(struct QueryIndex *index)
+{
 	printf("WEIGHT INFORMATION\n");
-	printf("Mean Weight: %f\tLow: %f\tHigh: %f\n", (weights / count), low, high);
+	printf("Mean Weight: %f\tLow: %f\tHigh: %f\n", (index->averages_sum / index->averages_count), index->averages_low, index->averages_high);
 }
@@ -0,0 +1,377 @@
+#include <errno.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "../include/screener.h"
+#include "../include/server.h"
+#include "../include/rescore.h"
+#include "../include/batch.h"
+#include "../include/report.h"
+#include "../include/strategy.h"
+#include "../include/safe.h"
+
+#define SERVER_MESSAGE_LENGTH 256
+
+/* One accepted connection, handed to the thread that serves it */
+struct Client {
+   struct Server *server;
+   int fd;
+};
+
+/* The socket to remove when the server is stopped */
+static const char *socket_path;
+
+/*
+ * Loads the databases as they are now and scores them. Stocks that have not changed since previous,
+ * the generation being replaced, keep its scores and only the rest are scored again.
+ */
+static struct Generation *generation_load(long number, struct Generation *previous) {
+	struct Generation *generation = safe_malloc(sizeof(struct Generation));
+
+	generation->have_sources = snapshot_sources(&generation->prices_db, &generation->options_db);
+	generation->number = number;
+	generation->references = 1;
+
+	universe_init(&generation->universe);
+	universe_load(&generation->universe);
+
+	generation->rescored = rescore_universe(&generation->universe, (previous != NULL ? &previous->universe : NULL));
+	query_index_build(&generation->index, generation->universe.parent_array, generation->universe.parent_array_size, &generation->universe.options, &generation->universe.arena);
+	chain_index_build(&generation->universe.chains, generation->universe.parent_array, generation->universe.parent_array_size, &generation->universe.options, &generation->universe.arena);
+
+	return generation;
+}
+
+/* Takes a reference to the generation being served, for as long as a query needs it */
+static struct Generation *acquire(struct Server *server) {
+	struct Generation *generation;
+
+	pthread_mutex_lock(&server->lock);
+	generation = server->current;
+	generation->references++;
+	pthread_mutex_unlock(&server->lock);
+
+	return generation;
+}
+
+/* Drops a reference, freeing the generation if it was the last one */
+static void release(struct Server *server, struct Generation *generation) {
+	long references;
+
+	pthread_mutex_lock(&server->lock);
+	references = --generation->references;
+	pthread_mutex_unlock(&server->lock);
+
+	if (references == 0) {
+		universe_free(&generation->universe);
+		free(generation);
+	}
+}
+
+/*
+ * Loads a new generation and swaps it in. Queries keep running against the old one the whole time,
+ * the lock is only held for the swap itself.
+ */
+static void server_reload(struct Server *server) {
+	struct Generation *generation, *old;
+
+	pthread_mutex_lock(&server->reload_lock);
+
+	generation = generation_load(server->current->number + 1, server->current);
+
+	pthread_mutex_lock(&server->lock);
+	old = server->current;
+	server->current = generation;
+	pthread_mutex_unlock(&server->lock);
+
+	release(server, old);
+
+	printf("Serving generation %ld, %ld stocks, %ld rescored\n", generation->number, generation->universe.parent_array_size, generation->rescored);
+	fflush(stdout);
+
+	pthread_mutex_unlock(&server->reload_lock);
+}
+
+/*
+ * Polls the databases and reloads when they change. Databases still being written are left until
+ * they have looked the same for a whole poll, so a reload never picks up half a collection run.
+ */
+static void *watch(void *arg) {
+	int changed, pending;
+	struct Server *server = arg;
+	struct SnapshotSource prices_db, options_db, seen_prices, seen_options;
+
+	pending = FALSE;
+
+	while (TRUE) {
+		sleep(SERVER_POLL_SECONDS);
+
+		if (!snapshot_sources(&prices_db, &options_db))
+			continue;
+
+		pthread_mutex_lock(&server->lock);
+		changed = !server->current->have_sources || !snapshot_same_source(&prices_db, &server->current->prices_db) || !snapshot_same_source(&options_db, &server->current->options_db);
+		pthread_mutex_unlock(&server->lock);
+
+		if (changed && pending && snapshot_same_source(&prices_db, &seen_prices) && snapshot_same_source(&options_db, &seen_options)) {
+			server_reload(server);
+			changed = FALSE;
+		}
+
+		pending = changed;
+		seen_prices = prices_db;
+		seen_options = options_db;
+	}
+
+	return NULL;
+}
+
+/* Sends all of data, FALSE once the client has gone */
+static int send_all(int fd, const void *data, size_t size) {
+	ssize_t sent;
+
+	while (size > 0) {
+		if ((sent = send(fd, data, size, MSG_NOSIGNAL)) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return FALSE;
+		}
+
+		data = (const char *)data + sent;
+		size -= sent;
+	}
+
+	return TRUE;
+}
+
+/* Sends one framed response, the status line and then the body */
+static int respond(int fd, const char *status, const char *body, size_t size) {
+	int length;
+	char header[32];
+
+	length = snprintf(header, sizeof(header), "%s %zu\n", status, size);
+
+	return send_all(fd, header, length) && send_all(fd, body, size);
+}
+
+static int respond_message(int fd, const char *status, const char *message) {
+	return respond(fd, status, message, strlen(message));
+}
+
+static int respond_stats(struct Server *server, int fd) {
+	int length;
+	char body[SERVER_MESSAGE_LENGTH];
+	struct Generation *generation;
+
+	generation = acquire(server);
+	length = snprintf(body, sizeof(body), "generation=%ld stocks=%ld rescored=%ld contracts=%ld indexed=%ld mean_weight=%f low_weight=%f high_weight=%f\n",
+	                  generation->number, generation->universe.parent_array_size, generation->rescored, generation->universe.options.size, generation->index.size,
+	                  generation->index.averages_sum / generation->index.averages_count, generation->index.averages_low, generation->index.averages_high);
+	release(server, generation);
+
+	return respond(fd, "OK", body, length);
+}
+
+/* Answers one query spec from the current generation, the report is built in sink and sent whole */
+static int answer_query(struct Server *server, int fd, const char *request, struct ReportSink *sink) {
+	int parsed;
+	long count, *rows;
+	struct QuerySpec spec;
+	struct Strategy *strategies;
+	struct Generation *generation;
+
+	if ((parsed = query_spec_parse(request, &spec)) < 0)
+		return respond_message(fd, "ERR", "unable to read query\n");
+	if (!parsed)
+		return respond_message(fd, "ERR", "empty request\n");
+	if (strcmp(spec.output, QUERY_STDOUT) != 0)
+		return respond_message(fd, "ERR", "out is not allowed, reports come back over the socket\n");
+
+	generation = acquire(server);
+
+	report_clear(sink, (spec.format >= 0 ? spec.format : REPORT_TABLE));
+
+	if (spec.strategy != STRATEGY_NONE) {
+		count = strategy_search(&generation->universe, &spec, &strategies);
+		print_strategies(&generation->universe, strategies, count, sink);
+		free(strategies);
+	}
+	else {
+		count = query_spec_rows(&generation->index, &generation->universe, &spec, &rows);
+		print_data(generation->universe.parent_array, &generation->universe.options, rows, count, sink, 1);
+		free(rows);
+	}
+
+	release(server, generation);
+
+	return respond(fd, "OK", sink->buffer, sink->used);
+}
+
+/* Serves one connection until the client closes it */
+static void *serve(void *arg) {
+	int c, fd, connected;
+	char request[QUERY_SPEC_LENGTH];
+	FILE *in;
+	struct Client *client = arg;
+	struct Server *server = client->server;
+	struct ReportSink sink;
+
+	fd = client->fd;
+	free(client);
+
+	if ((in = fdopen(fd, "r")) == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	// one buffer per connection, grown to its largest report and reused for every request after
+	report_open_memory(&sink, REPORT_TABLE);
+	connected = TRUE;
+
+	while (connected && fgets(request, QUERY_SPEC_LENGTH, in) != NULL) {
+		if (strchr(request, '\n') == NULL && !feof(in)) {
+			while ((c = fgetc(in)) != EOF && c != '\n')
+				;
+
+			connected = respond_message(fd, "ERR", "request too long\n");
+			continue;
+		}
+
+		request[strcspn(request, "\r\n")] = '\0';
+
+		if (strcmp(request, "PING") == 0)
+			connected = respond(fd, "OK", "", 0);
+		else if (strcmp(request, "STATS") == 0)
+			connected = respond_stats(server, fd);
+		else if (strcmp(request, "RELOAD") == 0) {
+			server_reload(server);
+			connected = respond_stats(server, fd);
+		}
+		else
+			connected = answer_query(server, fd, request, &sink);
+	}
+
+	report_close(&sink);
+	fclose(in);
+
+	return NULL;
+}
+
+/* Removes the socket on the way out, so the next server finds the path free */
+static void stop(int signal_number) {
+	unlink(socket_path);
+	_exit(EXIT_SUCCESS);
+}
+
+/* Binds the listening socket. A socket left behind by a server that is gone is replaced, a live one is not */
+static int listen_on(const char *path) {
+	int fd;
+	struct stat info;
+	struct sockaddr_un address;
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(struct sockaddr_un));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	if (connect(fd, (struct sockaddr *)&address, sizeof(struct sockaddr_un)) == 0) {
+		fprintf(stderr, "A server is already listening on %s\n", path);
+		close(fd);
+		return -1;
+	}
+
+	close(fd);
+
+	if (lstat(path, &info) == 0 && S_ISSOCK(info.st_mode))
+		unlink(path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	if (bind(fd, (struct sockaddr *)&address, sizeof(struct sockaddr_un)) < 0 || listen(fd, SERVER_BACKLOG) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Loads and scores the universe once, then answers queries on path until stopped, one thread per
+ * connection. Only returns, with FALSE, if the socket could not be set up.
+ */
+int server_run(const char *path) {
+	int fd;
+	pthread_t thread;
+	struct Client *client;
+	struct Server server;
+
+	server.path = path;
+	pthread_mutex_init(&server.lock, NULL);
+	pthread_mutex_init(&server.reload_lock, NULL);
+
+	// bound first, so a second server gives up before loading anything, and clients queue during the load
+	if ((server.listen_fd = listen_on(path)) < 0)
+		return FALSE;
+
+	socket_path = path;
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	printf("Gathering historical stock prices from database...\n");
+	server.current = generation_load(1, NULL);
+
+	printf("Serving generation 1, %ld stocks, on %s\n", server.current->universe.parent_array_size, path);
+	fflush(stdout);
+
+	if (pthread_create(&thread, NULL, watch, &server) != 0)
+		fprintf(stderr, "Warning: Unable to watch the databases, only RELOAD will pick up new data\n");
+	else
+		pthread_detach(thread);
+
+	while (TRUE) {
+		if ((fd = accept(server.listen_fd, NULL, NULL)) < 0) {
+			if (errno != EINTR && errno != ECONNABORTED)
+				perror("accept");
+
+			continue;
+		}
+
+		client = safe_malloc(sizeof(struct Client));
+		client->server = &server;
+		client->fd = fd;
+
+		if (pthread_create(&thread, NULL, serve, client) != 0) {
+			respond_message(fd, "ERR", "server busy\n");
+			close(fd);
+			free(client);
+			continue;
+		}
+
+		pthread_detach(thread);
+	}
+
+	return TRUE;
+}
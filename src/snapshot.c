@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/general_stocks.h"
+#include "../include/universe.h"
+#include "../include/snapshot.h"
+#include "../include/arena.h"
+
+#define SNAPSHOT_ALIGN(offset) (((offset) + SNAPSHOT_ALIGNMENT - 1) & ~((uint64_t)SNAPSHOT_ALIGNMENT - 1))
+#define SNAPSHOT_STRINGIFY(type, name) #type " " #name ";"
+
+/* Hash of everything that decides the file layout, so a rebuilt binary never maps an incompatible snapshot */
+static uint32_t snapshot_layout(void) {
+	size_t i;
+	uint32_t hash = 2166136261u;
+	const char *columns = PRICE_TABLE_COLUMNS(SNAPSHOT_STRINGIFY) OPTION_TABLE_COLUMNS(SNAPSHOT_STRINGIFY);
+	uint64_t sizes[] = { sizeof(struct SnapshotHeader), sizeof(struct ParentStock), sizeof(long), TICK_SIZE };
+
+	for (i = 0; columns[i] != '\0'; i++) {
+		hash ^= (unsigned char)columns[i];
+		hash *= 16777619u;
+	}
+
+	for (i = 0; i < sizeof(sizes); i++) {
+		hash ^= ((unsigned char *)sizes)[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* A file's modification time in nanoseconds */
+static int64_t modified(struct stat *st) {
+	return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static int fingerprint(const char *filename, struct SnapshotSource *source) {
+	char wal[PATH_MAX];
+	struct stat st;
+
+	if (stat(filename, &st) < 0)
+		return FALSE;
+
+	source->inode = st.st_ino;
+	source->size = st.st_size;
+	source->mtime = modified(&st);
+
+	// in WAL mode committed rows can sit in the -wal file until a checkpoint, leaving the database itself untouched
+	snprintf(wal, sizeof(wal), "%s-wal", filename);
+
+	if (stat(wal, &st) < 0) {
+		source->wal_size = 0;
+		source->wal_mtime = 0;
+	}
+	else {
+		source->wal_size = st.st_size;
+		source->wal_mtime = modified(&st);
+	}
+
+	return TRUE;
+}
+
+/* Fingerprints both databases. Take these before loading, so a database that changes mid-load invalidates the snapshot */
+int snapshot_sources(struct SnapshotSource *prices_db, struct SnapshotSource *options_db) {
+	return fingerprint(PRICES_DB, prices_db) && fingerprint(OPTIONS_DB, options_db);
+}
+
+/* TRUE if two fingerprints are of the same, unchanged, database */
+int snapshot_same_source(struct SnapshotSource *a, struct SnapshotSource *b) {
+	return a->inode == b->inode && a->size == b->size && a->mtime == b->mtime && a->wal_size == b->wal_size && a->wal_mtime == b->wal_mtime;
+}
+
+/* TRUE if size bytes at offset lie inside the file */
+static int in_file(struct SnapshotHeader *header, uint64_t offset, uint64_t size) {
+	return offset <= header->file_size && size <= header->file_size - offset;
+}
+
+static int valid_header(struct SnapshotHeader *header, uint64_t file_size, struct SnapshotSource *prices_db, struct SnapshotSource *options_db) {
+	int column;
+
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != SNAPSHOT_VERSION)
+		return FALSE;
+	if (header->layout != snapshot_layout() || header->file_size != file_size)
+		return FALSE;
+	if (!snapshot_same_source(&header->prices_db, prices_db) || !snapshot_same_source(&header->options_db, options_db))
+		return FALSE;
+	if (header->symbol_count < 0 || header->parent_count < 0 || header->price_rows < 0 || header->option_rows < 0)
+		return FALSE;
+	if (header->slots_capacity <= header->symbol_count || (header->slots_capacity & (header->slots_capacity - 1)))
+		return FALSE;
+
+	if (!in_file(header, header->names_offset, header->symbol_count * TICK_SIZE) ||
+		 !in_file(header, header->slots_offset, header->slots_capacity * sizeof(int)) ||
+		 !in_file(header, header->parents_offset, header->parent_count * sizeof(struct ParentStock)))
+		return FALSE;
+
+	column = 0;
+#define SNAPSHOT_CHECK_PRICES(type, name)                                                    \
+	if (!in_file(header, header->price_columns[column++], header->price_rows * sizeof(type))) \
+		return FALSE;
+	PRICE_TABLE_COLUMNS(SNAPSHOT_CHECK_PRICES)
+#undef SNAPSHOT_CHECK_PRICES
+
+	column = 0;
+#define SNAPSHOT_CHECK_OPTIONS(type, name)                                                     \
+	if (!in_file(header, header->option_columns[column++], header->option_rows * sizeof(type))) \
+		return FALSE;
+	OPTION_TABLE_COLUMNS(SNAPSHOT_CHECK_OPTIONS)
+#undef SNAPSHOT_CHECK_OPTIONS
+
+	return TRUE;
+}
+
+/*
+ * Maps filename privately and points the universe's symbols, parents and tables straight into it,
+ * with no parsing or copying. Pages are copy-on-write, so screening only duplicates the pages it
+ * writes weights into. Returns FALSE if there is no usable snapshot for the current databases.
+ */
+int snapshot_open(struct Universe *universe, const char *filename, struct SnapshotSource *prices_db, struct SnapshotSource *options_db) {
+	int fd, column;
+	long i;
+	struct stat st;
+	unsigned char *base;
+	struct ParentStock *parents;
+	struct SnapshotHeader *header;
+
+	if ((fd = open(filename, O_RDONLY)) < 0)
+		return FALSE;
+
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(struct SnapshotHeader)) {
+		close(fd);
+		return FALSE;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (base == MAP_FAILED)
+		return FALSE;
+
+	header = (struct SnapshotHeader *)base;
+
+	if (!valid_header(header, st.st_size, prices_db, options_db)) {
+		munmap(base, st.st_size);
+		return FALSE;
+	}
+
+	universe->mapping = base;
+	universe->mapping_size = st.st_size;
+
+	universe->symbols.size = header->symbol_count;
+	universe->symbols.names_capacity = header->symbol_count;
+	universe->symbols.slots_capacity = header->slots_capacity;
+	universe->symbols.names = (char (*)[TICK_SIZE])(base + header->names_offset);
+	universe->symbols.slots = (int *)(base + header->slots_offset);
+	universe->symbols.arena = &universe->arena;
+	pthread_mutex_init(&universe->symbols.lock, NULL);
+
+	parents = (struct ParentStock *)(base + header->parents_offset);
+	universe->parent_array_size = header->parent_count;
+	universe->parent_array = arena_alloc(&universe->arena, header->parent_count * sizeof(struct ParentStock *));
+
+	for (i = 0; i < header->parent_count; i++)
+		universe->parent_array[i] = &parents[i];
+
+	price_table_init(&universe->prices, &universe->arena);
+	universe->prices.size = universe->prices.capacity = header->price_rows;
+
+	column = 0;
+#define SNAPSHOT_ATTACH_PRICES(type, name) universe->prices.name = (type *)(base + header->price_columns[column++]);
+	PRICE_TABLE_COLUMNS(SNAPSHOT_ATTACH_PRICES)
+#undef SNAPSHOT_ATTACH_PRICES
+
+	option_table_init(&universe->options, &universe->arena);
+	universe->options.size = universe->options.capacity = header->option_rows;
+
+	column = 0;
+#define SNAPSHOT_ATTACH_OPTIONS(type, name) universe->options.name = (type *)(base + header->option_columns[column++]);
+	OPTION_TABLE_COLUMNS(SNAPSHOT_ATTACH_OPTIONS)
+#undef SNAPSHOT_ATTACH_OPTIONS
+
+	return TRUE;
+}
+
+/* Pads the file with zeros up to offset, then writes size bytes of data. data may be NULL when size is 0 */
+static void write_section(FILE *file, uint64_t *position, uint64_t offset, const void *data, uint64_t size) {
+	static const char zeros[SNAPSHOT_ALIGNMENT];
+
+	fwrite(zeros, 1, offset - *position, file);
+	if (size > 0)
+		fwrite(data, 1, size, file);
+
+	*position = offset + size;
+}
+
+/*
+ * Writes a freshly loaded, not yet screened universe to filename. The file is written next to it
+ * and renamed into place, so a concurrent reader only ever sees a complete snapshot. Failing to
+ * write a snapshot only costs the next run its warm start.
+ */
+void snapshot_write(struct Universe *universe, const char *filename, struct SnapshotSource *prices_db, struct SnapshotSource *options_db) {
+	int column;
+	long i;
+	char temp[256];
+	uint64_t offset, position;
+	FILE *file;
+	struct SnapshotHeader header;
+
+	memset(&header, 0, sizeof(struct SnapshotHeader));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.layout = snapshot_layout();
+	header.prices_db = *prices_db;
+	header.options_db = *options_db;
+	header.symbol_count = universe->symbols.size;
+	header.slots_capacity = universe->symbols.slots_capacity;
+	header.parent_count = universe->parent_array_size;
+	header.price_rows = universe->prices.size;
+	header.option_rows = universe->options.size;
+
+	offset = SNAPSHOT_ALIGN(sizeof(struct SnapshotHeader));
+	header.names_offset = offset;
+	offset = SNAPSHOT_ALIGN(offset + header.symbol_count * TICK_SIZE);
+	header.slots_offset = offset;
+	offset = SNAPSHOT_ALIGN(offset + header.slots_capacity * sizeof(int));
+	header.parents_offset = offset;
+	offset = SNAPSHOT_ALIGN(offset + header.parent_count * sizeof(struct ParentStock));
+
+	column = 0;
+#define SNAPSHOT_LAYOUT_PRICES(type, name)                     \
+	header.price_columns[column++] = offset;                    \
+	offset = SNAPSHOT_ALIGN(offset + header.price_rows * sizeof(type));
+	PRICE_TABLE_COLUMNS(SNAPSHOT_LAYOUT_PRICES)
+#undef SNAPSHOT_LAYOUT_PRICES
+
+	column = 0;
+#define SNAPSHOT_LAYOUT_OPTIONS(type, name)                    \
+	header.option_columns[column++] = offset;                   \
+	offset = SNAPSHOT_ALIGN(offset + header.option_rows * sizeof(type));
+	OPTION_TABLE_COLUMNS(SNAPSHOT_LAYOUT_OPTIONS)
+#undef SNAPSHOT_LAYOUT_OPTIONS
+
+	header.file_size = offset;
+
+	snprintf(temp, sizeof(temp), "%s.tmp", filename);
+	if ((file = fopen(temp, "wb")) == NULL)
+		return;
+
+	position = 0;
+	write_section(file, &position, 0, &header, sizeof(struct SnapshotHeader));
+	write_section(file, &position, header.names_offset, universe->symbols.names, header.symbol_count * TICK_SIZE);
+	write_section(file, &position, header.slots_offset, universe->symbols.slots, header.slots_capacity * sizeof(int));
+
+	for (i = 0; i < header.parent_count; i++)
+		write_section(file, &position, (i == 0 ? header.parents_offset : position), universe->parent_array[i], sizeof(struct ParentStock));
+
+	column = 0;
+#define SNAPSHOT_WRITE_PRICES(type, name) \
+	write_section(file, &position, header.price_columns[column++], universe->prices.name, header.price_rows * sizeof(type));
+	PRICE_TABLE_COLUMNS(SNAPSHOT_WRITE_PRICES)
+#undef SNAPSHOT_WRITE_PRICES
+
+	column = 0;
+#define SNAPSHOT_WRITE_OPTIONS(type, name) \
+	write_section(file, &position, header.option_columns[column++], universe->options.name, header.option_rows * sizeof(type));
+	OPTION_TABLE_COLUMNS(SNAPSHOT_WRITE_OPTIONS)
+#undef SNAPSHOT_WRITE_OPTIONS
+
+	write_section(file, &position, header.file_size, NULL, 0);
+
+	if (ferror(file) | fclose(file)) {
+		fprintf(stderr, "Warning: Unable to write %s\n", filename);
+		unlink(temp);
+		return;
+	}
+
+	if (rename(temp, filename) < 0)
+		unlink(temp);
+}
+
+/* Unmaps the snapshot the universe was loaded from, if any */
+void snapshot_close(struct Universe *universe) {
+	if (universe->mapping == NULL)
+		return;
+
+	munmap(universe->mapping, universe->mapping_size);
+
+	universe->mapping = NULL;
+	universe->mapping_size = 0;
+}
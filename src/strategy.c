@@ -0,0 +1,550 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/strategy.h"
+#include "../include/chain_index.h"
+#include "../include/greeks.h"
+#include "../include/thread_pool.h"
+#include "../include/safe.h"
+
+#define STRATEGY_DEFAULT_TOP 50      // candidates returned for a spec without top
+#define STRATEGY_NO_RISK 0.0075f     // less than a cent at risk, float error aside, is a stale quote rather than a trade
+
+/* A credit spread waiting to be paired into a condor */
+struct CreditSpread {
+   long bought;
+   long sold;
+   float cost;
+   float edge;
+   float width;
+};
+
+/* One stock's search and the best candidates it has found, best first */
+struct StrategySearch {
+   struct Universe *universe;
+   struct QuerySpec *spec;
+   struct ParentStock *stock;
+   int stock_index;
+   int keep;
+   int count;
+   struct Strategy *best;
+   long first;                // the stock's calls_begin, where its legs start
+   float *mid;                // per leg from first, see leg_mid
+   float *value;              // per leg from first, see leg_value
+   float *reach;              // per rung from first, see search_verticals
+};
+
+/* Shared arguments for searching one stock per thread pool task */
+struct StrategyJob {
+   struct Universe *universe;
+   struct QuerySpec *spec;
+   int keep;
+   struct Strategy **best;    // per stock, best first
+   int *best_count;
+};
+
+static const char *names[] = { "single", "vertical", "calendar", "straddle", "strangle", "condor" };
+
+const char *strategy_name(enum StrategyKind kind) {
+	return names[kind];
+}
+
+/* The kind a strategy= value names, -1 if it names none */
+int strategy_parse(const char *name) {
+	int kind;
+
+	for (kind = STRATEGY_NONE; kind <= STRATEGY_CONDOR; kind++) {
+		if (strcmp(name, names[kind]) == 0)
+			return kind;
+	}
+
+	// the desk's names for the same shapes
+	if (strcmp(name, "iron_condor") == 0)
+		return STRATEGY_CONDOR;
+	if (strcmp(name, "spread") == 0)
+		return STRATEGY_VERTICAL;
+
+	return -1;
+}
+
+/* TRUE if a ranks above b: a higher score, then the earlier stock, then the earlier legs */
+static int better(const struct Strategy *a, const struct Strategy *b) {
+	int i;
+
+	if (a->score != b->score)
+		return a->score > b->score;
+	if (a->stock != b->stock)
+		return a->stock < b->stock;
+
+	for (i = 0; i < a->leg_count && i < b->leg_count; i++) {
+		if (a->legs[i].row != b->legs[i].row)
+			return a->legs[i].row < b->legs[i].row;
+	}
+
+	return a->leg_count < b->leg_count;
+}
+
+static int by_score(const void *a, const void *b) {
+	return (better(b, a) ? 1 : (better(a, b) ? -1 : 0));
+}
+
+/* A contract's midpoint, or -1 if it cannot be a leg: closed, one sided, or outside the spec's type and DTE */
+static float quote_mid(struct StrategySearch *search, long row) {
+	struct OptionTable *options = &search->universe->options;
+	struct QuerySpec *spec = search->spec;
+
+	if (!options->open[row])
+		return -1;
+	if ((spec->type == QUERY_CALLS && !options->type[row]) || (spec->type == QUERY_PUTS && options->type[row]))
+		return -1;
+	if (options->days_til_expiration[row] < spec->min_dte || options->days_til_expiration[row] > spec->max_dte)
+		return -1;
+	if (!(options->ask[row] > 0 && options->bid[row] >= 0 && options->ask[row] >= options->bid[row]))
+		return -1;
+
+	return (options->bid[row] + options->ask[row]) / 2;
+}
+
+/* What a contract is worth at the stock's realized volatility for its DTE, the buckets one_std_deviation uses */
+static float model_value(struct StrategySearch *search, long row) {
+	float sigma;
+	struct OptionTable *options = &search->universe->options;
+
+	if (options->days_til_expiration[row] <= 30)
+		sigma = search->stock->iv20;
+	else if (options->days_til_expiration[row] <= 365 / 4)
+		sigma = search->stock->iv50;
+	else
+		sigma = search->stock->iv100;
+
+	return greeks_price(options->type[row], search->stock->curr_price, options->strike[row], options->days_til_expiration[row], sigma / 100);
+}
+
+/* Works out every contract's midpoint and, for those that can be legs, model value once, before any pairing */
+static void price_legs(struct StrategySearch *search) {
+	long i, count;
+
+	search->first = search->stock->calls_begin;
+	count = search->stock->puts_end - search->first;
+	search->mid = safe_malloc((count ? count : 1) * sizeof(float));
+	search->value = safe_malloc((count ? count : 1) * sizeof(float));
+	search->reach = safe_malloc((count ? count : 1) * sizeof(float));
+
+	for (i = 0; i < count; i++) {
+		search->mid[i] = quote_mid(search, search->first + i);
+		search->value[i] = (search->mid[i] < 0 ? NAN : model_value(search, search->first + i));
+	}
+}
+
+/* A leg's midpoint, -1 if the row cannot be a leg */
+static float leg_mid(struct StrategySearch *search, long row) {
+	return (row == CHAIN_NO_ROW ? -1 : search->mid[row - search->first]);
+}
+
+/* A leg's model value. Only asked of rows leg_mid has accepted */
+static float leg_value(struct StrategySearch *search, long row) {
+	return search->value[row - search->first];
+}
+
+/* Keeps candidate if it is among the best keep so far */
+static void offer(struct StrategySearch *search, struct Strategy *candidate) {
+	int i;
+
+	if (search->count == search->keep && !better(candidate, &search->best[search->count - 1]))
+		return;
+
+	i = (search->count < search->keep ? search->count++ : search->count - 1);
+
+	for (; i > 0 && better(candidate, &search->best[i - 1]); i--)
+		search->best[i] = search->best[i - 1];
+
+	search->best[i] = *candidate;
+}
+
+/*
+ * Prices a candidate whose kind and legs are set and offers it if it is inside the spec's bounds.
+ * wing is what a spread's strikes put at risk, the wider wing for a condor. The cost is checked
+ * first, before anything else is worked out.
+ */
+static void consider(struct StrategySearch *search, struct Strategy *candidate, float wing) {
+	int i;
+	long row;
+	float low, high, mid;
+	struct OptionTable *options = &search->universe->options;
+	struct QuerySpec *spec = search->spec;
+
+	candidate->cost = 0;
+
+	for (i = 0; i < candidate->leg_count; i++)
+		candidate->cost += candidate->legs[i].quantity * leg_mid(search, candidate->legs[i].row);
+
+	if (candidate->cost > spec->max_cost)
+		return;
+
+	candidate->stock = search->stock_index;
+	candidate->edge = 0;
+	low = INFINITY;
+	high = -INFINITY;
+
+	for (i = 0; i < candidate->leg_count; i++) {
+		row = candidate->legs[i].row;
+		mid = leg_mid(search, row);
+
+		candidate->edge += candidate->legs[i].quantity * (leg_value(search, row) - mid);
+		low = fminf(low, options->strike[row]);
+		high = fmaxf(high, options->strike[row]);
+	}
+
+	candidate->width = high - low;
+
+	switch (candidate->kind) {
+	case STRATEGY_VERTICAL:
+	case STRATEGY_CONDOR:
+		candidate->max_loss = (candidate->cost > 0 ? candidate->cost : wing + candidate->cost);
+		candidate->max_gain = (candidate->cost > 0 ? wing - candidate->cost : -candidate->cost);
+		break;
+	case STRATEGY_CALENDAR:
+		candidate->max_loss = candidate->cost;
+		candidate->max_gain = NAN;
+		break;
+	default:
+		candidate->max_loss = candidate->cost;
+		candidate->max_gain = INFINITY;
+		break;
+	}
+
+	// quotes that lock in a profit, or put nothing at risk, are stale rather than a trade
+	if (!(candidate->max_loss > STRATEGY_NO_RISK) || !(candidate->max_gain > 0 || isnan(candidate->max_gain)))
+		return;
+	if (!isnan(candidate->max_gain) && !(candidate->max_gain / candidate->max_loss >= spec->min_reward))
+		return;
+
+	candidate->score = candidate->edge / candidate->max_loss;
+
+	if (isfinite(candidate->score))
+		offer(search, candidate);
+}
+
+/*
+ * Every pair of strikes on one side of expiry within max_width, bought low and sold high and the other
+ * way around. Buying the lower call, or the higher put, costs at least what it would against the
+ * richest call, or cheapest put, from the sold strike up, which reach holds for each rung. Once that
+ * is over max_cost no wider spread from the same strike fits either, so that way around stops widening.
+ */
+static void search_verticals(struct StrategySearch *search, long expiry) {
+	int side, bought_low, bought_high;
+	long i, j, end, *rows;
+	float mid, *reach;
+	struct ChainIndex *chains = &search->universe->chains;
+	struct Strategy candidate;
+
+	candidate.kind = STRATEGY_VERTICAL;
+	candidate.leg_count = 2;
+	reach = search->reach - search->first;
+
+	for (side = 0; side < 2; side++) {
+		rows = (side ? chains->call : chains->put);
+
+		// stale quotes are not always in strike order, so the bound is over every rung above rather than the next one
+		for (i = chains->rungs_end[expiry] - 1; i >= chains->rungs_begin[expiry]; i--) {
+			reach[i] = (i + 1 < chains->rungs_end[expiry] ? reach[i + 1] : (side ? -INFINITY : INFINITY));
+			if ((mid = leg_mid(search, rows[i])) >= 0)
+				reach[i] = (side ? fmaxf(reach[i], mid) : fminf(reach[i], mid));
+		}
+
+		for (i = chains->rungs_begin[expiry]; i < chains->rungs_end[expiry]; i++) {
+			if ((mid = leg_mid(search, rows[i])) < 0)
+				continue;
+
+			chain_window(chains, expiry, chains->strike[i], chains->strike[i] + search->spec->max_width, &end);
+			bought_low = bought_high = TRUE;
+
+			for (j = i + 1; j < end && (bought_low || bought_high); j++) {
+				if (side && mid - reach[j] > search->spec->max_cost)
+					bought_low = FALSE;
+				if (!side && reach[j] - mid > search->spec->max_cost)
+					bought_high = FALSE;
+
+				if (leg_mid(search, rows[j]) < 0)
+					continue;
+
+				candidate.legs[0].row = rows[i];
+				candidate.legs[1].row = rows[j];
+
+				if (bought_low) {
+					candidate.legs[0].quantity = 1;
+					candidate.legs[1].quantity = -1;
+					consider(search, &candidate, chains->strike[j] - chains->strike[i]);
+				}
+
+				if (bought_high) {
+					candidate.legs[0].quantity = -1;
+					candidate.legs[1].quantity = 1;
+					consider(search, &candidate, chains->strike[j] - chains->strike[i]);
+				}
+			}
+		}
+	}
+}
+
+/* The call and put at every strike of expiry */
+static void search_straddles(struct StrategySearch *search, long expiry) {
+	long i;
+	struct ChainIndex *chains = &search->universe->chains;
+	struct Strategy candidate;
+
+	candidate.kind = STRATEGY_STRADDLE;
+	candidate.leg_count = 2;
+	candidate.legs[0].quantity = candidate.legs[1].quantity = 1;
+
+	for (i = chains->rungs_begin[expiry]; i < chains->rungs_end[expiry]; i++) {
+		if (leg_mid(search, chains->put[i]) < 0 || leg_mid(search, chains->call[i]) < 0)
+			continue;
+
+		candidate.legs[0].row = chains->put[i];
+		candidate.legs[1].row = chains->call[i];
+		consider(search, &candidate, 0);
+	}
+}
+
+/* A put below the stock with each call above it within max_width of the put */
+static void search_strangles(struct StrategySearch *search, long expiry) {
+	long i, j, end;
+	float price = search->stock->curr_price;
+	struct ChainIndex *chains = &search->universe->chains;
+	struct Strategy candidate;
+
+	candidate.kind = STRATEGY_STRANGLE;
+	candidate.leg_count = 2;
+	candidate.legs[0].quantity = candidate.legs[1].quantity = 1;
+
+	for (i = chains->rungs_begin[expiry]; i < chains->rungs_end[expiry] && chains->strike[i] < price; i++) {
+		if (leg_mid(search, chains->put[i]) < 0)
+			continue;
+
+		for (j = chain_window(chains, expiry, price, chains->strike[i] + search->spec->max_width, &end); j < end; j++) {
+			if (chains->strike[j] <= price || leg_mid(search, chains->call[j]) < 0)
+				continue;
+
+			candidate.legs[0].row = chains->put[i];
+			candidate.legs[1].row = chains->call[j];
+			consider(search, &candidate, 0);
+		}
+	}
+}
+
+/* Each strike of expiry sold against the same strike of every later expiration, bought */
+static void search_calendars(struct StrategySearch *search, long expiry) {
+	int side;
+	long i, later, rung, *rows;
+	struct ChainIndex *chains = &search->universe->chains;
+	struct Strategy candidate;
+
+	candidate.kind = STRATEGY_CALENDAR;
+	candidate.leg_count = 2;
+	candidate.legs[0].quantity = -1;
+	candidate.legs[1].quantity = 1;
+
+	for (later = expiry + 1; later < search->stock->expiries_end; later++) {
+		for (i = chains->rungs_begin[expiry]; i < chains->rungs_end[expiry]; i++) {
+			if ((rung = chain_rung(chains, later, chains->strike[i])) < 0)
+				continue;
+
+			for (side = 0; side < 2; side++) {
+				rows = (side ? chains->call : chains->put);
+
+				if (leg_mid(search, rows[i]) < 0 || leg_mid(search, rows[rung]) < 0)
+					continue;
+
+				candidate.legs[0].row = rows[i];
+				candidate.legs[1].row = rows[rung];
+				consider(search, &candidate, 0);
+			}
+		}
+	}
+}
+
+/* Keeps spread in beam, the STRATEGY_BEAM credit spreads with the most edge, most first */
+static void keep_spread(struct CreditSpread *beam, int *count, struct CreditSpread *spread) {
+	int i;
+
+	if (*count == STRATEGY_BEAM && !(spread->edge > beam[*count - 1].edge))
+		return;
+
+	i = (*count < STRATEGY_BEAM ? (*count)++ : *count - 1);
+
+	for (; i > 0 && spread->edge > beam[i - 1].edge; i--)
+		beam[i] = beam[i - 1];
+
+	beam[i] = *spread;
+}
+
+/* The credit spreads on one side of expiry whose sold strike is out of the money, into beam */
+static int credit_spreads(struct StrategySearch *search, long expiry, int side, struct CreditSpread *beam) {
+	int count;
+	long i, j, end, outer, inner, *rows;
+	float price = search->stock->curr_price, inner_mid, outer_mid;
+	struct ChainIndex *chains = &search->universe->chains;
+	struct OptionTable *options = &search->universe->options;
+	struct CreditSpread spread;
+
+	rows = (side ? chains->call : chains->put);
+	count = 0;
+
+	for (i = chains->rungs_begin[expiry]; i < chains->rungs_end[expiry]; i++) {
+		chain_window(chains, expiry, chains->strike[i], chains->strike[i] + search->spec->max_width, &end);
+
+		for (j = i + 1; j < end; j++) {
+			// the sold leg is the one nearer the money, the lower call or the higher put
+			inner = (side ? rows[i] : rows[j]);
+			outer = (side ? rows[j] : rows[i]);
+
+			if ((side ? chains->strike[i] < price : chains->strike[j] > price))
+				continue;
+			if ((inner_mid = leg_mid(search, inner)) < 0 || (outer_mid = leg_mid(search, outer)) < 0 || !(inner_mid > outer_mid))
+				continue;
+
+			spread.sold = inner;
+			spread.bought = outer;
+			spread.cost = outer_mid - inner_mid;
+			spread.edge = (leg_value(search, outer) - outer_mid) - (leg_value(search, inner) - inner_mid);
+			spread.width = fabsf(options->strike[outer] - options->strike[inner]);
+
+			if (isfinite(spread.edge))
+				keep_spread(beam, &count, &spread);
+		}
+	}
+
+	return count;
+}
+
+/* The best put credit spreads of expiry paired with its best call credit spreads */
+static void search_condors(struct StrategySearch *search, long expiry) {
+	int i, j, put_count, call_count;
+	struct CreditSpread puts[STRATEGY_BEAM], calls[STRATEGY_BEAM];
+	struct Strategy candidate;
+
+	put_count = credit_spreads(search, expiry, FALSE, puts);
+	call_count = credit_spreads(search, expiry, TRUE, calls);
+
+	candidate.kind = STRATEGY_CONDOR;
+	candidate.leg_count = 4;
+	candidate.legs[0].quantity = 1;
+	candidate.legs[1].quantity = -1;
+	candidate.legs[2].quantity = -1;
+	candidate.legs[3].quantity = 1;
+
+	for (i = 0; i < put_count; i++) {
+		for (j = 0; j < call_count; j++) {
+			candidate.legs[0].row = puts[i].bought;
+			candidate.legs[1].row = puts[i].sold;
+			candidate.legs[2].row = calls[j].sold;
+			candidate.legs[3].row = calls[j].bought;
+
+			// a condor spans no more than max_width from its lowest strike to its highest
+			if (search->universe->options.strike[calls[j].bought] - search->universe->options.strike[puts[i].bought] > search->spec->max_width)
+				continue;
+
+			consider(search, &candidate, fmaxf(puts[i].width, calls[j].width));
+		}
+	}
+}
+
+/* Searches one task's stock, every expiration of its chain */
+static void strategy_task(long task, void *arg) {
+	long expiry;
+	struct StrategyJob *job = arg;
+	struct StrategySearch search;
+
+	search.universe = job->universe;
+	search.spec = job->spec;
+	search.stock = job->universe->parent_array[task];
+	search.stock_index = task;
+	search.keep = job->keep;
+	search.count = 0;
+	search.best = safe_malloc(job->keep * sizeof(struct Strategy));
+	price_legs(&search);
+
+	for (expiry = search.stock->expiries_begin; expiry < search.stock->expiries_end; expiry++) {
+		switch (job->spec->strategy) {
+		case STRATEGY_VERTICAL:
+			search_verticals(&search, expiry);
+			break;
+		case STRATEGY_CALENDAR:
+			search_calendars(&search, expiry);
+			break;
+		case STRATEGY_STRADDLE:
+			search_straddles(&search, expiry);
+			break;
+		case STRATEGY_STRANGLE:
+			search_strangles(&search, expiry);
+			break;
+		case STRATEGY_CONDOR:
+			search_condors(&search, expiry);
+			break;
+		default:
+			break;
+		}
+	}
+
+	job->best[task] = search.best;
+	job->best_count[task] = search.count;
+
+	free(search.reach);
+	free(search.value);
+	free(search.mid);
+}
+
+long strategy_search(struct Universe *universe, struct QuerySpec *spec, struct Strategy **strategies) {
+	long i, count, *cost;
+	struct StrategyJob job;
+
+	job.universe = universe;
+	job.spec = spec;
+	job.keep = (spec->top > 0 ? spec->top : STRATEGY_DEFAULT_TOP);
+	job.best = safe_calloc((universe->parent_array_size ? universe->parent_array_size : 1), sizeof(struct Strategy *));
+	job.best_count = safe_calloc((universe->parent_array_size ? universe->parent_array_size : 1), sizeof(int));
+
+	cost = safe_malloc((universe->parent_array_size ? universe->parent_array_size : 1) * sizeof(long));
+	for (i = 0; i < universe->parent_array_size; i++)
+		cost[i] = universe->parent_array[i]->puts_end - universe->parent_array[i]->calls_begin;
+
+	thread_pool_run(universe->parent_array_size, cost, strategy_task, &job);
+
+	// every stock's best, together, are sure to hold the best overall
+	for (i = 0, count = 0; i < universe->parent_array_size; i++)
+		count += job.best_count[i];
+
+	*strategies = safe_malloc((count ? count : 1) * sizeof(struct Strategy));
+
+	for (i = 0, count = 0; i < universe->parent_array_size; i++) {
+		memcpy(*strategies + count, job.best[i], job.best_count[i] * sizeof(struct Strategy));
+		count += job.best_count[i];
+		free(job.best[i]);
+	}
+
+	qsort(*strategies, count, sizeof(struct Strategy), by_score);
+
+	free(cost);
+	free(job.best_count);
+	free(job.best);
+
+	return (count < job.keep ? count : job.keep);
+}
+
+/* Writes count strategies to sink, in the order given */
+void print_strategies(struct Universe *universe, struct Strategy *strategies, long count, struct ReportSink *sink) {
+	long i;
+
+	report_begin_strategies(sink);
+
+	for (i = 0; i < count; i++)
+		report_strategy(sink, universe->parent_array, &universe->options, &strategies[i]);
+
+	report_flush(sink);
+}
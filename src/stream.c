@@ -0,0 +1,341 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/stream.h"
+#include "../include/general_stocks.h"
+#include "../include/options.h"
+#include "../include/symbols.h"
+#include "../include/arena.h"
+#include "../include/archive.h"
+#include "../include/safe.h"
+
+/*
+ * Starts the collector with the write end of a pipe in STREAM_FD_ENV, so it sends every ticker as
+ * soon as it is parsed. Returns the collector's pid with the read end in fd, or -1 if it could not start.
+ */
+pid_t stream_collector(int *fd) {
+	int pipe_fds[2];
+	char number[16];
+	pid_t pid;
+
+	if (pipe(pipe_fds) < 0) {
+		perror("pipe");
+		return -1;
+	}
+
+	if ((pid = fork()) == 0) {
+		close(pipe_fds[0]);
+		snprintf(number, sizeof(number), "%d", pipe_fds[1]);
+		setenv(STREAM_FD_ENV, number, TRUE);
+
+		printf("Collecting stock and option data...\n");
+		execlp("python3", "python3", STREAM_COLLECTOR, (char *)NULL);
+
+		// if it reaches this point, the exec failed and the stream ends without its end frame
+		exit(EXIT_FAILURE);
+	}
+
+	close(pipe_fds[1]);
+
+	if (pid < 0) {
+		perror("fork");
+		close(pipe_fds[0]);
+		return -1;
+	}
+
+	*fd = pipe_fds[0];
+
+	return pid;
+}
+
+/* Reads exactly size bytes. FALSE at the end of the stream or on an error */
+static int read_full(int fd, void *buffer, size_t size) {
+	ssize_t got;
+	size_t done = 0;
+
+	while (done < size) {
+		if ((got = read(fd, (char *)buffer + done, size - done)) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("stream");
+			return FALSE;
+		}
+		if (got == 0)
+			return FALSE;
+
+		done += got;
+	}
+
+	return TRUE;
+}
+
+/* Copies one packed field out of a payload and steps past it */
+static const char *take(const char *payload, void *value, size_t size) {
+	memcpy(value, payload, size);
+
+	return payload + size;
+}
+
+/* Appends one ticker's price rows, tagged with the parent they are about to get */
+static const char *take_prices(const char *payload, struct PriceTable *prices, uint32_t count, int parent) {
+	int64_t date, volume;
+	long row;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		row = price_table_append(prices);
+
+		prices->parent[row] = parent;
+		payload = take(payload, &date, sizeof(int64_t));
+		payload = take(payload, &prices->open[row], sizeof(float));
+		payload = take(payload, &prices->low[row], sizeof(float));
+		payload = take(payload, &prices->high[row], sizeof(float));
+		payload = take(payload, &prices->close[row], sizeof(float));
+		payload = take(payload, &volume, sizeof(int64_t));
+		prices->date[row] = date;
+		prices->volume[row] = volume;
+	}
+
+	return payload;
+}
+
+/* Appends one ticker's calls or puts, tagged with the parent they are about to get */
+static const char *take_options(const char *payload, struct OptionTable *options, uint32_t count, int parent, char type) {
+	int32_t dte;
+	int64_t expiration, volume, open_interest;
+	uint8_t itm;
+	long row;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		row = option_table_append(options);
+
+		options->parent[row] = parent;
+		options->type[row] = type;
+		payload = take(payload, &expiration, sizeof(int64_t));
+		payload = take(payload, &dte, sizeof(int32_t));
+		payload = take(payload, &options->strike[row], sizeof(float));
+		payload = take(payload, &volume, sizeof(int64_t));
+		payload = take(payload, &open_interest, sizeof(int64_t));
+		payload = take(payload, &options->bid[row], sizeof(float));
+		payload = take(payload, &options->ask[row], sizeof(float));
+		payload = take(payload, &options->last_price[row], sizeof(float));
+		payload = take(payload, &options->percent_change[row], sizeof(float));
+		payload = take(payload, &options->implied_volatility[row], sizeof(float));
+		payload = take(payload, &itm, sizeof(uint8_t));
+		options->expiration_date[row] = expiration;
+		options->days_til_expiration[row] = dte;
+		options->volume[row] = volume;
+		options->open_interest[row] = open_interest;
+		options->in_the_money[row] = (itm != 0);
+	}
+
+	return payload;
+}
+
+/*
+ * A streamed day's volatilities as the collector sent them. Scoring overwrites them in place, the
+ * stocks' with realized estimates and the contracts' with solved ones, so they are kept aside here
+ * for the day's archive segment, which holds the chains as quoted.
+ */
+struct QuotedDay {
+   float *implied_volatility;         // option row -> quoted implied volatility
+   long capacity;
+   struct TickerVolatility *tickers;  // parent -> quoted iv20, iv50 and iv100
+   long ticker_capacity;
+};
+
+/* Keeps a copy of one ticker's quoted volatilities, before it is scored */
+static void keep_quoted(struct QuotedDay *quoted, struct Universe *universe, struct ParentStock *stock, long parent) {
+	if (universe->options.size > quoted->capacity) {
+		while (universe->options.size > quoted->capacity)
+			quoted->capacity = (quoted->capacity ? quoted->capacity * 2 : 1 << 12);
+
+		quoted->implied_volatility = safe_realloc(quoted->implied_volatility, quoted->capacity * sizeof(float));
+	}
+
+	if (parent >= quoted->ticker_capacity) {
+		quoted->ticker_capacity = (quoted->ticker_capacity ? quoted->ticker_capacity * 2 : 256);
+		quoted->tickers = safe_realloc(quoted->tickers, quoted->ticker_capacity * sizeof(struct TickerVolatility));
+	}
+
+	memcpy(quoted->implied_volatility + stock->calls_begin, universe->options.implied_volatility + stock->calls_begin,
+	       (stock->puts_end - stock->calls_begin) * sizeof(float));
+
+	quoted->tickers[parent].iv20 = stock->iv20;
+	quoted->tickers[parent].iv50 = stock->iv50;
+	quoted->tickers[parent].iv100 = stock->iv100;
+}
+
+/* Trades the stocks' volatilities with the ones kept in quoted, both ways round */
+static void swap_quoted(struct QuotedDay *quoted, struct Universe *universe) {
+	long i;
+	float *implied_volatility;
+	struct TickerVolatility held;
+	struct ParentStock *stock;
+
+	implied_volatility = universe->options.implied_volatility;
+	universe->options.implied_volatility = quoted->implied_volatility;
+	quoted->implied_volatility = implied_volatility;
+
+	for (i = 0; i < universe->parent_array_size; i++) {
+		stock = universe->parent_array[i];
+		held = quoted->tickers[i];
+
+		quoted->tickers[i].iv20 = stock->iv20;
+		quoted->tickers[i].iv50 = stock->iv50;
+		quoted->tickers[i].iv100 = stock->iv100;
+		stock->iv20 = held.iv20;
+		stock->iv50 = held.iv50;
+		stock->iv100 = held.iv100;
+	}
+}
+
+/*
+ * Loads one ticker frame into the tables and scores it on the spot. Each ticker arrives whole, so
+ * its rows are already contiguous, calls before puts, and need no grouping afterwards. Returns the
+ * new parent, or NULL if the ticker is left out.
+ */
+static struct ParentStock *take_ticker(struct Universe *universe, struct QuotedDay *quoted, const char *payload, uint32_t length, long parent) {
+	char ticker[TICK_SIZE];
+	float iv20, iv50, iv100;
+	uint32_t price_count, call_count, put_count;
+	struct ParentStock *stock;
+
+	memcpy(ticker, payload, TICK_SIZE);
+	ticker[TICK_SIZE - 1] = '\0';
+	payload = take(payload + TICK_SIZE, &iv20, sizeof(float));
+	payload = take(payload, &iv50, sizeof(float));
+	payload = take(payload, &iv100, sizeof(float));
+	payload = take(payload, &price_count, sizeof(uint32_t));
+	payload = take(payload, &call_count, sizeof(uint32_t));
+	payload = take(payload, &put_count, sizeof(uint32_t));
+
+	if (length != STREAM_TICKER_SIZE + (uint64_t)price_count * STREAM_PRICE_SIZE + ((uint64_t)call_count + put_count) * STREAM_OPTION_SIZE) {
+		fprintf(stderr, "Warning: Malformed stream frame for %s\n", ticker);
+		return NULL;
+	}
+
+	// a ticker sent twice keeps what came first, and one without price history has nothing to score against
+	if (symbol_lookup(&universe->symbols, ticker) != NO_SYMBOL || price_count == 0)
+		return NULL;
+
+	symbol_intern(&universe->symbols, ticker);
+
+	stock = arena_calloc(&universe->arena, 1, sizeof(struct ParentStock));
+	strcpy(stock->ticker, ticker);
+	stock->iv20 = iv20;
+	stock->iv50 = iv50;
+	stock->iv100 = iv100;
+
+	stock->prices_begin = universe->prices.size;
+	payload = take_prices(payload, &universe->prices, price_count, parent);
+	stock->prices_end = universe->prices.size;
+
+	stock->calls_begin = universe->options.size;
+	payload = take_options(payload, &universe->options, call_count, parent, TRUE);
+	stock->calls_end = stock->puts_begin = universe->options.size;
+	payload = take_options(payload, &universe->options, put_count, parent, FALSE);
+	stock->puts_end = universe->options.size;
+
+	find_curr_stock_price(stock, &universe->prices);
+	keep_quoted(quoted, universe, stock, parent);
+	screen_stock(stock, &universe->prices, &universe->options);
+	calc_stock_data(stock, &universe->prices, &universe->options);
+
+	return stock;
+}
+
+/*
+ * Loads and scores a universe from the collector's stream, one ticker at a time as it arrives, so
+ * scoring overlaps collection and the universe is ready as soon as the last ticker is in. Returns
+ * FALSE if the stream ended before the collector said it was done.
+ */
+int gather_stream(struct Universe *universe, int fd) {
+	int done;
+	char *payload, header[STREAM_HEADER_SIZE];
+	uint32_t length;
+	long parent_array_size, parent_array_capacity;
+	struct ParentStock *stock, **parent_array;
+	struct QuotedDay quoted;
+
+	if (universe->loaded)
+		universe_release(universe);
+
+	symbol_table_init(&universe->symbols, &universe->arena);
+	price_table_init(&universe->prices, &universe->arena);
+	option_table_init(&universe->options, &universe->arena);
+
+	done = FALSE;
+	payload = NULL;
+	parent_array = NULL;
+	parent_array_size = parent_array_capacity = 0;
+	memset(&quoted, 0, sizeof(struct QuotedDay));
+
+	while (!done && read_full(fd, header, STREAM_HEADER_SIZE)) {
+		memcpy(&length, header, sizeof(uint32_t));
+
+		if (length > STREAM_MAX_FRAME) {
+			fprintf(stderr, "Warning: Stream frame of %lu bytes is too large\n", (unsigned long)length);
+			break;
+		}
+
+		payload = safe_realloc(payload, (length ? length : 1));
+
+		if (!read_full(fd, payload, length))
+			break;
+
+		switch (header[4]) {
+		case STREAM_TICKER:
+			if (length < STREAM_TICKER_SIZE) {
+				fprintf(stderr, "Warning: Malformed stream frame\n");
+				break;
+			}
+
+			if ((stock = take_ticker(universe, &quoted, payload, length, parent_array_size)) == NULL)
+				break;
+
+			if (parent_array_size == parent_array_capacity) {
+				parent_array_capacity = (parent_array_capacity ? parent_array_capacity * 2 : 256);
+				parent_array = safe_realloc(parent_array, parent_array_capacity * sizeof(struct ParentStock *));
+			}
+
+			parent_array[parent_array_size++] = stock;
+			break;
+		case STREAM_END:
+			done = TRUE;
+			break;
+		default:
+			fprintf(stderr, "Warning: Unknown stream frame '%c'\n", header[4]);
+			break;
+		}
+	}
+
+	// the parents move into the arena with everything else, so the universe still goes in one call
+	universe->parent_array = arena_alloc(&universe->arena, (parent_array_size ? parent_array_size : 1) * sizeof(struct ParentStock *));
+	if (parent_array_size)
+		memcpy(universe->parent_array, parent_array, parent_array_size * sizeof(struct ParentStock *));
+	universe->parent_array_size = parent_array_size;
+	universe->loaded = TRUE;
+
+	// only a whole day is worth keeping, and it is kept as quoted so a replay can still choose how to score it
+	if (done && parent_array_size) {
+		swap_quoted(&quoted, universe);
+		archive_append(universe);
+		swap_quoted(&quoted, universe);
+	}
+
+	free(quoted.tickers);
+	free(quoted.implied_volatility);
+	free(parent_array);
+	free(payload);
+
+	return done;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/symbols.h"
+#include "../include/arena.h"
+
+/* FNV-1a over the significant characters of a ticker */
+static uint32_t hash_ticker(const char *ticker) {
+	int i;
+	uint32_t hash = 2166136261u;
+
+	for (i = 0; i < TICK_SIZE - 1 && ticker[i] != '\0'; i++) {
+		hash ^= (unsigned char)ticker[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* Returns the slot holding ticker, or the empty slot it would be placed in */
+static long find_slot(struct SymbolTable *symbols, const char *ticker) {
+	long slot, mask;
+
+	mask = symbols->slots_capacity - 1;
+	slot = hash_ticker(ticker) & mask;
+
+	while (symbols->slots[slot] != NO_SYMBOL && 0 != strncmp(symbols->names[symbols->slots[slot]], ticker, TICK_SIZE - 1))
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+/* Doubles the hash index and reinserts every id */
+static void grow_slots(struct SymbolTable *symbols) {
+	long i, slot;
+
+	symbols->slots_capacity *= 2;
+	symbols->slots = arena_alloc(symbols->arena, symbols->slots_capacity * sizeof(int));
+
+	for (i = 0; i < symbols->slots_capacity; i++)
+		symbols->slots[i] = NO_SYMBOL;
+
+	for (i = 0; i < symbols->size; i++) {
+		slot = find_slot(symbols, symbols->names[i]);
+		symbols->slots[slot] = i;
+	}
+}
+
+void symbol_table_init(struct SymbolTable *symbols, struct Arena *arena) {
+	long i;
+
+	symbols->size = 0;
+	symbols->arena = arena;
+	symbols->names_capacity = SYMBOL_TABLE_MIN_CAPACITY;
+	symbols->slots_capacity = SYMBOL_TABLE_MIN_CAPACITY * 2;
+	symbols->names = arena_alloc(arena, symbols->names_capacity * TICK_SIZE);
+	symbols->slots = arena_alloc(arena, symbols->slots_capacity * sizeof(int));
+
+	for (i = 0; i < symbols->slots_capacity; i++)
+		symbols->slots[i] = NO_SYMBOL;
+
+	pthread_mutex_init(&symbols->lock, NULL);
+}
+
+/* Returns the id of ticker, assigning the next free id the first time it is seen. Safe to call from several loaders at once */
+int symbol_intern(struct SymbolTable *symbols, const char *ticker) {
+	int id;
+	long slot;
+
+	pthread_mutex_lock(&symbols->lock);
+
+	slot = find_slot(symbols, ticker);
+
+	if ((id = symbols->slots[slot]) == NO_SYMBOL) {
+		if (symbols->size == symbols->names_capacity) {
+			symbols->names = arena_grow(symbols->arena, symbols->names, symbols->names_capacity * TICK_SIZE, symbols->names_capacity * 2 * TICK_SIZE);
+			symbols->names_capacity *= 2;
+		}
+
+		id = symbols->size++;
+		memset(symbols->names[id], 0, TICK_SIZE);
+		strncpy(symbols->names[id], ticker, TICK_SIZE - 1);
+		symbols->slots[slot] = id;
+
+		if (symbols->size * 2 > symbols->slots_capacity)
+			grow_slots(symbols);
+	}
+
+	pthread_mutex_unlock(&symbols->lock);
+
+	return id;
+}
+
+/* Returns the id of ticker, or NO_SYMBOL. Only safe once nothing is interning anymore */
+int symbol_lookup(struct SymbolTable *symbols, const char *ticker) {
+	return symbols->slots[find_slot(symbols, ticker)];
+}
+
+/* The names and index belong to the arena, only the lock needs releasing */
+void symbol_table_free(struct SymbolTable *symbols) {
+	pthread_mutex_destroy(&symbols->lock);
+
+	memset(symbols, 0, sizeof(struct SymbolTable));
+}
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/thread_pool.h"
+#include "../include/safe.h"
+
+/* One task and its estimated cost, for dealing the heaviest tasks first */
+struct TaskCost {
+   long cost;
+   long task;
+};
+
+/* Arguments for one worker thread */
+struct Worker {
+   int id;
+   struct ThreadPool *pool;
+};
+
+/* Number of workers to use, SCREENER_THREADS if it is set and otherwise one per online core */
+int thread_pool_threads(void) {
+	long count;
+	char *env;
+
+	env = getenv(THREAD_POOL_ENV);
+	count = (env != NULL ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN));
+
+	if (count < 1)
+		count = 1;
+	if (count > THREAD_POOL_MAX_THREADS)
+		count = THREAD_POOL_MAX_THREADS;
+
+	return count;
+}
+
+/* Takes the next task from the front of a worker's own deque, or -1 if it is empty */
+static long pop_task(struct WorkDeque *deque) {
+	long task = -1;
+
+	pthread_mutex_lock(&deque->lock);
+	if (deque->head < deque->tail)
+		task = deque->tasks[deque->head++];
+	pthread_mutex_unlock(&deque->lock);
+
+	return task;
+}
+
+/* Takes the last, and so cheapest, task from another worker's deque, or -1 if it is empty */
+static long steal_task(struct WorkDeque *deque) {
+	long task = -1;
+
+	pthread_mutex_lock(&deque->lock);
+	if (deque->head < deque->tail)
+		task = deque->tasks[--deque->tail];
+	pthread_mutex_unlock(&deque->lock);
+
+	return task;
+}
+
+/* Drains its own deque, then steals until every deque is empty. No task is ever added, so empty stays empty */
+static void *work(void *arg) {
+	int i, victim;
+	long task;
+	struct Worker *worker = arg;
+	struct ThreadPool *pool = worker->pool;
+
+	while ((task = pop_task(&pool->deques[worker->id])) >= 0)
+		pool->task(task, pool->arg);
+
+	for (i = 1; i < pool->thread_count; i++) {
+		victim = (worker->id + i) % pool->thread_count;
+
+		while ((task = steal_task(&pool->deques[victim])) >= 0)
+			pool->task(task, pool->arg);
+	}
+
+	return NULL;
+}
+
+/* Sorts tasks by descending cost, ties by index so the deal never depends on qsort */
+static int by_cost(const void *a, const void *b) {
+	const struct TaskCost *x = a, *y = b;
+
+	if (x->cost != y->cost)
+		return (x->cost < y->cost ? 1 : -1);
+
+	return (x->task > y->task) - (x->task < y->task);
+}
+
+/*
+ * Runs task(i, arg) for every i in [0, task_count) and returns once all of them have finished.
+ * cost[i] is an estimate of task i's work used to balance the workers, it may be NULL. With a
+ * single worker every task runs in order on the calling thread.
+ */
+void thread_pool_run(long task_count, const long *cost, ThreadTask task, void *arg) {
+	int i;
+	long t;
+	struct TaskCost *order;
+	pthread_t *threads;
+	struct Worker *workers;
+	struct ThreadPool pool;
+
+	pool.thread_count = thread_pool_threads();
+	pool.task = task;
+	pool.arg = arg;
+
+	if (pool.thread_count > task_count)
+		pool.thread_count = task_count;
+
+	if (pool.thread_count <= 1) {
+		for (t = 0; t < task_count; t++)
+			task(t, arg);
+
+		return;
+	}
+
+	order = safe_malloc(task_count * sizeof(struct TaskCost));
+	for (t = 0; t < task_count; t++) {
+		order[t].task = t;
+		order[t].cost = (cost != NULL ? cost[t] : 0);
+	}
+
+	qsort(order, task_count, sizeof(struct TaskCost), by_cost);
+
+	pool.deques = safe_calloc(pool.thread_count, sizeof(struct WorkDeque));
+	for (i = 0; i < pool.thread_count; i++) {
+		pool.deques[i].tasks = safe_malloc((task_count / pool.thread_count + 1) * sizeof(long));
+		pthread_mutex_init(&pool.deques[i].lock, NULL);
+	}
+
+	for (t = 0; t < task_count; t++)
+		pool.deques[t % pool.thread_count].tasks[pool.deques[t % pool.thread_count].tail++] = order[t].task;
+
+	threads = safe_malloc(pool.thread_count * sizeof(pthread_t));
+	workers = safe_malloc(pool.thread_count * sizeof(struct Worker));
+
+	// the calling thread is worker 0
+	for (i = 0; i < pool.thread_count; i++) {
+		workers[i].id = i;
+		workers[i].pool = &pool;
+
+		if (i > 0 && pthread_create(&threads[i], NULL, work, &workers[i]) != 0) {
+			fprintf(stderr, "Warning: Unable to start worker thread\n");
+			workers[i].id = -1;
+		}
+	}
+
+	work(&workers[0]);
+
+	for (i = 1; i < pool.thread_count; i++) {
+		if (workers[i].id >= 0)
+			pthread_join(threads[i], NULL);
+	}
+
+	for (i = 0; i < pool.thread_count; i++) {
+		pthread_mutex_destroy(&pool.deques[i].lock);
+		free(pool.deques[i].tasks);
+	}
+
+	free(workers);
+	free(threads);
+	free(pool.deques);
+	free(order);
+
+	return;
+}
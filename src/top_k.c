@@ -0,0 +1,212 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/top_k.h"
+#include "../include/options.h"
+#include "../include/thread_pool.h"
+#include "../include/safe.h"
+
+#define TOP_K_TASKS_PER_THREAD 4
+
+/* One slice of parent_array ranked into its own heap */
+struct TopKJob {
+   struct ParentStock **parent_array;
+   long parent_array_size;
+   struct OptionTable *options;
+   RankKey key;
+   long slice_size;
+   struct TopK *slices;
+};
+
+void top_k_init(struct TopK *top, int k) {
+	top->k = (k < 0 ? 0 : k);
+	top->size = 0;
+	top->heap = safe_malloc((top->k ? top->k : 1) * sizeof(struct TopEntry));
+}
+
+/* TRUE if a ranks below b, a lower key or the same key on a later row */
+static int worse(struct TopEntry *a, struct TopEntry *b) {
+	if (a->key != b->key)
+		return a->key < b->key;
+
+	return a->row > b->row;
+}
+
+static void sift_up(struct TopK *top, int i) {
+	struct TopEntry entry = top->heap[i];
+
+	while (i > 0 && worse(&entry, &top->heap[(i - 1) / 2])) {
+		top->heap[i] = top->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+
+	top->heap[i] = entry;
+}
+
+static void sift_down(struct TopK *top, int i, int size) {
+	int child;
+	struct TopEntry entry = top->heap[i];
+
+	while ((child = i * 2 + 1) < size) {
+		if (child + 1 < size && worse(&top->heap[child + 1], &top->heap[child]))
+			child++;
+		if (!worse(&top->heap[child], &entry))
+			break;
+
+		top->heap[i] = top->heap[child];
+		i = child;
+	}
+
+	top->heap[i] = entry;
+}
+
+/* Offers one entry, O(log k) if it makes the cut and O(1) otherwise */
+void top_k_push(struct TopK *top, double key, long row, int stock) {
+	struct TopEntry entry;
+
+	if (isnan(key) || top->k == 0)
+		return;
+
+	entry.key = key;
+	entry.row = row;
+	entry.stock = stock;
+
+	if (top->size < top->k) {
+		top->heap[top->size++] = entry;
+		sift_up(top, top->size - 1);
+	}
+	else if (worse(&top->heap[0], &entry)) {
+		top->heap[0] = entry;
+		sift_down(top, 0, top->size);
+	}
+}
+
+/* Offers every entry of from to into */
+void top_k_merge(struct TopK *into, struct TopK *from) {
+	int i;
+
+	for (i = 0; i < from->size; i++)
+		top_k_push(into, from->heap[i].key, from->heap[i].row, from->heap[i].stock);
+}
+
+/* Heapsorts in place into best first order. The heap is used up, push nothing more after this */
+void top_k_sort(struct TopK *top) {
+	int end;
+	struct TopEntry worst;
+
+	for (end = top->size - 1; end > 0; end--) {
+		worst = top->heap[0];
+		top->heap[0] = top->heap[end];
+		top->heap[end] = worst;
+		sift_down(top, 0, end);
+	}
+}
+
+void top_k_free(struct TopK *top) {
+	free(top->heap);
+	top->heap = NULL;
+	top->size = 0;
+}
+
+/* Ranks every open contract of one slice of stocks */
+static void top_k_task(long task, void *arg) {
+	int outter_i;
+	long inner_i, end;
+	struct TopKJob *job = arg;
+	struct ParentStock *stock;
+
+	end = (task + 1) * job->slice_size;
+	if (end > job->parent_array_size)
+		end = job->parent_array_size;
+
+	for (outter_i = task * job->slice_size; outter_i < end; outter_i++) {
+		stock = job->parent_array[outter_i];
+
+		for (inner_i = stock->calls_begin; inner_i < stock->puts_end; inner_i++) {
+			if (job->options->open[inner_i])
+				top_k_push(&job->slices[task], job->key(stock, job->options, inner_i), inner_i, outter_i);
+		}
+	}
+}
+
+/*
+ * Collects the top->k best open contracts by key. Slices of stocks are ranked into their own heaps
+ * across the thread pool and merged at the end. Returns with top sorted best first.
+ */
+void top_k_contracts(struct ParentStock **parent_array, long parent_array_size, struct OptionTable *options, RankKey key, struct TopK *top) {
+	long i, first, last, slices, *cost;
+	struct TopKJob job;
+
+	slices = thread_pool_threads() * TOP_K_TASKS_PER_THREAD;
+	if (slices > parent_array_size)
+		slices = parent_array_size;
+
+	job.parent_array = parent_array;
+	job.parent_array_size = parent_array_size;
+	job.options = options;
+	job.key = key;
+	job.slice_size = (slices ? (parent_array_size + slices - 1) / slices : 0);
+	job.slices = safe_malloc((slices ? slices : 1) * sizeof(struct TopK));
+	cost = safe_calloc((slices ? slices : 1), sizeof(long));
+
+	// a slice's contracts are contiguous, so its cost is the span from its first call to its last put
+	for (i = 0; i < slices; i++) {
+		top_k_init(&job.slices[i], top->k);
+
+		first = i * job.slice_size;
+		last = (first + job.slice_size < parent_array_size ? first + job.slice_size : parent_array_size) - 1;
+		if (first <= last)
+			cost[i] = parent_array[last]->puts_end - parent_array[first]->calls_begin;
+	}
+
+	thread_pool_run(slices, cost, top_k_task, &job);
+
+	top->size = 0;
+	for (i = 0; i < slices; i++) {
+		top_k_merge(top, &job.slices[i]);
+		top_k_free(&job.slices[i]);
+	}
+
+	top_k_sort(top);
+
+	free(cost);
+	free(job.slices);
+
+	return;
+}
+
+double rank_volume(struct ParentStock *stock, struct OptionTable *options, long row) {
+	return options->volume[row];
+}
+
+double rank_open_interest(struct ParentStock *stock, struct OptionTable *options, long row) {
+	return options->open_interest[row];
+}
+
+/* Volume over open interest, how much of the open position traded today */
+double rank_volume_oi(struct ParentStock *stock, struct OptionTable *options, long row) {
+	if (options->open_interest[row] == 0)
+		return NAN;
+
+	return (double)options->volume[row] / options->open_interest[row];
+}
+
+/* The contract's weight plus its stock's, the same total print_data screens on */
+double rank_total_weight(struct ParentStock *stock, struct OptionTable *options, long row) {
+	return total_weight(stock, options, row);
+}
+
+/* How far the contract's IV sits below the stock's IV for its DTE bucket, the same bucket iv_below uses */
+double rank_iv_discount(struct ParentStock *stock, struct OptionTable *options, long row) {
+	if (options->days_til_expiration[row] <= 30)
+		return options->perc_from_iv20[row];
+	else if (options->days_til_expiration[row] <= 365 / 4)
+		return options->perc_from_iv50[row];
+
+	return options->perc_from_iv100[row];
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/universe.h"
+#include "../include/general_stocks.h"
+#include "../include/arena.h"
+#include "../include/snapshot.h"
+#include "../include/yahoo.h"
+#include "../include/archive.h"
+
+void universe_init(struct Universe *universe) {
+	memset(universe, 0, sizeof(struct Universe));
+	arena_init(&universe->arena);
+}
+
+/*
+ * Loads prices and options into a fresh universe. A snapshot matching the current databases is
+ * mapped in place, otherwise everything is read from the databases and snapshotted for next time.
+ * With YAHOO_RAW_ENV set the collector's raw responses are parsed instead, and with ARCHIVE_AS_OF_ENV
+ * set that day's archived chains are loaded. Anything loaded fresh is archived for its day.
+ */
+void universe_load(struct Universe *universe) {
+	int have_sources;
+	char *raw, *as_of;
+	struct SnapshotSource prices_db, options_db;
+
+	if (universe->loaded)
+		universe_release(universe);
+
+	// a past day is replayed from the archive, with the bars it had
+	if ((as_of = getenv(ARCHIVE_AS_OF_ENV)) != NULL && *as_of != '\0') {
+		symbol_table_init(&universe->symbols, &universe->arena);
+		price_table_init(&universe->prices, &universe->arena);
+		option_table_init(&universe->options, &universe->arena);
+
+		if (archive_directory() == NULL || !archive_load(universe, archive_directory(), atoi(as_of), NULL))
+			fprintf(stderr, "Warning: No archived chains for %s\n", as_of);
+
+		universe->loaded = TRUE;
+		return;
+	}
+
+	// raw Yahoo responses are read as they are, there are no databases to snapshot
+	if ((raw = getenv(YAHOO_RAW_ENV)) != NULL && *raw != '\0') {
+		symbol_table_init(&universe->symbols, &universe->arena);
+		price_table_init(&universe->prices, &universe->arena);
+		option_table_init(&universe->options, &universe->arena);
+
+		gather_raw(universe, raw);
+		archive_append(universe);
+
+		universe->loaded = TRUE;
+		return;
+	}
+
+	have_sources = snapshot_sources(&prices_db, &options_db);
+
+	if (!have_sources || !snapshot_open(universe, SNAPSHOT_FILE, &prices_db, &options_db)) {
+		symbol_table_init(&universe->symbols, &universe->arena);
+		price_table_init(&universe->prices, &universe->arena);
+		option_table_init(&universe->options, &universe->arena);
+
+		gather_tickers(universe);
+
+		// written before screening, so the snapshot holds the universe exactly as loaded
+		if (have_sources)
+			snapshot_write(universe, SNAPSHOT_FILE, &prices_db, &options_db);
+	}
+
+	archive_append(universe);
+
+	universe->loaded = TRUE;
+}
+
+/* Drops everything that was loaded, keeping the arena's memory around for the next load */
+void universe_release(struct Universe *universe) {
+	if (!universe->loaded)
+		return;
+
+	symbol_table_free(&universe->symbols);
+	snapshot_close(universe);
+	arena_reset(&universe->arena);
+
+	universe->parent_array = NULL;
+	universe->parent_array_size = 0;
+	memset(&universe->chains, 0, sizeof(struct ChainIndex));
+	universe->loaded = FALSE;
+}
+
+/* Releases the whole universe in one go */
+void universe_free(struct Universe *universe) {
+	universe_release(universe);
+	arena_free(&universe->arena);
+}
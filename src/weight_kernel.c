@@ -0,0 +1,501 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define WEIGHT_KERNEL_X86
+#endif
+
+#include "../include/screener.h"
+#include "../include/options.h"
+#include "../include/weight_kernel.h"
+#include "../include/safe.h"
+
+/*
+ * The scalar functions compare floats against double constants like .05, so every threshold is
+ * replaced by the largest float not above it. For any float x, x <= d and x <= that float agree,
+ * as do x > d and x > that float, which keeps the vector compares exact.
+ */
+static float float_at_or_below(double value) {
+	float f = (float)value;
+
+	if ((double)f > value)
+		f = nextafterf(f, -INFINITY);
+
+	return f;
+}
+
+// the columns the weighting functions write, for checking a kernel against them
+#define WEIGHT_COLUMNS(X)  \
+   X(weight)               \
+   X(perc_from_strike)     \
+   X(perc_from_iv20)       \
+   X(perc_from_iv50)       \
+   X(perc_from_iv100)      \
+   X(one_std_deviation)
+
+#define WEIGHT_COLUMN_COUNT 6
+
+static enum WeightKernel selected;
+static int checking;
+static pthread_once_t selected_once = PTHREAD_ONCE_INIT;
+
+/* Picks the widest kernel the CPU supports, unless SCREENER_KERNEL asks for a narrower one */
+static void select_kernel(void) {
+	char *env;
+
+	selected = KERNEL_SCALAR;
+
+	env = getenv(WEIGHT_KERNEL_CHECK_ENV);
+	checking = (env != NULL && *env != '\0' && strcmp(env, "0") != 0);
+
+#ifdef WEIGHT_KERNEL_X86
+	selected = KERNEL_SSE2;
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		selected = KERNEL_AVX2;
+#endif
+
+	env = getenv(WEIGHT_KERNEL_ENV);
+	if (env == NULL)
+		return;
+
+	if (strcmp(env, "scalar") == 0)
+		selected = KERNEL_SCALAR;
+	else if (strcmp(env, "sse2") == 0 && selected >= KERNEL_SSE2)
+		selected = KERNEL_SSE2;
+}
+
+enum WeightKernel weight_kernel(void) {
+	pthread_once(&selected_once, select_kernel);
+
+	return selected;
+}
+
+const char *weight_kernel_name(enum WeightKernel kernel) {
+	switch (kernel) {
+	case KERNEL_AVX2:
+		return "avx2";
+	case KERNEL_SSE2:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+}
+
+/* The scalar functions on one open row, in the order calc_stock_data has always applied them */
+static void weight_row(struct OptionTable *options, long i, struct ParentStock *stock) {
+	if (options->open[i]) {
+		perc_from_strike(options, i, stock);
+		perc_from_ivs(options, i, stock);
+		one_std_deviation(options, i, stock);
+		iv_below(options, i, stock);
+		dte_weight(options, i);
+	}
+}
+
+/* bid_ask_spread on one open row, closing it if the spread is too wide. Returns TRUE if it was closed */
+static int spread_row(struct OptionTable *options, long i) {
+	if (options->open[i] && bid_ask_spread(options, i)) {
+		options->open[i] = FALSE;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+#ifdef WEIGHT_KERNEL_X86
+
+/* Lanes of mask take b, the rest keep a. SSE2 has no blendv */
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+/* All ones in each of the four lanes whose open byte is set */
+static inline __m128 open_mask_sse2(const char *open) {
+	int32_t bytes;
+	__m128i zero = _mm_setzero_si128(), lanes;
+
+	memcpy(&bytes, open, sizeof(int32_t));
+	lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+
+	return _mm_castsi128_ps(_mm_andnot_si128(_mm_cmpeq_epi32(lanes, zero), _mm_set1_epi32(-1)));
+}
+
+/* curr_price * (iv / 100) * sqrt(dte / 365) in double, rounded to float, for four lanes */
+static inline __m128 std_deviation_sse2(__m128d curr, __m128 iv, __m128i dte) {
+	__m128d low, high, hundred = _mm_set1_pd(100), days = _mm_set1_pd(365);
+
+	low = _mm_mul_pd(_mm_mul_pd(curr, _mm_div_pd(_mm_cvtps_pd(iv), hundred)),
+	                 _mm_sqrt_pd(_mm_div_pd(_mm_cvtepi32_pd(dte), days)));
+	high = _mm_mul_pd(_mm_mul_pd(curr, _mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(iv, iv)), hundred)),
+	                  _mm_sqrt_pd(_mm_div_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(dte, 0xEE)), days)));
+
+	return _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+}
+
+static long weight_sse2(struct OptionTable *options, long begin, long end, struct ParentStock *stock) {
+	long i;
+	__m128 active, strike, iv, weight, tier, perc, sel, std, range_low, range_high, in_range;
+	__m128i dte, over_30, over_91;
+	__m128 curr = _mm_set1_ps(stock->curr_price), hundred = _mm_set1_ps(100);
+	__m128 iv20 = _mm_set1_ps(stock->iv20), iv50 = _mm_set1_ps(stock->iv50), iv100 = _mm_set1_ps(stock->iv100);
+	__m128 at_05 = _mm_set1_ps(float_at_or_below(.05)), at_10 = _mm_set1_ps(float_at_or_below(.1));
+	__m128 at_175 = _mm_set1_ps(float_at_or_below(.175));
+	__m128d curr_d = _mm_set1_pd(stock->curr_price);
+
+	for (i = begin; i + 4 <= end; i += 4) {
+		active = open_mask_sse2(options->open + i);
+		if (_mm_movemask_ps(active) == 0)
+			continue;
+
+		dte = _mm_loadu_si128((const __m128i *)(options->days_til_expiration + i));
+		strike = _mm_loadu_ps(options->strike + i);
+		iv = _mm_loadu_ps(options->implied_volatility + i);
+		weight = _mm_loadu_ps(options->weight + i);
+
+		// perc_from_strike, the tier constant is 125, 75 or 50 and rows past .175 keep their weight
+		perc = _mm_mul_ps(_mm_div_ps(_mm_sub_ps(strike, curr), curr), hundred);
+		tier = select_ps(_mm_cmple_ps(perc, at_10), _mm_set1_ps(50), _mm_set1_ps(75));
+		tier = select_ps(_mm_cmple_ps(perc, at_05), tier, _mm_set1_ps(125));
+		weight = select_ps(_mm_cmple_ps(perc, at_175), weight, _mm_add_ps(weight, _mm_sub_ps(tier, perc)));
+		_mm_storeu_ps(options->perc_from_strike + i, select_ps(active, _mm_loadu_ps(options->perc_from_strike + i), perc));
+
+		// perc_from_ivs
+		_mm_storeu_ps(options->perc_from_iv20 + i, select_ps(active, _mm_loadu_ps(options->perc_from_iv20 + i), _mm_div_ps(_mm_sub_ps(iv20, iv), iv20)));
+		_mm_storeu_ps(options->perc_from_iv50 + i, select_ps(active, _mm_loadu_ps(options->perc_from_iv50 + i), _mm_div_ps(_mm_sub_ps(iv50, iv), iv50)));
+		_mm_storeu_ps(options->perc_from_iv100 + i, select_ps(active, _mm_loadu_ps(options->perc_from_iv100 + i), _mm_div_ps(_mm_sub_ps(iv100, iv), iv100)));
+
+		// the dte buckets pick iv20, iv50 or iv100 for one_std_deviation and iv_below
+		over_30 = _mm_cmpgt_epi32(dte, _mm_set1_epi32(30));
+		over_91 = _mm_cmpgt_epi32(dte, _mm_set1_epi32(365 / 4));
+		sel = select_ps(_mm_castsi128_ps(over_30), iv20, iv50);
+		sel = select_ps(_mm_castsi128_ps(over_91), sel, iv100);
+
+		// one_std_deviation
+		std = std_deviation_sse2(curr_d, sel, dte);
+		range_low = _mm_sub_ps(curr, std);
+		range_high = _mm_add_ps(curr, std);
+		in_range = _mm_and_ps(_mm_cmpgt_ps(curr, range_low), _mm_cmplt_ps(curr, range_high));
+		weight = select_ps(in_range, weight, _mm_add_ps(weight, _mm_mul_ps(_mm_div_ps(_mm_sub_ps(strike, range_low), std), hundred)));
+		_mm_storeu_ps(options->one_std_deviation + i, select_ps(active, _mm_loadu_ps(options->one_std_deviation + i), std));
+
+		// iv_below
+		weight = _mm_add_ps(weight, _mm_mul_ps(_mm_div_ps(_mm_sub_ps(sel, iv), sel), hundred));
+
+		// dte_weight
+		weight = _mm_add_ps(weight, select_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(dte, _mm_set1_epi32(100))), _mm_cvtepi32_ps(dte), hundred));
+
+		_mm_storeu_ps(options->weight + i, select_ps(active, _mm_loadu_ps(options->weight + i), weight));
+	}
+
+	return i;
+}
+
+static long spreads_sse2(struct OptionTable *options, long begin, long end, long *closed) {
+	int lane, wide;
+	long i;
+	__m128 active, bid, ask, error, too_wide;
+	__m128 max_error = _mm_set1_ps(float_at_or_below(MAX_BID_ASK_ERROR));
+
+	for (i = begin; i + 4 <= end; i += 4) {
+		active = open_mask_sse2(options->open + i);
+		if (_mm_movemask_ps(active) == 0)
+			continue;
+
+		bid = _mm_loadu_ps(options->bid + i);
+		ask = _mm_loadu_ps(options->ask + i);
+		error = _mm_div_ps(_mm_sub_ps(ask, bid), _mm_div_ps(_mm_add_ps(bid, ask), _mm_set1_ps(2)));
+
+		too_wide = _mm_and_ps(active, _mm_cmpgt_ps(error, max_error));
+		active = _mm_andnot_ps(too_wide, active);
+
+		_mm_storeu_ps(options->weight + i, select_ps(active, _mm_loadu_ps(options->weight + i),
+		              _mm_add_ps(_mm_loadu_ps(options->weight + i), _mm_mul_ps(error, _mm_set1_ps(50)))));
+
+		wide = _mm_movemask_ps(too_wide);
+		for (lane = 0; lane < 4; lane++) {
+			if (wide & (1 << lane)) {
+				options->open[i + lane] = FALSE;
+				(*closed)++;
+			}
+		}
+	}
+
+	return i;
+}
+
+/* All ones in each of the eight lanes whose open byte is set */
+__attribute__((target("avx2"))) static inline __m256 open_mask_avx2(const char *open) {
+	__m256i lanes = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)open));
+
+	return _mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpeq_epi32(lanes, _mm256_setzero_si256()), _mm256_set1_epi32(-1)));
+}
+
+/* curr_price * (iv / 100) * sqrt(dte / 365) in double, rounded to float, for eight lanes */
+__attribute__((target("avx2"))) static inline __m256 std_deviation_avx2(__m256d curr, __m256 iv, __m256i dte) {
+	__m256d low, high, hundred = _mm256_set1_pd(100), days = _mm256_set1_pd(365);
+
+	low = _mm256_mul_pd(_mm256_mul_pd(curr, _mm256_div_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(iv)), hundred)),
+	                    _mm256_sqrt_pd(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(dte)), days)));
+	high = _mm256_mul_pd(_mm256_mul_pd(curr, _mm256_div_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(iv, 1)), hundred)),
+	                     _mm256_sqrt_pd(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(dte, 1)), days)));
+
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)), _mm256_cvtpd_ps(high), 1);
+}
+
+/* Same steps as weight_sse2, eight lanes at a time. Built without fma so no multiply-add is ever fused */
+__attribute__((target("avx2"))) static long weight_avx2(struct OptionTable *options, long begin, long end, struct ParentStock *stock) {
+	long i;
+	__m256 active, strike, iv, weight, tier, perc, sel, std, range_low, range_high, in_range;
+	__m256i dte, over_30, over_91;
+	__m256 curr = _mm256_set1_ps(stock->curr_price), hundred = _mm256_set1_ps(100);
+	__m256 iv20 = _mm256_set1_ps(stock->iv20), iv50 = _mm256_set1_ps(stock->iv50), iv100 = _mm256_set1_ps(stock->iv100);
+	__m256 at_05 = _mm256_set1_ps(float_at_or_below(.05)), at_10 = _mm256_set1_ps(float_at_or_below(.1));
+	__m256 at_175 = _mm256_set1_ps(float_at_or_below(.175));
+	__m256d curr_d = _mm256_set1_pd(stock->curr_price);
+
+	for (i = begin; i + 8 <= end; i += 8) {
+		active = open_mask_avx2(options->open + i);
+		if (_mm256_movemask_ps(active) == 0)
+			continue;
+
+		dte = _mm256_loadu_si256((const __m256i *)(options->days_til_expiration + i));
+		strike = _mm256_loadu_ps(options->strike + i);
+		iv = _mm256_loadu_ps(options->implied_volatility + i);
+		weight = _mm256_loadu_ps(options->weight + i);
+
+		// perc_from_strike
+		perc = _mm256_mul_ps(_mm256_div_ps(_mm256_sub_ps(strike, curr), curr), hundred);
+		tier = _mm256_blendv_ps(_mm256_set1_ps(50), _mm256_set1_ps(75), _mm256_cmp_ps(perc, at_10, _CMP_LE_OQ));
+		tier = _mm256_blendv_ps(tier, _mm256_set1_ps(125), _mm256_cmp_ps(perc, at_05, _CMP_LE_OQ));
+		weight = _mm256_blendv_ps(weight, _mm256_add_ps(weight, _mm256_sub_ps(tier, perc)), _mm256_cmp_ps(perc, at_175, _CMP_LE_OQ));
+		_mm256_storeu_ps(options->perc_from_strike + i, _mm256_blendv_ps(_mm256_loadu_ps(options->perc_from_strike + i), perc, active));
+
+		// perc_from_ivs
+		_mm256_storeu_ps(options->perc_from_iv20 + i, _mm256_blendv_ps(_mm256_loadu_ps(options->perc_from_iv20 + i), _mm256_div_ps(_mm256_sub_ps(iv20, iv), iv20), active));
+		_mm256_storeu_ps(options->perc_from_iv50 + i, _mm256_blendv_ps(_mm256_loadu_ps(options->perc_from_iv50 + i), _mm256_div_ps(_mm256_sub_ps(iv50, iv), iv50), active));
+		_mm256_storeu_ps(options->perc_from_iv100 + i, _mm256_blendv_ps(_mm256_loadu_ps(options->perc_from_iv100 + i), _mm256_div_ps(_mm256_sub_ps(iv100, iv), iv100), active));
+
+		// dte buckets
+		over_30 = _mm256_cmpgt_epi32(dte, _mm256_set1_epi32(30));
+		over_91 = _mm256_cmpgt_epi32(dte, _mm256_set1_epi32(365 / 4));
+		sel = _mm256_blendv_ps(iv20, iv50, _mm256_castsi256_ps(over_30));
+		sel = _mm256_blendv_ps(sel, iv100, _mm256_castsi256_ps(over_91));
+
+		// one_std_deviation
+		std = std_deviation_avx2(curr_d, sel, dte);
+		range_low = _mm256_sub_ps(curr, std);
+		range_high = _mm256_add_ps(curr, std);
+		in_range = _mm256_and_ps(_mm256_cmp_ps(curr, range_low, _CMP_GT_OQ), _mm256_cmp_ps(curr, range_high, _CMP_LT_OQ));
+		weight = _mm256_blendv_ps(weight, _mm256_add_ps(weight, _mm256_mul_ps(_mm256_div_ps(_mm256_sub_ps(strike, range_low), std), hundred)), in_range);
+		_mm256_storeu_ps(options->one_std_deviation + i, _mm256_blendv_ps(_mm256_loadu_ps(options->one_std_deviation + i), std, active));
+
+		// iv_below
+		weight = _mm256_add_ps(weight, _mm256_mul_ps(_mm256_div_ps(_mm256_sub_ps(sel, iv), sel), hundred));
+
+		// dte_weight
+		weight = _mm256_add_ps(weight, _mm256_blendv_ps(_mm256_cvtepi32_ps(dte), hundred, _mm256_castsi256_ps(_mm256_cmpgt_epi32(dte, _mm256_set1_epi32(100)))));
+
+		_mm256_storeu_ps(options->weight + i, _mm256_blendv_ps(_mm256_loadu_ps(options->weight + i), weight, active));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2"))) static long spreads_avx2(struct OptionTable *options, long begin, long end, long *closed) {
+	int lane, wide;
+	long i;
+	__m256 active, bid, ask, error, too_wide, weight;
+	__m256 max_error = _mm256_set1_ps(float_at_or_below(MAX_BID_ASK_ERROR));
+
+	for (i = begin; i + 8 <= end; i += 8) {
+		active = open_mask_avx2(options->open + i);
+		if (_mm256_movemask_ps(active) == 0)
+			continue;
+
+		bid = _mm256_loadu_ps(options->bid + i);
+		ask = _mm256_loadu_ps(options->ask + i);
+		error = _mm256_div_ps(_mm256_sub_ps(ask, bid), _mm256_div_ps(_mm256_add_ps(bid, ask), _mm256_set1_ps(2)));
+
+		too_wide = _mm256_and_ps(active, _mm256_cmp_ps(error, max_error, _CMP_GT_OQ));
+		active = _mm256_andnot_ps(too_wide, active);
+
+		weight = _mm256_loadu_ps(options->weight + i);
+		_mm256_storeu_ps(options->weight + i, _mm256_blendv_ps(weight, _mm256_add_ps(weight, _mm256_mul_ps(error, _mm256_set1_ps(50))), active));
+
+		wide = _mm256_movemask_ps(too_wide);
+		for (lane = 0; lane < 8; lane++) {
+			if (wide & (1 << lane)) {
+				options->open[i + lane] = FALSE;
+				(*closed)++;
+			}
+		}
+	}
+
+	return i;
+}
+
+#endif
+
+/* weight_contracts on kernel */
+static void weight_block(struct OptionTable *options, long begin, long end, struct ParentStock *stock, enum WeightKernel kernel) {
+	long i = begin;
+
+	switch (kernel) {
+#ifdef WEIGHT_KERNEL_X86
+	case KERNEL_AVX2:
+		i = weight_avx2(options, begin, end, stock);
+		break;
+	case KERNEL_SSE2:
+		i = weight_sse2(options, begin, end, stock);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	// whatever is left over is less than one vector wide
+	for (; i < end; i++)
+		weight_row(options, i, stock);
+}
+
+/* screen_spreads on kernel */
+static long spreads_block(struct OptionTable *options, long begin, long end, enum WeightKernel kernel) {
+	long i = begin, closed = 0;
+
+	switch (kernel) {
+#ifdef WEIGHT_KERNEL_X86
+	case KERNEL_AVX2:
+		i = spreads_avx2(options, begin, end, &closed);
+		break;
+	case KERNEL_SSE2:
+		i = spreads_sse2(options, begin, end, &closed);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	for (; i < end; i++)
+		closed += spread_row(options, i);
+
+	return closed;
+}
+
+/* Warns about every value of one column the kernel and the scalar functions disagree on, NaNs aside */
+static void report_mismatches(struct ParentStock *stock, const char *column, const float *kernel, const float *scalar, long begin, long count) {
+	long i;
+
+	for (i = 0; i < count; i++) {
+		if (memcmp(&kernel[i], &scalar[i], sizeof(float)) != 0 && !(isnan(kernel[i]) && isnan(scalar[i])))
+			fprintf(stderr, "Warning: %s kernel gives %s row %ld %s %.9g, the scalar functions %.9g\n", weight_kernel_name(selected),
+			        stock->ticker, begin + i, column, kernel[i], scalar[i]);
+	}
+}
+
+/* Weights the block with the selected kernel, then again with the scalar functions from the same inputs, and compares */
+static void check_weights(struct OptionTable *options, long begin, long end, struct ParentStock *stock) {
+	int column;
+	long count = end - begin;
+	float *inputs, *kernel;
+
+	inputs = safe_malloc(WEIGHT_COLUMN_COUNT * count * sizeof(float));
+	kernel = safe_malloc(WEIGHT_COLUMN_COUNT * count * sizeof(float));
+
+	column = 0;
+#define WEIGHT_SAVE(name) memcpy(inputs + column++ * count, options->name + begin, count * sizeof(float));
+	WEIGHT_COLUMNS(WEIGHT_SAVE)
+#undef WEIGHT_SAVE
+
+	weight_block(options, begin, end, stock, selected);
+
+	// keep the kernel's columns aside and put the inputs back for the scalar pass
+	column = 0;
+#define WEIGHT_SWAP(name)                                                                \
+	memcpy(kernel + column * count, options->name + begin, count * sizeof(float));      \
+	memcpy(options->name + begin, inputs + column++ * count, count * sizeof(float));
+	WEIGHT_COLUMNS(WEIGHT_SWAP)
+#undef WEIGHT_SWAP
+
+	weight_block(options, begin, end, stock, KERNEL_SCALAR);
+
+	column = 0;
+#define WEIGHT_COMPARE(name)                                                                     \
+	report_mismatches(stock, #name, kernel + column * count, options->name + begin, begin, count); \
+	memcpy(options->name + begin, kernel + column++ * count, count * sizeof(float));
+	WEIGHT_COLUMNS(WEIGHT_COMPARE)
+#undef WEIGHT_COMPARE
+
+	free(kernel);
+	free(inputs);
+}
+
+/* Screens the block's spreads with the selected kernel, then again with the scalar function from the same rows, and compares */
+static long check_spreads(struct OptionTable *options, long begin, long end) {
+	long i, count = end - begin, closed, scalar_closed;
+	char *open;
+	float *weight;
+
+	// bid_ask_spread closes rows and adds to the weight of the ones it keeps
+	open = safe_malloc(2 * count);
+	weight = safe_malloc(2 * count * sizeof(float));
+
+	memcpy(open, options->open + begin, count);
+	memcpy(weight, options->weight + begin, count * sizeof(float));
+
+	closed = spreads_block(options, begin, end, selected);
+
+	memcpy(open + count, options->open + begin, count);
+	memcpy(weight + count, options->weight + begin, count * sizeof(float));
+	memcpy(options->open + begin, open, count);
+	memcpy(options->weight + begin, weight, count * sizeof(float));
+
+	scalar_closed = spreads_block(options, begin, end, KERNEL_SCALAR);
+
+	for (i = 0; i < count; i++) {
+		if (open[count + i] != options->open[begin + i])
+			fprintf(stderr, "Warning: %s kernel %s row %ld, the scalar function does not\n", weight_kernel_name(selected),
+			        (open[count + i] ? "keeps" : "closes"), begin + i);
+	}
+
+	if (closed != scalar_closed)
+		fprintf(stderr, "Warning: %s kernel closes %ld of rows [%ld, %ld), the scalar function %ld\n", weight_kernel_name(selected),
+		        closed, begin, end, scalar_closed);
+
+	for (i = 0; i < count; i++) {
+		if (memcmp(&weight[count + i], &options->weight[begin + i], sizeof(float)) != 0 && !(isnan(weight[count + i]) && isnan(options->weight[begin + i])))
+			fprintf(stderr, "Warning: %s kernel gives row %ld weight %.9g, the scalar function %.9g\n", weight_kernel_name(selected),
+			        begin + i, weight[count + i], options->weight[begin + i]);
+	}
+
+	memcpy(options->open + begin, open + count, count);
+	memcpy(options->weight + begin, weight + count, count * sizeof(float));
+
+	free(weight);
+	free(open);
+
+	return closed;
+}
+
+/* perc_from_strike, perc_from_ivs, one_std_deviation, iv_below and dte_weight on every open row of [begin, end) */
+void weight_contracts(struct OptionTable *options, long begin, long end, struct ParentStock *stock) {
+	if (weight_kernel() != KERNEL_SCALAR && checking && end > begin)
+		check_weights(options, begin, end, stock);
+	else
+		weight_block(options, begin, end, stock, weight_kernel());
+}
+
+/* bid_ask_spread on every open row of [begin, end), closing the ones that are too wide. Returns how many were closed */
+long screen_spreads(struct OptionTable *options, long begin, long end) {
+	if (weight_kernel() != KERNEL_SCALAR && checking && end > begin)
+		return check_spreads(options, begin, end);
+
+	return spreads_block(options, begin, end, weight_kernel());
+}
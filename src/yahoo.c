@@ -0,0 +1,575 @@
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/yahoo.h"
+#include "../include/json.h"
+#include "../include/general_stocks.h"
+#include "../include/options.h"
+#include "../include/safe.h"
+
+/* The columns of a chart result, in no particular order until every key has been seen */
+enum ChartSeries {
+   SERIES_TIMESTAMP,
+   SERIES_OPEN,
+   SERIES_LOW,
+   SERIES_HIGH,
+   SERIES_CLOSE,
+   SERIES_ADJCLOSE,
+   SERIES_VOLUME,
+   SERIES_COUNT
+};
+
+/* One column of a chart result, nulls kept as NaN so every column stays aligned with the timestamps */
+struct Series {
+   double *values;
+   long size;
+   long capacity;
+};
+
+/* Reads and throws away the next value, whatever it is */
+static int skip_value(struct JsonParser *parser) {
+	struct JsonToken token;
+
+	json_next(parser, &token);
+
+	return json_skip(parser, &token);
+}
+
+/* Reads the next key of the object being walked. FALSE at the end of the object, or on an error */
+static int next_key(struct JsonParser *parser, struct JsonToken *key) {
+	return json_next(parser, key) == JSON_KEY;
+}
+
+/* Reads the next value if it is of type, otherwise skips it and returns FALSE */
+static int expect(struct JsonParser *parser, enum JsonType type) {
+	struct JsonToken token;
+
+	if (json_next(parser, &token) == type)
+		return TRUE;
+
+	json_skip(parser, &token);
+
+	return FALSE;
+}
+
+/* Skips whatever is left of the object or array being walked, up to and including its end */
+static void skip_rest(struct JsonParser *parser, enum JsonType end) {
+	struct JsonToken token;
+
+	while (json_next(parser, &token) != end) {
+		if (!json_skip(parser, &token))
+			return;
+	}
+}
+
+/* Reads a number, or the raw number inside a formatted one. Anything else reads as NaN */
+static double read_value(struct JsonParser *parser) {
+	double value;
+	struct JsonToken token;
+
+	switch (json_next(parser, &token)) {
+	case JSON_NUMBER:
+		return token.number;
+	case JSON_TRUE:
+		return 1;
+	case JSON_FALSE:
+		return 0;
+	case JSON_OBJECT:
+		value = NAN;
+
+		while (next_key(parser, &token)) {
+			if (json_is(&token, "raw"))
+				value = read_value(parser);
+			else
+				skip_value(parser);
+		}
+
+		return value;
+	default:
+		json_skip(parser, &token);
+		return NAN;
+	}
+}
+
+/* Reads an array of numbers into series, replacing what it held */
+static void read_series(struct JsonParser *parser, struct Series *series) {
+	struct JsonToken token;
+
+	series->size = 0;
+
+	if (!expect(parser, JSON_ARRAY))
+		return;
+
+	while (json_next(parser, &token) != JSON_ARRAY_END) {
+		if (token.type == JSON_ERROR || token.type == JSON_END)
+			return;
+
+		if (series->size == series->capacity) {
+			series->capacity = (series->capacity ? series->capacity * 2 : 256);
+			series->values = safe_realloc(series->values, series->capacity * sizeof(double));
+		}
+
+		series->values[series->size++] = (token.type == JSON_NUMBER ? token.number : NAN);
+		json_skip(parser, &token);
+	}
+}
+
+/* Copies a string token into a ticker, cut to fit as the database loaders do */
+static void read_ticker(struct JsonToken *token, char *ticker) {
+	size_t length = (token->length < TICK_SIZE - 1 ? token->length : TICK_SIZE - 1);
+
+	memset(ticker, 0, TICK_SIZE);
+	memcpy(ticker, token->text, length);
+}
+
+/* Walks the first object of an array with walk, and skips the rest of the array */
+static void first_object(struct JsonParser *parser, void (*walk)(struct JsonParser *, void *), void *arg) {
+	struct JsonToken token;
+
+	if (!expect(parser, JSON_ARRAY))
+		return;
+
+	if (json_next(parser, &token) == JSON_OBJECT)
+		walk(parser, arg);
+	else if (token.type == JSON_ARRAY_END || !json_skip(parser, &token))
+		return;
+
+	skip_rest(parser, JSON_ARRAY_END);
+}
+
+/* Everything kept from one chart result */
+struct ChartResult {
+   char ticker[TICK_SIZE];
+   struct Series series[SERIES_COUNT];
+};
+
+static void chart_quote(struct JsonParser *parser, void *arg) {
+	struct ChartResult *result = arg;
+	struct JsonToken key;
+
+	while (next_key(parser, &key)) {
+		if (json_is(&key, "open"))
+			read_series(parser, &result->series[SERIES_OPEN]);
+		else if (json_is(&key, "low"))
+			read_series(parser, &result->series[SERIES_LOW]);
+		else if (json_is(&key, "high"))
+			read_series(parser, &result->series[SERIES_HIGH]);
+		else if (json_is(&key, "close"))
+			read_series(parser, &result->series[SERIES_CLOSE]);
+		else if (json_is(&key, "volume"))
+			read_series(parser, &result->series[SERIES_VOLUME]);
+		else
+			skip_value(parser);
+	}
+}
+
+static void chart_adjclose(struct JsonParser *parser, void *arg) {
+	struct ChartResult *result = arg;
+	struct JsonToken key;
+
+	while (next_key(parser, &key)) {
+		if (json_is(&key, "adjclose"))
+			read_series(parser, &result->series[SERIES_ADJCLOSE]);
+		else
+			skip_value(parser);
+	}
+}
+
+static void chart_result(struct JsonParser *parser, void *arg) {
+	struct ChartResult *result = arg;
+	struct JsonToken key, token;
+
+	while (next_key(parser, &key)) {
+		if (json_is(&key, "meta") && expect(parser, JSON_OBJECT)) {
+			while (next_key(parser, &key)) {
+				if (json_is(&key, "symbol")) {
+					if (json_next(parser, &token) == JSON_STRING)
+						read_ticker(&token, result->ticker);
+					else
+						json_skip(parser, &token);
+				}
+				else
+					skip_value(parser);
+			}
+		}
+		else if (json_is(&key, "timestamp"))
+			read_series(parser, &result->series[SERIES_TIMESTAMP]);
+		else if (json_is(&key, "indicators") && expect(parser, JSON_OBJECT)) {
+			while (next_key(parser, &key)) {
+				if (json_is(&key, "quote"))
+					first_object(parser, chart_quote, result);
+				else if (json_is(&key, "adjclose"))
+					first_object(parser, chart_adjclose, result);
+				else
+					skip_value(parser);
+			}
+		}
+		else if (!json_is(&key, "meta") && !json_is(&key, "indicators"))
+			skip_value(parser);
+	}
+}
+
+/*
+ * Appends the daily bars of one v8/finance/chart response to the price table, tagged with the
+ * ticker's symbol id. Closes are adjusted, as the collector has always stored them, and a bar with
+ * any value missing is left out. Returns FALSE if the response could not be read.
+ */
+int yahoo_parse_chart(const char *data, size_t size, struct SymbolTable *symbols, struct PriceTable *prices) {
+	int id, series, valid;
+	long i, row;
+	double *close;
+	struct JsonParser parser;
+	struct JsonToken key;
+	struct ChartResult result;
+
+	memset(&result, 0, sizeof(struct ChartResult));
+	json_init(&parser, data, size);
+
+	if (expect(&parser, JSON_OBJECT)) {
+		while (next_key(&parser, &key)) {
+			if (!json_is(&key, "chart") || !expect(&parser, JSON_OBJECT)) {
+				if (!json_is(&key, "chart"))
+					skip_value(&parser);
+				continue;
+			}
+
+			while (next_key(&parser, &key)) {
+				if (json_is(&key, "result"))
+					first_object(&parser, chart_result, &result);
+				else
+					skip_value(&parser);
+			}
+		}
+	}
+
+	valid = (!parser.failed && result.ticker[0] != '\0');
+
+	if (valid) {
+		id = symbol_intern(symbols, result.ticker);
+		close = (result.series[SERIES_ADJCLOSE].size ? result.series[SERIES_ADJCLOSE].values : result.series[SERIES_CLOSE].values);
+
+		for (i = 0; i < result.series[SERIES_TIMESTAMP].size; i++) {
+			if (i >= result.series[SERIES_OPEN].size || i >= result.series[SERIES_LOW].size || i >= result.series[SERIES_HIGH].size ||
+			    i >= result.series[SERIES_VOLUME].size || i >= (result.series[SERIES_ADJCLOSE].size ? result.series[SERIES_ADJCLOSE].size : result.series[SERIES_CLOSE].size))
+				break;
+			if (isnan(result.series[SERIES_OPEN].values[i]) || isnan(result.series[SERIES_LOW].values[i]) || isnan(result.series[SERIES_HIGH].values[i]) ||
+			    isnan(result.series[SERIES_VOLUME].values[i]) || isnan(close[i]))
+				continue;
+
+			row = price_table_append(prices);
+
+			prices->parent[row] = id;
+			prices->date[row] = result.series[SERIES_TIMESTAMP].values[i];
+			prices->open[row] = result.series[SERIES_OPEN].values[i];
+			prices->low[row] = result.series[SERIES_LOW].values[i];
+			prices->high[row] = result.series[SERIES_HIGH].values[i];
+			prices->close[row] = close[i];
+			prices->volume[row] = result.series[SERIES_VOLUME].values[i];
+		}
+	}
+
+	for (series = 0; series < SERIES_COUNT; series++)
+		free(result.series[series].values);
+
+	return valid;
+}
+
+/* Where an options response is being appended to */
+struct ChainLoad {
+   char ticker[TICK_SIZE];
+   time_t today;
+   struct OptionTable *options;
+};
+
+/* Appends one contract, unless it has no strike or expiration */
+static void chain_contract(struct JsonParser *parser, struct ChainLoad *load, char type) {
+	long row;
+	double strike, expiration, volume, open_interest, bid, ask, last_price, percent_change, implied_volatility;
+	struct JsonToken key;
+	struct OptionTable *options = load->options;
+
+	strike = expiration = volume = open_interest = bid = ask = last_price = percent_change = implied_volatility = NAN;
+
+	while (next_key(parser, &key)) {
+		if (json_is(&key, "strike"))
+			strike = read_value(parser);
+		else if (json_is(&key, "expiration"))
+			expiration = read_value(parser);
+		else if (json_is(&key, "volume"))
+			volume = read_value(parser);
+		else if (json_is(&key, "openInterest"))
+			open_interest = read_value(parser);
+		else if (json_is(&key, "bid"))
+			bid = read_value(parser);
+		else if (json_is(&key, "ask"))
+			ask = read_value(parser);
+		else if (json_is(&key, "lastPrice"))
+			last_price = read_value(parser);
+		else if (json_is(&key, "percentChange"))
+			percent_change = read_value(parser);
+		else if (json_is(&key, "impliedVolatility"))
+			implied_volatility = read_value(parser);
+		else
+			skip_value(parser);
+	}
+
+	if (isnan(strike) || isnan(expiration))
+		return;
+
+	row = option_table_append(options);
+
+	// anything else Yahoo leaves out reads as 0, the way a NULL column does from the database
+	options->parent[row] = NO_SYMBOL;
+	options->type[row] = type;
+	options->expiration_date[row] = expiration;
+	options->days_til_expiration[row] = ceil((expiration - load->today) / 86400);
+	options->strike[row] = strike;
+	options->volume[row] = (isnan(volume) ? 0 : volume);
+	options->open_interest[row] = (isnan(open_interest) ? 0 : open_interest);
+	options->bid[row] = (isnan(bid) ? 0 : bid);
+	options->ask[row] = (isnan(ask) ? 0 : ask);
+	options->last_price[row] = (isnan(last_price) ? 0 : last_price);
+	options->percent_change[row] = (isnan(percent_change) ? 0 : percent_change);
+	options->implied_volatility[row] = (isnan(implied_volatility) ? 0 : implied_volatility * 100);
+}
+
+static void chain_contracts(struct JsonParser *parser, struct ChainLoad *load, char type) {
+	struct JsonToken token;
+
+	if (!expect(parser, JSON_ARRAY))
+		return;
+
+	while (json_next(parser, &token) != JSON_ARRAY_END) {
+		if (token.type == JSON_OBJECT)
+			chain_contract(parser, load, type);
+		else if (!json_skip(parser, &token))
+			return;
+	}
+}
+
+static void chain_expiration(struct JsonParser *parser, struct ChainLoad *load) {
+	struct JsonToken key;
+
+	while (next_key(parser, &key)) {
+		if (json_is(&key, "calls"))
+			chain_contracts(parser, load, TRUE);
+		else if (json_is(&key, "puts"))
+			chain_contracts(parser, load, FALSE);
+		else
+			skip_value(parser);
+	}
+}
+
+static void chain_result(struct JsonParser *parser, void *arg) {
+	struct ChainLoad *load = arg;
+	struct JsonToken key, token;
+
+	while (next_key(parser, &key)) {
+		if (json_is(&key, "underlyingSymbol")) {
+			if (json_next(parser, &token) == JSON_STRING)
+				read_ticker(&token, load->ticker);
+			else
+				json_skip(parser, &token);
+		}
+		else if (json_is(&key, "options") && expect(parser, JSON_ARRAY)) {
+			while (json_next(parser, &token) != JSON_ARRAY_END) {
+				if (token.type == JSON_OBJECT)
+					chain_expiration(parser, load);
+				else if (!json_skip(parser, &token))
+					break;
+			}
+		}
+		else if (!json_is(&key, "options"))
+			skip_value(parser);
+	}
+}
+
+/*
+ * Appends every contract of one v7/finance/options response to the option table, tagged with the
+ * ticker's symbol id. Days to expiration count from today, midnight local time. Returns FALSE, with
+ * nothing appended, if the response could not be read.
+ */
+int yahoo_parse_options(const char *data, size_t size, time_t today, struct SymbolTable *symbols, struct OptionTable *options) {
+	int id;
+	long begin, row;
+	struct JsonParser parser;
+	struct JsonToken key;
+	struct ChainLoad load;
+
+	memset(load.ticker, 0, TICK_SIZE);
+	load.today = today;
+	load.options = options;
+	begin = options->size;
+
+	json_init(&parser, data, size);
+
+	if (expect(&parser, JSON_OBJECT)) {
+		while (next_key(&parser, &key)) {
+			if (!json_is(&key, "optionChain") || !expect(&parser, JSON_OBJECT)) {
+				if (!json_is(&key, "optionChain"))
+					skip_value(&parser);
+				continue;
+			}
+
+			while (next_key(&parser, &key)) {
+				if (json_is(&key, "result"))
+					first_object(&parser, chain_result, &load);
+				else
+					skip_value(&parser);
+			}
+		}
+	}
+
+	// the symbol can come after the contracts, so they are only tagged once the whole response is read
+	if (parser.failed || load.ticker[0] == '\0') {
+		options->size = begin;
+		return FALSE;
+	}
+
+	id = symbol_intern(symbols, load.ticker);
+	for (row = begin; row < options->size; row++)
+		options->parent[row] = id;
+
+	return TRUE;
+}
+
+/* Maps a whole file read only. Returns FALSE if it cannot be read or is empty */
+static int map_file(const char *filename, char **data, size_t *size) {
+	int fd;
+	struct stat st;
+
+	if ((fd = open(filename, O_RDONLY)) < 0)
+		return FALSE;
+
+	if (fstat(fd, &st) < 0 || st.st_size == 0 || (*data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return FALSE;
+	}
+
+	*size = st.st_size;
+	close(fd);
+
+	return TRUE;
+}
+
+static int has_suffix(const char *name, const char *suffix) {
+	size_t length = strlen(name), suffix_length = strlen(suffix);
+
+	return length > suffix_length && strcmp(name + length - suffix_length, suffix) == 0;
+}
+
+/* Midnight this morning, local time, which the collector has always counted days to expiration from */
+static time_t start_of_today(void) {
+	time_t now = time(NULL);
+	struct tm tm;
+
+	localtime_r(&now, &tm);
+	tm.tm_hour = 0;
+	tm.tm_min = 0;
+	tm.tm_sec = 0;
+	tm.tm_isdst = -1;
+
+	return mktime(&tm);
+}
+
+/* Reads ticker,iv20,iv50,iv100 lines into a table indexed by symbol id. Tickers with no payloads are skipped */
+static void gather_raw_volatility(const char *directory, struct SymbolTable *symbols, struct TickerVolatility *volatility) {
+	int id;
+	char path[PATH_MAX], line[256], ticker[TICK_SIZE];
+	float iv20, iv50, iv100;
+	FILE *file;
+
+	snprintf(path, sizeof(path), "%s/%s", directory, YAHOO_VOLATILITY_FILE);
+
+	if ((file = fopen(path, "r")) == NULL)
+		return;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		memset(ticker, 0, TICK_SIZE);
+
+		if (sscanf(line, "%9[^,],%f,%f,%f", ticker, &iv20, &iv50, &iv100) != 4)
+			continue;
+		if ((id = symbol_lookup(symbols, ticker)) == NO_SYMBOL)
+			continue;
+
+		volatility[id].iv20 = iv20;
+		volatility[id].iv50 = iv50;
+		volatility[id].iv100 = iv100;
+	}
+
+	fclose(file);
+}
+
+/*
+ * Loads the universe from a directory of raw Yahoo responses instead of the databases. Files are
+ * read in name order, so tickers come out in the same order every time.
+ */
+void gather_raw(struct Universe *universe, const char *directory) {
+	int i, count, *parent_of;
+	long outter_i, inner_i;
+	char path[PATH_MAX], *data;
+	size_t size;
+	time_t today;
+	struct dirent **entries;
+	struct ParentStock *stock;
+	struct TickerVolatility *volatility;
+	struct OptionTable *options = &universe->options;
+
+	if ((count = scandir(directory, &entries, NULL, alphasort)) < 0) {
+		perror(directory);
+		entries = NULL;
+		count = 0;
+	}
+
+	today = start_of_today();
+
+	for (i = 0; i < count; i++) {
+		snprintf(path, sizeof(path), "%s/%s", directory, entries[i]->d_name);
+
+		if (has_suffix(entries[i]->d_name, YAHOO_CHART_SUFFIX) || has_suffix(entries[i]->d_name, YAHOO_OPTIONS_SUFFIX)) {
+			if (!map_file(path, &data, &size))
+				fprintf(stderr, "Warning: Unable to read %s\n", path);
+			else {
+				if (!(has_suffix(entries[i]->d_name, YAHOO_CHART_SUFFIX) ? yahoo_parse_chart(data, size, &universe->symbols, &universe->prices)
+				                                                          : yahoo_parse_options(data, size, today, &universe->symbols, options)))
+					fprintf(stderr, "Warning: Unable to read %s\n", path);
+
+				munmap(data, size);
+			}
+		}
+
+		free(entries[i]);
+	}
+
+	free(entries);
+
+	volatility = safe_calloc((universe->symbols.size ? universe->symbols.size : 1), sizeof(struct TickerVolatility));
+	gather_raw_volatility(directory, &universe->symbols, volatility);
+
+	parent_of = link_tickers(universe, volatility, universe->symbols.size);
+
+	// Yahoo's own inTheMoney is ignored, as the collector always did, in favour of the last close
+	for (outter_i = 0; outter_i < universe->parent_array_size; outter_i++) {
+		stock = universe->parent_array[outter_i];
+
+		for (inner_i = stock->calls_begin; inner_i < stock->calls_end; inner_i++)
+			options->in_the_money[inner_i] = (options->strike[inner_i] <= stock->curr_price);
+		for (inner_i = stock->puts_begin; inner_i < stock->puts_end; inner_i++)
+			options->in_the_money[inner_i] = (options->strike[inner_i] >= stock->curr_price);
+	}
+
+	free(volatility);
+	free(parent_of);
+}
@@ -0,0 +1,288 @@
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/archive.h"
+#include "../include/universe.h"
+#include "../include/option_table.h"
+#include "../include/price_table.h"
+#include "../include/arena.h"
+
+/*
+ * Archives a small universe with archive_append into a scratch directory and reads every ticker
+ * back with archive_open, archive_find and archive_read, comparing each archived column bit for bit.
+ * One stock's quotes are all whole cents, one has volatilities and a NaN that only the XOR codec
+ * keeps, and one has no contracts at all. Then the day is appended again, which must leave it as
+ * it was, and one block is damaged, which must fail that ticker's read alone.
+ * Usage: archive_check. Exits non-zero on any mismatch.
+ */
+
+#define CHECK_DATE 20231114
+#define CHECK_EXPIRATION 1700179200
+
+/* One stock of the universe, and how many calls and puts it has */
+struct StockCase {
+   const char *ticker;
+   int calls;
+   int puts;
+   int cents;                 // every decimal column is whole cents
+};
+
+// out of name order, the segment sorts them
+static const struct StockCase stocks[] = {
+	{ "MSFT", 3, 2, FALSE },
+	{ "AAPL", 4, 4, TRUE },
+	{ "ZERO", 0, 0, TRUE }
+};
+
+#define STOCK_COUNT (long)(sizeof(stocks) / sizeof(stocks[0]))
+
+static int failures = 0;
+
+static void fail(const char *ticker, const char *what) {
+	fprintf(stderr, "%s: %s\n", ticker, what);
+	failures++;
+}
+
+/* Fills row, the kth contract of a stock, with values that change from one row to the next */
+static void fill_contract(struct OptionTable *options, long row, long k, int call, int cents) {
+	options->type[row] = call;
+	options->in_the_money[row] = (k % 3 == 0);
+	options->expiration_date[row] = CHECK_EXPIRATION + (k / 2) * 604800;
+	options->days_til_expiration[row] = 3 + (k / 2) * 7;
+	options->strike[row] = (float)((17500 + 250 * k) / 100.0);
+	options->volume[row] = 1000 * k + 17;
+	options->open_interest[row] = 50000 - 313 * k;
+	options->bid[row] = (float)((105 + 10 * k) / 100.0);
+	options->ask[row] = (float)((112 + 10 * k) / 100.0);
+	options->last_price[row] = (float)((108 + 10 * k) / 100.0);
+	options->percent_change[row] = (float)((37 * k - 50) / 100.0);
+	options->implied_volatility[row] = (float)((2510 + 7 * k) / 100.0);
+
+	if (!cents) {
+		options->implied_volatility[row] = 25.1234f + 0.3f * k;
+		options->percent_change[row] = (k == 1 ? NAN : -1.0f / (k + 3));
+	}
+}
+
+/* A universe of the stock cases, with one bar each on CHECK_DATE so that is the day it archives as */
+static void build_universe(struct Universe *universe) {
+	long i, k, row;
+	struct ParentStock *stock;
+
+	universe_init(universe);
+	symbol_table_init(&universe->symbols, &universe->arena);
+	price_table_init(&universe->prices, &universe->arena);
+	option_table_init(&universe->options, &universe->arena);
+
+	universe->parent_array = arena_calloc(&universe->arena, STOCK_COUNT, sizeof(struct ParentStock *));
+	universe->parent_array_size = STOCK_COUNT;
+
+	for (i = 0; i < STOCK_COUNT; i++) {
+		stock = universe->parent_array[i] = arena_calloc(&universe->arena, 1, sizeof(struct ParentStock));
+		strncpy(stock->ticker, stocks[i].ticker, TICK_SIZE - 1);
+		stock->curr_price = 180 + i;
+		stock->iv20 = 20.5f + i;
+		stock->iv50 = 21.5f + i;
+		stock->iv100 = 22.5f + i;
+
+		stock->prices_begin = universe->prices.size;
+		row = price_table_append(&universe->prices);
+		universe->prices.parent[row] = i;
+		universe->prices.date[row] = archive_time(CHECK_DATE, 0) + 16 * 3600;
+		universe->prices.close[row] = stock->curr_price;
+		stock->prices_end = universe->prices.size;
+
+		stock->calls_begin = universe->options.size;
+		for (k = 0; k < stocks[i].calls + stocks[i].puts; k++) {
+			if (k == stocks[i].calls)
+				stock->calls_end = stock->puts_begin = universe->options.size;
+
+			row = option_table_append(&universe->options);
+			universe->options.parent[row] = i;
+			fill_contract(&universe->options, row, k, k < stocks[i].calls, stocks[i].cents);
+		}
+
+		if (stocks[i].calls + stocks[i].puts == stocks[i].calls)
+			stock->calls_end = stock->puts_begin = universe->options.size;
+		stock->puts_end = universe->options.size;
+	}
+}
+
+/* Compares one ticker's index entry and every row archive_read gave back to the universe it was written from */
+static void check_ticker(struct Universe *universe, struct ArchiveDay *day, long i, struct OptionTable *read) {
+	long k, row, first;
+	struct ParentStock *stock = universe->parent_array[i];
+	struct ArchiveTicker *entry;
+	struct OptionTable *options = &universe->options;
+
+	if ((entry = archive_find(day, stock->ticker)) == NULL) {
+		fail(stock->ticker, "not in the index");
+		return;
+	}
+
+	if (entry->call_count != stocks[i].calls || entry->put_count != stocks[i].puts)
+		fail(stock->ticker, "wrong call or put count");
+	if (entry->curr_price != stock->curr_price || entry->iv20 != stock->iv20 || entry->iv50 != stock->iv50 || entry->iv100 != stock->iv100)
+		fail(stock->ticker, "wrong price or volatility");
+
+	first = read->size;
+
+	if (!archive_read(day, entry, read, i)) {
+		fail(stock->ticker, "block did not read");
+		return;
+	}
+
+	if (read->size - first != stock->puts_end - stock->calls_begin) {
+		fail(stock->ticker, "wrong row count");
+		return;
+	}
+
+	for (k = 0; k < read->size - first; k++) {
+		row = stock->calls_begin + k;
+
+		if (read->parent[first + k] != i || read->type[first + k] != options->type[row])
+			fail(stock->ticker, "wrong parent or type");
+
+#define CHECK_COLUMN(type, name, kind)                                                   \
+		if (memcmp(&read->name[first + k], &options->name[row], sizeof(type)) != 0)     \
+			fail(stock->ticker, "wrong " #name);
+		ARCHIVE_COLUMNS(CHECK_COLUMN)
+#undef CHECK_COLUMN
+	}
+}
+
+/* Opens the day and checks every ticker, TRUE if the day opened */
+static int check_day(struct Universe *universe, const char *directory) {
+	long i;
+	struct Arena arena;
+	struct OptionTable read;
+	struct ArchiveDay day;
+
+	if (!archive_open(&day, directory, CHECK_DATE)) {
+		fail("segment", "did not open");
+		return FALSE;
+	}
+
+	if (day.header->ticker_count != STOCK_COUNT || day.header->row_count != universe->options.size)
+		fail("segment", "wrong ticker or row count");
+
+	for (i = 1; i < day.header->ticker_count; i++) {
+		if (strncmp(day.tickers[i - 1].ticker, day.tickers[i].ticker, TICK_SIZE) >= 0)
+			fail("segment", "index out of name order");
+	}
+
+	if (archive_find(&day, "NONE") != NULL)
+		fail("NONE", "found though it was never archived");
+
+	arena_init(&arena);
+	option_table_init(&read, &arena);
+
+	for (i = 0; i < STOCK_COUNT; i++)
+		check_ticker(universe, &day, i, &read);
+
+	arena_free(&arena);
+	archive_close(&day);
+
+	return TRUE;
+}
+
+/* Overwrites the first column length of ticker's block, so the block claims more bytes than it has */
+static void damage_block(const char *directory, const char *ticker) {
+	int fd;
+	char path[1024];
+	uint32_t length = UINT32_MAX;
+	struct ArchiveDay day;
+	struct ArchiveTicker *entry;
+
+	if (!archive_open(&day, directory, CHECK_DATE) || (entry = archive_find(&day, ticker)) == NULL) {
+		fail(ticker, "could not be found to damage");
+		return;
+	}
+
+	snprintf(path, sizeof(path), "%s/%08d%s", directory, CHECK_DATE, ARCHIVE_SUFFIX);
+
+	if ((fd = open(path, O_WRONLY)) < 0 || pwrite(fd, &length, sizeof(uint32_t), entry->offset + 1) != sizeof(uint32_t))
+		fail(ticker, "could not be damaged");
+
+	if (fd >= 0)
+		close(fd);
+
+	archive_close(&day);
+}
+
+/* A damaged block fails its own read and leaves the table as it was, while the other tickers still read */
+static void check_damage(struct Universe *universe, const char *directory) {
+	long i, before;
+	struct Arena arena;
+	struct OptionTable read;
+	struct ArchiveDay day;
+	struct ArchiveTicker *entry;
+
+	damage_block(directory, "AAPL");
+
+	if (!archive_open(&day, directory, CHECK_DATE)) {
+		fail("segment", "did not open once a block was damaged");
+		return;
+	}
+
+	arena_init(&arena);
+	option_table_init(&read, &arena);
+
+	for (i = 0; i < STOCK_COUNT; i++) {
+		if (strcmp(stocks[i].ticker, "AAPL") != 0) {
+			check_ticker(universe, &day, i, &read);
+			continue;
+		}
+
+		before = read.size;
+		entry = archive_find(&day, "AAPL");
+
+		if (entry == NULL || archive_read(&day, entry, &read, i) || read.size != before)
+			fail("AAPL", "damaged block read, or left rows behind");
+	}
+
+	arena_free(&arena);
+	archive_close(&day);
+}
+
+int main(void) {
+	char directory[] = "/tmp/archive_check.XXXXXX", path[1024];
+	struct Universe universe;
+
+	if (mkdtemp(directory) == NULL) {
+		perror(directory);
+		return EXIT_FAILURE;
+	}
+
+	setenv(ARCHIVE_ENV, directory, 1);
+	build_universe(&universe);
+
+	archive_append(&universe);
+
+	if (check_day(&universe, directory)) {
+		// the day is written already, so a changed chain is not appended over it
+		universe.options.bid[0] += 1;
+		archive_append(&universe);
+		universe.options.bid[0] -= 1;
+		check_day(&universe, directory);
+
+		check_damage(&universe, directory);
+	}
+
+	snprintf(path, sizeof(path), "%s/%08d%s", directory, CHECK_DATE, ARCHIVE_SUFFIX);
+	unlink(path);
+	rmdir(directory);
+	arena_free(&universe.arena);
+
+	printf("archive_check: %ld tickers, %d failures\n", STOCK_COUNT, failures);
+
+	return (failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
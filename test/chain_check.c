@@ -0,0 +1,310 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/chain_index.h"
+#include "../include/option_table.h"
+#include "../include/greeks.h"
+#include "../include/arena.h"
+
+/*
+ * Builds the chain index over generated chains and checks every lookup against a linear scan of
+ * the stock's rows. The chains have gaps in their strikes, strikes with only a call or only a put,
+ * repeated contracts and rows in no particular order. Each expiration has one volatility, so call
+ * deltas fall as the strike rises, as chain_nearest_delta assumes.
+ * Usage: chain_check. Exits non-zero on any mismatch.
+ */
+
+#define CHECK_STOCKS 4
+#define CHECK_EXPIRIES 5
+#define CHECK_STRIKES 24            // at most, per expiration
+#define CHECK_EXPIRATION 1700179200
+#define CHECK_WEEK 604800
+
+static const float prices[] = { 3.1f, 47.5f, 100, 512.25f };
+static const float deltas[] = { -1.2f, -0.9f, -0.5f, -0.25f, -0.05f, 0.05f, 0.25f, 0.5f, 0.75f, 0.95f, 1.2f };
+
+static unsigned long seed = 12345;
+static int failures = 0;
+
+/* The next of a fixed sequence of numbers in [0, n) */
+static long next(long n) {
+	seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+
+	return (long)((seed >> 33) % n);
+}
+
+static void fail(const char *stock, const char *lookup, double key, long got, long expected) {
+	fprintf(stderr, "%s: %s(%g) is %ld, expected %ld\n", stock, lookup, key, got, expected);
+	failures++;
+}
+
+/* Appends one generated contract */
+static void append_contract(struct OptionTable *options, int parent, char type, long expiry, float strike, float volatility) {
+	long row = option_table_append(options);
+
+	options->parent[row] = parent;
+	options->type[row] = type;
+	options->expiration_date[row] = CHECK_EXPIRATION + expiry * CHECK_WEEK;
+	options->days_til_expiration[row] = 3 + 7 * expiry;
+	options->strike[row] = strike;
+	options->implied_volatility[row] = volatility;
+}
+
+/* Swaps every column of two rows */
+static void swap_rows(struct OptionTable *options, long a, long b) {
+#define SWAP_COLUMN(type, name) { type t = options->name[a]; options->name[a] = options->name[b]; options->name[b] = t; }
+	OPTION_TABLE_COLUMNS(SWAP_COLUMN)
+#undef SWAP_COLUMN
+}
+
+static void shuffle(struct OptionTable *options, long begin, long end) {
+	long i;
+
+	for (i = end - 1; i > begin; i--)
+		swap_rows(options, i, begin + next(i - begin + 1));
+}
+
+/* One stock's calls then puts, shuffled within each side */
+static void generate_stock(struct OptionTable *options, struct ParentStock *stock, int parent) {
+	int side;
+	long expiry, k, strikes, has, repeated;
+	float step, strike, volatility;
+
+	step = (stock->curr_price < 10 ? 0.5f : (stock->curr_price < 200 ? 2.5f : 10));
+
+	for (side = 1; side >= 0; side--) {
+		if (side)
+			stock->calls_begin = options->size;
+		else
+			stock->calls_end = stock->puts_begin = options->size;
+
+		// the same sequence for both sides, so each strike's two halves are decided together
+		seed = 777 + parent;
+
+		for (expiry = 0; expiry < CHECK_EXPIRIES; expiry++) {
+			strikes = 4 + next(CHECK_STRIKES - 4);
+			strike = stock->curr_price - step * (strikes / 2) - step * next(3);
+			volatility = 20 + 5 * expiry;
+
+			for (k = 0; k < strikes; k++, strike += step * (1 + (next(4) == 0))) {
+				// 1 call only, 2 put only, 3 both, and now and then a repeated contract
+				has = 1 + next(3);
+				repeated = (next(10) == 0);
+				if (strike <= 0 || !(has & (side ? 1 : 2)))
+					continue;
+
+				append_contract(options, parent, side, expiry, strike, volatility);
+				if (repeated)
+					append_contract(options, parent, side, expiry, strike, volatility);
+			}
+		}
+	}
+
+	stock->puts_end = options->size;
+
+	seed = 99 + parent;
+	shuffle(options, stock->calls_begin, stock->calls_end);
+	shuffle(options, stock->puts_begin, stock->puts_end);
+}
+
+/* The expected answers, from the stock's rows alone */
+static long scan_expiry(struct ChainIndex *chains, struct ParentStock *stock, long expiration_date) {
+	long e;
+
+	for (e = stock->expiries_begin; e < stock->expiries_end; e++) {
+		if (chains->expiration_date[e] == expiration_date)
+			return e;
+	}
+
+	return -1;
+}
+
+/* The first row of type at expiration and strike, CHAIN_NO_ROW if there is none */
+static long scan_contract(struct OptionTable *options, struct ParentStock *stock, char type, long expiration_date, float strike) {
+	long row;
+
+	for (row = stock->calls_begin; row < stock->puts_end; row++) {
+		if (options->type[row] == type && options->expiration_date[row] == expiration_date && options->strike[row] == strike)
+			return row;
+	}
+
+	return CHAIN_NO_ROW;
+}
+
+/* The closest strike to price at expiration, the lower on a tie */
+static float scan_nearest_strike(struct OptionTable *options, struct ParentStock *stock, long expiration_date, float price) {
+	long row;
+	float best = NAN;
+
+	for (row = stock->calls_begin; row < stock->puts_end; row++) {
+		if (options->expiration_date[row] != expiration_date)
+			continue;
+
+		if (isnan(best) || fabsf(options->strike[row] - price) < fabsf(best - price) ||
+		    (fabsf(options->strike[row] - price) == fabsf(best - price) && options->strike[row] < best))
+			best = options->strike[row];
+	}
+
+	return best;
+}
+
+/* How many distinct strikes at expiration lie in [low, high] */
+static long scan_window(struct OptionTable *options, struct ParentStock *stock, long expiration_date, float low, float high) {
+	long row, other, count = 0;
+
+	for (row = stock->calls_begin; row < stock->puts_end; row++) {
+		if (options->expiration_date[row] != expiration_date || options->strike[row] < low || options->strike[row] > high)
+			continue;
+
+		// counted at its first row only
+		for (other = stock->calls_begin; other < row; other++) {
+			if (options->expiration_date[other] == expiration_date && options->strike[other] == options->strike[row])
+				break;
+		}
+
+		count += (other == row);
+	}
+
+	return count;
+}
+
+/* The row of type at expiration with the delta closest to delta, the lower strike, then the first row, on a tie */
+static long scan_nearest_delta(struct OptionTable *options, struct ParentStock *stock, long expiration_date, char type, float delta) {
+	long row, best = CHAIN_NO_ROW;
+	float distance, best_distance = INFINITY;
+
+	for (row = stock->calls_begin; row < stock->puts_end; row++) {
+		if (options->type[row] != type || options->expiration_date[row] != expiration_date)
+			continue;
+
+		distance = fabsf(options->delta[row] - delta);
+
+		if (best == CHAIN_NO_ROW || distance < best_distance || (distance == best_distance && options->strike[row] < options->strike[best])) {
+			best = row;
+			best_distance = distance;
+		}
+	}
+
+	return best;
+}
+
+static void check_stock(struct ChainIndex *chains, struct OptionTable *options, struct ParentStock *stock) {
+	int type;
+	unsigned long d;
+	long e, expected, rung, row, begin, end, got;
+	float strike, low, high, price;
+
+	// every expiration, and a week before the first and after the last that it does not have
+	for (e = -1; e <= CHECK_EXPIRIES; e++) {
+		expected = scan_expiry(chains, stock, CHECK_EXPIRATION + e * CHECK_WEEK);
+		got = chain_expiry(chains, stock, CHECK_EXPIRATION + e * CHECK_WEEK);
+
+		if (got != expected || (e >= 0 && e < CHECK_EXPIRIES && got != stock->expiries_begin + e))
+			fail(stock->ticker, "chain_expiry", e, got, expected);
+	}
+
+	for (e = stock->expiries_begin; e < stock->expiries_end; e++) {
+		for (rung = chains->rungs_begin[e] + 1; rung < chains->rungs_end[e]; rung++) {
+			if (!(chains->strike[rung - 1] < chains->strike[rung]))
+				fail(stock->ticker, "rung order", chains->strike[rung], rung, rung - 1);
+		}
+	}
+
+	// every contract is found at its rung, which holds the first row of it
+	for (row = stock->calls_begin; row < stock->puts_end; row++) {
+		e = chain_expiry(chains, stock, options->expiration_date[row]);
+		rung = chain_rung(chains, e, options->strike[row]);
+
+		if (rung < 0) {
+			fail(stock->ticker, "chain_rung", options->strike[row], rung, row);
+			continue;
+		}
+
+		got = (options->type[row] ? chains->call : chains->put)[rung];
+		expected = scan_contract(options, stock, options->type[row], options->expiration_date[row], options->strike[row]);
+
+		if (got != expected)
+			fail(stock->ticker, (options->type[row] ? "call" : "put"), options->strike[row], got, expected);
+
+		// the other side is there exactly when the stock has it
+		got = (options->type[row] ? chains->put : chains->call)[rung];
+		expected = scan_contract(options, stock, !options->type[row], options->expiration_date[row], options->strike[row]);
+
+		if (got != expected)
+			fail(stock->ticker, (options->type[row] ? "put" : "call"), options->strike[row], got, expected);
+	}
+
+	for (e = stock->expiries_begin; e < stock->expiries_end; e++) {
+		// strikes on and between the rungs, and well outside them
+		for (price = stock->curr_price * 0.5f; price <= stock->curr_price * 1.5f; price += stock->curr_price / 37) {
+			rung = chain_nearest_strike(chains, e, price);
+			strike = scan_nearest_strike(options, stock, chains->expiration_date[e], price);
+
+			if (rung < 0 || chains->strike[rung] != strike)
+				fail(stock->ticker, "chain_nearest_strike", price, (rung < 0 ? -1 : (long)(chains->strike[rung] * 100)), (long)(strike * 100));
+
+			if (chain_rung(chains, e, price) >= 0 && chains->strike[chain_rung(chains, e, price)] != price)
+				fail(stock->ticker, "chain_rung", price, chain_rung(chains, e, price), -1);
+
+			low = price;
+			high = price + stock->curr_price / 5;
+			begin = chain_window(chains, e, low, high, &end);
+			expected = scan_window(options, stock, chains->expiration_date[e], low, high);
+
+			if (end - begin != expected || (begin < end && (chains->strike[begin] < low || chains->strike[end - 1] > high)))
+				fail(stock->ticker, "chain_window", low, end - begin, expected);
+		}
+
+		for (type = FALSE; type <= TRUE; type++) {
+			for (d = 0; d < sizeof(deltas) / sizeof(deltas[0]); d++) {
+				got = chain_nearest_delta(chains, options, e, type, deltas[d]);
+				expected = scan_nearest_delta(options, stock, chains->expiration_date[e], type, deltas[d]);
+
+				// far from the money deltas round to the same value, any row that near is as good
+				if (got != expected && !(got != CHAIN_NO_ROW && expected != CHAIN_NO_ROW &&
+				                         fabsf(options->delta[got] - deltas[d]) == fabsf(options->delta[expected] - deltas[d])))
+					fail(stock->ticker, (type ? "chain_nearest_delta call" : "chain_nearest_delta put"), deltas[d], got, expected);
+			}
+		}
+	}
+}
+
+int main(void) {
+	int i;
+	long contracts;
+	struct Arena arena;
+	struct OptionTable options;
+	struct ChainIndex chains;
+	struct ParentStock *parent_array[CHECK_STOCKS], stocks[CHECK_STOCKS];
+
+	arena_init(&arena);
+	option_table_init(&options, &arena);
+	memset(stocks, 0, sizeof(stocks));
+
+	for (i = 0; i < CHECK_STOCKS; i++) {
+		parent_array[i] = &stocks[i];
+		snprintf(stocks[i].ticker, TICK_SIZE, "T%03d", i);
+		stocks[i].curr_price = prices[i];
+
+		generate_stock(&options, &stocks[i], i);
+		greeks_contracts(&options, stocks[i].calls_begin, stocks[i].puts_end, &stocks[i]);
+	}
+
+	chain_index_build(&chains, parent_array, CHECK_STOCKS, &options, &arena);
+
+	for (i = 0, contracts = 0; i < CHECK_STOCKS; i++) {
+		check_stock(&chains, &options, &stocks[i]);
+		contracts += stocks[i].puts_end - stocks[i].calls_begin;
+	}
+
+	arena_free(&arena);
+
+	printf("chain_check: %d stocks, %ld contracts, %d failures\n", CHECK_STOCKS, contracts, failures);
+
+	return (failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,221 @@
+# Runs the collector's fetch and parse stages against a stub server on this machine that serves the saved
+# responses in test/fixtures, pointed at by SCREENER_YAHOO_URL and SCREENER_QUERY_URL. The quote pages
+# are served from one host name and the chart and options pages from another, so each has its own pacing.
+# Checks that throttled and failing pages are retried with backoff and other failures are not, that no
+# host is sent requests faster than FETCH_RATE, and that tickers are parsed while others are still fetching.
+# Usage: python3 collector_check.py [fixtures directory]. Exits non-zero on any mismatch.
+
+import os
+import sys
+import time
+import asyncio
+import threading
+import http.server
+from urllib.parse import urlsplit
+
+FIXTURES = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "fixtures")
+TICKERS = ["AAPL", "MSFT", "NVDA"]
+EXPIRATION = "1700179200"
+RATE = 10                  # requests per second per host, while pacing is checked
+BACKOFF = 0.05             # seconds before the first retry
+SLACK = 0.02               # seconds a request may arrive early, from scheduling alone
+SLOW = 0.6                 # seconds the stub holds NVDA's options page
+
+
+class stub_handler(http.server.BaseHTTPRequestHandler):
+    """ Serves the fixtures, failing a page with the statuses queued for it first """
+    failures = {}          # path to the statuses still to fail it with
+    log = []               # (arrival, host, path) of every request
+    lock = threading.Lock()
+
+    def do_GET(self):
+        arrival = time.monotonic()
+        url = urlsplit(self.path)
+
+        with stub_handler.lock:
+            stub_handler.log.append((arrival, self.headers.get("Host").split(":")[0], url.path))
+            queued = stub_handler.failures.get(url.path)
+            status = queued.pop(0) if queued else None
+
+        if (status is not None):
+            self.send_error(status)
+            return
+
+        body = self.page(url)
+
+        if (body is None):
+            self.send_error(404)
+            return
+
+        if (url.path == "/v7/finance/options/NVDA"):
+            time.sleep(SLOW)
+
+        self.send_response(200)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def page(self, url):
+        """ The fixture a path stands for, the quote page made up around the one expiration they have """
+        parts = url.path.strip("/").split("/")
+
+        if (len(parts) == 3 and parts[0] == "quote"):
+            return '<html><body>"expirationDates":[{0}],"hasMiniOptions":false</body></html>'.format(EXPIRATION).encode()
+        if (len(parts) == 4 and parts[2] == "chart"):
+            name = "{0}.chart.json".format(parts[3])
+        elif (len(parts) == 4 and parts[2] == "options"):
+            name = "{0}.{1}.options.json".format(parts[3], EXPIRATION)
+        else:
+            return None
+
+        try:
+            with open(os.path.join(FIXTURES, name), "rb") as fixture:
+                return fixture.read()
+        except OSError:
+            return None
+
+    def log_message(self, format, *args):
+        pass
+
+
+server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), stub_handler)
+threading.Thread(target=server.serve_forever, daemon=True).start()
+
+os.environ["SCREENER_YAHOO_URL"] = "http://127.0.0.1:{0}".format(server.server_port)
+os.environ["SCREENER_QUERY_URL"] = "http://localhost:{0}".format(server.server_port)
+os.environ["SCREENER_FETCH_ATTEMPTS"] = "4"
+os.environ["SCREENER_FETCH_BACKOFF"] = str(BACKOFF)
+os.environ.pop("SCREENER_RAW", None)
+os.environ.pop("SCREENER_STREAM_FD", None)
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src"))
+import options_collector
+
+failures = 0
+
+
+def fail(what):
+    global failures
+    print("collector_check: " + what, file=sys.stderr)
+    failures += 1
+
+
+def requests_to(path):
+    """ The arrival times of every request for path, in order """
+    with stub_handler.lock:
+        return [arrival for arrival, host, logged in stub_handler.log if logged == path]
+
+
+def check_retries():
+    """ 429 and 5xx are retried, each retry waiting twice as long as the one before, and anything else is final """
+    options_collector.FETCH_RATE = 0
+    fetch = options_collector.fetcher()
+    chart = "/v8/finance/chart/AAPL"
+
+    stub_handler.failures = {chart: [429, 503, 500], "/v8/finance/chart/MSFT": [500] * 4}
+    stub_handler.log = []
+
+    async def run():
+        return await asyncio.gather(fetch.fetch(options_collector.CHART_PAGE.format("AAPL")),
+                                    fetch.fetch(options_collector.CHART_PAGE.format("MSFT")),
+                                    fetch.fetch(options_collector.CHART_PAGE.format("NONE")))
+
+    aapl, msft, none = asyncio.run(run())
+    fetch.close()
+
+    with open(os.path.join(FIXTURES, "AAPL.chart.json")) as fixture:
+        if (aapl != fixture.read()):
+            fail("AAPL's chart did not come through after three failures")
+
+    arrivals = requests_to(chart)
+
+    if (len(arrivals) != 4):
+        fail("AAPL's chart took {0} requests, expected 4".format(len(arrivals)))
+    else:
+        for i in range(1, 4):
+            if (arrivals[i] - arrivals[i - 1] < BACKOFF * 2 ** (i - 1) - SLACK):
+                fail("retry {0} came {1:.3f}s after the last, expected at least {2:.3f}s".format(i, arrivals[i] - arrivals[i - 1], BACKOFF * 2 ** (i - 1)))
+
+    if (msft is not None or len(requests_to("/v8/finance/chart/MSFT")) != 4):
+        fail("MSFT's chart failed every attempt, expected None after 4 requests")
+    if (none is not None or len(requests_to("/v8/finance/chart/NONE")) != 1):
+        fail("a missing page was retried, or returned something")
+
+
+def check_rate():
+    """ Requests to one host start at least 1 / RATE apart, while the other host keeps its own pace """
+    options_collector.FETCH_RATE = RATE
+    fetch = options_collector.fetcher()
+    urls = [options_collector.QUOTE_PAGE.format(tick) for tick in TICKERS * 2] + \
+           [options_collector.CHART_PAGE.format(tick) for tick in TICKERS * 2]
+
+    stub_handler.failures = {}
+    stub_handler.log = []
+
+    async def run():
+        return await asyncio.gather(*[fetch.fetch(url) for url in urls])
+
+    begin = time.monotonic()
+    texts = asyncio.run(run())
+    elapsed = time.monotonic() - begin
+    fetch.close()
+
+    if (None in texts):
+        fail("a page did not come through while paced")
+
+    for host in ["127.0.0.1", "localhost"]:
+        with stub_handler.lock:
+            arrivals = sorted(arrival for arrival, logged, path in stub_handler.log if logged == host)
+
+        if (len(arrivals) != len(TICKERS) * 2):
+            fail("{0} was sent {1} requests, expected {2}".format(host, len(arrivals), len(TICKERS) * 2))
+
+        for i in range(1, len(arrivals)):
+            if (arrivals[i] - arrivals[i - 1] < 1 / RATE - SLACK):
+                fail("{0} was sent two requests {1:.3f}s apart".format(host, arrivals[i] - arrivals[i - 1]))
+
+    # both hosts at once take as long as one of them, not both
+    if (elapsed > (len(TICKERS) * 2) / RATE + 0.5):
+        fail("two hosts took {0:.3f}s, as if they shared one pace".format(elapsed))
+
+
+def check_overlap():
+    """ Tickers whose pages are in are parsed while NVDA's options page is still on its way """
+    options_collector.FETCH_RATE = 0
+    collector = options_collector.util()
+    collector.tickers = [options_collector.ticker(tick) for tick in TICKERS]
+    parsed = {}
+    parse_ticker = collector.parse_ticker
+
+    def timed_parse(tick):
+        parsed[tick.symbol] = time.monotonic()
+        parse_ticker(tick)
+
+    collector.parse_ticker = timed_parse
+    stub_handler.failures = {}
+    stub_handler.log = []
+
+    asyncio.run(collector.fetch_all())
+
+    slow = requests_to("/v7/finance/options/NVDA")
+
+    if (sorted(parsed) != TICKERS):
+        fail("parsed {0}, expected every ticker".format(sorted(parsed)))
+    elif (len(slow) != 1):
+        fail("NVDA's options page was requested {0} times, expected once".format(len(slow)))
+    elif (not (parsed["AAPL"] < slow[0] + SLOW and parsed["MSFT"] < slow[0] + SLOW)):
+        fail("AAPL and MSFT were not parsed until NVDA's pages were all in")
+
+    for tick in collector.tickers:
+        if (tick.symbol in ["AAPL", "MSFT"] and (len(tick.prices) == 0 or len(tick.calls) + len(tick.puts) == 0)):
+            fail("{0} was parsed to nothing".format(tick.symbol))
+
+
+check_retries()
+check_rate()
+check_overlap()
+
+server.shutdown()
+
+print("\ncollector_check: {0} tickers, {1} failures".format(len(TICKERS), failures))
+sys.exit(1 if failures else 0)
@@ -0,0 +1,176 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/greeks.h"
+#include "../include/option_table.h"
+#include "../include/weight_kernel.h"
+#include "../include/arena.h"
+
+/*
+ * Checks greeks_price and greeks_contracts against Black-Scholes values worked out in double
+ * precision, for a stock at CHECK_SPOT and the default rate, then quotes each contract at its
+ * price and checks solve_volatility gets its volatility back. The contracts go through in one
+ * range, so with SCREENER_KERNEL set to each kernel in turn every lane width and the scalar tail
+ * see some of them. Usage: greeks_check. Exits non-zero on any mismatch.
+ */
+
+#define CHECK_SPOT 100.0f
+#define CHECK_RELATIVE 1e-5f         // the float approximations are good to about 1e-6
+#define CHECK_ABSOLUTE 2e-6f         // the expected values are rounded to 6 or 7 places
+#define CHECK_EXPIRATION 1700179200 // every contract shares it, so the solver warm starts from whatever is on the same side
+#define CHECK_QUOTED 42.0f           // the volatility a contract is quoted at before it is solved
+#define CHECK_SOLVED 0.001f          // dollars, the solver stops within a tenth of a cent of the price
+#define CHECK_MIN_VEGA 0.01f         // below this a contract's price says next to nothing about its volatility
+
+/* One contract and what Black-Scholes makes of it */
+struct GreeksCase {
+   char type;
+   float strike;
+   int days;
+   float implied_volatility;    // points
+   float price;
+   float delta;
+   float gamma;
+   float theta;
+   float vega;
+   float rho;
+};
+
+static const struct GreeksCase cases[] = {
+	{ TRUE, 100, 365, 20, 10.450584, 0.636831, 0.0187620, -0.0175727, 0.375240, 0.532325 },
+	{ FALSE, 100, 365, 20, 5.573526, -0.363169, 0.0187620, -0.0045421, 0.375240, -0.418905 },
+	{ TRUE, 110, 91, 35, 3.743731, 0.349502, 0.0211837, -0.0398228, 0.184850, 0.077802 },
+	{ FALSE, 110, 91, 35, 12.381010, -0.650498, 0.0211837, -0.0249410, 0.184850, -0.193047 },
+	{ TRUE, 90, 30, 60, 12.951735, 0.764978, 0.0178658, -0.0968101, 0.088105, 0.052230 },
+	{ FALSE, 90, 30, 60, 2.582631, -0.235022, 0.0178658, -0.0845319, 0.088105, -0.021440 },
+	{ TRUE, 130, 182, 25, 0.819651, 0.104431, 0.0102599, -0.0101024, 0.127897, 0.047986 },
+	{ FALSE, 75, 182, 45, 2.316558, -0.126586, 0.0065355, -0.0160778, 0.146645, -0.074671 },
+	{ TRUE, 100, 7, 80, 4.463511, 0.525535, 0.0359357, -0.3216408, 0.055134, 0.009223 },
+	{ FALSE, 105, 400, 15, 5.944549, -0.453529, 0.0252334, -0.0007504, 0.414795, -0.562163 },
+	{ TRUE, 60, 60, 30, 40.491149, 0.999992, 0.0000028, -0.0081553, 0.000014, 0.097822 },
+	{ FALSE, 140, 120, 50, 39.937586, -0.834713, 0.0086683, -0.0127807, 0.142493, -0.405728 }
+};
+
+#define CASE_COUNT (long)(sizeof(cases) / sizeof(cases[0]))
+
+static int failures = 0;
+
+static void check_float(long row, const char *column, float got, float expected) {
+	if (!(fabsf(got - expected) <= CHECK_RELATIVE * fabsf(expected) + CHECK_ABSOLUTE)) {
+		fprintf(stderr, "contract %ld: %s is %.9g, expected %.9g\n", row, column, got, expected);
+		failures++;
+	}
+}
+
+/* Appends every case to options, quoted at its own price when priced is TRUE */
+static void append_cases(struct OptionTable *options, int priced) {
+	long i, row;
+	float price;
+
+	for (i = 0; i < CASE_COUNT; i++) {
+		row = option_table_append(options);
+		options->type[row] = cases[i].type;
+		options->strike[row] = cases[i].strike;
+		options->days_til_expiration[row] = cases[i].days;
+		options->expiration_date[row] = CHECK_EXPIRATION;
+		options->implied_volatility[row] = cases[i].implied_volatility;
+
+		if (priced) {
+			price = greeks_price(cases[i].type, CHECK_SPOT, cases[i].strike, cases[i].days, cases[i].implied_volatility / 100);
+			options->bid[row] = options->ask[row] = options->last_price[row] = price;
+			options->implied_volatility[row] = CHECK_QUOTED;
+		}
+	}
+}
+
+static void check_greeks(struct ParentStock *stock) {
+	long i;
+	struct Arena arena;
+	struct OptionTable options;
+
+	arena_init(&arena);
+	option_table_init(&options, &arena);
+	append_cases(&options, FALSE);
+
+	greeks_contracts(&options, 0, options.size, stock);
+
+	for (i = 0; i < CASE_COUNT; i++) {
+		check_float(i, "price", greeks_price(cases[i].type, CHECK_SPOT, cases[i].strike, cases[i].days, cases[i].implied_volatility / 100), cases[i].price);
+		check_float(i, "delta", options.delta[i], cases[i].delta);
+		check_float(i, "gamma", options.gamma[i], cases[i].gamma);
+		check_float(i, "theta", options.theta[i], cases[i].theta);
+		check_float(i, "vega", options.vega[i], cases[i].vega);
+		check_float(i, "rho", options.rho[i], cases[i].rho);
+	}
+
+	arena_free(&arena);
+}
+
+/*
+ * Solves every case back from its own price, twice over so each lane width warm starts from
+ * contracts of other strikes and DTEs, and a call quoted under its intrinsic value that has no
+ * volatility and keeps its quote.
+ * A solved volatility is right if it prices back to within CHECK_SOLVED, which vega turns into points.
+ */
+static void check_round_trip(struct ParentStock *stock) {
+	long i, row, intrinsic;
+	float solved, repriced, slack;
+	struct Arena arena;
+	struct OptionTable options;
+
+	arena_init(&arena);
+	option_table_init(&options, &arena);
+	append_cases(&options, TRUE);
+	append_cases(&options, TRUE);
+
+	intrinsic = option_table_append(&options);
+	options.type[intrinsic] = TRUE;
+	options.strike[intrinsic] = 90;
+	options.days_til_expiration[intrinsic] = 30;
+	options.bid[intrinsic] = options.ask[intrinsic] = options.last_price[intrinsic] = 5;
+	options.implied_volatility[intrinsic] = CHECK_QUOTED;
+
+	solve_volatility(&options, 0, options.size, stock);
+
+	for (row = 0; row < 2 * CASE_COUNT; row++) {
+		i = row % CASE_COUNT;
+
+		if (cases[i].vega < CHECK_MIN_VEGA)
+			continue;
+
+		solved = options.implied_volatility[row];
+		repriced = greeks_price(cases[i].type, CHECK_SPOT, cases[i].strike, cases[i].days, solved / 100);
+		slack = CHECK_SOLVED / cases[i].vega;
+
+		if (!(fabsf(repriced - options.bid[row]) <= CHECK_SOLVED * 1.5f && fabsf(solved - cases[i].implied_volatility) <= slack)) {
+			fprintf(stderr, "contract %ld: solved %.9g points, expected %.9g within %.3g\n", row, solved, cases[i].implied_volatility, slack);
+			failures++;
+		}
+	}
+
+	if (options.implied_volatility[intrinsic] != CHECK_QUOTED) {
+		fprintf(stderr, "contract %ld: under its intrinsic value solved to %.9g, expected the quoted %.9g\n", intrinsic, options.implied_volatility[intrinsic], CHECK_QUOTED);
+		failures++;
+	}
+
+	arena_free(&arena);
+}
+
+int main(void) {
+	struct ParentStock stock;
+
+	memset(&stock, 0, sizeof(struct ParentStock));
+	stock.curr_price = CHECK_SPOT;
+
+	check_greeks(&stock);
+	check_round_trip(&stock);
+
+	printf("greeks_check: %ld contracts, %s kernel, %d failures\n", CASE_COUNT, weight_kernel_name(weight_kernel()), failures);
+
+	return (failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
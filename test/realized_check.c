@@ -0,0 +1,134 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/realized.h"
+#include "../include/price_table.h"
+#include "../include/arena.h"
+
+/*
+ * Checks realized_volatility against estimates worked out by hand, with a two pass variance, over
+ * a short series of bars. The series has one bar with no close, which takes its own return and the
+ * next one's with it, and fewer returns than 50, so the 50 and 100 day windows both use all of them.
+ * Usage: realized_check. Exits non-zero on any mismatch.
+ */
+
+#define CHECK_TOLERANCE 1e-4f        // points
+#define CHECK_QUOTED 33.0f           // kept by a stock too short to estimate
+
+/* One day's bar, oldest first */
+struct Bar {
+   float open;
+   float low;
+   float high;
+   float close;
+};
+
+static const struct Bar bars[] = {
+	{ 99.65, 98.19, 100.30, 98.26 },
+	{ 98.33, 97.30, 98.39, 97.80 },
+	{ 96.90, 96.55, 96.97, 96.64 },
+	{ 96.49, 96.27, 97.87, 97.75 },
+	{ 98.00, 97.61, 100.34, 99.76 },
+	{ 100.71, 98.59, 101.57, 98.88 },
+	{ 98.18, 95.89, 98.48, 96.68 },
+	{ 96.06, 95.70, 96.99, 96.37 },
+	{ 96.46, 94.57, 96.52, 94.77 },
+	{ 95.11, 94.27, 95.41, 94.83 },
+	{ 94.74, 93.32, 95.49, 0.00 },
+	{ 93.50, 92.68, 94.27, 93.78 },
+	{ 94.21, 93.30, 95.13, 93.41 },
+	{ 93.26, 92.80, 94.36, 94.22 },
+	{ 93.35, 92.82, 94.70, 93.98 },
+	{ 94.69, 93.42, 95.35, 93.98 },
+	{ 94.13, 93.08, 94.92, 93.97 },
+	{ 93.92, 93.26, 94.60, 94.54 },
+	{ 94.82, 94.55, 97.48, 96.69 },
+	{ 96.47, 96.02, 97.14, 97.12 },
+	{ 96.48, 94.27, 96.54, 95.00 },
+	{ 94.30, 92.54, 94.67, 93.35 },
+	{ 92.57, 91.56, 93.08, 92.38 },
+	{ 92.97, 92.58, 94.58, 94.32 },
+	{ 94.05, 93.91, 96.41, 95.50 }
+};
+
+// the newest 20 of the 22 usable returns, then all 22 for the 50 and 100 day windows
+static const float expected_close[HV_WINDOWS] = { 21.75626, 21.12681, 21.12681 };
+static const float expected_parkinson[HV_WINDOWS] = { 20.22408, 19.43543, 19.43543 };
+static const float expected_yang_zhang[HV_WINDOWS] = { 22.00426, 21.33708, 21.33708 };
+
+static int failures = 0;
+
+static void check_float(const char *stock, const char *column, int window, float got, float expected) {
+	if (!(fabsf(got - expected) <= CHECK_TOLERANCE)) {
+		fprintf(stderr, "%s: %s[%d] is %.9g, expected %.9g\n", stock, column, window, got, expected);
+		failures++;
+	}
+}
+
+/* Appends bars [begin, end) to prices as one stock's history */
+static void append_bars(struct PriceTable *prices, struct ParentStock *stock, long begin, long end) {
+	long i, row;
+
+	stock->prices_begin = prices->size;
+
+	for (i = begin; i < end; i++) {
+		row = price_table_append(prices);
+		prices->open[row] = bars[i].open;
+		prices->low[row] = bars[i].low;
+		prices->high[row] = bars[i].high;
+		prices->close[row] = bars[i].close;
+	}
+
+	stock->prices_end = prices->size;
+}
+
+int main(void) {
+	int window;
+	struct Arena arena;
+	struct PriceTable prices;
+	struct ParentStock series, short_stock;
+
+	arena_init(&arena);
+	price_table_init(&prices, &arena);
+	memset(&series, 0, sizeof(struct ParentStock));
+	memset(&short_stock, 0, sizeof(struct ParentStock));
+
+	append_bars(&prices, &series, 0, sizeof(bars) / sizeof(bars[0]));
+	realized_volatility(&series, &prices);
+
+	for (window = 0; window < HV_WINDOWS; window++) {
+		check_float("series", "hv_close", window, series.hv_close[window], expected_close[window]);
+		check_float("series", "hv_parkinson", window, series.hv_parkinson[window], expected_parkinson[window]);
+		check_float("series", "hv_yang_zhang", window, series.hv_yang_zhang[window], expected_yang_zhang[window]);
+	}
+
+	// close to close is the default estimator
+	if (realized_estimator() == REALIZED_CLOSE) {
+		check_float("series", "iv20", 0, series.iv20, expected_close[0]);
+		check_float("series", "iv50", 1, series.iv50, expected_close[1]);
+		check_float("series", "iv100", 2, series.iv100, expected_close[2]);
+	}
+
+	// one bar has no return, so nothing is estimated and the quoted volatility stays
+	short_stock.iv20 = short_stock.iv50 = short_stock.iv100 = CHECK_QUOTED;
+	append_bars(&prices, &short_stock, 0, 1);
+	realized_volatility(&short_stock, &prices);
+
+	for (window = 0; window < HV_WINDOWS; window++)
+		check_float("short", "hv_close", window, short_stock.hv_close[window], 0);
+
+	check_float("short", "iv20", 0, short_stock.iv20, CHECK_QUOTED);
+	check_float("short", "iv50", 1, short_stock.iv50, CHECK_QUOTED);
+	check_float("short", "iv100", 2, short_stock.iv100, CHECK_QUOTED);
+
+	arena_free(&arena);
+
+	printf("realized_check: %lu bars, %d failures\n", sizeof(bars) / sizeof(bars[0]), failures);
+
+	return (failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,447 @@
+#include <math.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/strategy.h"
+#include "../include/batch.h"
+#include "../include/universe.h"
+#include "../include/chain_index.h"
+#include "../include/option_table.h"
+#include "../include/greeks.h"
+#include "../include/arena.h"
+
+/*
+ * Runs strategy_search over a generated fixture chain and checks its top candidates against every
+ * candidate of the spec worked out by brute force, for verticals, straddles, strangles and calendars.
+ * The quotes are the contracts' prices with noise on them, so far from the money they are often out
+ * of strike order, as stale quotes are, and some contracts are closed or one sided. Condors come from
+ * a beam rather than every pairing, so those are checked for their shape and their score instead.
+ * Usage: strategy_check. Exits non-zero on any mismatch.
+ */
+
+#define CHECK_STOCKS 3
+#define CHECK_EXPIRIES 3
+#define CHECK_STRIKES 21
+#define CHECK_EXPIRATION 1700179200
+#define CHECK_NO_RISK 0.0075f        // as strategy_search's, less than this at risk is a stale quote
+#define CHECK_TOLERANCE 1e-5f        // relative, for a score worked out again from a result's legs
+
+static const float prices[] = { 47.5f, 100, 212.3f };
+static const int days[] = { 12, 45, 150 };   // one in each of the realized volatility buckets
+
+/* One spec, the keys a query spec would give it and the rest left at their defaults */
+struct SpecCase {
+   const char *text;          // as it would be written in a batch file
+   int strategy;
+   int top;
+   int type;
+   int min_dte;
+   float max_cost;
+   float max_width;
+   float min_reward;
+};
+
+static const struct SpecCase specs[] = {
+	{ "strategy=vertical top=25", STRATEGY_VERTICAL, 25, QUERY_ALL, 0, INFINITY, INFINITY, -INFINITY },
+	{ "strategy=vertical top=25 max_cost=0.4 max_width=15 min_reward=0.5", STRATEGY_VERTICAL, 25, QUERY_ALL, 0, 0.4f, 15, 0.5f },
+	{ "strategy=vertical top=25 max_cost=-0.1 type=puts", STRATEGY_VERTICAL, 25, QUERY_PUTS, 0, -0.1f, INFINITY, -INFINITY },
+	{ "strategy=vertical top=40 max_cost=1 min_dte=30", STRATEGY_VERTICAL, 40, QUERY_ALL, 30, 1, INFINITY, -INFINITY },
+	{ "strategy=straddle top=10 max_cost=6 min_dte=20", STRATEGY_STRADDLE, 10, QUERY_ALL, 20, 6, INFINITY, -INFINITY },
+	{ "strategy=strangle top=15 max_width=30", STRATEGY_STRANGLE, 15, QUERY_ALL, 0, INFINITY, 30, -INFINITY },
+	{ "strategy=strangle top=15 max_cost=0.8", STRATEGY_STRANGLE, 15, QUERY_ALL, 0, 0.8f, INFINITY, -INFINITY },
+	{ "strategy=calendar top=15 max_cost=1", STRATEGY_CALENDAR, 15, QUERY_ALL, 0, 1, INFINITY, -INFINITY },
+	{ "strategy=calendar top=15 type=calls", STRATEGY_CALENDAR, 15, QUERY_CALLS, 0, INFINITY, INFINITY, -INFINITY },
+	{ "strategy=condor top=15 max_width=40", STRATEGY_CONDOR, 15, QUERY_ALL, 0, INFINITY, 40, -INFINITY },
+	{ "strategy=condor top=15 max_cost=-0.2", STRATEGY_CONDOR, 15, QUERY_ALL, 0, -0.2f, INFINITY, -INFINITY }
+};
+
+#define SPEC_COUNT (long)(sizeof(specs) / sizeof(specs[0]))
+
+static unsigned long seed = 4242;
+static int failures = 0;
+
+/* The next of a fixed sequence of numbers in [0, 1) */
+static double next(void) {
+	seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+
+	return (double)(seed >> 11) / 9007199254740992.0;
+}
+
+static void fail(const char *spec, long rank, const char *what) {
+	fprintf(stderr, "%s: #%ld %s\n", spec, rank, what);
+	failures++;
+}
+
+/* Appends one contract quoted at its price at volatility, with noise and now and then closed or one sided */
+static void append_contract(struct Universe *universe, int parent, char type, long expiry, float strike, float volatility) {
+	long row = option_table_append(&universe->options);
+	struct OptionTable *options = &universe->options;
+	float price, half;
+	double dice = next();
+
+	options->parent[row] = parent;
+	options->type[row] = type;
+	options->expiration_date[row] = CHECK_EXPIRATION + expiry * 7 * 86400;
+	options->days_til_expiration[row] = days[expiry];
+	options->strike[row] = strike;
+	options->implied_volatility[row] = volatility;
+	options->open[row] = (dice >= 0.06);
+
+	price = greeks_price(type, universe->parent_array[parent]->curr_price, strike, days[expiry], volatility / 100);
+	price = fmaxf(0.01f, price * (float)(0.8 + 0.4 * next()) + (float)(0.1 * next()));
+	half = 0.01f + price * (float)(0.05 * next());
+
+	options->bid[row] = roundf((price - half) * 100) / 100;
+	options->ask[row] = roundf((price + half) * 100) / 100;
+
+	// a few with no bid, no ask, or the two crossed
+	if (dice >= 0.06 && dice < 0.1)
+		options->bid[row] = 0;
+	else if (dice >= 0.1 && dice < 0.12)
+		options->ask[row] = 0;
+	else if (dice >= 0.12 && dice < 0.14)
+		options->ask[row] = options->bid[row] - 0.05f;
+}
+
+/* The fixture: each stock's calls then puts, strikes around its price with one side now and then missing */
+static void build_universe(struct Universe *universe) {
+	int i, side;
+	long expiry, k, rung;
+	float step, strike;
+	struct ParentStock *stock;
+
+	universe_init(universe);
+	symbol_table_init(&universe->symbols, &universe->arena);
+	price_table_init(&universe->prices, &universe->arena);
+	option_table_init(&universe->options, &universe->arena);
+
+	universe->parent_array = arena_calloc(&universe->arena, CHECK_STOCKS, sizeof(struct ParentStock *));
+	universe->parent_array_size = CHECK_STOCKS;
+
+	for (i = 0; i < CHECK_STOCKS; i++) {
+		stock = universe->parent_array[i] = arena_calloc(&universe->arena, 1, sizeof(struct ParentStock));
+		snprintf(stock->ticker, TICK_SIZE, "S%03d", i);
+		stock->curr_price = prices[i];
+		stock->iv20 = 24 + 3 * i;
+		stock->iv50 = 27 + 2 * i;
+		stock->iv100 = 30 - i;
+
+		step = (stock->curr_price < 60 ? 1 : (stock->curr_price < 150 ? 2.5f : 5));
+
+		for (side = 1; side >= 0; side--) {
+			if (side)
+				stock->calls_begin = universe->options.size;
+			else
+				stock->calls_end = stock->puts_begin = universe->options.size;
+
+			for (expiry = 0; expiry < CHECK_EXPIRIES; expiry++) {
+				rung = (long)(stock->curr_price / step) - CHECK_STRIKES / 2;
+
+				for (k = 0; k < CHECK_STRIKES; k++) {
+					strike = (rung + k) * step;
+
+					// the strikes either side of the ends have only one side
+					if (strike <= 0 || (k == 0 && side) || (k == CHECK_STRIKES - 1 && !side))
+						continue;
+
+					append_contract(universe, i, side, expiry, strike, 22 + 4 * expiry + 0.2f * (float)fabs(k - CHECK_STRIKES / 2.0));
+				}
+			}
+		}
+
+		stock->puts_end = universe->options.size;
+	}
+
+	chain_index_build(&universe->chains, universe->parent_array, universe->parent_array_size, &universe->options, &universe->arena);
+}
+
+/* A contract's midpoint, -1 if the spec cannot use it as a leg */
+static float mid_of(struct OptionTable *options, struct QuerySpec *spec, long row) {
+	if (!options->open[row])
+		return -1;
+	if ((spec->type == QUERY_CALLS && !options->type[row]) || (spec->type == QUERY_PUTS && options->type[row]))
+		return -1;
+	if (options->days_til_expiration[row] < spec->min_dte || options->days_til_expiration[row] > spec->max_dte)
+		return -1;
+	if (!(options->ask[row] > 0 && options->bid[row] >= 0 && options->ask[row] >= options->bid[row]))
+		return -1;
+
+	return (options->bid[row] + options->ask[row]) / 2;
+}
+
+/* A contract's worth at its stock's realized volatility for its DTE */
+static float value_of(struct Universe *universe, long row) {
+	struct OptionTable *options = &universe->options;
+	struct ParentStock *stock = universe->parent_array[options->parent[row]];
+	float sigma;
+
+	if (options->days_til_expiration[row] <= 30)
+		sigma = stock->iv20;
+	else if (options->days_til_expiration[row] <= 365 / 4)
+		sigma = stock->iv50;
+	else
+		sigma = stock->iv100;
+
+	return greeks_price(options->type[row], stock->curr_price, options->strike[row], options->days_til_expiration[row], sigma / 100);
+}
+
+/* Prices a candidate from its legs the way the spec defines it, TRUE if it is inside the spec's bounds */
+static int price_candidate(struct Universe *universe, struct QuerySpec *spec, struct Strategy *candidate, float wing) {
+	int i;
+	long row;
+	float mid, low = INFINITY, high = -INFINITY;
+	struct OptionTable *options = &universe->options;
+
+	candidate->cost = candidate->edge = 0;
+
+	for (i = 0; i < candidate->leg_count; i++) {
+		row = candidate->legs[i].row;
+		if ((mid = mid_of(options, spec, row)) < 0)
+			return FALSE;
+
+		candidate->cost += candidate->legs[i].quantity * mid;
+		candidate->edge += candidate->legs[i].quantity * (value_of(universe, row) - mid);
+		low = fminf(low, options->strike[row]);
+		high = fmaxf(high, options->strike[row]);
+	}
+
+	candidate->width = high - low;
+
+	if (candidate->cost > spec->max_cost)
+		return FALSE;
+
+	if (candidate->kind == STRATEGY_VERTICAL || candidate->kind == STRATEGY_CONDOR) {
+		candidate->max_loss = (candidate->cost > 0 ? candidate->cost : wing + candidate->cost);
+		candidate->max_gain = (candidate->cost > 0 ? wing - candidate->cost : -candidate->cost);
+	}
+	else {
+		candidate->max_loss = candidate->cost;
+		candidate->max_gain = (candidate->kind == STRATEGY_CALENDAR ? NAN : INFINITY);
+	}
+
+	if (!(candidate->max_loss > CHECK_NO_RISK) || !(candidate->max_gain > 0 || isnan(candidate->max_gain)))
+		return FALSE;
+	if (!isnan(candidate->max_gain) && !(candidate->max_gain / candidate->max_loss >= spec->min_reward))
+		return FALSE;
+
+	candidate->score = candidate->edge / candidate->max_loss;
+
+	return isfinite(candidate->score);
+}
+
+/* Best score first, then the earlier stock, then the earlier legs, as strategy_search ranks them */
+static int by_rank(const void *a, const void *b) {
+	const struct Strategy *x = a, *y = b;
+	int i;
+
+	if (x->score != y->score)
+		return (x->score < y->score) - (x->score > y->score);
+	if (x->stock != y->stock)
+		return (x->stock > y->stock) - (x->stock < y->stock);
+
+	for (i = 0; i < x->leg_count; i++) {
+		if (x->legs[i].row != y->legs[i].row)
+			return (x->legs[i].row > y->legs[i].row) - (x->legs[i].row < y->legs[i].row);
+	}
+
+	return 0;
+}
+
+/* Adds a two legged candidate to all if it prices inside the spec */
+static void add_pair(struct Universe *universe, struct QuerySpec *spec, struct Strategy *all, long *count, long stock, long first, int first_quantity, long second, int second_quantity, float wing) {
+	struct Strategy *candidate = &all[*count];
+
+	memset(candidate, 0, sizeof(struct Strategy));
+	candidate->kind = spec->strategy;
+	candidate->stock = stock;
+	candidate->leg_count = 2;
+	candidate->legs[0].row = first;
+	candidate->legs[0].quantity = first_quantity;
+	candidate->legs[1].row = second;
+	candidate->legs[1].quantity = second_quantity;
+
+	if (price_candidate(universe, spec, candidate, wing))
+		(*count)++;
+}
+
+/* Every candidate of the spec's kind in the universe, by trying every pair of contracts of each stock */
+static long brute_force(struct Universe *universe, struct QuerySpec *spec, struct Strategy *all) {
+	long i, a, b, count = 0;
+	float price, width;
+	struct ParentStock *stock;
+	struct OptionTable *options = &universe->options;
+
+	for (i = 0; i < universe->parent_array_size; i++) {
+		stock = universe->parent_array[i];
+		price = stock->curr_price;
+
+		for (a = stock->calls_begin; a < stock->puts_end; a++) {
+			for (b = stock->calls_begin; b < stock->puts_end; b++) {
+				width = options->strike[b] - options->strike[a];
+
+				switch (spec->strategy) {
+				case STRATEGY_VERTICAL:
+					// a the lower strike, bought then sold
+					if (options->type[a] != options->type[b] || options->expiration_date[a] != options->expiration_date[b] || !(width > 0) || width > spec->max_width)
+						break;
+					add_pair(universe, spec, all, &count, i, a, 1, b, -1, width);
+					add_pair(universe, spec, all, &count, i, a, -1, b, 1, width);
+					break;
+				case STRATEGY_STRADDLE:
+					if (options->type[a] || !options->type[b] || options->expiration_date[a] != options->expiration_date[b] || width != 0)
+						break;
+					add_pair(universe, spec, all, &count, i, a, 1, b, 1, 0);
+					break;
+				case STRATEGY_STRANGLE:
+					if (options->type[a] || !options->type[b] || options->expiration_date[a] != options->expiration_date[b])
+						break;
+					if (!(options->strike[a] < price) || !(options->strike[b] > price) || width > spec->max_width)
+						break;
+					add_pair(universe, spec, all, &count, i, a, 1, b, 1, 0);
+					break;
+				case STRATEGY_CALENDAR:
+					// a the nearer expiration, sold
+					if (options->type[a] != options->type[b] || width != 0 || !(options->expiration_date[a] < options->expiration_date[b]))
+						break;
+					add_pair(universe, spec, all, &count, i, a, -1, b, 1, 0);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+	}
+
+	qsort(all, count, sizeof(struct Strategy), by_rank);
+
+	return count;
+}
+
+/* A condor's legs are a put credit spread below the stock and a call credit spread above it, priced as they should be */
+static void check_condor(struct Universe *universe, struct QuerySpec *spec, const char *text, long rank, struct Strategy *found) {
+	int i;
+	long *row = &found->legs[0].row;
+	struct OptionTable *options = &universe->options;
+	struct Strategy expected = *found;
+	float price = universe->parent_array[found->stock]->curr_price;
+
+	if (found->leg_count != 4 || found->legs[0].quantity != 1 || found->legs[1].quantity != -1 || found->legs[2].quantity != -1 || found->legs[3].quantity != 1) {
+		fail(text, rank, "is not bought put, sold put, sold call, bought call");
+		return;
+	}
+
+	for (i = 0; i < 4; i++) {
+		if (options->type[found->legs[i].row] != (i >= 2) || options->expiration_date[found->legs[i].row] != options->expiration_date[row[0]])
+			fail(text, rank, "has a leg of the wrong side or expiration");
+	}
+
+	if (!(options->strike[found->legs[0].row] < options->strike[found->legs[1].row]) || !(options->strike[found->legs[2].row] < options->strike[found->legs[3].row]))
+		fail(text, rank, "does not sell the spreads' inner strikes");
+	if (options->strike[found->legs[1].row] > price || options->strike[found->legs[2].row] < price)
+		fail(text, rank, "sells a strike in the money");
+	if (options->strike[found->legs[3].row] - options->strike[found->legs[0].row] > spec->max_width)
+		fail(text, rank, "is wider than max_width");
+
+	if (!price_candidate(universe, spec, &expected, fmaxf(options->strike[found->legs[1].row] - options->strike[found->legs[0].row],
+	                                                       options->strike[found->legs[3].row] - options->strike[found->legs[2].row])))
+		fail(text, rank, "is outside the spec's bounds");
+	else if (!(fabsf(expected.score - found->score) <= CHECK_TOLERANCE * fabsf(expected.score)))
+		fail(text, rank, "has the wrong score");
+}
+
+/* The spec case as query_spec_parse would have filled it in */
+static void fill_spec(const struct SpecCase *source, struct QuerySpec *spec) {
+	memset(spec, 0, sizeof(struct QuerySpec));
+	spec->max_option_price = INFINITY;
+	spec->min_weight = -INFINITY;
+	spec->type = source->type;
+	spec->min_dte = source->min_dte;
+	spec->max_dte = INT_MAX;
+	spec->top = source->top;
+	spec->strikes = -1;
+	spec->strategy = source->strategy;
+	spec->max_cost = source->max_cost;
+	spec->max_width = source->max_width;
+	spec->min_reward = source->min_reward;
+	spec->format = -1;
+}
+
+static void check_spec(struct Universe *universe, const struct SpecCase *source, struct Strategy *all) {
+	long i, count, expected, top;
+	const char *text = source->text;
+	struct QuerySpec spec;
+	struct Strategy *found;
+
+	fill_spec(source, &spec);
+	count = strategy_search(universe, &spec, &found);
+	top = spec.top;
+
+	if (count == 0)
+		fail(text, 0, "found nothing, the fixture should have some");
+
+	for (i = 1; i < count; i++) {
+		if (by_rank(&found[i - 1], &found[i]) > 0)
+			fail(text, i, "is ranked above a better candidate");
+	}
+
+	if (spec.strategy == STRATEGY_CONDOR) {
+		for (i = 0; i < count; i++)
+			check_condor(universe, &spec, text, i, &found[i]);
+
+		if (count > top)
+			fail(text, count, "is more than top");
+
+		free(found);
+		return;
+	}
+
+	expected = brute_force(universe, &spec, all);
+
+	if (count != (expected < top ? expected : top))
+		fail(text, count, "is not as many as brute force finds");
+
+	for (i = 0; i < count && i < expected; i++) {
+		if (found[i].kind != spec.strategy || found[i].stock != all[i].stock || found[i].leg_count != 2 ||
+		    found[i].legs[0].row != all[i].legs[0].row || found[i].legs[0].quantity != all[i].legs[0].quantity ||
+		    found[i].legs[1].row != all[i].legs[1].row || found[i].legs[1].quantity != all[i].legs[1].quantity) {
+			fprintf(stderr, "%s: #%ld is %ld %+d/%ld %+d at %.6g, expected %ld %+d/%ld %+d at %.6g\n", text, i,
+			        found[i].legs[0].row, found[i].legs[0].quantity, found[i].legs[1].row, found[i].legs[1].quantity, found[i].score,
+			        all[i].legs[0].row, all[i].legs[0].quantity, all[i].legs[1].row, all[i].legs[1].quantity, all[i].score);
+			failures++;
+		}
+		else if (found[i].score != all[i].score || found[i].cost != all[i].cost || found[i].max_loss != all[i].max_loss)
+			fail(text, i, "has the right legs but a different score, cost or max loss");
+	}
+
+	free(found);
+}
+
+int main(void) {
+	long i, size;
+	struct Universe universe;
+	struct Strategy *all;
+
+	build_universe(&universe);
+
+	// room for every ordered pair of contracts, both ways around
+	size = 0;
+	for (i = 0; i < CHECK_STOCKS; i++)
+		size += 2 * (universe.parent_array[i]->puts_end - universe.parent_array[i]->calls_begin) * (universe.parent_array[i]->puts_end - universe.parent_array[i]->calls_begin);
+	all = malloc(size * sizeof(struct Strategy));
+
+	for (i = 0; i < SPEC_COUNT; i++)
+		check_spec(&universe, &specs[i], all);
+
+	free(all);
+
+	printf("strategy_check: %ld specs, %ld contracts, %d failures\n", SPEC_COUNT, universe.options.size, failures);
+
+	arena_free(&universe.arena);
+
+	return (failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,316 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/screener.h"
+#include "../include/yahoo.h"
+#include "../include/json.h"
+#include "../include/symbols.h"
+#include "../include/price_table.h"
+#include "../include/option_table.h"
+#include "../include/arena.h"
+#include "../include/safe.h"
+
+/*
+ * Runs yahoo_parse_chart and yahoo_parse_options over the saved responses in test/fixtures and
+ * checks every row they append. The fixtures cover Yahoo's plain layout, the same data with its
+ * keys reordered or wrapped as {"raw": n, "fmt": "..."}, and responses cut off part way through.
+ * A few short documents check that the JSON reader itself rejects stray commas.
+ * Usage: yahoo_check <fixture directory>. Exits non-zero on any mismatch.
+ */
+
+#define CHECK_TODAY 1699920000       // 2023-11-14 00:00 UTC, what days to expiration count from
+
+/* One bar a chart fixture should append */
+struct ExpectedBar {
+   long date;
+   float open;
+   float low;
+   float high;
+   float close;
+   long volume;
+};
+
+/* One contract an options fixture should append */
+struct ExpectedContract {
+   char type;
+   long expiration_date;
+   int days_til_expiration;
+   float strike;
+   float bid;
+   float ask;
+   float last_price;
+   long volume;
+   long open_interest;
+   float implied_volatility;
+};
+
+/* One fixture, whether it should parse, and the rows it should append */
+struct ChartCase {
+   const char *file;
+   const char *ticker;
+   int valid;
+   int rows;
+   const struct ExpectedBar *bars;
+};
+
+struct OptionsCase {
+   const char *file;
+   const char *ticker;
+   int valid;
+   int rows;
+   const struct ExpectedContract *contracts;
+};
+
+// the bar with a null volume is left out, closes are the adjusted ones
+static const struct ExpectedBar aapl_bars[] = {
+	{ 1699885800, 185.82, 184.21, 186.03, 184.12, 52236900 },
+	{ 1699972200, 187.70, 186.74, 188.11, 186.75, 60108400 },
+	{ 1700145000, 189.57, 188.19, 190.38, 189.01, 49653400 }
+};
+
+static const struct ExpectedBar msft_bars[] = {
+	{ 1699885800, 368.22, 365.46, 370.10, 369.12, 20902400 },
+	{ 1699972200, 371.01, 371.68, 375.12, 374.33, 28012300 },
+	{ 1700058600, 374.57, 373.33, 376.35, 375.41, 24234700 }
+};
+
+// a contract without a volume reads it as 0
+static const struct ExpectedContract aapl_contracts[] = {
+	{ TRUE, 1700179200, 3, 185, 4.65, 4.8, 4.75, 18234, 25310, 25.10 },
+	{ TRUE, 1700179200, 3, 190, 0.7, 0.72, 0.71, 0, 41532, 18.33 },
+	{ FALSE, 1700179200, 3, 185, 0.05, 0.07, 0.06, 9120, 30411, 21.97 },
+	{ FALSE, 1700179200, 3, 190, 0.99, 1.04, 1.02, 22410, 18002, 17.45 }
+};
+
+// puts come first in the file, and the put without a strike is left out
+static const struct ExpectedContract msft_contracts[] = {
+	{ FALSE, 1700179200, 3, 185, 0.05, 0.07, 0.06, 9120, 30411, 21.97 },
+	{ TRUE, 1700179200, 3, 185, 4.65, 4.8, 4.75, 18234, 25310, 25.10 }
+};
+
+// the first symbol is an object, skipped whole, so the rest of meta and the later symbol still count
+static const struct ExpectedBar amd_bars[] = {
+	{ 1699885800, 114.03, 112.94, 115.12, 114.30, 48011200 },
+	{ 1699972200, 117.18, 115.70, 118.47, 117.41, 61334800 }
+};
+
+static const struct ChartCase charts[] = {
+	{ "AAPL.chart.json", "AAPL", TRUE, 3, aapl_bars },
+	{ "MSFT.chart.json", "MSFT", TRUE, 3, msft_bars },
+	{ "AMD.chart.json", "AMD", TRUE, 2, amd_bars },
+	{ "NVDA.chart.json", "NVDA", FALSE, 0, NULL }
+};
+
+static const struct OptionsCase chains[] = {
+	{ "AAPL.1700179200.options.json", "AAPL", TRUE, 4, aapl_contracts },
+	{ "MSFT.1700179200.options.json", "MSFT", TRUE, 2, msft_contracts },
+	{ "NVDA.1700179200.options.json", "NVDA", FALSE, 0, NULL }
+};
+
+/* A document and whether every token of it reads */
+struct JsonCase {
+   const char *text;
+   int valid;
+};
+
+static const struct JsonCase documents[] = {
+	{ "{\"a\": [1, 2, {\"b\": null}], \"c\": \"d\"}", TRUE },
+	{ "[]", TRUE },
+	{ "{}", TRUE },
+	{ "[,1]", FALSE },
+	{ "[,,1]", FALSE },
+	{ "[1,,2]", FALSE },
+	{ "[1,]", FALSE },
+	{ "{\"a\":1,,}", FALSE },
+	{ "{\"a\":1,}", FALSE },
+	{ "{\"a\":,1}", FALSE },
+	{ "{\"a\":}", FALSE },
+	{ "[1 2]", FALSE },
+	{ "1,2", FALSE }
+};
+
+static int failures = 0;
+
+/* Reports a mismatch in one column of one row */
+static void mismatch(const char *file, long row, const char *column, double got, double expected) {
+	fprintf(stderr, "%s: row %ld %s is %.9g, expected %.9g\n", file, row, column, got, expected);
+	failures++;
+}
+
+/* Compares floats parsed from decimal text, which agree to well within a part in a million */
+static void check_float(const char *file, long row, const char *column, float got, float expected) {
+	if (!(fabsf(got - expected) <= 1e-6f * fmaxf(1, fabsf(expected))))
+		mismatch(file, row, column, got, expected);
+}
+
+static void check_long(const char *file, long row, const char *column, long got, long expected) {
+	if (got != expected)
+		mismatch(file, row, column, got, expected);
+}
+
+/* Reads a whole fixture into memory, NULL if it cannot be read */
+static char *read_fixture(const char *directory, const char *file, size_t *size) {
+	char path[1024], *data;
+	long length;
+	FILE *in;
+
+	snprintf(path, sizeof(path), "%s/%s", directory, file);
+
+	if ((in = fopen(path, "rb")) == NULL) {
+		perror(path);
+		failures++;
+		return NULL;
+	}
+
+	fseek(in, 0, SEEK_END);
+	length = ftell(in);
+	rewind(in);
+
+	data = safe_malloc(length + 1);
+	*size = fread(data, 1, length, in);
+	fclose(in);
+
+	return data;
+}
+
+/* Checks the parse result, the row count and the ticker of one fixture, TRUE if its rows can be compared */
+static int check_parse(const char *file, int valid, int expected_valid, long rows, long expected_rows, struct SymbolTable *symbols, const char *ticker) {
+	if (valid != expected_valid) {
+		fprintf(stderr, "%s: parsed %s, expected %s\n", file, (valid ? "TRUE" : "FALSE"), (expected_valid ? "TRUE" : "FALSE"));
+		failures++;
+		return FALSE;
+	}
+
+	if (rows != expected_rows) {
+		fprintf(stderr, "%s: appended %ld rows, expected %ld\n", file, rows, expected_rows);
+		failures++;
+		return FALSE;
+	}
+
+	if (valid && symbol_lookup(symbols, ticker) == NO_SYMBOL) {
+		fprintf(stderr, "%s: %s was never interned\n", file, ticker);
+		failures++;
+		return FALSE;
+	}
+
+	return valid;
+}
+
+static void check_chart(const char *directory, const struct ChartCase *test, struct SymbolTable *symbols, struct PriceTable *prices) {
+	int valid;
+	long i, begin, row;
+	size_t size;
+	char *data;
+
+	if ((data = read_fixture(directory, test->file, &size)) == NULL)
+		return;
+
+	begin = prices->size;
+	valid = yahoo_parse_chart(data, size, symbols, prices);
+
+	if (check_parse(test->file, valid, test->valid, prices->size - begin, test->rows, symbols, test->ticker)) {
+		for (i = 0; i < test->rows; i++) {
+			row = begin + i;
+			check_long(test->file, i, "parent", prices->parent[row], symbol_lookup(symbols, test->ticker));
+			check_long(test->file, i, "date", prices->date[row], test->bars[i].date);
+			check_float(test->file, i, "open", prices->open[row], test->bars[i].open);
+			check_float(test->file, i, "low", prices->low[row], test->bars[i].low);
+			check_float(test->file, i, "high", prices->high[row], test->bars[i].high);
+			check_float(test->file, i, "close", prices->close[row], test->bars[i].close);
+			check_long(test->file, i, "volume", prices->volume[row], test->bars[i].volume);
+		}
+	}
+
+	free(data);
+}
+
+static void check_options(const char *directory, const struct OptionsCase *test, struct SymbolTable *symbols, struct OptionTable *options) {
+	int valid;
+	long i, begin, row;
+	size_t size;
+	char *data;
+
+	if ((data = read_fixture(directory, test->file, &size)) == NULL)
+		return;
+
+	begin = options->size;
+	valid = yahoo_parse_options(data, size, CHECK_TODAY, symbols, options);
+
+	if (check_parse(test->file, valid, test->valid, options->size - begin, test->rows, symbols, test->ticker)) {
+		for (i = 0; i < test->rows; i++) {
+			row = begin + i;
+			check_long(test->file, i, "parent", options->parent[row], symbol_lookup(symbols, test->ticker));
+			check_long(test->file, i, "type", options->type[row], test->contracts[i].type);
+			check_long(test->file, i, "expiration_date", options->expiration_date[row], test->contracts[i].expiration_date);
+			check_long(test->file, i, "days_til_expiration", options->days_til_expiration[row], test->contracts[i].days_til_expiration);
+			check_float(test->file, i, "strike", options->strike[row], test->contracts[i].strike);
+			check_float(test->file, i, "bid", options->bid[row], test->contracts[i].bid);
+			check_float(test->file, i, "ask", options->ask[row], test->contracts[i].ask);
+			check_float(test->file, i, "last_price", options->last_price[row], test->contracts[i].last_price);
+			check_long(test->file, i, "volume", options->volume[row], test->contracts[i].volume);
+			check_long(test->file, i, "open_interest", options->open_interest[row], test->contracts[i].open_interest);
+			check_float(test->file, i, "implied_volatility", options->implied_volatility[row], test->contracts[i].implied_volatility);
+		}
+	}
+
+	free(data);
+}
+
+/* Reads every token of each short document, which must end cleanly exactly when it is valid */
+static void check_documents(void) {
+	unsigned long i;
+	enum JsonType type;
+	struct JsonParser parser;
+	struct JsonToken token;
+
+	for (i = 0; i < sizeof(documents) / sizeof(documents[0]); i++) {
+		json_init(&parser, documents[i].text, strlen(documents[i].text));
+
+		while ((type = json_next(&parser, &token)) != JSON_END && type != JSON_ERROR)
+			;
+
+		if ((type == JSON_END) != documents[i].valid) {
+			fprintf(stderr, "%s: read %s, expected %s\n", documents[i].text, (type == JSON_END ? "TRUE" : "FALSE"), (documents[i].valid ? "TRUE" : "FALSE"));
+			failures++;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	unsigned long i;
+	struct Arena arena;
+	struct SymbolTable symbols;
+	struct PriceTable prices;
+	struct OptionTable options;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: ./yahoo_check fixture_directory\n");
+		return EXIT_FAILURE;
+	}
+
+	arena_init(&arena);
+	symbol_table_init(&symbols, &arena);
+	price_table_init(&prices, &arena);
+	option_table_init(&options, &arena);
+
+	// every fixture appends to the same tables, as gather_raw does, so a failed parse must leave them as they were
+	for (i = 0; i < sizeof(charts) / sizeof(charts[0]); i++)
+		check_chart(argv[1], &charts[i], &symbols, &prices);
+
+	for (i = 0; i < sizeof(chains) / sizeof(chains[0]); i++)
+		check_options(argv[1], &chains[i], &symbols, &options);
+
+	check_documents();
+
+	symbol_table_free(&symbols);
+	arena_free(&arena);
+
+	printf("yahoo_check: %lu fixtures, %lu documents, %d failures\n", sizeof(charts) / sizeof(charts[0]) + sizeof(chains) / sizeof(chains[0]),
+	       sizeof(documents) / sizeof(documents[0]), failures);
+
+	return (failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}